@@ -0,0 +1,438 @@
+#define _POSIX_C_SOURCE 200809L /* clock_gettime, getrusage */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "../include/macro.h"
+#include "../include/symbol_table.h"
+#include "../include/second_pass.h"
+#include "../include/errors.h"
+
+/*
+ * =====================================================================================
+ * Filename:  assembler_bench.c
+ * Description: End-to-end benchmark runner of the assembler.
+ * Every corpus (.as file, usually written by gen_workload) is assembled through the
+ * same file based pipeline as the assembler executable: preprocess_file, first_pass
+ * and second_pass writing the .am/.ob/.ent/.ext files next to the corpus. For the
+ * best of N iterations it reports lines/s, MB/s and the time of every phase, plus the
+ * peak RSS and the number of heap allocations of one assembly.
+ * Results can be written as JSON and compared against a baseline of the same
+ * format; a throughput drop or allocation growth beyond its threshold fails the run.
+ * The allocation counts are the same on every host, while the throughput is taken
+ * from --timing-baseline when one was recorded on this host.
+ *
+ * Usage: assembler_bench [-n <iterations>] [--json=<out>] [--baseline=<file>]
+ *                        [--timing-baseline=<file>] [--threshold=<percent>]
+ *                        [--alloc-threshold=<percent>] <corpus.as> ...
+ * =====================================================================================
+ */
+
+#define DEFAULT_ITERATIONS 5
+#define DEFAULT_THRESHOLD 10.0 /* percent */
+#define DEFAULT_ALLOC_THRESHOLD 0.0 /* percent, the counts do not vary between runs */
+#define MAX_NAME_LENGTH 128
+#define MAX_PATH_LENGTH 1024
+
+/* Phases timed separately. */
+enum { PHASE_PREPROCESS, PHASE_FIRST_PASS, PHASE_SECOND_PASS, N_PHASES };
+
+static const char *const PHASE_KEYS[N_PHASES] = {"preprocess", "first_pass", "second_pass"};
+
+/* struct bench_result_t holds the measurements of one corpus. */
+typedef struct {
+    char name[MAX_NAME_LENGTH]; /* corpus file name without directory and extension */
+    long lines;
+    long bytes;
+    double seconds; /* best iteration */
+    double phase_seconds[N_PHASES]; /* split of the best iteration */
+    long peak_rss_kb; /* -1 if unknown */
+    unsigned long allocations; /* heap allocations of one assembly */
+} bench_result_t;
+
+/* --- Allocation counting --- */
+
+/* With BENCH_COUNT_ALLOCS the build links with -Wl,--wrap=malloc,... so that every
+ * allocation of the assembler core goes through the counters below.
+ */
+static unsigned long alloc_count = 0;
+
+#ifdef BENCH_COUNT_ALLOCS
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    alloc_count++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+    alloc_count++;
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *p, size_t size) {
+    alloc_count++;
+    return __real_realloc(p, size);
+}
+#endif
+
+/* --- Private Helper Functions --- */
+
+/* Returns the monotonic clock in seconds. */
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/* Resets the peak RSS of the process so every corpus is measured on its own.
+ * Linux only; elsewhere the peak is the one of the whole run.
+ */
+static void reset_peak_rss(void) {
+    FILE *fp = fopen("/proc/self/clear_refs", "w");
+    if (fp) {
+        fputs("5", fp);
+        fclose(fp);
+    }
+}
+
+/* Returns the peak RSS in KB, or -1 if unknown. */
+static long peak_rss_kb(void) {
+    char line[128];
+    long kb = -1;
+    struct rusage ru;
+    FILE *fp = fopen("/proc/self/status", "r");
+
+    if (fp) {
+        while (fgets(line, sizeof(line), fp)) {
+            if (strncmp(line, "VmHWM:", 6) == 0) {
+                kb = strtol(line + 6, NULL, 10);
+                break;
+            }
+        }
+        fclose(fp);
+    }
+    if (kb < 0 && getrusage(RUSAGE_SELF, &ru) == 0) kb = (long) ru.ru_maxrss;
+    return kb;
+}
+
+/* Counts the lines and bytes of a file. Returns 0 on success. */
+static int measure_file(const char *path, long *lines, long *bytes) {
+    FILE *fp = fopen(path, "rb");
+    int c;
+
+    if (!fp) return -1;
+    *lines = 0;
+    *bytes = 0;
+    while ((c = getc(fp)) != EOF) {
+        (*bytes)++;
+        if (c == '\n') (*lines)++;
+    }
+    fclose(fp);
+    return 0;
+}
+
+/* Splits "dir/name.as" into the base path "dir/name" and the name "name".
+ * Returns 0 on success, -1 if the path does not end in .as.
+ */
+static int split_corpus_path(const char *path, char *base, size_t base_size, char *name) {
+    size_t len = strlen(path);
+    const char *slash, *start;
+    size_t name_len;
+
+    if (len < 4 || strcmp(path + len - 3, ".as") != 0 || len - 3 >= base_size) return -1;
+    memcpy(base, path, len - 3);
+    base[len - 3] = '\0';
+
+    slash = strrchr(base, '/');
+    start = slash ? slash + 1 : base;
+    name_len = strlen(start);
+    if (name_len >= MAX_NAME_LENGTH) name_len = MAX_NAME_LENGTH - 1;
+    memcpy(name, start, name_len);
+    name[name_len] = '\0';
+    return 0;
+}
+
+/* Assembles one corpus through the file pipeline, timing each phase.
+ * Returns 0 on success, -1 on failure.
+ */
+static int assemble_once(const char *as_path, const char *am_path, const char *base, double *phases) {
+    symbol_table_t *symtab;
+    double t0, t1, t2, t3;
+    int status = -1;
+
+    t0 = now_seconds();
+    if (preprocess_file(as_path, am_path) != 0) return -1;
+    t1 = now_seconds();
+
+    symtab = symtab_create();
+    if (!symtab) return -1;
+    if (first_pass(am_path, symtab) == 0) {
+        t2 = now_seconds();
+        status = second_pass(am_path, base, symtab, NULL);
+        t3 = now_seconds();
+        phases[PHASE_PREPROCESS] = t1 - t0;
+        phases[PHASE_FIRST_PASS] = t2 - t1;
+        phases[PHASE_SECOND_PASS] = t3 - t2;
+    }
+    symtab_destroy(symtab);
+    return status;
+}
+
+/* Benchmarks one corpus. Returns 0 on success, -1 on failure. */
+static int bench_corpus(const char *as_path, int iterations, bench_result_t *r) {
+    char base[MAX_PATH_LENGTH], am_path[MAX_PATH_LENGTH + 4];
+    double phases[N_PHASES], total;
+    unsigned long allocs_before;
+    int i, p;
+
+    memset(r, 0, sizeof(*r));
+    if (split_corpus_path(as_path, base, sizeof(base), r->name) != 0) {
+        printf("%s: corpus files must end in .as\n", as_path);
+        return -1;
+    }
+    sprintf(am_path, "%s.am", base);
+    if (measure_file(as_path, &r->lines, &r->bytes) != 0) {
+        printf("%s: cannot read file\n", as_path);
+        return -1;
+    }
+
+    reset_peak_rss();
+    r->seconds = -1.0;
+    for (i = 0; i < iterations; i++) {
+        allocs_before = alloc_count;
+        if (assemble_once(as_path, am_path, base, phases) != 0) {
+            printf("%s: assembly failed\n", as_path);
+            return -1;
+        }
+        r->allocations = alloc_count - allocs_before;
+
+        total = 0;
+        for (p = 0; p < N_PHASES; p++) total += phases[p];
+        if (r->seconds < 0 || total < r->seconds) {
+            r->seconds = total;
+            memcpy(r->phase_seconds, phases, sizeof(phases));
+        }
+    }
+    r->peak_rss_kb = peak_rss_kb();
+    if (r->seconds <= 0) r->seconds = 1e-9;
+    return 0;
+}
+
+/* Prints the human readable line of a result. */
+static void print_result(const bench_result_t *r) {
+    printf("%-16s %9ld lines %7.2f MB  %10.0f lines/s %7.2f MB/s  pre %.3fs p1 %.3fs p2 %.3fs  rss %ld KB  allocs %lu\n",
+           r->name, r->lines, (double) r->bytes / 1e6,
+           (double) r->lines / r->seconds, (double) r->bytes / r->seconds / 1e6,
+           r->phase_seconds[PHASE_PREPROCESS], r->phase_seconds[PHASE_FIRST_PASS],
+           r->phase_seconds[PHASE_SECOND_PASS], r->peak_rss_kb, r->allocations);
+}
+
+/* Writes the results as JSON. Returns 0 on success. */
+static int write_json(const char *path, const bench_result_t *results, int n, int iterations) {
+    FILE *fp = fopen(path, "w");
+    int i, p;
+
+    if (!fp) return -1;
+    fprintf(fp, "{\n  \"iterations\": %d,\n  \"results\": [\n", iterations);
+    for (i = 0; i < n; i++) {
+        const bench_result_t *r = &results[i];
+        fprintf(fp, "    {\n");
+        fprintf(fp, "      \"name\": \"%s\",\n", r->name);
+        fprintf(fp, "      \"lines\": %ld,\n", r->lines);
+        fprintf(fp, "      \"bytes\": %ld,\n", r->bytes);
+        fprintf(fp, "      \"seconds\": %.6f,\n", r->seconds);
+        fprintf(fp, "      \"lines_per_s\": %.1f,\n", (double) r->lines / r->seconds);
+        fprintf(fp, "      \"mb_per_s\": %.3f,\n", (double) r->bytes / r->seconds / 1e6);
+        fprintf(fp, "      \"phases\": {");
+        for (p = 0; p < N_PHASES; p++) {
+            fprintf(fp, "%s\"%s\": %.6f", p ? ", " : "", PHASE_KEYS[p], r->phase_seconds[p]);
+        }
+        fprintf(fp, "},\n");
+        fprintf(fp, "      \"peak_rss_kb\": %ld,\n", r->peak_rss_kb);
+        fprintf(fp, "      \"allocations\": %lu\n", r->allocations);
+        fprintf(fp, "    }%s\n", i + 1 < n ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+    return fclose(fp) == 0 ? 0 : -1;
+}
+
+/* Reads a whole file into a null terminated buffer. Returns NULL on failure. */
+static char *read_text(const char *path) {
+    FILE *fp = fopen(path, "rb");
+    char *buf = NULL;
+    long size;
+
+    if (!fp) return NULL;
+    if (fseek(fp, 0, SEEK_END) == 0 && (size = ftell(fp)) >= 0 && fseek(fp, 0, SEEK_SET) == 0) {
+        buf = malloc((size_t) size + 1);
+        if (buf && fread(buf, 1, (size_t) size, fp) != (size_t) size) {
+            free(buf);
+            buf = NULL;
+        }
+        if (buf) buf[size] = '\0';
+    }
+    fclose(fp);
+    return buf;
+}
+
+/* Finds the numeric value of "key" inside the baseline object [obj, end).
+ * Returns 0 on success, -1 if missing.
+ */
+static int find_number(const char *obj, const char *end, const char *key, double *value) {
+    char pattern[64];
+    const char *p;
+
+    sprintf(pattern, "\"%s\":", key);
+    p = strstr(obj, pattern);
+    if (!p || (end && p >= end)) return -1;
+    *value = strtod(p + strlen(pattern), NULL);
+    return 0;
+}
+
+/* Finds the object of the result called name in a baseline text.
+ * Returns the object, or NULL if missing; *next is the start of the following one.
+ */
+static const char *find_result(const char *text, const char *name, const char **next) {
+    char pattern[MAX_NAME_LENGTH + 16];
+    const char *obj;
+
+    sprintf(pattern, "\"name\": \"%s\"", name);
+    obj = strstr(text, pattern);
+    *next = obj ? strstr(obj + 1, "\"name\":") : NULL;
+    return obj;
+}
+
+/* Compares the allocation counts with the checked-in baseline, which holds on every
+ * host, and the throughput with the timing baseline of this host. Without a timing
+ * baseline the throughput is compared with the checked-in one but only reported.
+ * Returns the number of regressions, or -1 if the baseline cannot be read.
+ */
+static int compare_baseline(const char *path, const char *timing_path, const bench_result_t *results, int n,
+                            const double threshold, const double alloc_threshold) {
+    char *text, *timing_text = NULL;
+    const char *obj, *next, *timing_obj, *timing_next;
+    double base_lps, base_allocs, lps, change;
+    int i, regressions = 0, check_timing = 1;
+
+    text = read_text(path);
+    if (!text) return -1;
+    if (timing_path) timing_text = read_text(timing_path);
+    if (timing_path && !timing_text) {
+        printf("No timing baseline %s, throughput is only reported (run the bench-baseline target)\n",
+               timing_path);
+        check_timing = 0;
+    }
+
+    printf("Allocations against %s, threshold %.1f%%\n", path, alloc_threshold);
+    printf("Throughput against %s, threshold %.1f%%:\n", timing_text ? timing_path : path, threshold);
+    for (i = 0; i < n; i++) {
+        obj = find_result(text, results[i].name, &next);
+        timing_obj = obj;
+        timing_next = next;
+        if (timing_text) timing_obj = find_result(timing_text, results[i].name, &timing_next);
+        if (!obj && !timing_obj) {
+            printf("  %-16s not in baseline\n", results[i].name);
+            continue;
+        }
+        printf("  %-16s", results[i].name);
+        if (timing_obj && find_number(timing_obj, timing_next, "lines_per_s", &base_lps) == 0 && base_lps > 0) {
+            lps = (double) results[i].lines / results[i].seconds;
+            change = 100.0 * (lps - base_lps) / base_lps;
+            printf(" %10.0f lines/s vs %10.0f (%+.1f%%)", lps, base_lps, change);
+            if (check_timing && change < -threshold) {
+                printf("  REGRESSION");
+                regressions++;
+            }
+        } else {
+            printf(" baseline has no throughput");
+        }
+#ifdef BENCH_COUNT_ALLOCS
+        if (obj && find_number(obj, next, "allocations", &base_allocs) == 0 && base_allocs > 0) {
+            printf("  allocs %lu vs %.0f", results[i].allocations, base_allocs);
+            if ((double) results[i].allocations > base_allocs * (1.0 + alloc_threshold / 100.0)) {
+                printf("  ALLOCATIONS");
+                regressions++;
+            }
+        }
+#else
+        (void) base_allocs;
+#endif
+        printf("\n");
+    }
+    free(timing_text);
+    free(text);
+    return regressions;
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [-n <iterations>] [--json=<out>] [--baseline=<file>] [--timing-baseline=<file>]"
+           " [--threshold=<percent>] [--alloc-threshold=<percent>] <corpus.as> ...\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    bench_result_t *results;
+    const char *json_path = NULL;
+    const char *baseline_path = NULL;
+    const char *timing_path = NULL;
+    double threshold = DEFAULT_THRESHOLD;
+    double alloc_threshold = DEFAULT_ALLOC_THRESHOLD;
+    int iterations = DEFAULT_ITERATIONS;
+    int i, n = 0, failed = 0, regressions;
+
+    results = malloc(sizeof(bench_result_t) * (size_t) argc);
+    if (!results) return 1;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+        } else if (strncmp(argv[i], "--json=", 7) == 0) {
+            json_path = argv[i] + 7;
+        } else if (strncmp(argv[i], "--baseline=", 11) == 0) {
+            baseline_path = argv[i] + 11;
+        } else if (strncmp(argv[i], "--timing-baseline=", 18) == 0) {
+            timing_path = argv[i] + 18;
+        } else if (strncmp(argv[i], "--threshold=", 12) == 0) {
+            threshold = strtod(argv[i] + 12, NULL);
+        } else if (strncmp(argv[i], "--alloc-threshold=", 18) == 0) {
+            alloc_threshold = strtod(argv[i] + 18, NULL);
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            free(results);
+            return 1;
+        } else if (bench_corpus(argv[i], iterations < 1 ? 1 : iterations, &results[n]) == 0) {
+            print_result(&results[n++]);
+        } else {
+            failed = 1;
+        }
+    }
+    if (n == 0 && !failed) {
+        usage(argv[0]);
+        free(results);
+        return 1;
+    }
+#ifndef BENCH_COUNT_ALLOCS
+    printf("(allocation counting unavailable in this build)\n");
+#endif
+
+    if (json_path && write_json(json_path, results, n, iterations) != 0) {
+        printf("Cannot write %s\n", json_path);
+        failed = 1;
+    }
+    if (baseline_path) {
+        regressions = compare_baseline(baseline_path, timing_path, results, n, threshold, alloc_threshold);
+        if (regressions < 0) {
+            printf("Cannot read baseline %s\n", baseline_path);
+            failed = 1;
+        } else if (regressions > 0) {
+            printf("%d regression(s)\n", regressions);
+            free(results);
+            return 2;
+        }
+    }
+    free(results);
+    return failed;
+}
@@ -0,0 +1,438 @@
+#define _POSIX_C_SOURCE 200809L /* clock_gettime, fmemopen, open_memstream */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../include/macro.h"
+#include "../include/line_parser.h"
+#include "../include/symbol_table.h"
+#include "../include/second_pass.h"
+#include "../include/errors.h"
+
+/*
+ * =====================================================================================
+ * Filename:  phase_bench.c
+ * Description: Per-phase microbenchmarks of the assembler on in-memory inputs.
+ * Every corpus is read into memory once; afterwards no phase touches the disk:
+ * sources are read through fmemopen and outputs go to open_memstream buffers, so
+ * file system noise stays out of the numbers. Each phase is timed on its own and
+ * reported, best of N iterations, per unit of work:
+ *
+ *   preprocess     preprocess_stream (macro expansion), ns per source line
+ *   first_pass     first_pass_stream (symbol building), ns per preprocessed line
+ *   encode         encode_instruction/encode_data on pre-parsed lines, ns per word
+ *   word_to_base4  conversion of all 1024 word values, ns per word
+ *   write_ob       write_ob_stream, ns per word
+ *   write_ent      write_ent_stream, ns per entry
+ *   write_ext      write_ext_stream, ns per external usage
+ *
+ * The file based preprocess_file and write_*_file are thin wrappers that open
+ * the files and call the stream functions measured here.
+ *
+ * Usage: phase_bench [-n <iterations>] <corpus.as> ...
+ * =====================================================================================
+ */
+
+#define DEFAULT_ITERATIONS 5
+#define PARSE_CHUNK 1024 /* lines parsed ahead of one timed encoding run */
+#define BASE4_ROUNDS 1000 /* passes over the 1024 word values */
+
+/* struct corpus_t is a corpus loaded in memory with its preprocessed text. */
+typedef struct {
+    const char *path;
+    char *src; /* .as text */
+    size_t src_len;
+    long src_lines;
+    char *am; /* preprocessed text */
+    size_t am_len;
+    long am_lines;
+} corpus_t;
+
+/* Phases measured, with the unit of work each one is reported per. */
+enum {
+    PHASE_PREPROCESS, PHASE_FIRST_PASS, PHASE_ENCODE, PHASE_BASE4,
+    PHASE_WRITE_OB, PHASE_WRITE_ENT, PHASE_WRITE_EXT, N_PHASES
+};
+
+static const char *const PHASE_NAMES[N_PHASES] = {
+    "preprocess", "first_pass", "encode", "word_to_base4", "write_ob", "write_ent", "write_ext"
+};
+
+static const char *const PHASE_UNITS[N_PHASES] = {
+    "line", "line", "word", "word", "word", "entry", "usage"
+};
+
+/* struct phase_result_t holds the best time of every phase and its work. */
+typedef struct {
+    double seconds[N_PHASES]; /* best iteration, -1 if not measured */
+    long units[N_PHASES]; /* lines, words or records handled by one iteration */
+    unsigned long checksum; /* sum over the base-4 digits, keeps them observable */
+} phase_result_t;
+
+/* --- Private Helper Functions --- */
+
+/* Returns the monotonic clock in seconds. */
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/* Reads a whole file into a null terminated buffer. Returns NULL on failure. */
+static char *read_text(const char *path, size_t *len) {
+    FILE *fp = fopen(path, "rb");
+    char *buf = NULL;
+    long size;
+
+    if (!fp) return NULL;
+    if (fseek(fp, 0, SEEK_END) == 0 && (size = ftell(fp)) >= 0 && fseek(fp, 0, SEEK_SET) == 0) {
+        buf = malloc((size_t) size + 1);
+        if (buf && fread(buf, 1, (size_t) size, fp) != (size_t) size) {
+            free(buf);
+            buf = NULL;
+        }
+        if (buf) {
+            buf[size] = '\0';
+            *len = (size_t) size;
+        }
+    }
+    fclose(fp);
+    return buf;
+}
+
+/* Counts the newline terminated lines of a buffer. */
+static long count_lines(const char *text, size_t len) {
+    long n = 0;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        if (text[i] == '\n') n++;
+    }
+    return n;
+}
+
+/* Opens a read stream over an in-memory text (fmemopen rejects empty buffers). */
+static FILE *open_text(char *text, size_t len) {
+    static char empty[1];
+    return len ? fmemopen(text, len, "r") : fmemopen(empty, 1, "r");
+}
+
+/* Keeps the smaller of two timings, a negative best means none yet. */
+static void keep_best(double *best, double seconds) {
+    if (*best < 0 || seconds < *best) *best = seconds;
+}
+
+/* Prints one result line, units is the amount of work of one iteration. */
+static void print_phase(const char *name, double seconds, long units, const char *unit) {
+    if (units <= 0 || seconds < 0) {
+        printf("  %-14s %10s\n", name, "-");
+        return;
+    }
+    printf("  %-14s %10.1f ns/%-6s (%ld in %.3f ms)\n", name, seconds * 1e9 / (double) units,
+           unit, units, seconds * 1e3);
+}
+
+/* Runs the preprocessor from memory to memory. Returns the elapsed seconds or -1.
+ * If keep is set the output buffer is stored in the corpus.
+ */
+static double run_preprocess(corpus_t *c, int keep) {
+    FILE *in, *out;
+    char *am = NULL;
+    size_t am_len = 0;
+    double t0, t1;
+    int status;
+
+    in = open_text(c->src, c->src_len);
+    out = open_memstream(&am, &am_len);
+    if (!in || !out) {
+        if (in) fclose(in);
+        if (out) fclose(out);
+        free(am);
+        return -1;
+    }
+    t0 = now_seconds();
+    status = preprocess_stream(in, out);
+    fflush(out);
+    t1 = now_seconds();
+    fclose(in);
+    fclose(out);
+
+    if (status != 0) {
+        free(am);
+        return -1;
+    }
+    if (keep) {
+        c->am = am;
+        c->am_len = am_len;
+        c->am_lines = count_lines(am, am_len);
+    } else {
+        free(am);
+    }
+    return t1 - t0;
+}
+
+/* Builds the symbol table of the preprocessed text into *symtab.
+ * Returns the elapsed seconds or -1; the caller destroys *symtab.
+ */
+static double run_first_pass(corpus_t *c, symbol_table_t **symtab) {
+    FILE *in;
+    double t0, t1;
+    int status;
+
+    *symtab = symtab_create();
+    in = open_text(c->am, c->am_len);
+    if (!*symtab || !in) {
+        if (in) fclose(in);
+        return -1;
+    }
+    t0 = now_seconds();
+    status = first_pass_stream(in, c->path, *symtab);
+    t1 = now_seconds();
+    fclose(in);
+    return status == 0 ? t1 - t0 : -1;
+}
+
+/* Encodes the preprocessed text, timing only the encoders: lines are parsed
+ * PARSE_CHUNK at a time outside of the clock. Returns the elapsed seconds or -1
+ * and stores the number of words encoded.
+ */
+static double run_encode(corpus_t *c, symbol_table_t *symtab, parsed_line *chunk, long *words) {
+    second_pass_ctx_t ctx;
+    char line_buf[MAX_LINE_LENGTH];
+    FILE *in;
+    double t0, total = 0;
+    int n, i, done = 0, status = 0;
+
+    in = open_text(c->am, c->am_len);
+    if (!in) return -1;
+    memset(&ctx, 0, sizeof(ctx));
+    vec_create(&ctx.code_image, sizeof(WORD));
+    vec_create(&ctx.data_image, sizeof(WORD));
+    vec_create(&ctx.ext_list, sizeof(ext_usage_t));
+
+    while (!done && status == 0) {
+        for (n = 0; n < PARSE_CHUNK;) {
+            if (!fgets(line_buf, sizeof(line_buf), in)) {
+                done = 1;
+                break;
+            }
+            if (parse_line(line_buf, &chunk[n]) != ERROR_OK) continue;
+            if (chunk[n].kind == LINE_OPERATION ||
+                (chunk[n].kind == LINE_DIRECTIVE && (chunk[n].body.directive.type == DATA_DIRECTIVE ||
+                                                     chunk[n].body.directive.type == STRING_DIRECTIVE ||
+                                                     chunk[n].body.directive.type == MATRIX_DIRECTIVE))) {
+                n++;
+            }
+        }
+
+        t0 = now_seconds();
+        for (i = 0; i < n; i++) {
+            if (chunk[i].kind == LINE_OPERATION) {
+                if (encode_instruction(&ctx, &chunk[i], symtab) < 0) {
+                    status = -1;
+                    break;
+                }
+            } else {
+                encode_data(&ctx, &chunk[i]);
+            }
+        }
+        total += now_seconds() - t0;
+    }
+    fclose(in);
+
+    *words = (long) ctx.code_pos + ctx.data_pos;
+    if (ctx.out_failed) status = -1;
+    second_pass_ctx_destroy(&ctx);
+    return status == 0 ? total : -1;
+}
+
+/* Converts every 10-bit value BASE4_ROUNDS times. Returns the elapsed seconds. */
+static double run_word_to_base4(unsigned long *checksum) {
+    char out[6];
+    double t0;
+    int r, w;
+
+    t0 = now_seconds();
+    for (r = 0; r < BASE4_ROUNDS; r++) {
+        for (w = 0; w <= WORD_MASK; w++) {
+            word_to_base4((WORD) w, out, sizeof(out));
+            *checksum += (unsigned char) out[r % 5];
+        }
+    }
+    return now_seconds() - t0;
+}
+
+/* Runs one writer into a memory stream. Returns the elapsed seconds or -1. */
+static double run_writer(int phase, const second_pass_ctx_t *ctx, symbol_table_t *symtab) {
+    FILE *out;
+    char *text = NULL;
+    size_t len = 0;
+    double t0, t1;
+    int status;
+
+    out = open_memstream(&text, &len);
+    if (!out) return -1;
+    t0 = now_seconds();
+    if (phase == PHASE_WRITE_OB) {
+        status = write_ob_stream(out, ctx);
+    } else if (phase == PHASE_WRITE_ENT) {
+        status = write_ent_stream(out, symtab);
+    } else {
+        status = write_ext_stream(out, ctx);
+    }
+    fflush(out);
+    t1 = now_seconds();
+    fclose(out);
+    free(text);
+    return status == 0 ? t1 - t0 : -1;
+}
+
+/* Counts the entry symbols of a table. */
+static long count_entries(symbol_table_t *symtab) {
+    hash_entry_t *it = NULL;
+    symbol_t *sym;
+    long n = 0;
+
+    while ((sym = symtab_iter_next(symtab, &it)) != NULL) {
+        if (sym->flags & SYM_ENTRY) n++;
+    }
+    return n;
+}
+
+/* Measures every phase of a loaded corpus into r. The symbol table and the
+ * second pass context built on the way are left to the caller to release.
+ * Returns 0 on success, -1 on failure.
+ */
+static int measure_corpus(corpus_t *c, int iterations, parsed_line *chunk, symbol_table_t **symtab,
+                          second_pass_ctx_t *ctx, phase_result_t *r) {
+    FILE *in;
+    double t;
+    int i, p, status;
+
+    for (p = 0; p < N_PHASES; p++) r->seconds[p] = -1;
+
+    /* the first run keeps the preprocessed text every later phase works on */
+    for (i = 0; i < iterations; i++) {
+        if ((t = run_preprocess(c, i == 0)) < 0) {
+            printf("%s: preprocessing failed\n", c->path);
+            return -1;
+        }
+        keep_best(&r->seconds[PHASE_PREPROCESS], t);
+    }
+    r->units[PHASE_PREPROCESS] = c->src_lines;
+
+    for (i = 0; i < iterations; i++) {
+        if (*symtab) symtab_destroy(*symtab);
+        if ((t = run_first_pass(c, symtab)) < 0) {
+            printf("%s: first pass failed\n", c->path);
+            return -1;
+        }
+        keep_best(&r->seconds[PHASE_FIRST_PASS], t);
+    }
+    r->units[PHASE_FIRST_PASS] = c->am_lines;
+
+    for (i = 0; i < iterations; i++) {
+        if ((t = run_encode(c, *symtab, chunk, &r->units[PHASE_ENCODE])) < 0) {
+            printf("%s: encoding failed\n", c->path);
+            return -1;
+        }
+        keep_best(&r->seconds[PHASE_ENCODE], t);
+    }
+
+    for (i = 0; i < iterations; i++) {
+        keep_best(&r->seconds[PHASE_BASE4], run_word_to_base4(&r->checksum));
+    }
+    r->units[PHASE_BASE4] = (long) BASE4_ROUNDS * (WORD_MASK + 1);
+
+    /* the writers need a complete context, built once by the second pass */
+    in = open_text(c->am, c->am_len);
+    if (!in) return -1;
+    status = second_pass_stream(in, c->path, *symtab, ctx);
+    fclose(in);
+    if (status != 0) {
+        printf("%s: second pass failed\n", c->path);
+        return -1;
+    }
+    r->units[PHASE_WRITE_OB] = (long) ctx->code_pos + ctx->data_pos;
+    r->units[PHASE_WRITE_ENT] = count_entries(*symtab);
+    r->units[PHASE_WRITE_EXT] = (long) ctx->ext_list.len;
+    for (p = PHASE_WRITE_OB; p <= PHASE_WRITE_EXT; p++) {
+        for (i = 0; i < iterations; i++) {
+            if ((t = run_writer(p, ctx, *symtab)) < 0) {
+                printf("%s: %s failed\n", c->path, PHASE_NAMES[p]);
+                return -1;
+            }
+            keep_best(&r->seconds[p], t);
+        }
+    }
+    return 0;
+}
+
+/* Benchmarks every phase of one corpus file. Returns 0 on success, -1 on failure. */
+static int bench_corpus(const char *path, int iterations, parsed_line *chunk) {
+    corpus_t c;
+    phase_result_t r;
+    symbol_table_t *symtab = NULL;
+    second_pass_ctx_t ctx;
+    int p, status;
+
+    memset(&c, 0, sizeof(c));
+    memset(&r, 0, sizeof(r));
+    memset(&ctx, 0, sizeof(ctx));
+    c.path = path;
+    c.src = read_text(path, &c.src_len);
+    if (!c.src) {
+        printf("%s: cannot read file\n", path);
+        return -1;
+    }
+    c.src_lines = count_lines(c.src, c.src_len);
+
+    status = measure_corpus(&c, iterations, chunk, &symtab, &ctx, &r);
+    if (status == 0) {
+        printf("%s: %ld lines, %ld preprocessed lines, %ld words\n",
+               path, c.src_lines, c.am_lines, r.units[PHASE_ENCODE]);
+        for (p = 0; p < N_PHASES; p++) {
+            print_phase(PHASE_NAMES[p], r.seconds[p], r.units[p], PHASE_UNITS[p]);
+        }
+        if (r.checksum == 0) printf("  (empty conversion)\n"); /* keeps the conversions observable */
+    }
+
+    second_pass_ctx_destroy(&ctx);
+    if (symtab) symtab_destroy(symtab);
+    free(c.src);
+    free(c.am);
+    return status;
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [-n <iterations>] <corpus.as> ...\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    parsed_line *chunk;
+    int iterations = DEFAULT_ITERATIONS;
+    int i, ran = 0, failed = 0;
+
+    chunk = malloc(sizeof(parsed_line) * PARSE_CHUNK);
+    if (!chunk) return 1;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+            if (iterations < 1) iterations = 1;
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            free(chunk);
+            return 1;
+        } else {
+            if (bench_corpus(argv[i], iterations, chunk) != 0) failed = 1;
+            ran++;
+        }
+    }
+    free(chunk);
+    if (!ran) {
+        usage(argv[0]);
+        return 1;
+    }
+    return failed;
+}
@@ -0,0 +1,92 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+#include <stddef.h>
+#include "object_file.h"
+
+/*
+ * =====================================================================================
+ * Filename:  archive.h
+ * Description: Static archives of assembled modules. An archive packs the .ob, .ent
+ * and .ext texts of many modules into one file, together with a prebuilt index from
+ * every entry symbol to the member exporting it. The index is an open addressing
+ * hash table stored in the file, so an opened (memory mapped) archive answers a
+ * symbol lookup in O(1) without reading any member.
+ *
+ * File layout, every number a 32 bit big-endian value:
+ *   header   magic "ASMARCH1", member count, slot count, offsets of the member
+ *            table, the slot table and the string area, file size
+ *   members  per member: name, .ob, .ent and .ext as (offset, length) pairs
+ *   slots    per slot: hash of the symbol, offset of its name (0 = empty), member
+ *   strings  NUL terminated names and the member texts, the file ends with a NUL
+ * =====================================================================================
+ */
+
+/* struct archive_t is an opened archive, mapped read-only. */
+typedef struct {
+    char *path; /* used in diagnostics */
+    const unsigned char *base; /* the mapped file */
+    size_t size;
+    unsigned long n_members;
+    unsigned long n_slots; /* power of two */
+    const unsigned char *members;
+    const unsigned char *slots;
+} archive_t;
+
+/**
+ * @brief Pack modules into a new archive
+ *
+ * Every module is read with object_read first, so broken objects are rejected.
+ * An entry symbol exported by two members is an error.
+ *
+ * @param path Path of the archive to write
+ * @param modules Base names of the modules, without extension
+ * @param n_modules Number of modules
+ * @return 0 on success, -1 on errors (reported with print_error_file)
+ */
+int archive_write(const char *path, char *const *modules, int n_modules);
+
+/**
+ * @brief Map an archive and check its layout
+ *
+ * @param path Path of the archive
+ * @param ar Receives the archive, must be released with archive_close on success
+ * @return 0 on success, -1 if the file cannot be mapped or is not a valid archive
+ */
+int archive_open(const char *path, archive_t *ar);
+
+/**
+ * @brief Unmap an archive
+ *
+ * @param ar Archive opened by archive_open
+ */
+void archive_close(archive_t *ar);
+
+/**
+ * @brief Find the member exporting a symbol
+ *
+ * @param ar Opened archive
+ * @param symbol Name of the entry symbol
+ * @return Index of the member, or -1 if no member exports the symbol
+ */
+int archive_find(const archive_t *ar, const char *symbol);
+
+/**
+ * @brief Name of a member, as given when the archive was written
+ *
+ * @param ar Opened archive
+ * @param member Index of the member
+ * @return The name, pointing into the mapped file
+ */
+const char *archive_member_name(const archive_t *ar, int member);
+
+/**
+ * @brief Read a member into a module
+ *
+ * @param ar Opened archive
+ * @param member Index of the member
+ * @param obj Receives the module, must be released with object_free
+ * @return 0 on success, -1 if the member is malformed
+ */
+int archive_load_member(const archive_t *ar, int member, object_t *obj);
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef COST_H
+#define COST_H
+#include <stdio.h>
+#include "line_parser.h"
+#include "symbol_table.h"
+#include "util_vec.h"
+
+/*
+ * =====================================================================================
+ * Filename:  cost.h
+ * Description: Static cost estimate of assembled code (--cost). The second pass
+ * hands every instruction it encodes to the estimator, which keeps a small record
+ * of it: its address, its words, its cycles from a cost table keyed by opcode and
+ * addressing modes, and the target of a direct jump or call. After the pass the
+ * records are cut into routines and basic blocks, and each routine gets its size,
+ * its best and worst case cycles along one path and a loop weighted estimate.
+ * =====================================================================================
+ */
+
+#define COST_OPCODES 16 /* opcodes of the cost table */
+#define COST_MODES 4 /* addressing modes of the cost table */
+#define COST_DEFAULT_LOOP_WEIGHT 10 /* iterations assumed for every loop level */
+#define COST_NO_LABEL "(no label)" /* routine at the start of the code without a label */
+
+/* struct cost_table_t is the cycles an instruction is charged. */
+typedef struct {
+    int cycles[COST_OPCODES][COST_MODES][COST_MODES]; /* opcode, source mode, destination mode */
+    int loop_weight; /* factor applied per loop nesting level of a block */
+} cost_table_t;
+
+/* struct cost_t collects the instructions of one source during the second pass. */
+typedef struct {
+    const cost_table_t *table;
+    vec_t insns; /* cost_insn_t, by address */
+    int failed; /* set when a record could not be stored */
+} cost_t;
+
+/* struct cost_routine_t is the estimate of one routine.
+ * A routine starts at the first instruction, at a .entry label or at the target of
+ * a jsr, and ends before the next one. Best and worst follow one path from its
+ * start to a rts, stop or jump out of it: loops are taken once (back edges are not
+ * followed) and a jsr costs its own cycles only. The weighted estimate sums the
+ * cycles of every block, multiplied by the loop weight once per enclosing loop.
+ */
+typedef struct {
+    char name[MAX_LABEL_LENGTH];
+    int address;
+    int words;
+    int blocks;
+    int loops; /* back edges */
+    long best;
+    long worst;
+    double weighted;
+} cost_routine_t;
+
+/**
+ * @brief Fill a cost table with the cycle model of the emulator (see isa_cycles)
+ *
+ * @param table Table to fill
+ */
+void cost_table_default(cost_table_t *table);
+
+/**
+ * @brief Override entries of a cost table from a file
+ *
+ * Each line is "<mnemonic> <source mode> <destination mode> <cycles>", where a mode
+ * is 0 to 3 (immediate, direct, matrix, register) or * for all four, or
+ * "loop <weight>". Empty lines and lines starting with ';' are skipped.
+ *
+ * @param table Table to update, usually filled by cost_table_default first
+ * @param path Path of the file
+ * @return 0 on success, -1 if the file cannot be read or a line is invalid
+ */
+int cost_table_read(cost_table_t *table, const char *path);
+
+/**
+ * @brief Start collecting the instructions of a source
+ *
+ * @param cost Estimator to initialize
+ * @param table Cost table, must outlive the estimator
+ */
+void cost_init(cost_t *cost, const cost_table_t *table);
+
+/**
+ * @brief Release the records of an estimator
+ *
+ * @param cost Estimator to release
+ */
+void cost_destroy(cost_t *cost);
+
+/**
+ * @brief Record one instruction of the second pass
+ *
+ * @param cost Estimator
+ * @param pl Parsed operation line
+ * @param st Symbol table from first pass
+ * @param address Address of the first word of the instruction
+ */
+void cost_add(cost_t *cost, const parsed_line *pl, symbol_table_t *st, int address);
+
+/**
+ * @brief Estimate the routines of the recorded instructions
+ *
+ * @param cost Estimator after the second pass
+ * @param st Symbol table of the source, naming the routines
+ * @param routines Receives the routines by address, free with free()
+ * @param count Receives the number of routines
+ * @return 0 on success, -1 if memory allocation fails
+ */
+int cost_analyze(const cost_t *cost, symbol_table_t *st, cost_routine_t **routines, int *count);
+
+/**
+ * @brief Write the estimate of every routine as a table
+ *
+ * @param cost Estimator after the second pass
+ * @param st Symbol table of the source
+ * @param source_name Name of the source, shown in the title
+ * @param out Stream receiving the report
+ * @return 0 on success, -1 if memory allocation or writing fails
+ */
+int cost_report(const cost_t *cost, symbol_table_t *st, const char *source_name, FILE *out);
+
+#endif
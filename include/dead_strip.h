@@ -0,0 +1,42 @@
+#ifndef DEAD_STRIP_H
+#define DEAD_STRIP_H
+#include "object_file.h"
+
+/*
+ * =====================================================================================
+ * Filename:  dead_strip.h
+ * Description: Link-time removal of unreachable code and data. The modules are cut
+ * into fragments, a reference graph is built from their external usages and
+ * relocation sites, and only the fragments reachable from the roots are kept.
+ * =====================================================================================
+ */
+
+/* enum strip_granularity_t selects the unit that is kept or removed. */
+typedef enum {
+    STRIP_MODULES, /* a module is kept whole if anything in it is reachable */
+    STRIP_LABELS /* every labeled routine or data item is kept on its own */
+} strip_granularity_t;
+
+/**
+ * @brief Remove the code and data that the roots cannot reach
+ *
+ * With STRIP_LABELS a module is cut at its entry symbols and at every address a
+ * relocatable word refers to (the labels visible in an object file). A code
+ * fragment that does not end with jmp, rts or stop falls through into the next
+ * one, which keeps it reachable. A module whose code cannot be decoded is
+ * handled as a whole. The kept words of every module are moved together and
+ * its relocatable words, entries and usage sites are renumbered; modules with
+ * nothing left are removed from the array.
+ *
+ * @param modules Modules to strip, rewritten in place
+ * @param n_modules Number of modules, updated
+ * @param roots Entry symbols execution may start from; with none, the first word of the first module
+ * @param n_roots Number of roots
+ * @param granularity Unit of removal
+ * @param removed_words Receives the number of words removed, may be NULL
+ * @return 0 on success, -1 if a root is not an entry symbol or memory ran out
+ */
+int link_strip(object_t *modules, int *n_modules, char *const *roots, int n_roots,
+               strip_granularity_t granularity, int *removed_words);
+
+#endif
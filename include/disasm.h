@@ -0,0 +1,95 @@
+#ifndef DISASM_H
+#define DISASM_H
+#include <stdio.h>
+#include "object_file.h"
+
+/*
+ * =====================================================================================
+ * Filename:  disasm.h
+ * Description: Disassembler of programs (object files, linked images or archive
+ * members) back into assembly source. Decoding is driven by a table indexed by the
+ * first word of an instruction, built once from isa_decode: each of the 1024
+ * entries holds the opcode, the addressing modes and the length, or marks the word
+ * as no instruction the assembler emits. Addresses are named after the .ent
+ * symbols and any symbol file, external operands after the .ext usages, and every
+ * other address an operand refers to gets a label L<address>, so the output
+ * assembles back into the same words.
+ * =====================================================================================
+ */
+
+#define DISASM_TABLE_SIZE 1024 /* every 10 bit first word */
+#define DISASM_TEXT_SIZE 96 /* an instruction with two matrix operands and long labels */
+
+/* struct disasm_entry_t is the decoding of one first word. */
+typedef struct {
+    unsigned char valid; /* 0 if the word is not a first word the assembler emits */
+    unsigned char opcode;
+    unsigned char n_operands;
+    unsigned char src_mode; /* addressing_mode_t, valid with 2 operands */
+    unsigned char dst_mode; /* addressing_mode_t of the destination or the only operand */
+    unsigned char length; /* words of the instruction */
+} disasm_entry_t;
+
+/* struct disasm_t is a program prepared for disassembly. */
+typedef struct {
+    disasm_entry_t table[DISASM_TABLE_SIZE];
+    const object_t *program;
+    obj_symbol_t *labels; /* names of addresses: symbols first, then the generated ones */
+    int n_labels;
+    int *label_at; /* per word of the program: index into labels, -1 if none */
+    int *external_at; /* per word of the program: index into the program's externals, -1 if none */
+} disasm_t;
+
+/**
+ * @brief Build the decoding table of every first word
+ *
+ * @param table DISASM_TABLE_SIZE entries to fill
+ */
+void disasm_build_table(disasm_entry_t *table);
+
+/**
+ * @brief Prepare a program for disassembly
+ *
+ * Builds the table, names the addresses of the program and adds a label for every
+ * address inside the program that an operand refers to and that has no name.
+ *
+ * @param d Disassembler to initialize
+ * @param program Program to disassemble, must outlive the disassembler
+ * @param symbols Extra names of addresses (e.g. from a symbol file), or NULL
+ * @param n_symbols Number of extra names
+ * @return 0 on success, -1 if memory allocation fails
+ */
+int disasm_open(disasm_t *d, const object_t *program, const obj_symbol_t *symbols, int n_symbols);
+
+/**
+ * @brief Release a disassembler
+ *
+ * @param d Disassembler prepared by disasm_open
+ */
+void disasm_close(disasm_t *d);
+
+/**
+ * @brief Disassemble the instruction at an address of the program
+ *
+ * @param d Disassembler
+ * @param address Address of the first word, ADDRESS_BASE or above
+ * @param text Receives the instruction, e.g. "mov M[r1][r2], r3"
+ * @param size Size of text, DISASM_TEXT_SIZE is always enough
+ * @return The length of the instruction, or 0 if the words are not an instruction
+ */
+int disasm_insn(const disasm_t *d, int address, char *text, size_t size);
+
+/**
+ * @brief Write the whole program as assembly source
+ *
+ * Writes the .entry and .extern declarations, the code and then the data as .data
+ * lines. Words of the code that are not an instruction are written as comments.
+ *
+ * @param d Disassembler
+ * @param with_addresses Prefix every line with its address; the output then no longer assembles
+ * @param out Stream receiving the source
+ * @return 0 on success, -1 on a write error
+ */
+int disasm_write(const disasm_t *d, int with_addresses, FILE *out);
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef EMU_BATCH_H
+#define EMU_BATCH_H
+#include <stddef.h>
+#include "emulator.h"
+
+/*
+ * =====================================================================================
+ * Filename:  emu_batch.h
+ * Description: Batch emulation of one program over many test vectors. A vector is
+ * the input stream read by red; every run starts from the state of the loaded
+ * program and gets its own output buffer. The runs are spread over a worker pool,
+ * each worker with an emulator of its own, and the results are kept in vector
+ * order; the lockstep variant runs groups of vectors together, see emu_lockstep.h.
+ * A vector file holds one vector per line, where \n, \t and \\ stand for a
+ * newline, a tab and a backslash.
+ * =====================================================================================
+ */
+
+/* struct emu_run_t is one test vector and the result of running it. */
+typedef struct {
+    char *input; /* bytes read by red */
+    size_t input_len;
+    char *output; /* text written by prn, NULL before the run */
+    size_t output_len;
+    emu_status_t status; /* EMU_HALTED or EMU_FAULT after the run */
+    error_code_t fault;
+    int fault_pc;
+    long steps;
+} emu_run_t;
+
+/**
+ * @brief Read the test vectors of a vector file
+ *
+ * @param path Path of the file
+ * @param runs Receives the vectors in file order, released with emu_batch_free
+ * @param n_runs Receives the number of vectors
+ * @return 0 on success, -1 if the file is missing or malformed (reported with print_error_file)
+ */
+int emu_batch_read(const char *path, emu_run_t **runs, int *n_runs);
+
+/**
+ * @brief Run a program once per test vector on a worker pool
+ *
+ * @param program Program loaded for every run
+ * @param mat_cols Columns of a matrix, see emulator_t
+ * @param max_steps Step limit of every run, or EMU_NO_STEP_LIMIT
+ * @param runs Vectors, receive the results
+ * @param n_runs Number of vectors
+ * @param n_workers Number of threads
+ * @return 0 on success, -1 if the program does not fit the memory or memory allocation fails
+ */
+int emu_batch_run(const object_t *program, int mat_cols, long max_steps, emu_run_t *runs, int n_runs,
+                  int n_workers);
+
+/**
+ * @brief Run a program once per test vector, EMU_LANES vectors at a time in lockstep
+ *
+ * Every run gets the same result as from emu_batch_run. The groups of vectors are
+ * spread over the worker pool.
+ *
+ * @param program Program loaded for every run
+ * @param mat_cols Columns of a matrix, see emulator_t
+ * @param max_steps Step limit of every run, or EMU_NO_STEP_LIMIT
+ * @param runs Vectors, receive the results
+ * @param n_runs Number of vectors
+ * @param n_workers Number of threads
+ * @param rounds Receives the number of instructions issued for whole groups, may be NULL
+ * @return 0 on success, -1 if the program does not fit the memory or memory allocation fails
+ */
+int emu_batch_run_lockstep(const object_t *program, int mat_cols, long max_steps, emu_run_t *runs, int n_runs,
+                           int n_workers, long *rounds);
+
+/**
+ * @brief Release the vectors and the results of a batch
+ *
+ * @param runs Vectors filled by emu_batch_read, may be NULL
+ * @param n_runs Number of vectors
+ */
+void emu_batch_free(emu_run_t *runs, int n_runs);
+
+#endif
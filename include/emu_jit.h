@@ -0,0 +1,103 @@
+#ifndef EMU_JIT_H
+#define EMU_JIT_H
+#include <stddef.h>
+#include "emulator.h"
+
+/*
+ * =====================================================================================
+ * Filename:  emu_jit.h
+ * Description: Translating tier of the emulator for x86-64 Linux. A basic block that
+ * was entered EMU_JIT_HOT_THRESHOLD times is translated into native code in an
+ * executable mapping. The eight registers live in host registers while native code
+ * runs, and a block that ends in a jump to a translated block jumps straight into
+ * it. The interpreter executes what is not translated: red, prn, jsr, rts, stop,
+ * matrix and register-indirect operands. A store into a translated instruction
+ * drops every translation. A run gives exactly the state, output and counters of
+ * emu_run; on other hosts emu_jit_run is emu_run.
+ * =====================================================================================
+ */
+
+#if defined(__x86_64__) && defined(__linux__)
+#define EMU_JIT_NATIVE 1
+#endif
+
+#define EMU_JIT_CODE_SIZE (1L << 20) /* bytes of native code before everything is dropped */
+#define EMU_JIT_HOT_THRESHOLD 8 /* entries of a block before it is translated */
+#define EMU_JIT_MAX_BLOCK 32 /* instructions of a block */
+#define EMU_JIT_MAX_LINKS 512 /* pending jumps to blocks not translated yet */
+
+/* struct emu_jit_link_t is a jump of a block that still exits to the interpreter. */
+typedef struct {
+    long site; /* offset of the rel32 of the jump */
+    int target; /* emulated address it jumps to */
+} emu_jit_link_t;
+
+/* struct emu_jit_t is the translation cache of one emulator. */
+typedef struct {
+    unsigned char *code; /* executable mapping, NULL when native code is not available */
+    long code_used;
+    long exit_offset; /* code that stores the registers back and returns */
+    long stubs_end; /* blocks are emitted from here */
+    long block[EMU_MEMORY_SIZE]; /* offset of the block starting at every address, or < 0 */
+    unsigned char hits[EMU_MEMORY_SIZE]; /* entries of the addresses without a block */
+    unsigned char code_map[EMU_MEMORY_SIZE]; /* word belongs to a translated instruction */
+    emu_jit_link_t links[EMU_JIT_MAX_LINKS];
+    int n_links;
+    long limit; /* max_steps of the run, read by native code */
+    const emulator_t *owner; /* emulator the translations were made from */
+    long blocks; /* blocks translated */
+    long chained; /* jumps patched to go straight to their block */
+    long flushes; /* times every translation was dropped */
+    long interpreted; /* instructions executed by the interpreter */
+} emu_jit_t;
+
+/**
+ * @brief Create the translation cache
+ *
+ * Without native code (another host, or the mapping failed) the cache is still
+ * usable and emu_jit_run interprets.
+ *
+ * @param jit Cache to initialize
+ * @return 0 if native code is available, -1 otherwise
+ */
+int emu_jit_open(emu_jit_t *jit);
+
+/**
+ * @brief Release the executable mapping of a cache
+ *
+ * @param jit Cache created with emu_jit_open
+ */
+void emu_jit_close(emu_jit_t *jit);
+
+/**
+ * @brief Drop every translation
+ *
+ * Needed after the memory of the emulator changed outside of emu_jit_run, as
+ * with emu_load or emu_restore. Running another emulator drops them by itself.
+ *
+ * @param jit Cache to empty
+ */
+void emu_jit_reset(emu_jit_t *jit);
+
+/**
+ * @brief Execute until the program halts, faults or reaches max_steps, as emu_run
+ *
+ * @param jit Translation cache of the emulator
+ * @param emu Loaded emulator
+ * @return EMU_HALTED or EMU_FAULT (ERROR_STEP_LIMIT when the limit was reached)
+ */
+emu_status_t emu_jit_run(emu_jit_t *jit, emulator_t *emu);
+
+/**
+ * @brief Compare the states of two emulators after a run
+ *
+ * The machine state, the status and the steps, cycles and profile counters are
+ * compared; the dispatch records, which only cache the memory, are not.
+ *
+ * @param a First emulator
+ * @param b Second emulator
+ * @return NULL if they are equal, otherwise the name of the first part that differs
+ */
+const char *emu_jit_diff(const emulator_t *a, const emulator_t *b);
+
+#endif
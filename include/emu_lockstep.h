@@ -0,0 +1,57 @@
+#ifndef EMU_LOCKSTEP_H
+#define EMU_LOCKSTEP_H
+#include "emulator.h"
+#include "emu_batch.h"
+
+/*
+ * =====================================================================================
+ * Filename:  emu_lockstep.h
+ * Description: Lockstep emulation of up to EMU_LANES runs of one program. The state
+ * is kept as a structure of arrays, every register and memory word holding one
+ * value per lane, and each instruction is applied to all lanes by loops over the
+ * lanes that the compiler turns into SIMD code. Every round executes the lowest
+ * pc among the running lanes for the lanes that are at it, so lanes that took
+ * different branches are masked off and join again where their paths meet.
+ * =====================================================================================
+ */
+
+#define EMU_LANES 16
+#define EMU_LANE_STOPPED (2 * EMU_MEMORY_SIZE) /* pc of a lane that halted or faulted */
+
+typedef WORD emu_lane_words_t[EMU_LANES];
+
+/* struct emu_lockstep_t is the state of all lanes. */
+typedef struct {
+    emu_lane_words_t memory[EMU_MEMORY_SIZE];
+    emu_lane_words_t regs[EMU_REGISTERS];
+    int pc[EMU_LANES]; /* EMU_LANE_STOPPED once the lane stopped */
+    unsigned char zero_flag[EMU_LANES];
+    int stack[EMU_STACK_DEPTH][EMU_LANES];
+    int sp[EMU_LANES];
+    long steps[EMU_LANES];
+    emu_insn_t insns[EMU_MEMORY_SIZE]; /* records valid while every lane holds the same words */
+    int mat_cols;
+    long max_steps;
+    long rounds; /* instructions issued, each for the lanes at its pc */
+    emu_run_t *runs[EMU_LANES]; /* I/O and result of every lane, NULL for an unused lane */
+    size_t in_pos[EMU_LANES]; /* next input byte of every lane */
+    size_t out_cap[EMU_LANES];
+} emu_lockstep_t;
+
+/**
+ * @brief Run up to EMU_LANES vectors of a program in lockstep
+ *
+ * Every run gets the same result as it would from emu_batch_run.
+ *
+ * @param m State of the lanes, overwritten
+ * @param program Program loaded into every lane
+ * @param mat_cols Columns of a matrix, see emulator_t
+ * @param max_steps Step limit of every run, or EMU_NO_STEP_LIMIT
+ * @param runs Vectors, receive the results
+ * @param n_runs Number of vectors, 1..EMU_LANES
+ * @return 0 on success, -1 if the program does not fit the memory
+ */
+int emu_lockstep_run(emu_lockstep_t *m, const object_t *program, int mat_cols, long max_steps, emu_run_t *runs,
+                     int n_runs);
+
+#endif
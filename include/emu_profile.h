@@ -0,0 +1,34 @@
+#ifndef EMU_PROFILE_H
+#define EMU_PROFILE_H
+#include <stdio.h>
+#include "emulator.h"
+
+/*
+ * =====================================================================================
+ * Filename:  emu_profile.h
+ * Description: Execution profile of an emulated program. The emulator counts the
+ * executions and cycles of every address while it runs; the report attributes
+ * the counters to the labels of the program (the .ent file, or any symbol file in
+ * the same format) as a hot-label table and an annotated listing.
+ * =====================================================================================
+ */
+
+#define EMU_PROFILE_NO_LABEL "(no label)" /* addresses below the first symbol */
+
+/**
+ * @brief Write the hot-label report and the annotated listing of a run
+ *
+ * Every address belongs to the closest symbol at or below it. The hot labels are
+ * sorted by decreasing cycles; the listing shows every instruction of the code
+ * image and every other address that was executed, under its labels.
+ *
+ * @param emu Emulator after a run
+ * @param code_len Number of code words loaded at ADDRESS_BASE
+ * @param symbols Symbols of the program, in any order
+ * @param n_symbols Number of symbols
+ * @param out Stream receiving the report
+ * @return 0 on success, -1 if memory allocation or writing fails
+ */
+int emu_profile_report(const emulator_t *emu, int code_len, const obj_symbol_t *symbols, int n_symbols, FILE *out);
+
+#endif
@@ -0,0 +1,180 @@
+#ifndef EMULATOR_H
+#define EMULATOR_H
+#include <stdio.h>
+#include "object_file.h"
+#include "errors.h"
+
+/*
+ * =====================================================================================
+ * Filename:  emulator.h
+ * Description: Functional emulator of the imaginary CPU. A program (an object file
+ * or a linked image) is loaded at ADDRESS_BASE of a 256 word memory and executed
+ * with eight registers, a zero flag set by cmp and a return stack for jsr/rts.
+ * Every instruction is decoded once, on its first execution, into a dispatch
+ * record; the execution loop only reads records. A store into a decoded
+ * instruction drops its record so that modified code is decoded again.
+ * Every executed instruction also adds to the execution and cycle counters of its
+ * address, which emu_profile.h attributes to the symbols of the program.
+ * =====================================================================================
+ */
+
+#define EMU_MEMORY_SIZE IMAGE_LENGTH /* addresses are 8 bits wide */
+#define EMU_REGISTERS 8
+#define EMU_STACK_DEPTH 256 /* nested jsr calls */
+#define EMU_MAX_INSN_LENGTH 5 /* first word and two matrix operands */
+#define EMU_DEFAULT_MAT_COLS 2 /* columns of a matrix, see emulator_t */
+#define EMU_NO_STEP_LIMIT 0
+#define EMU_PAGE_WORDS 16 /* granularity of the dirty tracking of snapshots */
+#define EMU_PAGES (EMU_MEMORY_SIZE / EMU_PAGE_WORDS)
+
+/* Kinds of operands of a dispatch record. */
+typedef enum {
+    EMU_OPERAND_NONE,
+    EMU_OPERAND_IMMEDIATE, /* value is the number */
+    EMU_OPERAND_MEMORY, /* value is the address */
+    EMU_OPERAND_MATRIX, /* value is the address of the first cell, row and col are registers */
+    EMU_OPERAND_REGISTER, /* value is the register number */
+    EMU_OPERAND_EXTERNAL /* unresolved external reference, faults when executed */
+} emu_operand_kind_t;
+
+/* struct emu_operand_t is a decoded operand. */
+typedef struct {
+    unsigned char kind; /* emu_operand_kind_t */
+    unsigned char row; /* matrix row register */
+    unsigned char col; /* matrix column register */
+    short value;
+} emu_operand_t;
+
+/* struct emu_insn_t is the dispatch record of a decoded instruction.
+ * A single operand is kept as the destination, as in instruction_t.
+ */
+typedef struct {
+    unsigned char opcode; /* op_code_t, or EMU_INVALID_OPCODE */
+    unsigned char length; /* words of the instruction */
+    unsigned char decoded; /* the record is valid */
+    unsigned char cycles; /* see isa_cycles */
+    emu_operand_t src;
+    emu_operand_t dst;
+} emu_insn_t;
+
+#define EMU_INVALID_OPCODE 0xFF
+
+/* State of an emulator after a step or a run. */
+typedef enum {
+    EMU_RUNNING,
+    EMU_HALTED, /* stop was executed */
+    EMU_FAULT /* see emulator_t.fault */
+} emu_status_t;
+
+/* struct emulator_t is the complete machine state.
+ * The object format does not keep the dimensions of a .mat, so a matrix access
+ * label[rx][ry] addresses cell label + rx * mat_cols + ry.
+ */
+typedef struct {
+    WORD memory[EMU_MEMORY_SIZE];
+    WORD regs[EMU_REGISTERS];
+    int pc;
+    int zero_flag; /* set by cmp when both operands are equal */
+    int stack[EMU_STACK_DEPTH]; /* return addresses */
+    int sp; /* number of return addresses */
+    emu_insn_t insns[EMU_MEMORY_SIZE]; /* dispatch record of the instruction at every address */
+    int mat_cols;
+    long steps; /* instructions executed */
+    long cycles; /* cycles of the executed instructions */
+    unsigned long exec_count[EMU_MEMORY_SIZE]; /* executions of the instruction at every address */
+    unsigned long cycle_count[EMU_MEMORY_SIZE]; /* cycles spent in the instruction at every address */
+    long max_steps; /* EMU_NO_STEP_LIMIT or the number of instructions a run may execute */
+    FILE *in; /* read by red */
+    FILE *out; /* written by prn */
+    emu_status_t status;
+    error_code_t fault; /* why the emulator stopped with EMU_FAULT */
+    int fault_pc; /* address of the faulting instruction */
+    unsigned long dirty_pages; /* bit p: page p was written since the last snapshot or restore */
+} emulator_t;
+
+/* struct emu_snapshot_t is the machine state saved by emu_snapshot: memory,
+ * dispatch records, registers, stack and counters of steps and cycles. The
+ * streams, mat_cols, max_steps and the profile counters are not part of it.
+ */
+typedef struct {
+    WORD memory[EMU_MEMORY_SIZE];
+    emu_insn_t insns[EMU_MEMORY_SIZE];
+    WORD regs[EMU_REGISTERS];
+    int pc;
+    int zero_flag;
+    int stack[EMU_STACK_DEPTH];
+    int sp;
+    long steps;
+    long cycles;
+    emu_status_t status;
+    error_code_t fault;
+    int fault_pc;
+} emu_snapshot_t;
+
+/**
+ * @brief Build the dispatch record of the instruction in words
+ *
+ * An invalid instruction gets EMU_INVALID_OPCODE and length 1; it faults when it
+ * is executed.
+ *
+ * @param words The first word of the instruction and the words after it
+ * @param available Number of words readable at words
+ * @param insn Receives the record
+ */
+void emu_decode(const WORD *words, int available, emu_insn_t *insn);
+
+/**
+ * @brief Reset an emulator: empty memory, registers and stack, pc at ADDRESS_BASE
+ *
+ * @param emu Emulator to reset
+ * @param in Stream read by red
+ * @param out Stream written by prn
+ */
+void emu_init(emulator_t *emu, FILE *in, FILE *out);
+
+/**
+ * @brief Load the code and data of a program at ADDRESS_BASE
+ *
+ * @param emu Initialized emulator
+ * @param program Object or linked image
+ * @return 0 on success, -1 if the program does not fit the memory
+ */
+int emu_load(emulator_t *emu, const object_t *program);
+
+/**
+ * @brief Save the state of an emulator and start tracking the pages written after it
+ *
+ * @param emu Emulator to save
+ * @param snap Receives the state
+ */
+void emu_snapshot(emulator_t *emu, emu_snapshot_t *snap);
+
+/**
+ * @brief Return an emulator to the state of its last snapshot
+ *
+ * Only the memory pages written since the last snapshot or restore are copied
+ * back, together with their dispatch records, so the records of the other pages
+ * stay decoded.
+ *
+ * @param emu Emulator the snapshot was taken of, with no snapshot or load since
+ * @param snap State saved by the last emu_snapshot
+ */
+void emu_restore(emulator_t *emu, const emu_snapshot_t *snap);
+
+/**
+ * @brief Execute one instruction
+ *
+ * @param emu Loaded emulator
+ * @return EMU_RUNNING, or the final state once the program halted or faulted
+ */
+emu_status_t emu_step(emulator_t *emu);
+
+/**
+ * @brief Execute until the program halts, faults or reaches max_steps
+ *
+ * @param emu Loaded emulator
+ * @return EMU_HALTED or EMU_FAULT (ERROR_STEP_LIMIT when the limit was reached)
+ */
+emu_status_t emu_run(emulator_t *emu);
+
+#endif
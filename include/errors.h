@@ -45,6 +45,8 @@ typedef enum {
     ERROR_STRING_TOO_LONG,
     ERROR_INVALID_ARGUMENT,
     ERROR_EXPECTED_OPERAND,
+    ERROR_TOO_MANY_OPERANDS,
+    ERROR_INVALID_OPERAND_COUNT_FOR_COMMAND,
     ERROR_TRAILING_CHARACTERS,
     ERROR_DUPLICATE_ENTRY_DECLARATION,
 
@@ -53,9 +55,63 @@ typedef enum {
     ERROR_DUPLICATE_LABEL_DEFINITION,
     ERROR_UNDEFINED_SYMBOL_USED,
     ERROR_EXTERNAL_SYMBOL_CANNOT_BE_ENTRY,
-    ERROR_ENTRY_SYMBOL_NOT_DEFINED
+    ERROR_ENTRY_SYMBOL_NOT_DEFINED,
+
+    /* Linker Errors */
+    ERROR_INVALID_OBJECT_FILE,
+    ERROR_DUPLICATE_EXPORTED_SYMBOL,
+    ERROR_UNRESOLVED_EXTERNAL_SYMBOL,
+    ERROR_INVALID_ARCHIVE,
+    ERROR_UNKNOWN_ROOT_SYMBOL,
+
+    /* Emulator Errors */
+    ERROR_PROGRAM_TOO_LARGE,
+    ERROR_INVALID_INSTRUCTION,
+    ERROR_UNLINKED_EXTERNAL,
+    ERROR_ADDRESS_OUT_OF_RANGE,
+    ERROR_RETURN_STACK,
+    ERROR_STEP_LIMIT,
+    ERROR_INVALID_TEST_VECTOR,
+    ERROR_JIT_MISMATCH,
+    ERROR_CODE_MODIFIED,
+    ERROR_UNTRANSLATED_ADDRESS,
+
+    /* Cost Estimate Errors */
+    ERROR_INVALID_COST_TABLE
 } error_code_t;
 
+/**
+ * A sink receives the diagnostics of the calling thread instead of stdout.
+ * file_name is NULL and line_number is 0 for errors reported with print_error.
+ */
+typedef void (*error_sink_t)(void *user, const char *file_name, int error_code, int line_number);
+
+/**
+ * Return the human-readable message of an error code.
+ *
+ * @param error_code The error code.
+ * @return A static string describing the error.
+ */
+const char *error_message(int error_code);
+
+/**
+ * Redirect the diagnostics of the calling thread to a sink.
+ * Other threads keep their own setting, so concurrent assemblies do not mix
+ * their diagnostics. Passing a NULL sink restores printing to stdout.
+ *
+ * @param sink The function receiving the diagnostics, or NULL.
+ * @param user Opaque pointer handed to the sink.
+ */
+void set_error_sink(error_sink_t sink, void *user);
+
+/**
+ * Return the sink of the calling thread, so that it can be restored later.
+ *
+ * @param user Receives the opaque pointer of the sink, NULL without a sink.
+ * @return The sink, or NULL if the thread prints to stdout.
+ */
+error_sink_t get_error_sink(void **user);
+
 /**
  * Print an error message based on the error code.
  * This function maps error codes to human-readable messages.
@@ -27,6 +27,7 @@ typedef enum {
 #define MAX_LABEL_LENGTH  31  /* 30 chars + terminator */
 #define IMAGE_LENGTH 256 /* max image size in words */
 #define MAX_STRING_LEN (MAX_LINE_LENGTH -2) /* fits any single input line */
+#define MAX_JOBS 1024 /* upper bound of a -j job count */
 
 
 /**
@@ -56,4 +57,12 @@ bool_t is_reserved_keyword(const char* name);
  * @return A newly allocated string containing the full file path, or NULL on failure.
  */
 char *create_file_path(const char *file_name, const char *ending);
+
+/**
+ * Parses the value of a -j / --jobs option.
+ *
+ * @param val The option value.
+ * @return The job count between 1 and MAX_JOBS, or -1 if the value is invalid.
+ */
+int parse_jobs(const char *val);
 #endif
@@ -0,0 +1,68 @@
+#ifndef ISA_H
+#define ISA_H
+#include "line_parser.h"
+#include "second_pass.h"
+
+/*
+ * =====================================================================================
+ * Filename:  isa.h
+ * Description: Decoding of encoded instructions, the inverse of FIRST_WORD. Tools that
+ * work on object files (the linker, analyzers) use it to find where instructions
+ * start and how many words each one takes. It also holds the cycle model shared by
+ * the emulator and the tools that estimate run time.
+ * =====================================================================================
+ */
+
+/* fields of a first word, see FIRST_WORD */
+#define WORD_OPCODE(w) (((w) >> 6) & 0xF)
+#define WORD_SRC_MODE(w) (((w) >> 4) & 0x3)
+#define WORD_DST_MODE(w) (((w) >> 2) & 0x3)
+#define WORD_ARE(w) ((w) & 0x3)
+
+/* struct instruction_t is a decoded first word. */
+typedef struct {
+    op_code_t opcode;
+    int n_operands; /* 0, 1 or 2 */
+    addressing_mode_t src_mode; /* valid with 2 operands */
+    addressing_mode_t dst_mode; /* valid with 1 or 2 operands, the only operand is the destination */
+    int length; /* words of the instruction, the first word included */
+} instruction_t;
+
+/**
+ * @brief Number of operands an opcode takes
+ *
+ * @param opcode Opcode 0..15
+ * @return 0, 1 or 2
+ */
+int isa_operand_count(op_code_t opcode);
+
+/**
+ * @brief Decode the first word of an instruction
+ *
+ * @param w The word
+ * @param out Receives the decoded instruction
+ * @return 0 on success, -1 if the word cannot be a first word as the assembler encodes it
+ */
+int isa_decode(WORD w, instruction_t *out);
+
+/**
+ * @brief Cycles an instruction takes
+ *
+ * One cycle per word of the instruction plus one per memory word it reads or
+ * writes; register and immediate operands are free, a push or pop of the return
+ * stack costs one cycle.
+ *
+ * @param ins Decoded instruction
+ * @return Number of cycles
+ */
+int isa_cycles(const instruction_t *ins);
+
+/**
+ * @brief Mnemonic of an opcode
+ *
+ * @param opcode Opcode 0..15
+ * @return The mnemonic, "?" for any other value
+ */
+const char *isa_mnemonic(int opcode);
+
+#endif
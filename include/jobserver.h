@@ -0,0 +1,69 @@
+#ifndef JOBSERVER_H
+#define JOBSERVER_H
+
+/*
+ * =====================================================================================
+ * Filename:  jobserver.h
+ * Description: Client side of the GNU make jobserver protocol. When the assembler
+ * runs under "make -jN" from a recipe marked with '+', make passes a pipe (or a
+ * named fifo) holding N-1 tokens in MAKEFLAGS. A process owns one implicit token
+ * and must read one byte from the jobserver before every additional concurrent
+ * job, writing the same byte back when that job is done.
+ * =====================================================================================
+ */
+
+#define JOBSERVER_POLL_MS 50 /* how often a waiting worker rechecks for work */
+
+/* struct jobserver_t describes the connection to make's jobserver. */
+typedef struct {
+    int read_fd; /* tokens are read from here (non blocking) */
+    int write_fd; /* and written back here */
+    int owns_read_fd; /* read_fd was opened by us and must be closed */
+    int owns_write_fd; /* write_fd was opened by us and must be closed */
+} jobserver_t;
+
+/* Result of jobserver_connect. */
+typedef enum {
+    JOBSERVER_NONE = 0, /* MAKEFLAGS has no jobserver, run unconstrained */
+    JOBSERVER_CONNECTED, /* tokens must be acquired for extra jobs */
+    JOBSERVER_UNUSABLE /* advertised but not inherited (recipe without '+') or only readable blocking */
+} jobserver_status_t;
+
+/**
+ * @brief Detect and connect to the jobserver advertised in MAKEFLAGS.
+ *
+ * Understands "--jobserver-auth=R,W", "--jobserver-auth=fifo:PATH" and the
+ * older "--jobserver-fds=R,W".
+ *
+ * @param js Jobserver to initialize (valid only when connected).
+ * @return JOBSERVER_NONE, JOBSERVER_CONNECTED or JOBSERVER_UNUSABLE.
+ */
+jobserver_status_t jobserver_connect(jobserver_t *js);
+
+/**
+ * @brief Close the descriptors opened by jobserver_connect.
+ *
+ * @param js Connected jobserver.
+ */
+void jobserver_disconnect(jobserver_t *js);
+
+/**
+ * @brief Acquire one token, waiting while keep_waiting(arg) returns nonzero.
+ *
+ * @param js Connected jobserver.
+ * @param token Receives the token byte, which must be handed back to jobserver_release.
+ * @param keep_waiting Called between polls; returning 0 abandons the wait.
+ * @param arg Argument of keep_waiting.
+ * @return 0 if a token was acquired, -1 if the wait was abandoned or failed.
+ */
+int jobserver_acquire(jobserver_t *js, unsigned char *token, int (*keep_waiting)(void *), void *arg);
+
+/**
+ * @brief Give a token back to make.
+ *
+ * @param js Connected jobserver.
+ * @param token Token byte obtained from jobserver_acquire.
+ */
+void jobserver_release(jobserver_t *js, unsigned char token);
+
+#endif
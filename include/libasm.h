@@ -0,0 +1,91 @@
+#ifndef LIBASM_H
+#define LIBASM_H
+#include <stddef.h>
+#include "globals.h"
+#include "errors.h"
+#include "second_pass.h"
+
+/*
+ * =====================================================================================
+ * Filename:  libasm.h
+ * Description: Embeddable in-memory assembler library. A source held in memory is
+ * preprocessed, assembled and returned as in-memory structures: the code and data
+ * images, the entry symbols, the external symbol usages and the diagnostics.
+ * Nothing is read from or written to the filesystem. Different threads may use
+ * different contexts concurrently.
+ * =====================================================================================
+ */
+
+#define ASM_DEFAULT_SOURCE_NAME "<buffer>" /* name used in diagnostics */
+
+/* struct asm_ctx_t holds the settings reused across assemblies. */
+typedef struct {
+    const char *source_name; /* name reported in diagnostics */
+} asm_ctx_t;
+
+/* struct asm_symbol_t is an entry symbol and its absolute address. */
+typedef struct {
+    char name[MAX_LABEL_LENGTH];
+    int address;
+} asm_symbol_t;
+
+/* struct asm_diagnostic_t is one error reported while assembling. */
+typedef struct {
+    error_code_t code;
+    int line; /* source line, 0 if the error has no location */
+    const char *message; /* static text of the error code */
+} asm_diagnostic_t;
+
+/* struct asm_result_t is the output of one assembly.
+ * Addresses are absolute: code starts at ADDRESS_BASE and data follows the code,
+ * exactly as in the .ob/.ent/.ext files.
+ */
+typedef struct {
+    WORD *code; /* code image, code_len words */
+    int code_len;
+    WORD *data; /* data image, data_len words */
+    int data_len;
+    asm_symbol_t *entries; /* same order as the .ent file */
+    int n_entries;
+    ext_usage_t *externals; /* same order as the .ext file */
+    int n_externals;
+    asm_diagnostic_t *diagnostics; /* in the order they were reported */
+    int n_diagnostics;
+} asm_result_t;
+
+/**
+ * @brief Create an assembler context with default settings.
+ *
+ * @return Pointer to the new context, or NULL on allocation failure.
+ */
+asm_ctx_t *asm_ctx_create(void);
+
+/**
+ * @brief Destroy a context created by asm_ctx_create.
+ *
+ * @param ctx The context, may be NULL.
+ */
+void asm_ctx_destroy(asm_ctx_t *ctx);
+
+/**
+ * @brief Assemble a source held in memory.
+ *
+ * The result is always initialized (also on failure, where it holds the
+ * diagnostics) and must be released with asm_result_free.
+ *
+ * @param ctx Assembler context.
+ * @param src Source text (.as content), not necessarily null terminated.
+ * @param len Length of the source in bytes.
+ * @param result Receives the images, symbols and diagnostics.
+ * @return 0 on success, -1 if the source has errors or memory ran out.
+ */
+int asm_assemble_buffer(asm_ctx_t *ctx, const char *src, size_t len, asm_result_t *result);
+
+/**
+ * @brief Release everything held by a result.
+ *
+ * @param result Result filled by asm_assemble_buffer.
+ */
+void asm_result_free(asm_result_t *result);
+
+#endif
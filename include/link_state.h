@@ -0,0 +1,102 @@
+#ifndef LINK_STATE_H
+#define LINK_STATE_H
+#include "globals.h"
+#include "util_hash.h"
+
+/*
+ * =====================================================================================
+ * Filename:  link_state.h
+ * Description: Link-state file kept next to an incrementally linked image
+ * (<output>.lks). It records what a relink needs without reading the unchanged
+ * modules again: the content key of every input, the slot of every module in the
+ * image, the global symbol table and every site that was patched with a symbol.
+ * =====================================================================================
+ */
+
+#define LINK_STATE_ENDING ".lks"
+#define LINK_STATE_FILES 3 /* keyed files of a module: .ob, .ent and .ext */
+
+/* struct link_input_t is an archive the image was linked with. */
+typedef struct {
+    char *path;
+    content_key_t key; /* content key of the archive */
+} link_input_t;
+
+/* struct link_module_t is one module of the image and the slot it occupies. */
+typedef struct {
+    char *name; /* base name as given on the command line, or archive member name */
+    int from_archive; /* pulled from one of the archives, never changes on its own */
+    content_key_t keys[LINK_STATE_FILES]; /* content keys, all zero for a missing file */
+    int code_base; /* image address of the code slot */
+    int code_slot; /* words reserved for the code */
+    int data_base; /* image address of the data slot */
+    int data_slot; /* words reserved for the data */
+    int n_entries; /* symbols the module exports */
+} link_module_t;
+
+/* struct link_symbol_t is one entry of the global symbol table. */
+typedef struct {
+    char name[MAX_LABEL_LENGTH];
+    int module; /* defining module */
+    int address; /* image address */
+} link_symbol_t;
+
+/* struct link_site_t is an image word patched with the address of a symbol. */
+typedef struct {
+    int module; /* module the usage belongs to */
+    int symbol; /* index in the symbol table, -1 once the usage is gone */
+    int address; /* image address of the patched word */
+} link_site_t;
+
+/* struct link_state_t is the content of a link-state file. */
+typedef struct {
+    int code_len; /* image lengths, slots included */
+    int data_len;
+    link_input_t *archives;
+    int n_archives;
+    link_module_t *modules;
+    int n_modules;
+    link_symbol_t *symbols; /* same order as the image .ent file */
+    int n_symbols;
+    link_site_t *sites;
+    int n_sites;
+} link_state_t;
+
+/**
+ * @brief Compute the content keys of the .ob, .ent and .ext files of a module
+ *
+ * @param base_name Path of the module without extension
+ * @param keys Receives one key per file, all zero for a file that does not exist
+ * @return 0 on success, -1 if memory ran out
+ */
+int link_module_keys(const char *base_name, content_key_t keys[LINK_STATE_FILES]);
+
+/**
+ * @brief Read a link-state file
+ *
+ * A missing or unusable state is not an error of the link, it only means that
+ * the image is linked in full, so nothing is reported.
+ *
+ * @param path Path of the state file
+ * @param state Receives the state, always initialized, release with link_state_free
+ * @return 0 on success, -1 if the file is missing or malformed
+ */
+int link_state_read(const char *path, link_state_t *state);
+
+/**
+ * @brief Write a link-state file, dropping the sites whose usage is gone
+ *
+ * @param path Path of the state file
+ * @param state State to write
+ * @return 0 on success, -1 on a write error
+ */
+int link_state_write(const char *path, const link_state_t *state);
+
+/**
+ * @brief Release everything held by a state
+ *
+ * @param state State filled by link_state_read or link_record_state, may be NULL
+ */
+void link_state_free(link_state_t *state);
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef LINKER_H
+#define LINKER_H
+#include "object_file.h"
+#include "archive.h"
+#include "link_state.h"
+#include "util_vec.h"
+
+/*
+ * =====================================================================================
+ * Filename:  linker.h
+ * Description: Links separately assembled modules into a single image.
+ * The code of every module is laid out first, in module order, followed by the
+ * data of every module in the same order. Relocatable (ARE_R) words are moved by
+ * the offset of the section they point into and every external usage site is
+ * patched with the address of the entry symbol it refers to. Archive members are
+ * only linked when they export a symbol that is still unresolved. An image can be
+ * relinked incrementally from a link state recorded at its last full link.
+ * =====================================================================================
+ */
+
+/**
+ * @brief Link modules into a single image
+ *
+ * The entry symbols of all modules form one global table, a symbol exported by
+ * two modules and an external symbol exported by none are errors. The image has
+ * no external usages left and its entries are the relocated entries of all modules.
+ * Modules that do not fit the 256 word memory together are rejected before anything
+ * is patched. The image is always initialized and must be released with object_free.
+ *
+ * @param modules Modules read with object_read
+ * @param n_modules Number of modules
+ * @param image Receives the linked image
+ * @return 0 on success, -1 on errors (reported with print_error_file)
+ */
+int link_objects(const object_t *modules, int n_modules, object_t *image);
+
+/**
+ * @brief Link modules into a single image, patching them on a worker pool
+ *
+ * Same as link_objects. The entry table is built first, then the modules are
+ * copied, relocated and resolved in batches by n_workers threads; every module
+ * writes only its own code and data slots. The diagnostics are reported after
+ * the workers are done, in module order, so the output does not depend on the
+ * number of workers.
+ *
+ * @param modules Modules read with object_read
+ * @param n_modules Number of modules
+ * @param n_workers Number of threads, values below 1 mean 1
+ * @param image Receives the linked image
+ * @return 0 on success, -1 on errors (reported with print_error_file)
+ */
+int link_objects_parallel(const object_t *modules, int n_modules, int n_workers, object_t *image);
+
+/**
+ * @brief Append the archive members that resolve the outstanding externals
+ *
+ * Every external of the modules that no module exports is looked up in the
+ * archive indexes, in archive order, and the first member exporting it is
+ * appended to the modules. The externals of pulled members are resolved the
+ * same way, so a member is pulled in only when something needs it. Externals
+ * that no archive resolves are left for link_objects to report.
+ *
+ * @param modules Vector of object_t, grows with the pulled members
+ * @param archives Opened archives
+ * @param n_archives Number of archives
+ * @return 0 on success, -1 if a member cannot be read or memory ran out
+ */
+int link_pull_members(vec_t *modules, const archive_t *archives, int n_archives);
+
+/**
+ * @brief Record the link state of an image linked with link_objects
+ *
+ * Every module keeps the slot it got in the image, so that it can later be
+ * relinked on its own while it fits there.
+ *
+ * @param modules Linked modules, the named ones first and the archive members after them
+ * @param n_modules Number of modules
+ * @param n_named Number of modules named on the command line
+ * @param archive_paths Archives the image was linked with
+ * @param n_archives Number of archives
+ * @param state Receives the state, release with link_state_free
+ * @return 0 on success, -1 if memory ran out
+ */
+int link_record_state(const object_t *modules, int n_modules, int n_named,
+                      char *const *archive_paths, int n_archives, link_state_t *state);
+
+/**
+ * @brief Relink an image by patching only the modules that changed since its state was recorded
+ *
+ * The modules whose .ob, .ent or .ext content changed are read and copied into
+ * their slots, and only their own usage sites and the sites that refer to their
+ * moved symbols are patched again. This is possible while the modules and archives
+ * are the same, every changed module still fits its slot, exports the same symbols
+ * and uses only symbols the image already has, and the state describes an image
+ * that fits the 256 word memory. Otherwise a full link is needed.
+ *
+ * @param state State of the image, updated to the relinked image
+ * @param output Base name of the image to read
+ * @param names Base names of the modules named on the command line, in order
+ * @param n_names Number of names
+ * @param archive_paths Archives named on the command line, in order
+ * @param n_archives Number of archives
+ * @param image Receives the relinked image, release with object_free
+ * @param relinked Receives the number of modules relinked, 0 when the image is up to date
+ * @return 1 when relinked (or up to date), 0 when a full link is needed, -1 on errors
+ */
+int link_incremental(link_state_t *state, const char *output, char *const *names, int n_names,
+                     char *const *archive_paths, int n_archives, object_t *image, int *relinked);
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef MACRO_H
 #define MACRO_H
 
+#include <stdio.h>
 #include "util_vec.h"
 
 /*
@@ -30,4 +31,16 @@ typedef struct {
  * @return int Returns 0 on success, or -1 on failure.
  */
 int preprocess_file(const char *input_path, const char *output_path);
+
+/**
+ * @brief Expands the macros of an already opened source into an opened output stream.
+ *
+ * This is the core of preprocess_file, it can run on in-memory streams.
+ * The output is left as is when an error is found, the caller decides what to do with it.
+ *
+ * @param as_file The stream holding the source with macro definitions.
+ * @param am_file The stream receiving the expanded source.
+ * @return int Returns 0 on success, or -1 on failure.
+ */
+int preprocess_stream(FILE *as_file, FILE *am_file);
 #endif /* MACRO_H */
@@ -0,0 +1,31 @@
+#ifndef OB2C_H
+#define OB2C_H
+#include <stdio.h>
+#include "object_file.h"
+
+/*
+ * =====================================================================================
+ * Filename:  ob2c.h
+ * Description: Ahead-of-time translation of a program (an object file or a linked
+ * image) into a C source file. The file compiles with any C89 compiler into a
+ * simulator of that program alone: every instruction becomes a few statements,
+ * jumps to known addresses become gotos, and return addresses and jumps through
+ * registers go through a switch over the addresses they may reach. The simulator
+ * reads stdin and writes stdout as the emulator does and reports a fault in the
+ * emulator's words. Code that stores into its own instructions is not supported;
+ * such a store stops the simulator with ERROR_CODE_MODIFIED.
+ * =====================================================================================
+ */
+
+/**
+ * @brief Write the C simulator of a program
+ *
+ * @param program Object or linked image
+ * @param ob_name Name of the .ob file, used in the fault reports of the simulator
+ * @param mat_cols Columns of a matrix, see emulator_t
+ * @param out Stream receiving the C source
+ * @return 0 on success, -1 if the program does not fit the memory or writing fails
+ */
+int ob2c_translate(const object_t *program, const char *ob_name, int mat_cols, FILE *out);
+
+#endif
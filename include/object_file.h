@@ -0,0 +1,105 @@
+#ifndef OBJECT_FILE_H
+#define OBJECT_FILE_H
+#include <stdio.h>
+#include "globals.h"
+#include "second_pass.h"
+#include "libasm.h"
+
+/*
+ * =====================================================================================
+ * Filename:  object_file.h
+ * Description: In-memory form of an assembled module: the words of its .ob file and
+ * the symbols of its .ent and .ext files. Used by the linker to read the modules
+ * and to write the linked image back in the same formats.
+ * =====================================================================================
+ */
+
+/* struct obj_symbol_t is one line of a .ent or .ext file. */
+typedef struct {
+    char name[MAX_LABEL_LENGTH];
+    int address; /* absolute address: the definition (.ent) or the usage site (.ext) */
+} obj_symbol_t;
+
+/* struct object_t is one module.
+ * Addresses are absolute: code starts at ADDRESS_BASE and data follows the code.
+ */
+typedef struct {
+    char *name; /* base name the module was read from, used in diagnostics */
+    WORD *words; /* code_len code words followed by data_len data words */
+    int code_len;
+    int data_len;
+    obj_symbol_t *entries; /* same order as the .ent file */
+    int n_entries;
+    obj_symbol_t *externals; /* same order as the .ext file */
+    int n_externals;
+} object_t;
+
+/**
+ * @brief Read a module from its .ob file and its optional .ent and .ext files
+ *
+ * The header lengths must add up to the number of words, so objects written
+ * before the header kept every digit (code longer than 63 words) are rejected.
+ * The object is always initialized and must be released with object_free.
+ *
+ * @param base_name Path of the module without extension
+ * @param obj Receives the module
+ * @return 0 on success, -1 if a file is missing or malformed (reported with print_error_file)
+ */
+int object_read(const char *base_name, object_t *obj);
+
+/**
+ * @brief Read a module from opened .ob, .ent and .ext streams
+ *
+ * Same as object_read for contents that are not in files of their own.
+ *
+ * @param name Base name of the module, used in diagnostics
+ * @param ob Stream holding the .ob text
+ * @param ent Stream holding the .ent text, or NULL if the module has no entries
+ * @param ext Stream holding the .ext text, or NULL if the module has no externals
+ * @param obj Receives the module, must be released with object_free
+ * @return 0 on success, -1 if a stream is malformed (reported with print_error_file)
+ */
+int object_read_streams(const char *name, FILE *ob, FILE *ent, FILE *ext, object_t *obj);
+
+/**
+ * @brief Read a symbol file in the "name<TAB>address" format of .ent and .ext
+ *
+ * @param path Path of the file
+ * @param symbols Receives the symbols in file order (NULL if there are none), released with free
+ * @param count Receives the number of symbols
+ * @return 0 on success, -1 if the file is missing or malformed (reported with print_error_file)
+ */
+int object_read_symbols(const char *path, obj_symbol_t **symbols, int *count);
+
+/**
+ * @brief Build a module from the result of an in-memory assembly
+ *
+ * The words and symbols are copied, so the result can be released afterwards.
+ *
+ * @param name Base name of the module, used in diagnostics, or NULL
+ * @param result Result of a successful asm_assemble_buffer
+ * @param obj Receives the module, must be released with object_free
+ * @return 0 on success, -1 on allocation failure
+ */
+int object_from_result(const char *name, const asm_result_t *result, object_t *obj);
+
+/**
+ * @brief Write a module to base_name.ob, plus .ent and .ext when it has such symbols
+ *
+ * Nothing is written when an address of the module does not fit the 256 word
+ * memory (ADDRESS_BASE plus its words, or a symbol address above 255).
+ *
+ * @param base_name Path of the output without extension
+ * @param obj Module to write
+ * @return 0 on success, -1 on a write error or if the module does not fit (reported with print_error_file)
+ */
+int object_write(const char *base_name, const object_t *obj);
+
+/**
+ * @brief Release everything held by a module
+ *
+ * @param obj Module filled by object_read or link_objects, may be NULL
+ */
+void object_free(object_t *obj);
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+#include <signal.h>
+#include <stdio.h>
+
+/*
+ * =====================================================================================
+ * Filename:  profile.h
+ * Description: Built-in sampling profiler (--profile).
+ * The code marks which phase and which activity it is executing by storing small
+ * integers in two global markers. While profiling, a SIGPROF timer (setitimer)
+ * samples the markers every PROFILE_INTERVAL_US of CPU time, and a flat profile
+ * of the samples is written at the end of the run. The markers are process wide,
+ * so they are only written while prof_enabled is set: from profile_start to
+ * profile_stop, which the driver only calls around a serial run. Outside of it
+ * a marker is a load and a branch, and threads assembling at the same time (the
+ * -j workers, library callers, the linker's readers) never store to them.
+ * =====================================================================================
+ */
+
+#define PROFILE_INTERVAL_US 1000L /* sampling period in microseconds of CPU time */
+
+/* Phase of the assembly being executed. */
+typedef enum {
+    PROF_PHASE_DRIVER = 0, /* option parsing, setup, outside of a file */
+    PROF_PHASE_PREPROCESS,
+    PROF_PHASE_FIRST_PASS,
+    PROF_PHASE_SECOND_PASS,
+    PROF_PHASE_COUNT
+} prof_phase_t;
+
+/* Activity inside the current phase. */
+typedef enum {
+    PROF_ACT_OTHER = 0, /* code without a more specific marker */
+    PROF_ACT_LEXING, /* splitting and parsing source lines */
+    PROF_ACT_OPCODE_LOOKUP, /* mnemonic, directive and keyword tables */
+    PROF_ACT_SYMBOL_LOOKUP, /* symbol and macro tables */
+    PROF_ACT_FORMATTING, /* base-4 conversion of the output */
+    PROF_ACT_IO, /* reading and writing files */
+    PROF_ACT_COUNT
+} prof_activity_t;
+
+extern volatile sig_atomic_t prof_phase;
+extern volatile sig_atomic_t prof_activity;
+extern int prof_enabled; /* set by profile_start, cleared by profile_stop */
+
+/* Marks the current phase. */
+#define PROF_SET_PHASE(phase) (prof_enabled ? (void) (prof_phase = (phase)) : (void) 0)
+
+/* Enters an activity, saving the enclosing one in saved (a sig_atomic_t). */
+#define PROF_ENTER(saved, activity) \
+    ((saved) = prof_activity, prof_enabled ? (void) (prof_activity = (activity)) : (void) 0)
+
+/* Returns to the activity saved by PROF_ENTER. */
+#define PROF_LEAVE(saved) (prof_enabled ? (void) (prof_activity = (saved)) : (void) 0)
+
+/**
+ * @brief Start sampling the phase markers.
+ *
+ * Sets prof_enabled, so it must only be called while a single thread runs the
+ * marked code.
+ *
+ * @param interval_us Sampling period in microseconds of CPU time.
+ * @return 0 on success, -1 if the timer or the signal handler cannot be installed.
+ */
+int profile_start(long interval_us);
+
+/**
+ * @brief Stop sampling and restore the previous SIGPROF handler.
+ */
+void profile_stop(void);
+
+/**
+ * @brief Write the flat profile of the samples taken so far.
+ *
+ * Lists every sampled phase/activity pair by decreasing time, followed by the
+ * totals per activity and per phase.
+ *
+ * @param out Stream receiving the report.
+ */
+void profile_report(FILE *out);
+
+/**
+ * @brief fgets marked as I/O for the profiler.
+ *
+ * @param buf Buffer receiving the line.
+ * @param size Size of the buffer.
+ * @param fp Stream to read from.
+ * @return Same as fgets.
+ */
+char *prof_fgets(char *buf, int size, FILE *fp);
+
+#endif
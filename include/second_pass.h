@@ -1,7 +1,11 @@
 #ifndef SECOND_PASS_H
 #define SECOND_PASS_H
+#include <stdio.h>
 #include "globals.h"
+#include "line_parser.h"
+#include "symbol_table.h"
 #include "util_vec.h"
+#include "cost.h"
 
 /*
  * =====================================================================================
@@ -25,6 +29,11 @@
 #define WORD_SET_ARE(w, are) do { (w) = (WORD)(((w) & ~0x0003) | ((are) & 0x3)); } while(0)
 
 typedef unsigned short WORD;/* store 10-bit words in 16 bits */
+#define WORD_MASK 0x3FF /* the 10 significant bits of a WORD */
+
+#define OB_CODE_DIGITS 3 /* minimum base-4 digits of the code length in the .ob header */
+#define OB_DATA_DIGITS 2 /* minimum base-4 digits of the data length in the .ob header */
+#define LENGTH_BASE4_MAX 33 /* buffer size for any length in base-4 */
 
 /* struct ext_usage_t defines an external symbol usage
  * It contains the name of the external symbol and its absolute address in the code image.
@@ -38,13 +47,20 @@ typedef struct ext_usage {
 /* struct second_pass_ctx_t defines the context for the second pass of the assembler.
  * It contains the code and data images, their current positions, and a vector list of external symbols.
  * The code image is used to store machine code instructions, while the data image stores data directives.
+ * In streaming mode (ob_fp set) code words and extern usages are written out as they are encoded
+ * and the images stay empty.
  */
 typedef struct {
-    WORD code_image[IMAGE_LENGTH];
-    WORD data_image[IMAGE_LENGTH];
+    vec_t code_image; /* WORD elements */
+    vec_t data_image; /* WORD elements */
     int  code_pos;
     int  data_pos;
     vec_t ext_list; /* vector list of all external symbols*/
+    FILE *ob_fp; /* streaming: object file receiving the code words */
+    FILE *ext_fp; /* streaming: externals file, opened on first usage */
+    const char *ext_path; /* streaming: path of the externals file */
+    int  out_failed; /* set when a word could not be stored or written */
+    cost_t *cost; /* receives every encoded instruction, NULL without a cost estimate */
 } second_pass_ctx_t;
 
 /**
@@ -56,8 +72,94 @@ typedef struct {
  * @param input_path Path to the preprocessed assembly file
  * @param file_name Base name for output files
  * @param symtab Symbol table from first pass
+ * @param cost Estimator receiving the instructions, or NULL
+ * @return 0 on success, -1 on failure
+ */
+int second_pass(const char *input_path, const char *file_name, symbol_table_t *symtab, cost_t *cost);
+
+/**
+ * @brief Encodes a preprocessed source from an opened stream into a context
+ *
+ * Core of second_pass without any output file: on return ctx holds the code and
+ * data images and the external symbol usages. The context is initialized by this
+ * call and must be released with second_pass_ctx_destroy, also on failure.
+ *
+ * @param fp Stream holding the preprocessed source
+ * @param file_name Name of the source used in diagnostics
+ * @param symtab Symbol table from first pass
+ * @param ctx Context receiving the images
  * @return 0 on success, -1 on failure
  */
-int second_pass(const char *input_path, const char *file_name, symbol_table_t *symtab);
+int second_pass_stream(FILE *fp, const char *file_name, symbol_table_t *symtab, second_pass_ctx_t *ctx);
+
+/**
+ * @brief Release the images and lists of a second pass context
+ *
+ * @param ctx Context filled by second_pass_stream
+ */
+void second_pass_ctx_destroy(second_pass_ctx_t *ctx);
+
+/**
+ * @brief Convert a word to base-4 digits 'a' (0) to 'd' (3)
+ *
+ * @param w Word to convert, only the low 2 * (length - 1) bits are used
+ * @param out Buffer of length characters receiving the digits and a terminator
+ * @param length Size of out, one more than the number of digits
+ */
+void word_to_base4(WORD w, char *out, int length);
+
+/**
+ * @brief Convert a length to base-4 digits, without losing high digits
+ *
+ * @param length Non-negative value to convert
+ * @param min_digits The result is padded with 'a' (0) to at least this many digits
+ * @param out Buffer of LENGTH_BASE4_MAX characters receiving the digits and a terminator
+ */
+void length_to_base4(long length, int min_digits, char *out);
+
+/**
+ * @brief Encode one parsed instruction into the code image of a context
+ *
+ * @param ctx Context filled by second_pass_stream (or zero initialized with its vectors created)
+ * @param pl Parsed operation line
+ * @param st Symbol table from first pass
+ * @return 0 on success, -1 if an operand uses an undefined symbol
+ */
+int encode_instruction(second_pass_ctx_t *ctx, parsed_line *pl, symbol_table_t *st);
+
+/**
+ * @brief Encode one parsed .data, .string or .mat directive into the data image
+ *
+ * @param ctx Context receiving the data words
+ * @param pl Parsed directive line
+ */
+void encode_data(second_pass_ctx_t *ctx, parsed_line *pl);
+
+/**
+ * @brief Write the object file contents (header, code and data words) to a stream
+ *
+ * @param fp Stream receiving the .ob text
+ * @param ctx Context filled by second_pass_stream
+ * @return 0 on success, -1 on a write error
+ */
+int write_ob_stream(FILE *fp, const second_pass_ctx_t *ctx);
+
+/**
+ * @brief Write the entry symbols of a symbol table to a stream in .ent format
+ *
+ * @param fp Stream receiving the .ent text
+ * @param st Symbol table from first pass
+ * @return 0 on success, -1 on a write error
+ */
+int write_ent_stream(FILE *fp, symbol_table_t *st);
+
+/**
+ * @brief Write the external symbol usages of a context to a stream in .ext format
+ *
+ * @param fp Stream receiving the .ext text
+ * @param ctx Context filled by second_pass_stream
+ * @return 0 on success, -1 on a write error
+ */
+int write_ext_stream(FILE *fp, const second_pass_ctx_t *ctx);
 
 #endif
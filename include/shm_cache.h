@@ -0,0 +1,74 @@
+#ifndef SHM_CACHE_H
+#define SHM_CACHE_H
+#include <stdio.h>
+#include "util_hash.h"
+
+/*
+ * =====================================================================================
+ * Filename:  shm_cache.h
+ * Description: Opt-in build cache in POSIX shared memory. Concurrently running
+ * assembler processes store the preprocessed (.am) result of every source in a
+ * shared segment keyed by a hash of the source content, and reuse each other's
+ * work without any daemon. The index is an open addressing table protected by a
+ * single process-shared mutex that is only held while copying an entry.
+ * =====================================================================================
+ */
+
+#define SHM_CACHE_DEFAULT_NAME "/assembler_cache" /* shm_open name */
+#define SHM_CACHE_SLOTS 4096 /* index slots, power of 2 */
+#define SHM_CACHE_ARENA_SIZE (32UL * 1024UL * 1024UL) /* bytes of cached content */
+#define SHM_CACHE_MAX_ENTRY (SHM_CACHE_ARENA_SIZE / 8) /* larger results are not cached */
+
+/* struct shm_cache_t is a process local handle on the shared segment. */
+typedef struct {
+    void *base; /* start of the mapping */
+    size_t map_size; /* size of the mapping */
+    struct shm_cache_header *hdr; /* segment header (in the mapping) */
+    struct shm_cache_slot *slots; /* index slots (in the mapping) */
+    char *arena; /* cached content (in the mapping) */
+} shm_cache_t;
+
+/**
+ * @brief Create or attach the shared cache segment.
+ *
+ * The first process creates and initializes the segment, the others wait
+ * until it is ready and attach to it. A segment that is never made ready, or
+ * that was created by a build with another layout, is replaced by a new one.
+ *
+ * @param cache Handle to initialize.
+ * @param name shm_open name of the segment (starts with '/').
+ * @return 0 on success, -1 if shared memory is not available.
+ */
+int shm_cache_open(shm_cache_t *cache, const char *name);
+
+/**
+ * @brief Detach from the shared segment. The segment itself stays for other processes.
+ *
+ * @param cache Handle to close.
+ */
+void shm_cache_close(shm_cache_t *cache);
+
+/**
+ * @brief Look up a key and write the cached content to out.
+ *
+ * @param cache Open cache handle.
+ * @param key Content key of the source (content_key_file).
+ * @param out Stream receiving the cached content on a hit.
+ * @return 1 on a hit, 0 on a miss, -1 on error.
+ */
+int shm_cache_fetch(shm_cache_t *cache, const content_key_t *key, FILE *out);
+
+/**
+ * @brief Store the content of a file under a key.
+ *
+ * Results larger than SHM_CACHE_MAX_ENTRY are silently skipped. When the arena
+ * or the index is full the whole cache is recycled.
+ *
+ * @param cache Open cache handle.
+ * @param key Content key of the source (content_key_file).
+ * @param path File holding the result to cache.
+ * @return 0 on success (or skipped), -1 on error.
+ */
+int shm_cache_store(shm_cache_t *cache, const content_key_t *key, const char *path);
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef SPILL_H
+#define SPILL_H
+#include <stdio.h>
+#include "line_parser.h"
+#include "second_pass.h"
+
+/*
+ * =====================================================================================
+ * Filename:  spill.h
+ * Description: Compact temporary spill files used by the memory-bounded (streaming)
+ * mode of the assembler. The first pass streams every instruction into a statement
+ * spill and every data word into a data spill, the second pass streams them back.
+ * Memory use stays constant in the size of the input.
+ * =====================================================================================
+ */
+
+#define SPILL_MIN_BUFFER 4096 /* smallest stdio buffer given to a spill file */
+
+/* struct spill_t defines the pair of temporary files of a streaming assembly.
+ * Instruction records are written in source order, data words are already encoded.
+ */
+typedef struct {
+    FILE *stmt_fp; /* compact instruction records */
+    FILE *data_fp; /* encoded data image words */
+    long code_words; /* words the instructions will occupy (IC) */
+    long data_words; /* words written to data_fp (DC) */
+} spill_t;
+
+/**
+ * @brief Open the temporary spill files.
+ *
+ * The files are anonymous (tmpfile) and vanish when closed. The memory budget
+ * in bytes is split between the stdio buffers of the two files.
+ *
+ * @param sp Pointer to the spill structure to initialize.
+ * @param mem_budget Memory budget in bytes for the spill buffers.
+ * @return 0 on success, -1 on failure.
+ */
+int spill_open(spill_t *sp, long mem_budget);
+
+/**
+ * @brief Close and delete the spill files.
+ *
+ * @param sp Pointer to the spill structure.
+ */
+void spill_close(spill_t *sp);
+
+/**
+ * @brief Append an instruction record to the statement spill.
+ *
+ * @param sp Pointer to the spill structure.
+ * @param pl Parsed line of kind LINE_OPERATION.
+ * @param line_no Source line number, kept for diagnostics of the second pass.
+ * @param n_words Number of words the instruction occupies.
+ * @return 0 on success, -1 on write failure.
+ */
+int spill_put_instruction(spill_t *sp, const parsed_line *pl, int line_no, int n_words);
+
+/**
+ * @brief Append the words of a .data/.string/.mat directive to the data spill.
+ *
+ * @param sp Pointer to the spill structure.
+ * @param pl Parsed line of kind LINE_DIRECTIVE.
+ * @return 0 on success, -1 on write failure.
+ */
+int spill_put_data(spill_t *sp, const parsed_line *pl);
+
+/**
+ * @brief Rewind both spill files so the second pass can stream them back.
+ *
+ * @param sp Pointer to the spill structure.
+ * @return 0 on success, -1 on failure.
+ */
+int spill_rewind(spill_t *sp);
+
+/**
+ * @brief Read the next instruction record from the statement spill.
+ *
+ * @param sp Pointer to the spill structure.
+ * @param pl Parsed line to fill, only the operation part is meaningful.
+ * @param line_no Receives the source line number of the instruction.
+ * @return 1 if a record was read, 0 at end of spill, -1 on a corrupt record.
+ */
+int spill_get_instruction(spill_t *sp, parsed_line *pl, int *line_no);
+
+/**
+ * @brief Read the next encoded data word from the data spill.
+ *
+ * @param sp Pointer to the spill structure.
+ * @param w Receives the word.
+ * @return 1 if a word was read, 0 at end of spill.
+ */
+int spill_get_data_word(spill_t *sp, WORD *w);
+
+/**
+ * @brief Performs the first pass of the assembler, spilling the statements.
+ *
+ * Same as first_pass, but every instruction is also appended to the statement
+ * spill and every data directive is encoded into the data spill.
+ * A NULL spill makes it behave exactly like first_pass.
+ *
+ * @param input_path Path to the assembly file (.am)
+ * @param symtab Pointer to the symbol table to populate
+ * @param spill Open spill files, or NULL
+ * @return 0 on success, number of errors otherwise
+ */
+int first_pass_spill(const char *input_path, symbol_table_t *symtab, spill_t *spill);
+
+/**
+ * @brief Performs the second pass of the assembler from the spill files.
+ *
+ * Streams the instruction records back, writes every encoded word to the .ob
+ * file as soon as it is produced and appends the spilled data words. Extern
+ * usages are written to the .ext file directly. The outputs are identical to
+ * the ones of second_pass, partial outputs are removed on failure.
+ *
+ * @param spill Spill files filled by first_pass_spill
+ * @param file_name Base name for output files
+ * @param symtab Symbol table from first pass
+ * @param cost Estimator receiving the instructions, or NULL
+ * @return 0 on success, -1 on failure
+ */
+int second_pass_spill(spill_t *spill, const char *file_name, symbol_table_t *symtab, cost_t *cost);
+
+#endif
@@ -1,5 +1,6 @@
 #ifndef SYMBOL_TABLE_H
 #define SYMBOL_TABLE_H
+#include <stdio.h>
 #include "globals.h"
 #include "util_hash.h"
 
@@ -101,4 +102,17 @@ symbol_t *symtab_iter_next(symbol_table_t *st, hash_entry_t **iter);
  * @return 0 on success, -1 on failure
  */
 int first_pass(const char *input_path, symbol_table_t *symbol_table);
+
+/**
+ * @brief Performs the first pass of the assembler on an opened stream
+ *
+ * Same as first_pass, for sources that are not files (e.g. in-memory buffers).
+ * The stream is read to its end and not closed.
+ *
+ * @param fp Stream holding the preprocessed source
+ * @param source_name Name of the source used in diagnostics
+ * @param symbol_table Pointer to the symbol table to populate
+ * @return 0 on success, number of errors otherwise
+ */
+int first_pass_stream(FILE *fp, const char *source_name, symbol_table_t *symbol_table);
 #endif
@@ -5,13 +5,15 @@
  * =====================================================================================
  * Filename: util_hash.h
  * Description: Header file for a generic hash table implementation using the djb2 hash
- * function and collision resolution with the Chaining method.
+ * function and collision resolution with the Chaining method, and for the content
+ * keys that identify a file by what it holds.
  * =====================================================================================
  */
 
 #define HASH_STARTING_VAL 5381 /* The initial value for the hash function, commonly used in djb2 */
 #define DJ_SHIFT 5 /* The number of bits to shift left in the hash function */
 #define INITIAL_CAPACITY 32 /* The initial capacity of the hash table */
+#define HASH_MAX_LOAD 1 /* average entries per bucket before the table doubles */
 
 /**
  * A hash entry structure that represents a key-value pair in the hash table.
@@ -20,6 +22,7 @@
 typedef struct hash_entry_t {
     char *key;
     void *value;
+    unsigned long hash; /* djb2 of the key, kept for lookups, growth and iteration */
     struct hash_entry_t *next; /* for chaining */
 } hash_entry_t;
 
@@ -34,6 +37,16 @@ typedef struct {
     hash_entry_t **tbl;
 } hash_table_t;
 
+/**
+ * A content key identifies a file by content.
+ * Two independent hashes and the length make accidental collisions negligible.
+ */
+typedef struct {
+    unsigned long fnv; /* FNV-1a of the content */
+    unsigned long djb; /* djb2 of the content */
+    unsigned long len; /* content length in bytes */
+} content_key_t;
+
 /**
  * Creates a new hash table with the specified capacity.
  * The capacity should be a power of 2.
@@ -57,6 +70,8 @@ void hash_destroy(hash_table_t *ht, void (*destroy_val)(void *));
  * Puts a key-value pair into the hash table.
  * If the key already exists, it updates the value.
  * Old value is not freed, caller is responsible.
+ * The table doubles its capacity when it holds more than HASH_MAX_LOAD entries
+ * per bucket, so an iteration must not be interleaved with insertions.
  *
  * @param ht Pointer to the hash table
  * @param key The key to insert or update
@@ -97,6 +112,7 @@ size_t hash_size(const hash_table_t *ht);
  * Gets the next entry in the hash table after the current entry.
  * If current is NULL, it returns the first entry in the table.
  * If there are no more entries, it returns NULL.
+ * A full iteration takes time linear in the size plus the capacity.
  *
  * @param ht Pointer to the hash table
  * @param current Pointer to the current hash entry, or NULL to start from the beginning
@@ -104,4 +120,22 @@ size_t hash_size(const hash_table_t *ht);
  */
 hash_entry_t *hash_get_next(hash_table_t *ht, const hash_entry_t *current);
 
+/**
+ * Computes the content key of a file.
+ *
+ * @param path Path of the file to hash
+ * @param key Receives the key
+ * @return 0 on success, -1 if the file cannot be read
+ */
+int content_key_file(const char *path, content_key_t *key);
+
+/**
+ * Compares two content keys.
+ *
+ * @param a First key
+ * @param b Second key
+ * @return 1 if both keys are equal, 0 otherwise
+ */
+int content_key_equal(const content_key_t *a, const content_key_t *b);
+
 #endif
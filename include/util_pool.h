@@ -0,0 +1,35 @@
+#ifndef UTIL_POOL_H
+#define UTIL_POOL_H
+#include <stddef.h>
+#include "jobserver.h"
+
+/*
+ * =====================================================================================
+ * Filename:  util_pool.h
+ * Description: Header file for a minimal worker pool. A fixed number of threads
+ * take items 0..n-1 from a shared counter in increasing order until none is left.
+ * The calling thread is worker 0. Optionally every additional worker holds a make
+ * jobserver token while it processes an item.
+ * =====================================================================================
+ */
+
+/**
+ * A task processes a single item. worker is the index (0..n_workers-1) of the
+ * thread running it, so tasks can use per-worker scratch state without locking.
+ */
+typedef void (*pool_task_fn)(void *arg, size_t item, int worker);
+
+/**
+ * Runs task on every item using up to n_workers threads and waits for all of them.
+ * If some threads cannot be started the remaining workers still process every item.
+ *
+ * @param n_items Number of items
+ * @param n_workers Number of workers, values below 1 mean 1
+ * @param task Function called once per item
+ * @param arg Argument passed to every call of task
+ * @param js Connected jobserver to take tokens from, or NULL
+ * @return 0 if all workers were started, -1 if the pool ran with fewer workers
+ */
+int pool_run(size_t n_items, int n_workers, pool_task_fn task, void *arg, jobserver_t *js);
+
+#endif
@@ -56,4 +56,14 @@ int vec_push(vec_t *v, const void *elem);
  */
 void *vec_get(const vec_t *v, size_t idx);
 
+/**
+ * Moves the elements of a vector into a plain array owned by the caller
+ * and leaves the vector empty.
+ *
+ * @param v Pointer to the vector structure
+ * @param len Receives the number of elements
+ * @return The array, or NULL if the vector is empty
+ */
+void *vec_take(vec_t *v, int *len);
+
 #endif
\ No newline at end of file
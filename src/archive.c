@@ -0,0 +1,425 @@
+#define _POSIX_C_SOURCE 200809L /* mmap, fmemopen */
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../include/archive.h"
+#include "../include/errors.h"
+
+/*
+ * =====================================================================================
+ * Filename:  archive.c
+ * Description: Writes and reads static archives (layout in archive.h). Numbers are
+ * stored big-endian so an archive can be copied between hosts, and every offset is
+ * checked once when the archive is opened, so lookups and member reads can trust
+ * the mapped file afterwards.
+ * =====================================================================================
+ */
+
+#define ARCHIVE_MAGIC "ASMARCH1"
+#define MAGIC_LEN 8
+#define FIELD_SIZE 4 /* every number is 32 bits */
+#define HEADER_SIZE (MAGIC_LEN + 6 * FIELD_SIZE)
+#define MEMBER_FIELDS 7 /* name, ob offset/length, ent offset/length, ext offset/length */
+#define SLOT_FIELDS 3 /* hash, name offset, member */
+#define MEMBER_SIZE (MEMBER_FIELDS * FIELD_SIZE)
+#define SLOT_SIZE (SLOT_FIELDS * FIELD_SIZE)
+
+/* header fields after the magic */
+#define H_MEMBERS 0
+#define H_SLOTS 1
+#define H_MEMBER_OFF 2
+#define H_SLOT_OFF 3
+#define H_STRING_OFF 4
+#define H_SIZE 5
+
+/* member fields, the file texts are (offset, length) pairs starting at M_OB */
+#define M_NAME 0
+#define M_OB 1
+#define M_ENT 3
+#define M_EXT 5
+
+/* slot fields */
+#define S_HASH 0
+#define S_NAME 1
+#define S_MEMBER 2
+
+/* struct blob_t is a growing byte buffer: the string area while an archive is written. */
+typedef struct {
+    unsigned char *data;
+    size_t len;
+    size_t cap;
+} blob_t;
+
+/* --- Private Helper Functions --- */
+
+static unsigned long get_u32(const unsigned char *p) {
+    return ((unsigned long) p[0] << 24) | ((unsigned long) p[1] << 16) |
+           ((unsigned long) p[2] << 8) | (unsigned long) p[3];
+}
+
+static void put_u32(unsigned char *p, const unsigned long v) {
+    p[0] = (unsigned char) ((v >> 24) & 0xFF);
+    p[1] = (unsigned char) ((v >> 16) & 0xFF);
+    p[2] = (unsigned char) ((v >> 8) & 0xFF);
+    p[3] = (unsigned char) (v & 0xFF);
+}
+
+/* The djb2 hash cut to 32 bits, the width stored in the slots. */
+static unsigned long symbol_hash(const char *s) {
+    unsigned long h = 5381;
+
+    while (*s) h = ((h << 5) + h + (unsigned char) *s++) & 0xFFFFFFFFUL;
+    return h;
+}
+
+/* Appends n bytes to a blob. Returns their offset in the blob, or -1 on allocation failure. */
+static long blob_append(blob_t *b, const void *p, const size_t n) {
+    unsigned char *grown;
+    size_t cap;
+    long at = (long) b->len;
+
+    if (b->len + n > b->cap) {
+        cap = b->cap ? b->cap : 4096;
+        while (cap < b->len + n) cap *= 2;
+        grown = realloc(b->data, cap);
+        if (!grown) return -1;
+        b->data = grown;
+        b->cap = cap;
+    }
+    memcpy(b->data + b->len, p, n);
+    b->len += n;
+    return at;
+}
+
+/* Appends the contents of a file to a blob and sets its offset and length.
+ * A missing file leaves a length of 0.
+ */
+static int append_file(blob_t *b, const char *path, long *offset, long *length) {
+    FILE *fp;
+    char buf[4096];
+    size_t n;
+    long at;
+
+    *offset = 0;
+    *length = 0;
+    fp = fopen(path, "rb");
+    if (!fp) return 0;
+    *offset = (long) b->len;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        at = blob_append(b, buf, n);
+        if (at < 0) {
+            fclose(fp);
+            return -1;
+        }
+    }
+    fclose(fp);
+    *length = (long) b->len - *offset;
+    return 0;
+}
+
+/* Appends a module's name and file texts to the string area and fills its member record
+ * with offsets relative to the string area.
+ */
+static int pack_member(blob_t *strings, const char *name, unsigned char *record) {
+    const char *endings[3] = {".ob", ".ent", ".ext"};
+    char *path;
+    long offset, length;
+    int i;
+
+    offset = blob_append(strings, name, strlen(name) + 1);
+    if (offset < 0) return -1;
+    put_u32(record + M_NAME * FIELD_SIZE, (unsigned long) offset);
+    for (i = 0; i < 3; i++) {
+        path = create_file_path(name, endings[i]);
+        if (!path || append_file(strings, path, &offset, &length) != 0) {
+            free(path);
+            return -1;
+        }
+        free(path);
+        put_u32(record + (M_OB + 2 * i) * FIELD_SIZE, (unsigned long) offset);
+        put_u32(record + (M_OB + 2 * i + 1) * FIELD_SIZE, (unsigned long) length);
+    }
+    return 0;
+}
+
+/* Inserts the entries of a module into the slot table.
+ * Name offsets are relative to the string area. Returns the number of duplicates.
+ */
+static int index_entries(blob_t *strings, const object_t *obj, const int member, unsigned char *slots,
+                         const unsigned long n_slots, int *out_of_memory) {
+    unsigned char *slot;
+    unsigned long h, i;
+    long name_off;
+    int e, duplicates = 0;
+    char *ent_path;
+
+    for (e = 0; e < obj->n_entries; e++) {
+        h = symbol_hash(obj->entries[e].name);
+        for (i = h & (n_slots - 1);; i = (i + 1) & (n_slots - 1)) {
+            slot = slots + i * SLOT_SIZE;
+            if (get_u32(slot + S_NAME * FIELD_SIZE) == 0) break;
+            if (get_u32(slot + S_HASH * FIELD_SIZE) == h &&
+                strcmp((char *) strings->data + get_u32(slot + S_NAME * FIELD_SIZE), obj->entries[e].name) == 0) {
+                break;
+            }
+        }
+        if (get_u32(slot + S_NAME * FIELD_SIZE) != 0) {
+            ent_path = create_file_path(obj->name, ".ent");
+            print_error_file(ent_path ? ent_path : obj->name, ERROR_DUPLICATE_EXPORTED_SYMBOL, e + 1);
+            free(ent_path);
+            duplicates++;
+            continue;
+        }
+        name_off = blob_append(strings, obj->entries[e].name, strlen(obj->entries[e].name) + 1);
+        if (name_off < 0) {
+            *out_of_memory = 1;
+            return duplicates;
+        }
+        put_u32(slot + S_HASH * FIELD_SIZE, h);
+        put_u32(slot + S_NAME * FIELD_SIZE, (unsigned long) name_off);
+        put_u32(slot + S_MEMBER * FIELD_SIZE, (unsigned long) member);
+    }
+    return duplicates;
+}
+
+/* Turns the offsets into the string area of the tables into file offsets. */
+static void rebase_offsets(unsigned char *members, const int n_members, unsigned char *slots,
+                           const unsigned long n_slots, const unsigned long string_off) {
+    unsigned char *p;
+    unsigned long i;
+    int m, f;
+
+    for (m = 0; m < n_members; m++) {
+        p = members + (size_t) m * MEMBER_SIZE;
+        for (f = M_NAME; f <= M_EXT; f += (f == M_NAME) ? 1 : 2) {
+            put_u32(p + f * FIELD_SIZE, get_u32(p + f * FIELD_SIZE) + string_off);
+        }
+    }
+    for (i = 0; i < n_slots; i++) {
+        p = slots + i * SLOT_SIZE;
+        if (get_u32(p + S_NAME * FIELD_SIZE) != 0) {
+            put_u32(p + S_NAME * FIELD_SIZE, get_u32(p + S_NAME * FIELD_SIZE) + string_off);
+        }
+    }
+}
+
+/* Checks that every offset of an archive stays inside the file. */
+static int check_layout(const archive_t *ar, const unsigned long member_off, const unsigned long slot_off,
+                        const unsigned long string_off) {
+    const unsigned char *p;
+    unsigned long i, off, len;
+    int f;
+
+    if (ar->n_slots == 0 || (ar->n_slots & (ar->n_slots - 1)) != 0) return -1;
+    if (member_off != HEADER_SIZE || ar->n_members > (ar->size - HEADER_SIZE) / MEMBER_SIZE) return -1;
+    if (slot_off != member_off + ar->n_members * MEMBER_SIZE) return -1;
+    if (ar->n_slots > (ar->size - slot_off) / SLOT_SIZE) return -1;
+    if (string_off != slot_off + ar->n_slots * SLOT_SIZE || string_off >= ar->size) return -1;
+
+    for (i = 0; i < ar->n_members; i++) {
+        p = ar->members + i * MEMBER_SIZE;
+        off = get_u32(p + M_NAME * FIELD_SIZE);
+        if (off < string_off || off >= ar->size) return -1;
+        for (f = M_OB; f <= M_EXT; f += 2) {
+            off = get_u32(p + f * FIELD_SIZE);
+            len = get_u32(p + (f + 1) * FIELD_SIZE);
+            if (len > 0 && (off < string_off || len > ar->size - off)) return -1;
+        }
+        if (get_u32(p + (M_OB + 1) * FIELD_SIZE) == 0) return -1; /* every member has code or data */
+    }
+    for (i = 0; i < ar->n_slots; i++) {
+        p = ar->slots + i * SLOT_SIZE;
+        off = get_u32(p + S_NAME * FIELD_SIZE);
+        if (off == 0) continue;
+        if (off < string_off || off >= ar->size || get_u32(p + S_MEMBER * FIELD_SIZE) >= ar->n_members) return -1;
+    }
+    return 0;
+}
+
+/* Opens one text of a member as a stream, NULL if the member has no such file. */
+static FILE *open_member_text(const archive_t *ar, const unsigned char *record, const int field) {
+    unsigned long off = get_u32(record + field * FIELD_SIZE);
+    unsigned long len = get_u32(record + (field + 1) * FIELD_SIZE);
+
+    if (len == 0) return NULL;
+    return fmemopen((void *) (ar->base + off), (size_t) len, "r");
+}
+
+/* --- Public API Functions Implementation --- */
+
+int archive_write(const char *path, char *const *modules, const int n_modules) {
+    object_t *objs;
+    blob_t strings;
+    unsigned char header[HEADER_SIZE];
+    unsigned char *members = NULL, *slots = NULL;
+    unsigned long n_slots = 1, total_entries = 0, string_off;
+    int m, n_read = 0, out_of_memory = 0, errors = 0;
+    FILE *fp;
+
+    memset(&strings, 0, sizeof(strings));
+    objs = calloc((size_t) (n_modules > 0 ? n_modules : 1), sizeof(object_t));
+    members = calloc((size_t) (n_modules > 0 ? n_modules : 1), MEMBER_SIZE);
+    if (!objs || !members || blob_append(&strings, "", 1) < 0) {
+        print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+        free(objs);
+        free(members);
+        free(strings.data);
+        return -1;
+    }
+
+    /* read every module, so the archive only holds valid objects, and pack its texts */
+    for (m = 0; m < n_modules; m++, n_read++) {
+        if (object_read(modules[m], &objs[m]) != 0) {
+            errors++;
+            continue;
+        }
+        total_entries += (unsigned long) objs[m].n_entries;
+        if (pack_member(&strings, modules[m], members + (size_t) m * MEMBER_SIZE) != 0) out_of_memory = 1;
+    }
+
+    /* at most half the slots are used, so probe sequences stay short */
+    while (n_slots < 2 * total_entries) n_slots *= 2;
+    slots = calloc((size_t) n_slots, SLOT_SIZE);
+    if (!slots) out_of_memory = 1;
+    for (m = 0; m < n_modules && !errors && !out_of_memory; m++) {
+        errors += index_entries(&strings, &objs[m], m, slots, n_slots, &out_of_memory);
+    }
+    if (!out_of_memory && blob_append(&strings, "", 1) < 0) out_of_memory = 1; /* the file ends with a NUL */
+
+    if (out_of_memory) print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+    if (!errors && !out_of_memory) {
+        string_off = HEADER_SIZE + (unsigned long) n_modules * MEMBER_SIZE + n_slots * SLOT_SIZE;
+        rebase_offsets(members, n_modules, slots, n_slots, string_off);
+        memcpy(header, ARCHIVE_MAGIC, MAGIC_LEN);
+        put_u32(header + MAGIC_LEN + H_MEMBERS * FIELD_SIZE, (unsigned long) n_modules);
+        put_u32(header + MAGIC_LEN + H_SLOTS * FIELD_SIZE, n_slots);
+        put_u32(header + MAGIC_LEN + H_MEMBER_OFF * FIELD_SIZE, HEADER_SIZE);
+        put_u32(header + MAGIC_LEN + H_SLOT_OFF * FIELD_SIZE, HEADER_SIZE + (unsigned long) n_modules * MEMBER_SIZE);
+        put_u32(header + MAGIC_LEN + H_STRING_OFF * FIELD_SIZE, string_off);
+        put_u32(header + MAGIC_LEN + H_SIZE * FIELD_SIZE, string_off + (unsigned long) strings.len);
+
+        fp = fopen(path, "wb");
+        if (!fp) {
+            print_error_file(path, ERROR_CANNOT_OPEN_FILE, 0);
+            errors++;
+        } else {
+            fwrite(header, 1, HEADER_SIZE, fp);
+            fwrite(members, MEMBER_SIZE, (size_t) n_modules, fp);
+            fwrite(slots, SLOT_SIZE, (size_t) n_slots, fp);
+            fwrite(strings.data, 1, strings.len, fp);
+            if (ferror(fp)) errors++;
+            if (fclose(fp) != 0) errors++;
+            if (errors) print_error_file(path, ERROR_WRITE_FAILED, 0);
+        }
+    }
+
+    for (m = 0; m < n_read; m++) object_free(&objs[m]);
+    free(objs);
+    free(members);
+    free(slots);
+    free(strings.data);
+    return (errors || out_of_memory) ? -1 : 0;
+}
+
+int archive_open(const char *path, archive_t *ar) {
+    struct stat st;
+    void *map;
+    int fd;
+    unsigned long member_off, slot_off, string_off;
+
+    memset(ar, 0, sizeof(*ar));
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        print_error_file(path, ERROR_CANNOT_OPEN_FILE, 0);
+        return -1;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size < HEADER_SIZE) {
+        close(fd);
+        print_error_file(path, ERROR_INVALID_ARCHIVE, 0);
+        return -1;
+    }
+    map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        print_error_file(path, ERROR_CANNOT_OPEN_FILE, 0);
+        return -1;
+    }
+
+    ar->base = map;
+    ar->size = (size_t) st.st_size;
+    ar->path = dupstr(path);
+    ar->n_members = get_u32(ar->base + MAGIC_LEN + H_MEMBERS * FIELD_SIZE);
+    ar->n_slots = get_u32(ar->base + MAGIC_LEN + H_SLOTS * FIELD_SIZE);
+    member_off = get_u32(ar->base + MAGIC_LEN + H_MEMBER_OFF * FIELD_SIZE);
+    slot_off = get_u32(ar->base + MAGIC_LEN + H_SLOT_OFF * FIELD_SIZE);
+    string_off = get_u32(ar->base + MAGIC_LEN + H_STRING_OFF * FIELD_SIZE);
+    ar->members = ar->base + member_off;
+    ar->slots = ar->base + slot_off;
+
+    if (!ar->path) {
+        print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+        archive_close(ar);
+        return -1;
+    }
+    if (memcmp(ar->base, ARCHIVE_MAGIC, MAGIC_LEN) != 0 ||
+        get_u32(ar->base + MAGIC_LEN + H_SIZE * FIELD_SIZE) != ar->size || ar->base[ar->size - 1] != '\0' ||
+        check_layout(ar, member_off, slot_off, string_off) != 0) {
+        print_error_file(path, ERROR_INVALID_ARCHIVE, 0);
+        archive_close(ar);
+        return -1;
+    }
+    return 0;
+}
+
+void archive_close(archive_t *ar) {
+    if (!ar) return;
+    if (ar->base) munmap((void *) ar->base, ar->size);
+    free(ar->path);
+    memset(ar, 0, sizeof(*ar));
+}
+
+int archive_find(const archive_t *ar, const char *symbol) {
+    const unsigned char *slot;
+    unsigned long h = symbol_hash(symbol), i, probes, name_off;
+
+    i = h & (ar->n_slots - 1);
+    for (probes = 0; probes < ar->n_slots; probes++, i = (i + 1) & (ar->n_slots - 1)) {
+        slot = ar->slots + i * SLOT_SIZE;
+        name_off = get_u32(slot + S_NAME * FIELD_SIZE);
+        if (name_off == 0) return -1;
+        if (get_u32(slot + S_HASH * FIELD_SIZE) == h && strcmp((const char *) ar->base + name_off, symbol) == 0) {
+            return (int) get_u32(slot + S_MEMBER * FIELD_SIZE);
+        }
+    }
+    return -1;
+}
+
+const char *archive_member_name(const archive_t *ar, const int member) {
+    return (const char *) ar->base + get_u32(ar->members + (size_t) member * MEMBER_SIZE + M_NAME * FIELD_SIZE);
+}
+
+int archive_load_member(const archive_t *ar, const int member, object_t *obj) {
+    const unsigned char *record = ar->members + (size_t) member * MEMBER_SIZE;
+    FILE *ob, *ent, *ext;
+    int result = -1;
+
+    memset(obj, 0, sizeof(*obj));
+    ob = open_member_text(ar, record, M_OB);
+    ent = open_member_text(ar, record, M_ENT);
+    ext = open_member_text(ar, record, M_EXT);
+    if (!ob || (get_u32(record + (M_ENT + 1) * FIELD_SIZE) && !ent) ||
+        (get_u32(record + (M_EXT + 1) * FIELD_SIZE) && !ext)) {
+        print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+    } else {
+        result = object_read_streams(archive_member_name(ar, member), ob, ent, ext, obj);
+    }
+
+    if (ob) fclose(ob);
+    if (ent) fclose(ent);
+    if (ext) fclose(ext);
+    return result;
+}
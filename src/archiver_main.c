@@ -0,0 +1,55 @@
+#include <stdio.h>
+#include <string.h>
+#include "../include/archive.h"
+#include "../include/errors.h"
+
+/*
+ * =====================================================================================
+ * Filename:  archiver_main.c
+ * Description: Command line driver of the archiver. Packs assembled modules into a
+ * static archive with a prebuilt symbol index, or lists the members and the index
+ * of an existing archive (-t).
+ * =====================================================================================
+ */
+
+/* Prints every member with the symbols the index maps to it. */
+static int list_archive(const char *path) {
+    archive_t ar;
+    object_t obj;
+    unsigned long m;
+    int i, result = 0;
+
+    if (archive_open(path, &ar) != 0) return -1;
+    for (m = 0; m < ar.n_members; m++) {
+        printf("%s\n", archive_member_name(&ar, (int) m));
+        if (archive_load_member(&ar, (int) m, &obj) != 0) {
+            result = -1;
+        } else {
+            for (i = 0; i < obj.n_entries; i++) {
+                printf("\t%s%s\n", obj.entries[i].name,
+                       archive_find(&ar, obj.entries[i].name) == (int) m ? "" : " (not indexed)");
+            }
+        }
+        object_free(&obj);
+    }
+    archive_close(&ar);
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc == 3 && strcmp(argv[1], "-t") == 0) {
+        return list_archive(argv[2]) == 0 ? 0 : 1;
+    }
+    if (argc < 3 || argv[1][0] == '-') {
+        print_error(ERROR_INVALID_ARGUMENT);
+        printf("Usage: %s <archive> <module1> ... <moduleN>\n"
+               "       %s -t <archive>\n", argv[0], argv[0]);
+        return 1;
+    }
+    if (archive_write(argv[1], argv + 2, argc - 2) != 0) {
+        printf("Archive %s not written\n", argv[1]);
+        return 1;
+    }
+    printf("Archived %d modules into %s\n", argc - 2, argv[1]);
+    return 0;
+}
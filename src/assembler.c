@@ -1,96 +1,430 @@
+#define _POSIX_C_SOURCE 200809L /* sysconf */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include "../include/macro.h"
 #include "../include/symbol_table.h"
 #include "../include/second_pass.h"
+#include "../include/spill.h"
+#include "../include/shm_cache.h"
+#include "../include/jobserver.h"
+#include "../include/util_pool.h"
+#include "../include/profile.h"
+#include "../include/cost.h"
 #include "../include/errors.h"
-int main(int argc, char *argv[]) {
-    int i;
-    int overall_result = 0;
+
+#define NO_MEM_BUDGET (-1L) /* assemble every file in memory */
+#define JOBS_UNSET 0 /* no -j given */
+
+/* struct options_t holds the command line options shared by every input file. */
+typedef struct {
+    long mem_budget; /* bytes, NO_MEM_BUDGET for the in-memory mode */
+    const char *shm_cache_name; /* shared build cache segment, NULL if disabled */
+    int jobs; /* worker threads, JOBS_UNSET if not given */
+    int profile; /* sample the phases with the built-in profiler */
+    const char *profile_path; /* profile report file, NULL for stderr */
+    int cost; /* write the static cost estimate of every file */
+    cost_table_t cost_table; /* cycles charged by the estimate */
+} options_t;
+
+/* struct driver_t is the state shared by the workers assembling the input files. */
+typedef struct {
+    const options_t *opts;
+    shm_cache_t *cache; /* NULL if the shared cache is disabled */
+    char **files; /* input file names */
+    int *results; /* per file result, 0 on success */
+} driver_t;
+
+/* Returns the size of a file in bytes, or -1 if it cannot be opened. */
+static long file_size(const char *path) {
+    FILE *fp;
+    long size;
+
+    fp = fopen(path, "rb");
+    if (!fp) return -1;
+    if (fseek(fp, 0, SEEK_END) != 0) {
+        fclose(fp);
+        return -1;
+    }
+    size = ftell(fp);
+    fclose(fp);
+    return size;
+}
+
+/* Parses the option at argv[i] into opts.
+ * Returns the number of argv entries consumed, 0 if argv[i] is not an option,
+ * or -1 if the option is invalid.
+ *   -m <KB> / --mem-budget=<KB>   memory budget of the streaming mode
+ *   --shm-cache[=<name>]          shared-memory build cache
+ *   -j <N> / -j<N> / --jobs=<N>   number of files assembled in parallel
+ *   --profile[=<file>]            flat profile of the run, on stderr by default
+ *   --cost / --cost-table=<file>  static cost estimate into <file>.cost, with the given cost table
+ */
+static int parse_option(int argc, char *argv[], int i, options_t *opts) {
+    const char *val = NULL;
+    char *end;
+    long kb;
+    int consumed = 0;
+
+    if (strcmp(argv[i], "-j") == 0) {
+        if (i + 1 >= argc) return -1;
+        opts->jobs = parse_jobs(argv[i + 1]);
+        return opts->jobs > 0 ? 2 : -1;
+    }
+    if (strncmp(argv[i], "-j", 2) == 0 || strncmp(argv[i], "--jobs=", 7) == 0) {
+        opts->jobs = parse_jobs(argv[i] + (argv[i][1] == 'j' ? 2 : 7));
+        return opts->jobs > 0 ? 1 : -1;
+    }
+
+    if (strcmp(argv[i], "--profile") == 0) {
+        opts->profile = 1;
+        return 1;
+    }
+    if (strncmp(argv[i], "--profile=", 10) == 0) {
+        opts->profile = 1;
+        opts->profile_path = argv[i] + 10;
+        return opts->profile_path[0] ? 1 : -1;
+    }
+
+    if (strcmp(argv[i], "--cost") == 0) {
+        opts->cost = 1;
+        return 1;
+    }
+    if (strncmp(argv[i], "--cost-table=", 13) == 0) {
+        opts->cost = 1;
+        return argv[i][13] && cost_table_read(&opts->cost_table, argv[i] + 13) == 0 ? 1 : -1;
+    }
+
+    if (strcmp(argv[i], "--shm-cache") == 0) {
+        opts->shm_cache_name = SHM_CACHE_DEFAULT_NAME;
+        return 1;
+    }
+    if (strncmp(argv[i], "--shm-cache=", 12) == 0) {
+        opts->shm_cache_name = argv[i] + 12;
+        return opts->shm_cache_name[0] == '/' ? 1 : -1;
+    }
+
+    if (strcmp(argv[i], "-m") == 0) {
+        if (i + 1 >= argc) return -1;
+        val = argv[i + 1];
+        consumed = 2;
+    } else if (strncmp(argv[i], "--mem-budget=", 13) == 0) {
+        val = argv[i] + 13;
+        consumed = 1;
+    }
+    if (!val) return argv[i][0] == '-' ? -1 : 0;
+
+    kb = strtol(val, &end, 10);
+    if (*end != '\0' || end == val || kb < 0) return -1;
+    opts->mem_budget = kb * 1024L;
+    return consumed;
+}
+
+/* Preprocesses a source, reusing the result of another assembler process
+ * from the shared cache when the same content was already expanded.
+ * Returns 0 on success, -1 on failure.
+ */
+static int preprocess_cached(const char *as_path, const char *am_path, shm_cache_t *cache) {
+    content_key_t key;
+    FILE *out;
+    int hit = 0;
+
+    if (!cache || content_key_file(as_path, &key) != 0) {
+        return preprocess_file(as_path, am_path);
+    }
+
+    out = fopen(am_path, "w");
+    if (out) {
+        hit = shm_cache_fetch(cache, &key, out);
+        if (fclose(out) != 0) hit = -1;
+    }
+    if (hit == 1) {
+        printf("Pre-processing result reused from the shared cache\n");
+        return 0;
+    }
+
+    if (preprocess_file(as_path, am_path) != 0) return -1;
+    shm_cache_store(cache, &key, am_path); /* a failed store only costs a later miss */
+    return 0;
+}
+
+/* Writes the cost estimate of a file into <file_name>.cost. Returns 0 on success, -1 on failure. */
+static int write_cost(const char *file_name, const char *am_path, symbol_table_t *symbol_table, const cost_t *cost) {
+    char *path;
+    FILE *fp;
+    int result;
+
+    if (cost->failed) {
+        print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+        return -1;
+    }
+    path = create_file_path(file_name, ".cost");
+    if (!path) {
+        print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+        return -1;
+    }
+    fp = fopen(path, "w");
+    if (!fp) {
+        print_error_file(path, ERROR_CANNOT_OPEN_FILE, 0);
+        free(path);
+        return -1;
+    }
+    result = cost_report(cost, symbol_table, am_path, fp);
+    if (fclose(fp) != 0) result = -1;
+    if (result != 0) {
+        print_error_file(path, ERROR_WRITE_FAILED, 0);
+    } else {
+        printf("Cost estimate written to: %s\n", path);
+    }
+    free(path);
+    return result;
+}
+
+/* Runs both passes on a preprocessed file through the spill files,
+ * keeping memory constant in the size of the input.
+ * Returns 0 on success, 1 if the first pass failed, 2 if the second pass failed.
+ */
+static int assemble_streaming(const char *am_path, const char *file_name, symbol_table_t *symbol_table,
+                              long mem_budget, cost_t *cost) {
+    spill_t spill;
+    int result = 0;
+
+    if (spill_open(&spill, mem_budget) != 0) {
+        print_error(ERROR_WRITE_FAILED);
+        return 1;
+    }
+    if (first_pass_spill(am_path, symbol_table, &spill) != 0) {
+        result = 1;
+    } else {
+        printf("First pass completed successfully.\n");
+        printf("Starting second pass on: %s\n", am_path);
+        PROF_SET_PHASE(PROF_PHASE_SECOND_PASS);
+        if (second_pass_spill(&spill, file_name, symbol_table, cost) != 0) result = 2;
+    }
+    spill_close(&spill);
+    return result;
+}
+
+/* Assembles a single input file: preprocessing, first pass and second pass.
+ * Returns 0 on success, 1 on failure.
+ */
+static int assemble_file(const char *file_name, const options_t *opts, shm_cache_t *cache) {
+    int pass_result;
+    long am_size;
     char *as_path;
     char *am_path;
     symbol_table_t *symbol_table;
+    cost_t cost;
+
+    /* create file paths */
+    as_path = create_file_path(file_name, ".as");
+    am_path = create_file_path(file_name, ".am");
 
-    if (argc < 2) {
+    if (!as_path || !am_path) {
         print_error(ERROR_CANNOT_OPEN_FILE);
-        printf("Usage: %s <file1> <file2> ... <fileN>\n", argv[0]);
+        if (as_path) free(as_path);
+        if (am_path) free(am_path);
+        printf("Failed to process file: %s\n", file_name);
         return 1;
     }
 
-    for (i = 1; i < argc; i++) {
-        as_path = NULL;
-        am_path = NULL;
-        symbol_table = NULL;
-
-        /* create file paths */
-        as_path = create_file_path(argv[i], ".as");
-        am_path = create_file_path(argv[i], ".am");
-
-        if (!as_path || !am_path) {
-            print_error(ERROR_CANNOT_OPEN_FILE);
-            if (as_path) free(as_path);
-            if (am_path) free(am_path);
-            overall_result = 1;
-            printf("Failed to process file: %s\n", argv[i]);
-            continue;
-        }
+    /* preprocessing */
+    printf("Processing file: %s\n", as_path);
+    PROF_SET_PHASE(PROF_PHASE_PREPROCESS);
+    if (preprocess_cached(as_path, am_path, cache) != 0) {
+        PROF_SET_PHASE(PROF_PHASE_DRIVER);
+        print_error(ERROR_FAILED_PREPROCESSING);
+        free(as_path);
+        free(am_path);
+        printf("Failed to process file: %s\n", file_name);
+        return 1;
+    }
+    printf("Pre-processing successful. Output file: %s\n", am_path);
 
-        /* preprocessing */
-        printf("Processing file: %s\n", as_path);
-        if (preprocess_file(as_path, am_path) != 0) {
-            print_error(ERROR_FAILED_PREPROCESSING);
-            free(as_path);
-            free(am_path);
-            overall_result = 1;
-            printf("Failed to process file: %s\n", argv[i]);
-            continue;
-        }
-        printf("Pre-processing successful. Output file: %s\n", am_path);
-
-        /* first pass */
-        printf("Starting first pass on: %s\n", am_path);
-        symbol_table = symtab_create();
-        if (!symbol_table) {
-            print_error(ERROR_MEMORY_ALLOCATION_FAILED);
-            free(as_path);
-            free(am_path);
-            overall_result = 1;
-            printf("Failed to process file: %s\n", argv[i]);
-            continue;
-        }
+    /* first pass */
+    printf("Starting first pass on: %s\n", am_path);
+    PROF_SET_PHASE(PROF_PHASE_FIRST_PASS);
+    symbol_table = symtab_create();
+    if (!symbol_table) {
+        PROF_SET_PHASE(PROF_PHASE_DRIVER);
+        print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+        free(as_path);
+        free(am_path);
+        printf("Failed to process file: %s\n", file_name);
+        return 1;
+    }
 
-        if (first_pass(am_path, symbol_table) != 0) {
-            print_error(ERROR_FIRST_PASSED);
-            free(as_path);
-            free(am_path);
-            symtab_destroy(symbol_table);
-            overall_result = 1;
-            printf("Failed to process file: %s\n", argv[i]);
-            continue;
-        }
+    /* files larger than the memory budget are streamed through spill files */
+    cost_init(&cost, &opts->cost_table);
+    am_size = (opts->mem_budget == NO_MEM_BUDGET) ? -1 : file_size(am_path);
+    if (am_size > opts->mem_budget) {
+        printf("Streaming %s within a %ld KB memory budget\n", am_path, opts->mem_budget / 1024L);
+        pass_result = assemble_streaming(am_path, file_name, symbol_table, opts->mem_budget, opts->cost ? &cost : NULL);
+    } else if (first_pass(am_path, symbol_table) != 0) {
+        pass_result = 1;
+    } else {
         printf("First pass completed successfully.\n");
 
         /* second pass */
         printf("Starting second pass on: %s\n", am_path);
-        if (second_pass(am_path, argv[i], symbol_table) != 0) {
-            print_error(ERROR_WRITE_FAILED);
-            free(as_path);
-            free(am_path);
-            symtab_destroy(symbol_table);
-            overall_result = 1;
-            printf("Failed to process file: %s\n", argv[i]);
-            continue;
+        PROF_SET_PHASE(PROF_PHASE_SECOND_PASS);
+        pass_result = second_pass(am_path, file_name, symbol_table, opts->cost ? &cost : NULL) != 0 ? 2 : 0;
+    }
+    if (pass_result == 0 && opts->cost && write_cost(file_name, am_path, symbol_table, &cost) != 0) pass_result = 2;
+
+    /* clean up resources for this file */
+    PROF_SET_PHASE(PROF_PHASE_DRIVER);
+    free(as_path);
+    free(am_path);
+    symtab_destroy(symbol_table);
+    cost_destroy(&cost);
+
+    if (pass_result != 0) {
+        print_error(pass_result == 1 ? ERROR_FIRST_PASSED : ERROR_WRITE_FAILED);
+        printf("Failed to process file: %s\n", file_name);
+        return 1;
+    }
+
+    printf("Second pass completed successfully\n");
+    printf("Processed file: %s\n", file_name);
+    return 0;
+}
+
+/* Pool task: assembles one input file. */
+static void assemble_task(void *arg, size_t item, int worker) {
+    driver_t *d = arg;
+    (void) worker;
+    d->results[item] = assemble_file(d->files[item], d->opts, d->cache);
+}
+
+/* Chooses the number of workers for n_files files.
+ * Under a make jobserver the tokens limit the concurrency, so without -j
+ * every online processor may be used.
+ */
+static int choose_workers(const options_t *opts, jobserver_status_t js_status, int n_files) {
+    long cpus;
+    int workers = opts->jobs == JOBS_UNSET ? 1 : opts->jobs;
+
+    if (js_status == JOBSERVER_UNUSABLE) {
+        printf("make jobserver unusable (recipe not marked with '+' or no non-blocking read), assembling serially\n");
+        return 1;
+    }
+    if (js_status == JOBSERVER_CONNECTED && opts->jobs == JOBS_UNSET) {
+        cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cpus > 0 ? (int) cpus : 1;
+    }
+    return workers < n_files ? workers : n_files;
+}
+
+/* Writes the flat profile to the requested file, or stderr. */
+static void write_profile(const options_t *opts) {
+    FILE *out = stderr;
+
+    if (opts->profile_path && !(out = fopen(opts->profile_path, "w"))) {
+        printf("Cannot write the profile to %s, using stderr\n", opts->profile_path);
+        out = stderr;
+    }
+    profile_report(out);
+    if (out != stderr) fclose(out);
+}
+
+int main(int argc, char *argv[]) {
+    int i;
+    int consumed;
+    int n_files = 0;
+    int n_workers;
+    int overall_result = 0;
+    options_t opts;
+    driver_t driver;
+    shm_cache_t cache;
+    shm_cache_t *cache_ptr = NULL;
+    jobserver_t js;
+    jobserver_status_t js_status;
+
+    opts.mem_budget = NO_MEM_BUDGET;
+    opts.shm_cache_name = NULL;
+    opts.jobs = JOBS_UNSET;
+    opts.profile = 0;
+    opts.profile_path = NULL;
+    opts.cost = 0;
+    cost_table_default(&opts.cost_table);
+
+    driver.files = malloc(sizeof(char *) * (size_t) argc);
+    driver.results = malloc(sizeof(int) * (size_t) argc);
+    if (!driver.files || !driver.results) {
+        print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+        free(driver.files);
+        free(driver.results);
+        return 1;
+    }
+
+    /* options may appear anywhere on the command line */
+    for (i = 1; i < argc; i++) {
+        consumed = parse_option(argc, argv, i, &opts);
+        if (consumed < 0) {
+            print_error(ERROR_INVALID_ARGUMENT);
+            printf("Invalid option: %s\n", argv[i]);
+            free(driver.files);
+            free(driver.results);
+            return 1;
+        }
+        if (consumed) {
+            i += consumed - 1;
+        } else {
+            driver.files[n_files++] = argv[i];
         }
+    }
 
-        printf("Second pass completed successfully\n");
-        /* clean up resources for this file */
-        free(as_path);
-        free(am_path);
-        symtab_destroy(symbol_table);
+    if (n_files == 0) {
+        print_error(ERROR_CANNOT_OPEN_FILE);
+        printf("Usage: %s [-j <jobs>] [-m <budget KB>] [--shm-cache[=<name>]] [--profile[=<file>]]"
+               " [--cost | --cost-table=<file>] <file1> <file2> ... <fileN>\n", argv[0]);
+        free(driver.files);
+        free(driver.results);
+        return 1;
+    }
+
+    if (opts.shm_cache_name) {
+        if (shm_cache_open(&cache, opts.shm_cache_name) == 0) {
+            cache_ptr = &cache;
+        } else {
+            printf("Shared cache %s unavailable, continuing without it\n", opts.shm_cache_name);
+        }
+    }
+
+    js_status = jobserver_connect(&js);
+    n_workers = choose_workers(&opts, js_status, n_files);
 
-        printf("Processed file: %s\n", argv[i]);
+    /* the phase markers are process wide, they are only written while a single worker runs */
+    if (opts.profile) {
+        if (n_workers > 1) printf("Profiling: assembling serially\n");
+        n_workers = 1;
+        if (profile_start(PROFILE_INTERVAL_US) != 0) {
+            printf("Profiling timer unavailable, continuing without profile\n");
+            opts.profile = 0;
+        }
+    }
+
+    driver.opts = &opts;
+    driver.cache = cache_ptr;
+    pool_run((size_t) n_files, n_workers, assemble_task, &driver,
+             js_status == JOBSERVER_CONNECTED ? &js : NULL);
+
+    for (i = 0; i < n_files; i++) {
+        if (driver.results[i] != 0) overall_result = 1;
     }
 
+    if (opts.profile) {
+        profile_stop();
+        write_profile(&opts);
+    }
+
+    if (js_status == JOBSERVER_CONNECTED) jobserver_disconnect(&js);
+    if (cache_ptr) shm_cache_close(cache_ptr);
+    free(driver.files);
+    free(driver.results);
+
     printf("Assembly complete\n");
     return overall_result;
 }
@@ -0,0 +1,361 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../include/cost.h"
+#include "../include/isa.h"
+#include "../include/errors.h"
+
+/*
+ * =====================================================================================
+ * Filename:  cost.c
+ * Description: Static cost estimator. The records arrive by increasing address, so
+ * a target is found by binary search and the blocks of a routine are contiguous.
+ * An edge to a block at or before its source is a back edge: it marks a loop over
+ * the blocks between its target and its source, which raises their nesting depth,
+ * and the paths never follow it. Every other edge goes forward, so best and worst
+ * paths are computed in one backward sweep over the blocks; the whole analysis is
+ * linear in the number of instructions plus a lookup per jump and symbol.
+ * =====================================================================================
+ */
+
+#define COST_NO_TARGET (-1) /* indirect, external or absent target */
+#define COST_LINE_LENGTH 128
+
+/* edges of a block besides the index of another block */
+#define EDGE_NONE (-1)
+#define EDGE_EXIT (-2) /* leaves the routine: rts, stop, a jump out of it or into data */
+
+/* insn flags of the analysis */
+#define FLAG_ROUTINE 1 /* first instruction of a routine */
+#define FLAG_LEADER 2 /* first instruction of a block */
+
+/* struct cost_insn_t is the record of one instruction. */
+typedef struct {
+    int address;
+    int target; /* direct target of jmp, bne or jsr, COST_NO_TARGET otherwise */
+    int cycles;
+    unsigned char length;
+    unsigned char opcode;
+} cost_insn_t;
+
+/* struct cost_block_t is a basic block during the analysis. */
+typedef struct {
+    int first; /* index of its first instruction */
+    int routine;
+    int words;
+    long cycles;
+    int succ[2]; /* fall through and jump target: block index, EDGE_NONE or EDGE_EXIT */
+    int depth; /* difference of the loop depth to the previous block, then the depth */
+    long best;
+    long worst;
+} cost_block_t;
+
+/* --- Private Helper Functions --- */
+
+/* Index of the instruction starting at address, or -1. */
+static int find_insn(const cost_insn_t *insns, const int n, const int address) {
+    int low = 0, high = n - 1, mid;
+
+    while (low <= high) {
+        mid = low + (high - low) / 2;
+        if (insns[mid].address == address) return mid;
+        if (insns[mid].address < address) low = mid + 1;
+        else high = mid - 1;
+    }
+    return -1;
+}
+
+/* Parses an addressing mode column: 0..3 or '*'. Returns the mode, COST_MODES for '*' or -1. */
+static int parse_mode(const char *s) {
+    if (strcmp(s, "*") == 0) return COST_MODES;
+    if (s[0] >= '0' && s[0] < '0' + COST_MODES && s[1] == '\0') return s[0] - '0';
+    return -1;
+}
+
+/* Applies one line of a cost table file. Returns 0 on success, -1 if the line is invalid. */
+static int apply_line(cost_table_t *table, const char *line) {
+    char mnemonic[COST_LINE_LENGTH], src[COST_LINE_LENGTH], dst[COST_LINE_LENGTH], extra[2];
+    int op, s, d, value, src_mode, dst_mode, fields;
+
+    fields = sscanf(line, "%127s %127s %127s %d %1s", mnemonic, src, dst, &value, extra);
+    if (fields <= 0 || mnemonic[0] == ';') return 0;
+    if (strcmp(mnemonic, "loop") == 0) {
+        if (sscanf(line, "%*s %d %1s", &value, extra) != 1 || value < 1) return -1;
+        table->loop_weight = value;
+        return 0;
+    }
+    if (fields != 4 || value < 0) return -1;
+    op = 0;
+    while (op < COST_OPCODES && strcmp(isa_mnemonic(op), mnemonic) != 0) op++;
+    src_mode = parse_mode(src);
+    dst_mode = parse_mode(dst);
+    if (op == COST_OPCODES || src_mode < 0 || dst_mode < 0) return -1;
+
+    for (s = 0; s < COST_MODES; s++) {
+        for (d = 0; d < COST_MODES; d++) {
+            if ((src_mode == COST_MODES || src_mode == s) && (dst_mode == COST_MODES || dst_mode == d)) {
+                table->cycles[op][s][d] = value;
+            }
+        }
+    }
+    return 0;
+}
+
+/* Cuts the instructions into blocks and routines, filling flags, block_of and blocks.
+ * Returns the number of blocks.
+ */
+static int build_blocks(const cost_insn_t *insns, const int n, unsigned char *flags, int *block_of,
+                        cost_block_t *blocks, int *n_routines) {
+    int i, t, b = -1, r = -1;
+
+    for (i = 0; i < n; i++) {
+        if (insns[i].opcode == JMP_OP || insns[i].opcode == BNE_OP) {
+            t = find_insn(insns, n, insns[i].target);
+            if (t >= 0) flags[t] |= FLAG_LEADER;
+        }
+        if (i > 0 && (insns[i - 1].opcode == JMP_OP || insns[i - 1].opcode == BNE_OP || insns[i - 1].opcode == RTS_OP ||
+                      insns[i - 1].opcode == STOP_OP)) {
+            flags[i] |= FLAG_LEADER;
+        }
+        if (flags[i] & FLAG_ROUTINE) flags[i] |= FLAG_LEADER;
+    }
+
+    for (i = 0; i < n; i++) {
+        if (flags[i] & FLAG_LEADER) {
+            if (flags[i] & FLAG_ROUTINE) r++;
+            b++;
+            memset(&blocks[b], 0, sizeof(blocks[b]));
+            blocks[b].first = i;
+            blocks[b].routine = r;
+        }
+        block_of[i] = b;
+        blocks[b].words += insns[i].length;
+        blocks[b].cycles += insns[i].cycles;
+    }
+    *n_routines = r + 1;
+    return b + 1;
+}
+
+/* Fills the edges of every block and counts the back edges of its routine into routines. */
+static void link_blocks(const cost_insn_t *insns, const int n, const int *block_of, cost_block_t *blocks,
+                        const int n_blocks, cost_routine_t *routines) {
+    const cost_insn_t *last;
+    int b, t, k, s;
+
+    for (b = 0; b < n_blocks; b++) {
+        last = &insns[b + 1 < n_blocks ? blocks[b + 1].first - 1 : n - 1];
+        blocks[b].succ[0] = blocks[b].succ[1] = EDGE_NONE;
+        if (last->opcode != JMP_OP && last->opcode != RTS_OP && last->opcode != STOP_OP) {
+            s = b + 1 < n_blocks && blocks[b + 1].routine == blocks[b].routine ? b + 1 : EDGE_EXIT;
+            blocks[b].succ[0] = s;
+        }
+        if (last->opcode == JMP_OP || last->opcode == BNE_OP) {
+            t = find_insn(insns, n, last->target);
+            s = t >= 0 && blocks[block_of[t]].routine == blocks[b].routine ? block_of[t] : EDGE_EXIT;
+            blocks[b].succ[1] = s;
+        }
+        for (k = 0; k < 2; k++) {
+            s = blocks[b].succ[k];
+            if (s < 0 || s > b) continue;
+            /* a back edge: the blocks s..b are one loop deeper */
+            blocks[s].depth++;
+            if (b + 1 < n_blocks) blocks[b + 1].depth--;
+            routines[blocks[b].routine].loops++;
+        }
+    }
+}
+
+/* Computes the best and worst path of every block, from the last block backwards. */
+static void sweep_paths(cost_block_t *blocks, const int n_blocks) {
+    long best, worst;
+    int b, k, s, ends;
+
+    for (b = n_blocks - 1; b >= 0; b--) {
+        best = -1;
+        worst = 0;
+        ends = 1;
+        for (k = 0; k < 2; k++) {
+            s = blocks[b].succ[k];
+            if (s <= b) continue; /* none, exit or back edge */
+            if (best < 0 || blocks[s].best < best) best = blocks[s].best;
+            if (blocks[s].worst > worst) worst = blocks[s].worst;
+            ends = 0;
+        }
+        for (k = 0; k < 2; k++) {
+            if (blocks[b].succ[k] == EDGE_EXIT) ends = 1;
+        }
+        if (ends) best = 0;
+        blocks[b].best = blocks[b].cycles + best;
+        blocks[b].worst = blocks[b].cycles + worst;
+    }
+}
+
+/* --- Public API Functions Implementation --- */
+
+void cost_table_default(cost_table_t *table) {
+    instruction_t ins;
+    int op, s, d, n;
+
+    for (op = 0; op < COST_OPCODES; op++) {
+        n = isa_operand_count((op_code_t) op);
+        for (s = 0; s < COST_MODES; s++) {
+            for (d = 0; d < COST_MODES; d++) {
+                /* unused mode fields are encoded as 0 and cost as such */
+                isa_decode((WORD) FIRST_WORD(op, n > 1 ? s : 0, n > 0 ? d : 0, ARE_A), &ins);
+                table->cycles[op][s][d] = isa_cycles(&ins);
+            }
+        }
+    }
+    table->loop_weight = COST_DEFAULT_LOOP_WEIGHT;
+}
+
+int cost_table_read(cost_table_t *table, const char *path) {
+    char line[COST_LINE_LENGTH];
+    FILE *fp = fopen(path, "r");
+    int line_no = 0;
+
+    if (!fp) {
+        print_error_file(path, ERROR_CANNOT_OPEN_FILE, 0);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        line_no++;
+        if (!strchr(line, '\n') && !feof(fp)) {
+            print_error_file(path, ERROR_LINE_TOO_LONG, line_no);
+            fclose(fp);
+            return -1;
+        }
+        if (apply_line(table, line) != 0) {
+            print_error_file(path, ERROR_INVALID_COST_TABLE, line_no);
+            fclose(fp);
+            return -1;
+        }
+    }
+    fclose(fp);
+    return 0;
+}
+
+void cost_init(cost_t *cost, const cost_table_t *table) {
+    cost->table = table;
+    vec_create(&cost->insns, sizeof(cost_insn_t));
+    cost->failed = 0;
+}
+
+void cost_destroy(cost_t *cost) {
+    if (!cost) return;
+    vec_destroy(&cost->insns);
+}
+
+void cost_add(cost_t *cost, const parsed_line *pl, symbol_table_t *st, const int address) {
+    const operand_t *src = &pl->body.operation.source_op, *dst = &pl->body.operation.dest_op;
+    const int n_ops = pl->body.operation.n_operands;
+    instruction_t ins;
+    cost_insn_t rec;
+    symbol_t *sym;
+    int s, d;
+
+    /* the only operand of a one operand instruction is parsed into source_op */
+    s = n_ops == 2 ? (int) src->mode : 0;
+    d = n_ops == 2 ? (int) dst->mode : n_ops == 1 ? (int) src->mode : 0;
+    isa_decode((WORD) FIRST_WORD(pl->body.operation.opcode, s, d, ARE_A), &ins);
+
+    rec.address = address;
+    rec.opcode = (unsigned char) pl->body.operation.opcode;
+    rec.length = (unsigned char) ins.length;
+    rec.cycles = cost->table->cycles[rec.opcode][s][d];
+    rec.target = COST_NO_TARGET;
+    if ((rec.opcode == JMP_OP || rec.opcode == BNE_OP || rec.opcode == JSR_OP) && n_ops == 1 && src->mode == DIRECT) {
+        sym = symtab_lookup(st, src->value.label);
+        if (sym && !(sym->flags & SYM_EXTERN)) rec.target = sym->address;
+    }
+    if (vec_push(&cost->insns, &rec) != 0) cost->failed = 1;
+}
+
+int cost_analyze(const cost_t *cost, symbol_table_t *st, cost_routine_t **routines, int *count) {
+    const cost_insn_t *insns = cost->insns.data;
+    const int n = (int) cost->insns.len;
+    unsigned char *flags;
+    int *block_of;
+    cost_block_t *blocks;
+    cost_routine_t *out = NULL, *r;
+    hash_entry_t *it = NULL;
+    symbol_t *sym;
+    double factor;
+    int i, b, k, t, depth = 0, n_blocks, n_routines = 0;
+
+    *routines = NULL;
+    *count = 0;
+    if (n == 0) return 0;
+    flags = calloc((size_t) n, 1);
+    block_of = malloc(sizeof(int) * (size_t) n);
+    blocks = malloc(sizeof(cost_block_t) * (size_t) n);
+    if (!flags || !block_of || !blocks) {
+        free(flags);
+        free(block_of);
+        free(blocks);
+        return -1;
+    }
+
+    flags[0] |= FLAG_ROUTINE;
+    for (i = 0; i < n; i++) {
+        if (insns[i].opcode == JSR_OP && (t = find_insn(insns, n, insns[i].target)) >= 0) flags[t] |= FLAG_ROUTINE;
+    }
+    while ((sym = symtab_iter_next(st, &it)) != NULL) {
+        if ((sym->flags & SYM_ENTRY) && (sym->flags & SYM_CODE) && (t = find_insn(insns, n, sym->address)) >= 0) {
+            flags[t] |= FLAG_ROUTINE;
+        }
+    }
+
+    n_blocks = build_blocks(insns, n, flags, block_of, blocks, &n_routines);
+    out = calloc((size_t) n_routines, sizeof(cost_routine_t));
+    if (out) {
+        link_blocks(insns, n, block_of, blocks, n_blocks, out);
+        sweep_paths(blocks, n_blocks);
+
+        for (b = 0; b < n_blocks; b++) {
+            r = &out[blocks[b].routine];
+            if (r->blocks++ == 0) {
+                strcpy(r->name, COST_NO_LABEL);
+                r->address = insns[blocks[b].first].address;
+                r->best = blocks[b].best;
+                r->worst = blocks[b].worst;
+            }
+            r->words += blocks[b].words;
+            depth += blocks[b].depth;
+            for (factor = 1.0, k = 0; k < depth; k++) factor *= cost->table->loop_weight;
+            r->weighted += factor * (double) blocks[b].cycles;
+        }
+
+        it = NULL;
+        while ((sym = symtab_iter_next(st, &it)) != NULL) {
+            if (!(sym->flags & SYM_CODE) || (t = find_insn(insns, n, sym->address)) < 0) continue;
+            if (flags[t] & FLAG_ROUTINE) strcpy(out[blocks[block_of[t]].routine].name, sym->name);
+        }
+    }
+
+    free(flags);
+    free(block_of);
+    free(blocks);
+    if (!out) return -1;
+    *routines = out;
+    *count = n_routines;
+    return 0;
+}
+
+int cost_report(const cost_t *cost, symbol_table_t *st, const char *source_name, FILE *out) {
+    cost_routine_t *routines;
+    int i, n, words = 0;
+
+    if (cost_analyze(cost, st, &routines, &n) != 0) return -1;
+    fprintf(out, "Cost estimate of %s: cycles of one path, loops taken once; weighted by %d per loop level\n\n",
+            source_name, cost->table->loop_weight);
+    fprintf(out, "  address  words  blocks  loops      best     worst      weighted  routine\n");
+    for (i = 0; i < n; i++) {
+        fprintf(out, "  %7d  %5d  %6d  %5d  %8ld  %8ld  %12.0f  %s\n", routines[i].address, routines[i].words,
+                routines[i].blocks, routines[i].loops, routines[i].best, routines[i].worst, routines[i].weighted,
+                routines[i].name);
+        words += routines[i].words;
+    }
+    fprintf(out, "\n%d routine(s), %d code words\n", n, words);
+    free(routines);
+    return ferror(out) ? -1 : 0;
+}
@@ -0,0 +1,312 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../include/dead_strip.h"
+#include "../include/isa.h"
+#include "../include/errors.h"
+#include "../include/util_hash.h"
+#include "../include/util_vec.h"
+
+/*
+ * =====================================================================================
+ * Filename:  dead_strip.c
+ * Description: Dead stripping for the linker. Every module is cut into fragments,
+ * the nodes of the reference graph. The edges are not stored: they are found
+ * while a fragment is visited, from its relocatable words (to the fragment of
+ * the same module they point into), its external usage sites (through the
+ * global entry table to the fragment of the defining module) and its fall
+ * through into the next fragment. A depth-first walk from the roots marks the
+ * live fragments, then every module is rewritten with its live words only.
+ * =====================================================================================
+ */
+
+/* struct fragment_t is a run of words of one module that is kept or removed as a whole. */
+typedef struct {
+    int module;
+    int first; /* index of the first word in the module */
+    int end; /* one past the last word */
+    int falls_through; /* execution can run on into the next fragment */
+    int live;
+} fragment_t;
+
+/* struct module_map_t links the words of a module to the graph. */
+typedef struct {
+    int *frag_of; /* fragment of every word */
+    const char **ext_at; /* external symbol used at every code word, NULL if none */
+} module_map_t;
+
+/* struct symbol_ref_t is where an entry symbol is defined. */
+typedef struct {
+    int module;
+    int word; /* index in the module */
+} symbol_ref_t;
+
+/* --- Private Helper Functions --- */
+
+/* Returns the index of the word a relocatable word refers to, or -1 if w is not
+ * relocatable or points outside its module.
+ */
+static int word_target(const object_t *m, const WORD w) {
+    int t;
+
+    if (WORD_ARE(w) != ARE_R) return -1;
+    t = (w >> 2) - ADDRESS_BASE;
+    return (t >= 0 && t < m->code_len + m->data_len) ? t : -1;
+}
+
+/* Decodes the code of a module, marking instruction starts and the instructions
+ * after which execution does not continue (jmp, rts, stop).
+ * Returns -1 if the code cannot be decoded or a cut falls inside an instruction.
+ */
+static int decode_code(const object_t *m, const unsigned char *cut, unsigned char *starts, unsigned char *stops) {
+    instruction_t ins;
+    int i = 0, j;
+
+    while (i < m->code_len) {
+        if (isa_decode(m->words[i], &ins) != 0 || i + ins.length > m->code_len) return -1;
+        for (j = i + 1; j < i + ins.length; j++) {
+            if (cut[j]) return -1;
+        }
+        starts[i] = 1;
+        stops[i] = (ins.opcode == JMP_OP || ins.opcode == RTS_OP || ins.opcode == STOP_OP);
+        i += ins.length;
+    }
+    return 0;
+}
+
+/* Cuts a module into fragments, appended to frags, and fills its map. */
+static int map_module(const object_t *m, const int index, const strip_granularity_t granularity,
+                      module_map_t *map, vec_t *frags) {
+    int total = m->code_len + m->data_len;
+    unsigned char *cut, *starts, *stops;
+    fragment_t f;
+    int i, t, last, result = 0;
+
+    cut = calloc((size_t) total + 1, 1);
+    starts = calloc((size_t) total + 1, 1);
+    stops = calloc((size_t) total + 1, 1);
+    map->frag_of = malloc(sizeof(int) * ((size_t) total + 1));
+    map->ext_at = calloc((size_t) m->code_len + 1, sizeof(char *));
+    if (!cut || !starts || !stops || !map->frag_of || !map->ext_at) {
+        free(cut);
+        free(starts);
+        free(stops);
+        return -1;
+    }
+
+    cut[0] = 1;
+    if (granularity == STRIP_LABELS) {
+        if (m->data_len > 0) cut[m->code_len] = 1;
+        for (i = 0; i < m->n_entries; i++) {
+            t = m->entries[i].address - ADDRESS_BASE;
+            if (t >= 0 && t < total) cut[t] = 1;
+        }
+        for (i = 0; i < m->code_len; i++) {
+            t = word_target(m, m->words[i]);
+            if (t >= 0) cut[t] = 1;
+        }
+        if (decode_code(m, cut, starts, stops) != 0) {
+            memset(cut, 0, (size_t) total + 1); /* keep or remove the module as a whole */
+            cut[0] = 1;
+        }
+    }
+
+    f.module = index;
+    f.live = 0;
+    for (f.first = 0; f.first < total && result == 0; f.first = f.end) {
+        f.end = f.first + 1;
+        while (f.end < total && !cut[f.end]) f.end++;
+        f.falls_through = 0;
+        if (f.end < m->code_len) {
+            last = f.end - 1;
+            while (last > f.first && !starts[last]) last--;
+            f.falls_through = starts[last] && !stops[last];
+        }
+        for (i = f.first; i < f.end; i++) map->frag_of[i] = (int) frags->len;
+        if (vec_push(frags, &f) != 0) result = -1;
+    }
+
+    for (i = 0; i < m->n_externals; i++) {
+        t = m->externals[i].address - ADDRESS_BASE;
+        if (t >= 0 && t < m->code_len) map->ext_at[t] = m->externals[i].name;
+    }
+
+    free(cut);
+    free(starts);
+    free(stops);
+    return result;
+}
+
+/* Marks a fragment live and queues it for a visit. */
+static int mark(vec_t *frags, vec_t *stack, const int id) {
+    fragment_t *f = vec_get(frags, (size_t) id);
+
+    if (!f || f->live) return 0;
+    f->live = 1;
+    return vec_push(stack, &id);
+}
+
+/* Marks every fragment reachable from the queued ones. */
+static int propagate(const object_t *modules, const module_map_t *maps, hash_table_t *globals,
+                     vec_t *frags, vec_t *stack) {
+    const fragment_t *f;
+    const object_t *m;
+    const symbol_ref_t *ref;
+    int id, i, t, result = 0;
+
+    while (stack->len > 0 && result == 0) {
+        id = *(int *) vec_get(stack, stack->len - 1);
+        stack->len--;
+        f = vec_get(frags, (size_t) id);
+        m = &modules[f->module];
+
+        for (i = f->first; i < f->end && i < m->code_len && result == 0; i++) {
+            t = word_target(m, m->words[i]);
+            if (t >= 0) result = mark(frags, stack, maps[f->module].frag_of[t]);
+            if (result == 0 && maps[f->module].ext_at[i]) {
+                ref = hash_get(globals, maps[f->module].ext_at[i]);
+                if (ref) result = mark(frags, stack, maps[ref->module].frag_of[ref->word]);
+            }
+        }
+        if (result == 0 && f->falls_through) result = mark(frags, stack, id + 1);
+    }
+    return result;
+}
+
+/* Keeps the live words of a module and renumbers everything that refers to them. */
+static int rewrite_module(object_t *m, const module_map_t *map, const vec_t *frags) {
+    int total = m->code_len + m->data_len;
+    int *new_index;
+    WORD *words, w;
+    int i, k, t, live, n_code = 0, n_data = 0;
+
+    new_index = malloc(sizeof(int) * ((size_t) total + 1));
+    words = malloc(sizeof(WORD) * ((size_t) total + 1));
+    if (!new_index || !words) {
+        free(new_index);
+        free(words);
+        return -1;
+    }
+
+    for (i = 0; i < total; i++) {
+        live = ((fragment_t *) vec_get(frags, (size_t) map->frag_of[i]))->live;
+        new_index[i] = live ? (i < m->code_len ? n_code++ : n_data++) : -1;
+    }
+    for (i = m->code_len; i < total; i++) {
+        if (new_index[i] >= 0) new_index[i] += n_code; /* the data follows the kept code */
+    }
+
+    for (i = 0; i < total; i++) {
+        if (new_index[i] < 0) continue;
+        w = m->words[i];
+        if (i < m->code_len && (t = word_target(m, w)) >= 0 && new_index[t] >= 0) {
+            w = (WORD) ((((new_index[t] + ADDRESS_BASE) << 2) | ARE_R) & WORD_MASK);
+        }
+        words[new_index[i]] = w;
+    }
+
+    for (i = 0, k = 0; i < m->n_entries; i++) {
+        t = m->entries[i].address - ADDRESS_BASE;
+        if (t < 0 || t >= total || new_index[t] < 0) continue;
+        m->entries[k] = m->entries[i];
+        m->entries[k++].address = new_index[t] + ADDRESS_BASE;
+    }
+    m->n_entries = k;
+    for (i = 0, k = 0; i < m->n_externals; i++) {
+        t = m->externals[i].address - ADDRESS_BASE;
+        if (t < 0 || t >= total || new_index[t] < 0) continue;
+        m->externals[k] = m->externals[i];
+        m->externals[k++].address = new_index[t] + ADDRESS_BASE;
+    }
+    m->n_externals = k;
+
+    free(m->words);
+    m->words = words;
+    m->code_len = n_code;
+    m->data_len = n_data;
+    free(new_index);
+    return 0;
+}
+
+/* --- Public API Functions Implementation --- */
+
+int link_strip(object_t *modules, int *n_modules, char *const *roots, const int n_roots,
+               const strip_granularity_t granularity, int *removed_words) {
+    module_map_t *maps;
+    symbol_ref_t *refs;
+    const symbol_ref_t *ref;
+    hash_table_t *globals;
+    vec_t frags, stack;
+    int count = *n_modules;
+    int m, i, k, n_refs = 0, total_entries = 0, words_before = 0, words_after = 0, result = 0;
+
+    if (removed_words) *removed_words = 0;
+    for (m = 0; m < *n_modules; m++) {
+        total_entries += modules[m].n_entries;
+        words_before += modules[m].code_len + modules[m].data_len;
+    }
+
+    vec_create(&frags, sizeof(fragment_t));
+    vec_create(&stack, sizeof(int));
+    maps = calloc((size_t) *n_modules + 1, sizeof(module_map_t));
+    refs = malloc(sizeof(symbol_ref_t) * ((size_t) total_entries + 1));
+    globals = hash_create(0);
+    if (!maps || !refs || !globals) result = -1;
+
+    for (m = 0; m < *n_modules && result == 0; m++) {
+        result = map_module(&modules[m], m, granularity, &maps[m], &frags);
+    }
+    /* the first definition wins, link_objects reports the others */
+    for (m = 0; m < *n_modules && result == 0; m++) {
+        for (i = 0; i < modules[m].n_entries && result == 0; i++) {
+            refs[n_refs].module = m;
+            refs[n_refs].word = modules[m].entries[i].address - ADDRESS_BASE;
+            if (refs[n_refs].word < 0 || refs[n_refs].word >= modules[m].code_len + modules[m].data_len ||
+                hash_get(globals, modules[m].entries[i].name)) {
+                continue;
+            }
+            result = hash_put(globals, modules[m].entries[i].name, &refs[n_refs++]);
+        }
+    }
+    if (result != 0) print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+
+    if (result == 0 && n_roots == 0 && *n_modules > 0 && modules[0].code_len + modules[0].data_len > 0) {
+        result = mark(&frags, &stack, maps[0].frag_of[0]);
+    }
+    for (i = 0; i < n_roots && result == 0; i++) {
+        ref = hash_get(globals, roots[i]);
+        if (!ref) {
+            print_error_file(roots[i], ERROR_UNKNOWN_ROOT_SYMBOL, 0);
+            result = -1;
+        } else {
+            result = mark(&frags, &stack, maps[ref->module].frag_of[ref->word]);
+        }
+    }
+    if (result == 0) result = propagate(modules, maps, globals, &frags, &stack);
+
+    for (m = 0; m < *n_modules && result == 0; m++) {
+        result = rewrite_module(&modules[m], &maps[m], &frags);
+    }
+    if (result == 0) {
+        for (m = 0, k = 0; m < *n_modules; m++) {
+            if (modules[m].code_len + modules[m].data_len == 0) {
+                object_free(&modules[m]);
+                continue;
+            }
+            words_after += modules[m].code_len + modules[m].data_len;
+            modules[k++] = modules[m];
+        }
+        *n_modules = k;
+        if (removed_words) *removed_words = words_before - words_after;
+    }
+
+    for (m = 0; maps && m < count; m++) {
+        free(maps[m].frag_of);
+        free(maps[m].ext_at);
+    }
+    free(maps);
+    free(refs);
+    hash_destroy(globals, NULL);
+    vec_destroy(&frags);
+    vec_destroy(&stack);
+    return result;
+}
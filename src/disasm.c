@@ -0,0 +1,410 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/disasm.h"
+#include "../include/isa.h"
+#include "../include/util_hash.h"
+#include "../include/util_vec.h"
+
+/*
+ * =====================================================================================
+ * Filename:  disasm.c
+ * Description: Implementation of the disassembler. An instruction is only shown as
+ * such if the assembler would encode its text into the very same words: the first
+ * word must be valid in the table, and each operand word must hold nothing but its
+ * fields with the ARE bits the assembler sets. Anything else is written as a
+ * comment. Labels are only placed where a line starts, at an instruction found by
+ * the sweep over the code or at a data word. A label word only keeps the low 8 bits
+ * of an address, so in a program reaching past 255 an operand refers to the first
+ * line start with those bits; one with none is written as a number.
+ * =====================================================================================
+ */
+
+#define IMMEDIATE_BITS 0xFF /* 8 bit signed immediates */
+#define IMMEDIATE_SIGN 0x80
+#define SIGN_BIT 0x200 /* sign of a 10 bit data word */
+#define REGISTER_COUNT 8
+#define SRC_REGISTER_SHIFT 6
+#define DST_REGISTER_SHIFT 2
+#define REGISTER_FIELD 0xF
+#define DATA_PER_LINE 6 /* keeps a .data line with a long label within the line limit */
+#define NAME_HASH_CAPACITY 64
+#define ADDRESS_WRAP 0x100 /* label words keep the low 8 bits of an address */
+
+/* struct disasm_operand_t is one decoded operand. */
+typedef struct {
+    addressing_mode_t mode;
+    int value; /* immediate, register or address */
+    int row; /* registers of a matrix operand */
+    int col;
+    int external; /* index into the externals of the program, -1 if not external */
+} disasm_operand_t;
+
+/* --- Private Helper Functions --- */
+
+/* Returns TRUE if the addressing modes suit the opcode, as the line parser checks them. */
+static bool_t valid_modes(const instruction_t *ins) {
+    switch (ins->opcode) {
+        case LEA_OP:
+            if (ins->src_mode != DIRECT && ins->src_mode != MATRIX_ACCESS) return FALSE;
+            return ins->dst_mode != IMMEDIATE ? TRUE : FALSE;
+        case CMP_OP:
+        case PRN_OP:
+        case RTS_OP:
+        case STOP_OP:
+            return TRUE;
+        default:
+            return ins->dst_mode != IMMEDIATE ? TRUE : FALSE;
+    }
+}
+
+/* Word at an index of the program, limited to its 10 bits. */
+static WORD word_at(const disasm_t *d, const int index) {
+    return (WORD) (d->program->words[index] & WORD_MASK);
+}
+
+/* Decodes a register word holding one register at shift.
+ * Returns 1 if the word is exactly that encoding.
+ */
+static int decode_register(const WORD w, const int shift, disasm_operand_t *op) {
+    op->value = (w >> shift) & REGISTER_FIELD;
+    return op->value < REGISTER_COUNT && w == (WORD) (op->value << shift) ? 1 : 0;
+}
+
+/* Decodes the operand of a mode at index. Returns the words used, or 0 if they do
+ * not encode such an operand.
+ */
+static int decode_operand(const disasm_t *d, const addressing_mode_t mode, const int index, const int shift,
+                          disasm_operand_t *op) {
+    WORD w = word_at(d, index);
+
+    op->mode = mode;
+    op->external = -1;
+    switch (mode) {
+        case IMMEDIATE:
+            op->value = (w >> 2) & IMMEDIATE_BITS;
+            if (op->value & IMMEDIATE_SIGN) op->value -= IMMEDIATE_BITS + 1;
+            return WORD_ARE(w) == ARE_A ? 1 : 0;
+        case DIRECT:
+        case MATRIX_ACCESS:
+            op->value = w >> 2;
+            if (WORD_ARE(w) == ARE_E) {
+                op->external = d->external_at[index];
+                if (op->external < 0 || op->value != 0) return 0;
+            } else if (WORD_ARE(w) != ARE_R) {
+                return 0;
+            }
+            if (mode == DIRECT) return 1;
+            w = word_at(d, index + 1);
+            op->row = (w >> SRC_REGISTER_SHIFT) & REGISTER_FIELD;
+            op->col = (w >> DST_REGISTER_SHIFT) & REGISTER_FIELD;
+            if (op->row >= REGISTER_COUNT || op->col >= REGISTER_COUNT) return 0;
+            return w == (WORD) ((op->row << SRC_REGISTER_SHIFT) | (op->col << DST_REGISTER_SHIFT)) ? 2 : 0;
+        default:
+            return decode_register(w, shift, op);
+    }
+}
+
+/* Decodes the instruction at a code index into its table entry and operands.
+ * Returns its length, or 0 if the words are not an instruction the assembler emits.
+ */
+static int decode_insn(const disasm_t *d, const int index, const disasm_entry_t **entry, disasm_operand_t *ops) {
+    const disasm_entry_t *e = &d->table[word_at(d, index)];
+    WORD w;
+    int used;
+
+    *entry = e;
+    if (!e->valid || (d->program->words[index] & ~WORD_MASK) || index + e->length > d->program->code_len) return 0;
+    if (e->n_operands == 2 && e->src_mode == REGISTER_DIRECT && e->dst_mode == REGISTER_DIRECT) {
+        /* two registers share one word */
+        w = word_at(d, index + 1);
+        ops[0].mode = ops[1].mode = REGISTER_DIRECT;
+        ops[0].value = (w >> SRC_REGISTER_SHIFT) & REGISTER_FIELD;
+        ops[1].value = (w >> DST_REGISTER_SHIFT) & REGISTER_FIELD;
+        ops[0].external = ops[1].external = -1;
+        if (ops[0].value >= REGISTER_COUNT || ops[1].value >= REGISTER_COUNT) return 0;
+        return w == (WORD) ((ops[0].value << SRC_REGISTER_SHIFT) | (ops[1].value << DST_REGISTER_SHIFT)) ? 2 : 0;
+    }
+    if (e->n_operands == 2) {
+        used = decode_operand(d, (addressing_mode_t) e->src_mode, index + 1, SRC_REGISTER_SHIFT, &ops[0]);
+        if (used == 0) return 0;
+        if (decode_operand(d, (addressing_mode_t) e->dst_mode, index + 1 + used, DST_REGISTER_SHIFT, &ops[1]) == 0) {
+            return 0;
+        }
+    } else if (e->n_operands == 1) {
+        /* the single operand is encoded like a source */
+        if (decode_operand(d, (addressing_mode_t) e->dst_mode, index + 1, SRC_REGISTER_SHIFT, &ops[0]) == 0) return 0;
+    }
+    return e->length;
+}
+
+/* Returns the index of the first word an operand value can refer to: placeable if
+ * given, labeled otherwise. Returns -1 if there is none.
+ */
+static int target_index(const disasm_t *d, const unsigned char *placeable, const int value) {
+    const int total = d->program->code_len + d->program->data_len;
+    int index;
+
+    for (index = value - ADDRESS_BASE; index < total; index += ADDRESS_WRAP) {
+        if (index < 0) continue;
+        if (placeable ? placeable[index] != 0 : d->label_at[index] >= 0) return index;
+    }
+    return -1;
+}
+
+/* Writes an operand at p. Returns the end of the text. */
+static char *format_operand(const disasm_t *d, const disasm_operand_t *op, char *p) {
+    int index;
+
+    switch (op->mode) {
+        case IMMEDIATE:
+            return p + sprintf(p, "#%d", op->value);
+        case REGISTER_DIRECT:
+            return p + sprintf(p, "r%d", op->value);
+        default:
+            index = op->external >= 0 ? -1 : target_index(d, NULL, op->value);
+            if (op->external >= 0) {
+                p += sprintf(p, "%s", d->program->externals[op->external].name);
+            } else if (index >= 0) {
+                p += sprintf(p, "%s", d->labels[d->label_at[index]].name);
+            } else {
+                p += sprintf(p, "%d", op->value);
+            }
+            if (op->mode == MATRIX_ACCESS) p += sprintf(p, "[r%d][r%d]", op->row, op->col);
+            return p;
+    }
+}
+
+/* Returns the index of the first external label word from index on whose address has
+ * the low bits of address, or -1 if there is none.
+ */
+static int next_external(const disasm_t *d, int index, const int address) {
+    for (; index < d->program->code_len; index++) {
+        if (((index + ADDRESS_BASE - address) % ADDRESS_WRAP) == 0 && d->program->words[index] == ARE_E) return index;
+    }
+    return -1;
+}
+
+/* Returns 1 if a symbol got its name placed in the program. */
+static int placed(const disasm_t *d, const obj_symbol_t *symbol) {
+    const int total = d->program->code_len + d->program->data_len;
+    int index;
+
+    for (index = symbol->address - ADDRESS_BASE; index < total; index += ADDRESS_WRAP) {
+        if (index >= 0 && d->label_at[index] >= 0 && strcmp(d->labels[d->label_at[index]].name, symbol->name) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Names the word at index, unless it already has a name or the name is taken.
+ * Returns 0 on success, -1 if memory allocation fails.
+ */
+static int add_label(disasm_t *d, vec_t *labels, hash_table_t *names, const int index, const char *name) {
+    obj_symbol_t label;
+
+    if (d->label_at[index] >= 0 || hash_get(names, name)) return 0;
+    strcpy(label.name, name);
+    label.address = index + ADDRESS_BASE;
+    if (vec_push(labels, &label) != 0 || hash_put(names, name, d) != 0) return -1;
+    d->label_at[index] = (int) labels->len - 1;
+    return 0;
+}
+
+/* Adds the names of symbols that fall where a line starts. */
+static int add_symbols(disasm_t *d, vec_t *labels, hash_table_t *names, const unsigned char *placeable,
+                       const obj_symbol_t *symbols, const int n_symbols) {
+    int i, index;
+
+    for (i = 0; i < n_symbols; i++) {
+        index = target_index(d, placeable, symbols[i].address);
+        if (index < 0) continue;
+        if (add_label(d, labels, names, index, symbols[i].name) != 0) return -1;
+    }
+    return 0;
+}
+
+/* Adds an L<address> label for every unnamed address an operand refers to. */
+static int add_references(disasm_t *d, vec_t *labels, hash_table_t *names, const unsigned char *placeable) {
+    const disasm_entry_t *e;
+    disasm_operand_t ops[2];
+    char name[MAX_LABEL_LENGTH];
+    int i, k, length, index, suffix;
+
+    for (i = 0; i < d->program->code_len; i += length > 0 ? length : 1) {
+        length = decode_insn(d, i, &e, ops);
+        for (k = 0; length > 0 && k < e->n_operands; k++) {
+            if (ops[k].mode != DIRECT && ops[k].mode != MATRIX_ACCESS) continue;
+            index = ops[k].external >= 0 ? -1 : target_index(d, placeable, ops[k].value);
+            if (index < 0 || d->label_at[index] >= 0) continue;
+            sprintf(name, "L%d", index + ADDRESS_BASE);
+            for (suffix = 0; hash_get(names, name); suffix++) sprintf(name, "L%dx%d", index + ADDRESS_BASE, suffix);
+            if (add_label(d, labels, names, index, name) != 0) return -1;
+        }
+    }
+    return 0;
+}
+
+/* Writes the line prefix of the word at index: its address and label. */
+static void write_prefix(const disasm_t *d, const int index, const int with_addresses, FILE *out) {
+    if (with_addresses) fprintf(out, "%5d  ", index + ADDRESS_BASE);
+    if (d->label_at[index] >= 0) fprintf(out, "%s: ", d->labels[d->label_at[index]].name);
+}
+
+/* Writes .extern once per external name. Returns 0 on success, -1 if memory allocation fails. */
+static int write_externals(const disasm_t *d, FILE *out) {
+    hash_table_t *seen = hash_create(NAME_HASH_CAPACITY);
+    const obj_symbol_t *x;
+    int i, result = 0;
+
+    if (!seen) return -1;
+    for (i = 0; i < d->program->n_externals && result == 0; i++) {
+        x = &d->program->externals[i];
+        if (hash_get(seen, x->name)) continue;
+        if (hash_put(seen, x->name, seen) != 0) result = -1;
+        fprintf(out, ".extern %s\n", x->name);
+    }
+    hash_destroy(seen, NULL);
+    return result;
+}
+
+/* --- Public API Functions Implementation --- */
+
+void disasm_build_table(disasm_entry_t *table) {
+    instruction_t ins;
+    int w;
+
+    for (w = 0; w < DISASM_TABLE_SIZE; w++) {
+        memset(&table[w], 0, sizeof(table[w]));
+        if (isa_decode((WORD) w, &ins) != 0 || !valid_modes(&ins)) continue;
+        table[w].valid = 1;
+        table[w].opcode = (unsigned char) ins.opcode;
+        table[w].n_operands = (unsigned char) ins.n_operands;
+        table[w].src_mode = (unsigned char) ins.src_mode;
+        table[w].dst_mode = (unsigned char) ins.dst_mode;
+        table[w].length = (unsigned char) ins.length;
+    }
+}
+
+int disasm_open(disasm_t *d, const object_t *program, const obj_symbol_t *symbols, const int n_symbols) {
+    const disasm_entry_t *e;
+    disasm_operand_t ops[2];
+    const int total = program->code_len + program->data_len;
+    unsigned char *placeable;
+    hash_table_t *names;
+    vec_t labels;
+    int i, index, length, result = 0;
+
+    memset(d, 0, sizeof(*d));
+    disasm_build_table(d->table);
+    d->program = program;
+    d->label_at = malloc(sizeof(int) * (size_t) (total + 1));
+    d->external_at = malloc(sizeof(int) * (size_t) (total + 1));
+    placeable = calloc((size_t) total + 1, 1);
+    names = hash_create(NAME_HASH_CAPACITY);
+    vec_create(&labels, sizeof(obj_symbol_t));
+    if (!d->label_at || !d->external_at || !placeable || !names) result = -1;
+
+    if (result == 0) {
+        for (i = 0; i < total; i++) d->label_at[i] = d->external_at[i] = -1;
+        /* the .ext file lists the usages in address order, so each one is the next
+         * external label word with the low bits of its address
+         */
+        for (i = 0, index = -1; i < program->n_externals; i++) {
+            index = next_external(d, index + 1, program->externals[i].address);
+            if (index < 0) break;
+            d->external_at[index] = i;
+        }
+        /* lines start at the instructions of a sweep over the code and at every data word */
+        for (i = 0; i < program->code_len; i += length > 0 ? length : 1) {
+            length = decode_insn(d, i, &e, ops);
+            if (length > 0) placeable[i] = 1;
+        }
+        for (i = program->code_len; i < total; i++) placeable[i] = 1;
+
+        if (add_symbols(d, &labels, names, placeable, program->entries, program->n_entries) != 0 ||
+            add_symbols(d, &labels, names, placeable, symbols, n_symbols) != 0 ||
+            add_references(d, &labels, names, placeable) != 0) {
+            result = -1;
+        }
+    }
+
+    free(placeable);
+    if (names) hash_destroy(names, NULL);
+    d->labels = labels.data;
+    d->n_labels = (int) labels.len;
+    if (result != 0) disasm_close(d);
+    return result;
+}
+
+void disasm_close(disasm_t *d) {
+    if (!d) return;
+    free(d->labels);
+    free(d->label_at);
+    free(d->external_at);
+    d->labels = NULL;
+    d->label_at = d->external_at = NULL;
+    d->n_labels = 0;
+}
+
+int disasm_insn(const disasm_t *d, const int address, char *text, const size_t size) {
+    const disasm_entry_t *e;
+    disasm_operand_t ops[2];
+    char line[DISASM_TEXT_SIZE], *p;
+    int k, length, index = address - ADDRESS_BASE;
+
+    if (size > 0) text[0] = '\0';
+    if (index < 0 || index >= d->program->code_len) return 0;
+    length = decode_insn(d, index, &e, ops);
+    if (length == 0) return 0;
+
+    p = line + sprintf(line, "%s", isa_mnemonic(e->opcode));
+    for (k = 0; k < e->n_operands; k++) {
+        strcpy(p, k == 0 ? " " : ", ");
+        p = format_operand(d, &ops[k], p + strlen(p));
+    }
+    if ((size_t) (p - line) >= size) return 0;
+    strcpy(text, line);
+    return length;
+}
+
+int disasm_write(const disasm_t *d, const int with_addresses, FILE *out) {
+    const obj_symbol_t *entry;
+    char text[DISASM_TEXT_SIZE];
+    const int total = d->program->code_len + d->program->data_len;
+    int i, length, value, in_line = 0;
+
+    for (i = 0; i < d->program->n_entries; i++) {
+        entry = &d->program->entries[i];
+        /* an entry that could not be placed would be undefined */
+        if (placed(d, entry)) fprintf(out, ".entry %s\n", entry->name);
+    }
+    if (write_externals(d, out) != 0) return -1;
+
+    for (i = 0; i < d->program->code_len; i += length > 0 ? length : 1) {
+        length = disasm_insn(d, i + ADDRESS_BASE, text, sizeof(text));
+        if (length == 0) {
+            if (with_addresses) fprintf(out, "%5d  ", i + ADDRESS_BASE);
+            fprintf(out, "; not an instruction: %d\n", word_at(d, i));
+            continue;
+        }
+        write_prefix(d, i, with_addresses, out);
+        fprintf(out, "%s\n", text);
+    }
+
+    for (i = d->program->code_len; i < total; i++) {
+        if (in_line == DATA_PER_LINE || (in_line > 0 && d->label_at[i] >= 0)) {
+            fputc('\n', out);
+            in_line = 0;
+        }
+        if (in_line == 0) {
+            write_prefix(d, i, with_addresses, out);
+            fprintf(out, ".data ");
+        }
+        value = (word_at(d, i) & SIGN_BIT) ? (int) word_at(d, i) - (WORD_MASK + 1) : (int) word_at(d, i);
+        fprintf(out, in_line++ == 0 ? "%d" : ", %d", value);
+    }
+    if (in_line > 0) fputc('\n', out);
+    return ferror(out) ? -1 : 0;
+}
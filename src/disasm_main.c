@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/disasm.h"
+#include "../include/archive.h"
+#include "../include/errors.h"
+
+/*
+ * =====================================================================================
+ * Filename:  disasm_main.c
+ * Description: Command line driver of the disassembler. Reads <program>.ob (an
+ * object file or a linked image) with its .ent and .ext files, or every member of
+ * an archive given with --archive, and writes the assembly source to stdout or to
+ * the file given with -o. --symbols names more addresses from a file in the .ent
+ * format and --addresses prefixes every line with its address.
+ * =====================================================================================
+ */
+
+/* Disassembles one program. Returns 0 on success, -1 on failure. */
+static int write_program(const object_t *program, const obj_symbol_t *symbols, const int n_symbols,
+                         const int with_addresses, FILE *out) {
+    disasm_t d;
+    int result;
+
+    if (disasm_open(&d, program, symbols, n_symbols) != 0) {
+        print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+        return -1;
+    }
+    result = disasm_write(&d, with_addresses, out);
+    disasm_close(&d);
+    return result;
+}
+
+/* Disassembles every member of an archive, each under a comment naming it. */
+static int write_archive(const char *path, const obj_symbol_t *symbols, const int n_symbols,
+                         const int with_addresses, FILE *out) {
+    archive_t ar;
+    object_t obj;
+    unsigned long m;
+    int result = 0;
+
+    if (archive_open(path, &ar) != 0) return -1;
+    for (m = 0; m < ar.n_members && result == 0; m++) {
+        fprintf(out, "%s; member %s\n", m > 0 ? "\n" : "", archive_member_name(&ar, (int) m));
+        if (archive_load_member(&ar, (int) m, &obj) != 0 ||
+            write_program(&obj, symbols, n_symbols, with_addresses, out) != 0) {
+            result = -1;
+        }
+        object_free(&obj);
+    }
+    archive_close(&ar);
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    object_t program;
+    obj_symbol_t *symbols = NULL;
+    FILE *out = stdout;
+    const char *name = NULL, *archive_path = NULL, *symbols_path = NULL, *out_path = NULL;
+    int i, n_symbols = 0, with_addresses = 0, result = 0;
+
+    for (i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--symbols=", 10) == 0 && argv[i][10] != '\0') {
+            symbols_path = argv[i] + 10;
+        } else if (strncmp(argv[i], "--archive=", 10) == 0 && argv[i][10] != '\0') {
+            archive_path = argv[i] + 10;
+        } else if (strcmp(argv[i], "--addresses") == 0) {
+            with_addresses = 1;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (argv[i][0] == '-' || name) {
+            print_error(ERROR_INVALID_ARGUMENT);
+            printf("Invalid option: %s\n", argv[i]);
+            return 1;
+        } else {
+            name = argv[i];
+        }
+    }
+    if (!name == !archive_path) {
+        print_error(ERROR_CANNOT_OPEN_FILE);
+        printf("Usage: %s [--symbols=<file>] [--addresses] [-o <file>] <program>\n"
+               "       %s [--symbols=<file>] [--addresses] [-o <file>] --archive=<file>\n", argv[0], argv[0]);
+        return 1;
+    }
+
+    if (symbols_path && object_read_symbols(symbols_path, &symbols, &n_symbols) != 0) return 1;
+    if (out_path && !(out = fopen(out_path, "w"))) {
+        print_error_file(out_path, ERROR_CANNOT_OPEN_FILE, 0);
+        free(symbols);
+        return 1;
+    }
+
+    if (archive_path) {
+        result = write_archive(archive_path, symbols, n_symbols, with_addresses, out);
+    } else if (object_read(name, &program) != 0) {
+        result = -1;
+        object_free(&program);
+    } else {
+        result = write_program(&program, symbols, n_symbols, with_addresses, out);
+        object_free(&program);
+    }
+
+    if (out != stdout && fclose(out) != 0) result = -1;
+    if (result != 0 && out_path) print_error_file(out_path, ERROR_WRITE_FAILED, 0);
+    free(symbols);
+    return result == 0 ? 0 : 1;
+}
@@ -0,0 +1,235 @@
+#define _POSIX_C_SOURCE 200809L /* getline, fmemopen, open_memstream */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/emu_batch.h"
+#include "../include/emu_lockstep.h"
+#include "../include/util_pool.h"
+#include "../include/util_vec.h"
+
+/*
+ * =====================================================================================
+ * Filename:  emu_batch.c
+ * Description: Implementation of batch emulation. The program is loaded once into
+ * the emulator of every worker and a snapshot of the loaded state is shared by all
+ * of them; each run restores it, reads its vector through fmemopen and writes its
+ * output into a buffer of its own through open_memstream. Only the run with the
+ * given index writes to runs[index], so the results need no locking.
+ * =====================================================================================
+ */
+
+/* struct batch_job_t is the shared state of a batch. */
+typedef struct {
+    emulator_t *emus; /* one per worker */
+    const emu_snapshot_t *start; /* the loaded program */
+    emu_run_t *runs;
+} batch_job_t;
+
+/* struct lockstep_job_t is the shared state of a lockstep batch. */
+typedef struct {
+    emu_lockstep_t *machines; /* one per worker */
+    long *rounds; /* per worker */
+    const object_t *program;
+    int mat_cols;
+    long max_steps;
+    emu_run_t *runs;
+    int n_runs;
+} lockstep_job_t;
+
+static char empty_input[1]; /* stream of an empty vector */
+
+/* --- Private Helper Functions --- */
+
+/* Replaces the escapes of a vector line in place.
+ * Returns the length of the vector, or -1 if an escape is invalid.
+ */
+static long unescape(char *line, const size_t len) {
+    size_t i, n = 0;
+
+    for (i = 0; i < len; i++) {
+        if (line[i] != '\\') {
+            line[n++] = line[i];
+            continue;
+        }
+        if (++i == len) return -1;
+        switch (line[i]) {
+            case 'n': line[n++] = '\n'; break;
+            case 't': line[n++] = '\t'; break;
+            case '\\': line[n++] = '\\'; break;
+            default: return -1;
+        }
+    }
+    return (long) n;
+}
+
+/* Pool task: runs one vector on the emulator of the worker. */
+static void run_task(void *arg, size_t item, int worker) {
+    batch_job_t *job = arg;
+    emulator_t *emu = &job->emus[worker];
+    emu_run_t *run = &job->runs[item];
+    FILE *in, *out;
+
+    emu_restore(emu, job->start);
+    in = fmemopen(run->input_len > 0 ? run->input : empty_input, run->input_len, "r");
+    out = open_memstream(&run->output, &run->output_len);
+    if (!in || !out) {
+        run->status = EMU_FAULT;
+        run->fault = ERROR_MEMORY_ALLOCATION_FAILED;
+        run->fault_pc = emu->pc;
+        run->steps = 0;
+    } else {
+        emu->in = in;
+        emu->out = out;
+        run->status = emu_run(emu);
+        run->fault = emu->fault;
+        run->fault_pc = emu->fault_pc;
+        run->steps = emu->steps;
+    }
+    if (in) fclose(in);
+    if (out) fclose(out); /* sets the final output and output_len */
+    emu->in = emu->out = NULL;
+}
+
+/* Pool task: runs the group of EMU_LANES vectors starting at item * EMU_LANES. */
+static void lockstep_task(void *arg, size_t item, int worker) {
+    lockstep_job_t *job = arg;
+    int first = (int) item * EMU_LANES;
+    int n = job->n_runs - first < EMU_LANES ? job->n_runs - first : EMU_LANES;
+
+    /* the size of the program was checked before, so every group runs */
+    emu_lockstep_run(&job->machines[worker], job->program, job->mat_cols, job->max_steps, job->runs + first, n);
+    job->rounds[worker] += job->machines[worker].rounds;
+}
+
+/* --- Public API Functions Implementation --- */
+
+int emu_batch_read(const char *path, emu_run_t **runs, int *n_runs) {
+    FILE *fp;
+    vec_t list;
+    emu_run_t run;
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t len;
+    long n;
+    int line_no = 0;
+    error_code_t status = ERROR_OK;
+
+    *runs = NULL;
+    *n_runs = 0;
+    fp = fopen(path, "r");
+    if (!fp) {
+        print_error_file(path, ERROR_CANNOT_OPEN_FILE, 0);
+        return -1;
+    }
+    vec_create(&list, sizeof(emu_run_t));
+
+    while (status == ERROR_OK && (len = getline(&line, &cap, fp)) >= 0) {
+        line_no++;
+        if (len > 0 && line[len - 1] == '\n') len--;
+        if (len > 0 && line[len - 1] == '\r') len--;
+        n = unescape(line, (size_t) len);
+        if (n < 0) {
+            status = ERROR_INVALID_TEST_VECTOR;
+            break;
+        }
+        memset(&run, 0, sizeof(run));
+        run.input = malloc((size_t) n + 1);
+        run.input_len = (size_t) n;
+        if (!run.input) {
+            status = ERROR_MEMORY_ALLOCATION_FAILED;
+        } else {
+            memcpy(run.input, line, (size_t) n);
+            if (vec_push(&list, &run) != 0) {
+                free(run.input);
+                status = ERROR_MEMORY_ALLOCATION_FAILED;
+            }
+        }
+    }
+    free(line);
+    fclose(fp);
+
+    if (status != ERROR_OK) {
+        print_error_file(path, status, status == ERROR_INVALID_TEST_VECTOR ? line_no : 0);
+        emu_batch_free(list.data, (int) list.len);
+        return -1;
+    }
+    *runs = list.data;
+    *n_runs = (int) list.len;
+    return 0;
+}
+
+int emu_batch_run(const object_t *program, const int mat_cols, const long max_steps, emu_run_t *runs,
+                  const int n_runs, int n_workers) {
+    batch_job_t job;
+    emu_snapshot_t *start;
+    int w, result = 0;
+
+    if (n_workers > n_runs) n_workers = n_runs;
+    if (n_workers < 1) n_workers = 1;
+    job.emus = malloc(sizeof(emulator_t) * (size_t) n_workers);
+    start = malloc(sizeof(emu_snapshot_t));
+    if (!job.emus || !start) {
+        free(job.emus);
+        free(start);
+        return -1;
+    }
+
+    /* a freshly loaded emulator has every page dirty, so its first restore copies it all */
+    for (w = 0; w < n_workers && result == 0; w++) {
+        emu_init(&job.emus[w], NULL, NULL);
+        job.emus[w].mat_cols = mat_cols;
+        job.emus[w].max_steps = max_steps;
+        result = emu_load(&job.emus[w], program);
+    }
+    if (result == 0) {
+        emu_snapshot(&job.emus[0], start);
+        job.start = start;
+        job.runs = runs;
+        pool_run((size_t) n_runs, n_workers, run_task, &job, NULL);
+    }
+
+    free(job.emus);
+    free(start);
+    return result;
+}
+
+int emu_batch_run_lockstep(const object_t *program, const int mat_cols, const long max_steps, emu_run_t *runs,
+                           const int n_runs, int n_workers, long *rounds) {
+    lockstep_job_t job;
+    int w, n_groups = (n_runs + EMU_LANES - 1) / EMU_LANES;
+
+    if (rounds) *rounds = 0;
+    if (program->code_len + program->data_len > EMU_MEMORY_SIZE - ADDRESS_BASE) return -1;
+    if (n_runs == 0) return 0;
+    if (n_workers > n_groups) n_workers = n_groups;
+    if (n_workers < 1) n_workers = 1;
+    job.machines = malloc(sizeof(emu_lockstep_t) * (size_t) n_workers);
+    job.rounds = calloc((size_t) n_workers, sizeof(long));
+    if (!job.machines || !job.rounds) {
+        free(job.machines);
+        free(job.rounds);
+        return -1;
+    }
+    job.program = program;
+    job.mat_cols = mat_cols;
+    job.max_steps = max_steps;
+    job.runs = runs;
+    job.n_runs = n_runs;
+    pool_run((size_t) n_groups, n_workers, lockstep_task, &job, NULL);
+
+    for (w = 0; w < n_workers && rounds; w++) *rounds += job.rounds[w];
+    free(job.machines);
+    free(job.rounds);
+    return 0;
+}
+
+void emu_batch_free(emu_run_t *runs, const int n_runs) {
+    int i;
+
+    if (!runs) return;
+    for (i = 0; i < n_runs; i++) {
+        free(runs[i].input);
+        free(runs[i].output);
+    }
+    free(runs);
+}
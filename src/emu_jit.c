@@ -0,0 +1,568 @@
+#define _POSIX_C_SOURCE 200809L /* mprotect */
+#define _DEFAULT_SOURCE /* MAP_ANONYMOUS */
+#include <limits.h>
+#include <string.h>
+#include "../include/emu_jit.h"
+#include "../include/isa.h"
+#ifdef EMU_JIT_NATIVE
+#include <sys/mman.h>
+#endif
+
+/*
+ * =====================================================================================
+ * Filename:  emu_jit.c
+ * Description: Implementation of the translating tier. Native code is called
+ * through an entry stub, int enter(emulator_t *emu, emu_jit_t *jit, block), that
+ * keeps emu in rbx, jit in rbp and register rN in r(8+N)d, and returns through an
+ * exit stub that stores the registers back. A block first charges the steps and
+ * cycles of all its instructions (leaving to the interpreter when the step limit
+ * would be crossed), then runs them, each adding to its profile counters. A
+ * memory store also marks the page dirty and drops the dispatch records, as the
+ * interpreter's store does, and leaves with JIT_EXIT_MODIFIED when it hit a
+ * translated word, taking back the charge of the instructions it skips. A jump
+ * to an address without a block leaves with JIT_EXIT_NEXT; the jump is patched
+ * once that block is translated. The mapping is writable only while code is
+ * written into it.
+ * =====================================================================================
+ */
+
+#define JIT_NOT_TRANSLATED (-1) /* block[] of an address not translated yet */
+#define JIT_UNTRANSLATABLE (-2) /* block[] of an address the interpreter executes */
+#define JIT_MAX_INSN_BYTES 192 /* native code of one instruction, with its exit */
+#define JIT_BLOCK_ROOM (EMU_JIT_MAX_BLOCK * JIT_MAX_INSN_BYTES + 256)
+
+/* Why native code returned. */
+#define JIT_EXIT_NEXT 0 /* pc has no block, or the interpreter executes it */
+#define JIT_EXIT_LIMIT 1 /* the block would cross the step limit */
+#define JIT_EXIT_MODIFIED 2 /* a store hit a translated word */
+
+#define SIGN_BIT 0x200
+
+/* True if the two emulators differ in the counted array field. */
+#define FIELD_DIFFERS(field, count) (memcmp(a->field, b->field, sizeof(a->field[0]) * (size_t) (count)) != 0)
+
+/* --- Private Helper Functions --- */
+
+/* Returns the address the instruction stores into, or -1 if it stores into none. */
+static int stored_address(const emulator_t *emu, const emu_insn_t *insn) {
+    const emu_operand_t *op = &insn->dst;
+    int row, col, address;
+
+    switch (insn->opcode) {
+        case MOV_OP: case ADD_OP: case SUB_OP: case LEA_OP: case CLR_OP:
+        case NOT_OP: case INC_OP: case DEC_OP: case RED_OP:
+            break;
+        default:
+            return -1;
+    }
+    if (op->kind == EMU_OPERAND_MEMORY) return op->value;
+    if (op->kind != EMU_OPERAND_MATRIX) return -1;
+    row = emu->regs[op->row] & SIGN_BIT ? emu->regs[op->row] - (WORD_MASK + 1) : emu->regs[op->row];
+    col = emu->regs[op->col] & SIGN_BIT ? emu->regs[op->col] - (WORD_MASK + 1) : emu->regs[op->col];
+    address = op->value + row * emu->mat_cols + col;
+    return address >= 0 && address < EMU_MEMORY_SIZE ? address : -1;
+}
+
+#ifdef EMU_JIT_NATIVE
+
+/* Host registers, by their encoding. */
+#define RAX 0
+#define RCX 1
+#define RDX 2
+#define RBX 3
+#define RBP 5
+#define RSI 6
+#define RDI 7
+#define R8 8 /* r8..r15 hold emulated r0..r7 */
+
+/* Opcodes; those above 0xFF are two bytes. */
+#define OP_ADD 0x01
+#define OP_SUB 0x29
+#define OP_CMP 0x39
+#define OP_CMP_LOAD 0x3B
+#define OP_STORE 0x89
+#define OP_LOAD 0x8B
+#define OP_GROUP1 0x81 /* add/or/and/sub with imm32, the digit selects */
+#define OP_GROUP1_IMM8 0x83
+#define OP_CMP_BYTE_IMM 0x80 /* digit 7 */
+#define OP_MOV_BYTE_IMM 0xC6 /* digit 0 */
+#define OP_MOV_IMM 0xC7 /* digit 0 */
+#define OP_GROUP3 0xF7 /* digit 2: not */
+#define OP_GROUP5 0xFF /* digit 4: jmp */
+#define OP_MOVZX_WORD 0x0FB7
+#define OP_MOV_EAX_IMM 0xB8
+#define OP_JMP 0xE9
+#define OP_JE8 0x74
+#define OP_JLE8 0x7E
+#define DIGIT_ADD 0
+#define DIGIT_OR 1
+#define DIGIT_AND 4
+#define DIGIT_SUB 5
+#define DIGIT_CMP 7
+
+#define EMU_OFFSET(field) ((long) offsetof(emulator_t, field))
+#define JIT_OFFSET(field) ((long) offsetof(emu_jit_t, field))
+
+typedef int (*jit_enter_t)(emulator_t *emu, emu_jit_t *jit, unsigned char *block);
+
+static void emit8(emu_jit_t *jit, const unsigned v) {
+    jit->code[jit->code_used++] = (unsigned char) (v & 0xFF);
+}
+
+static void put32(emu_jit_t *jit, const long at, const long v) {
+    unsigned long u = (unsigned long) v;
+    int i;
+
+    for (i = 0; i < 4; i++, u >>= 8) jit->code[at + i] = (unsigned char) (u & 0xFF);
+}
+
+static void emit32(emu_jit_t *jit, const long v) {
+    put32(jit, jit->code_used, v);
+    jit->code_used += 4;
+}
+
+/* Emits [66] [REX] opcode ModRM [disp32] for an operation of size bits on reg and
+ * either the register rm or, when memory is set, the word at [rm + disp].
+ */
+static void emit_modrm(emu_jit_t *jit, const int size, const unsigned opcode, const int reg, const int rm,
+                       const int memory, const long disp) {
+    unsigned rex = (size == 64 ? 8U : 0U) | ((unsigned) reg >> 3 << 2) | ((unsigned) rm >> 3);
+
+    if (size == 16) emit8(jit, 0x66);
+    if (rex != 0) emit8(jit, 0x40 | rex);
+    if (opcode > 0xFF) emit8(jit, opcode >> 8);
+    emit8(jit, opcode);
+    emit8(jit, (memory ? 0x80U : 0xC0U) | ((unsigned) reg & 7) << 3 | ((unsigned) rm & 7));
+    if (memory) emit32(jit, disp);
+}
+
+static void emit_rr(emu_jit_t *jit, const int size, const unsigned opcode, const int reg, const int rm) {
+    emit_modrm(jit, size, opcode, reg, rm, 0, 0);
+}
+
+static void emit_rm(emu_jit_t *jit, const int size, const unsigned opcode, const int reg, const int base,
+                    const long disp) {
+    emit_modrm(jit, size, opcode, reg, base, 1, disp);
+}
+
+/* Emits a short conditional jump forward. Returns the offset to pass to land_jump. */
+static long emit_jump8(emu_jit_t *jit, const unsigned opcode) {
+    emit8(jit, opcode);
+    emit8(jit, 0);
+    return jit->code_used - 1;
+}
+
+/* Makes the short jump emitted at site land at the current offset. */
+static void land_jump(emu_jit_t *jit, const long site) {
+    jit->code[site] = (unsigned char) (jit->code_used - site - 1);
+}
+
+static void emit_jump_to(emu_jit_t *jit, const long target) {
+    emit8(jit, OP_JMP);
+    emit32(jit, target - (jit->code_used + 4));
+}
+
+/* Emits the code leaving native code with pc set and the given reason. */
+static void emit_exit(emu_jit_t *jit, const int pc, const int reason) {
+    emit_rm(jit, 32, OP_MOV_IMM, 0, RBX, EMU_OFFSET(pc));
+    emit32(jit, pc);
+    emit8(jit, OP_MOV_EAX_IMM + RAX);
+    emit32(jit, reason);
+    emit_jump_to(jit, jit->exit_offset);
+}
+
+/* Emits a jump to the block at target, or to an exit patched once that block exists. */
+static void emit_chained_exit(emu_jit_t *jit, const int target) {
+    if (target < EMU_MEMORY_SIZE && jit->block[target] >= 0) {
+        emit_jump_to(jit, jit->block[target]);
+        return;
+    }
+    emit8(jit, OP_JMP);
+    if (target < EMU_MEMORY_SIZE && jit->n_links < EMU_JIT_MAX_LINKS) {
+        jit->links[jit->n_links].site = jit->code_used;
+        jit->links[jit->n_links].target = target;
+        jit->n_links++;
+    }
+    emit32(jit, 0); /* to the exit right after */
+    emit_exit(jit, target, JIT_EXIT_NEXT);
+}
+
+/* Emits the load of an operand into the host register reg. */
+static void emit_load(emu_jit_t *jit, const emu_operand_t *op, const int reg) {
+    if (op->kind == EMU_OPERAND_IMMEDIATE) {
+        emit8(jit, OP_MOV_EAX_IMM + (unsigned) reg);
+        emit32(jit, op->value & WORD_MASK);
+    } else if (op->kind == EMU_OPERAND_REGISTER) {
+        emit_rr(jit, 32, OP_STORE, R8 + op->value, reg);
+    } else {
+        emit_rm(jit, 32, OP_MOVZX_WORD, reg, RBX, EMU_OFFSET(memory) + (long) sizeof(WORD) * op->value);
+    }
+}
+
+/* Emits the store of eax into an operand. A memory store leaves native code when it
+ * hit a translated word; skipped and skipped_cycles are the charge of the rest of
+ * the block and next the address after the instruction.
+ */
+static void emit_store(emu_jit_t *jit, const emu_operand_t *op, const int skipped, const int skipped_cycles,
+                       const int next) {
+    long site;
+    int a;
+
+    if (op->kind == EMU_OPERAND_REGISTER) {
+        emit_rr(jit, 32, OP_STORE, RAX, R8 + op->value);
+        return;
+    }
+    emit_rm(jit, 16, OP_STORE, RAX, RBX, EMU_OFFSET(memory) + (long) sizeof(WORD) * op->value);
+    emit_rm(jit, 64, OP_GROUP1, DIGIT_OR, RBX, EMU_OFFSET(dirty_pages));
+    emit32(jit, 1L << (op->value / EMU_PAGE_WORDS));
+    for (a = op->value; a >= 0 && a > op->value - EMU_MAX_INSN_LENGTH; a--) {
+        emit_rm(jit, 8, OP_MOV_BYTE_IMM, 0, RBX,
+                EMU_OFFSET(insns) + (long) sizeof(emu_insn_t) * a + (long) offsetof(emu_insn_t, decoded));
+        emit8(jit, 0);
+    }
+    emit_rm(jit, 8, OP_CMP_BYTE_IMM, DIGIT_CMP, RBP, JIT_OFFSET(code_map) + op->value);
+    emit8(jit, 0);
+    site = emit_jump8(jit, OP_JE8);
+    if (skipped > 0) {
+        emit_rm(jit, 64, OP_GROUP1, DIGIT_SUB, RBX, EMU_OFFSET(steps));
+        emit32(jit, skipped);
+        emit_rm(jit, 64, OP_GROUP1, DIGIT_SUB, RBX, EMU_OFFSET(cycles));
+        emit32(jit, skipped_cycles);
+    }
+    emit_exit(jit, next, JIT_EXIT_MODIFIED);
+    land_jump(jit, site);
+}
+
+/* Emits eax &= WORD_MASK. */
+static void emit_mask(emu_jit_t *jit) {
+    emit_rr(jit, 32, OP_GROUP1, DIGIT_AND, RAX);
+    emit32(jit, WORD_MASK);
+}
+
+/* Emits one instruction at pc; skipped and skipped_cycles are the charge of the
+ * instructions after it in the block.
+ */
+static void emit_insn(emu_jit_t *jit, const emu_insn_t *insn, const int pc, const int skipped,
+                      const int skipped_cycles) {
+    int next = pc + insn->length;
+    long site;
+
+    emit_rm(jit, 64, OP_GROUP1, DIGIT_ADD, RBX, EMU_OFFSET(exec_count) + (long) sizeof(unsigned long) * pc);
+    emit32(jit, 1);
+    emit_rm(jit, 64, OP_GROUP1, DIGIT_ADD, RBX, EMU_OFFSET(cycle_count) + (long) sizeof(unsigned long) * pc);
+    emit32(jit, insn->cycles);
+
+    switch (insn->opcode) {
+        case MOV_OP:
+            emit_load(jit, &insn->src, RAX);
+            emit_store(jit, &insn->dst, skipped, skipped_cycles, next);
+            break;
+        case CMP_OP:
+            emit_load(jit, &insn->src, RCX);
+            emit_load(jit, &insn->dst, RAX);
+            emit_rr(jit, 32, OP_CMP, RCX, RAX);
+            emit8(jit, 0x0F); /* sete al */
+            emit8(jit, 0x94);
+            emit8(jit, 0xC0);
+            emit8(jit, 0x0F); /* movzx eax, al */
+            emit8(jit, 0xB6);
+            emit8(jit, 0xC0);
+            emit_rm(jit, 32, OP_STORE, RAX, RBX, EMU_OFFSET(zero_flag));
+            break;
+        case ADD_OP:
+        case SUB_OP:
+            emit_load(jit, &insn->src, RCX);
+            emit_load(jit, &insn->dst, RAX);
+            emit_rr(jit, 32, insn->opcode == ADD_OP ? OP_ADD : OP_SUB, RCX, RAX);
+            emit_mask(jit);
+            emit_store(jit, &insn->dst, skipped, skipped_cycles, next);
+            break;
+        case LEA_OP:
+            emit8(jit, OP_MOV_EAX_IMM + RAX);
+            emit32(jit, insn->src.value);
+            emit_store(jit, &insn->dst, skipped, skipped_cycles, next);
+            break;
+        case CLR_OP:
+            emit8(jit, OP_MOV_EAX_IMM + RAX);
+            emit32(jit, 0);
+            emit_store(jit, &insn->dst, skipped, skipped_cycles, next);
+            break;
+        case NOT_OP:
+        case INC_OP:
+        case DEC_OP:
+            emit_load(jit, &insn->dst, RAX);
+            if (insn->opcode == NOT_OP) {
+                emit_rr(jit, 32, OP_GROUP3, 2, RAX);
+            } else {
+                emit_rr(jit, 32, OP_GROUP1, insn->opcode == INC_OP ? DIGIT_ADD : DIGIT_SUB, RAX);
+                emit32(jit, 1);
+            }
+            emit_mask(jit);
+            emit_store(jit, &insn->dst, skipped, skipped_cycles, next);
+            break;
+        case JMP_OP:
+            emit_chained_exit(jit, insn->dst.value);
+            break;
+        case BNE_OP:
+            emit_rm(jit, 32, OP_GROUP1_IMM8, DIGIT_CMP, RBX, EMU_OFFSET(zero_flag));
+            emit8(jit, 0);
+            site = emit_jump8(jit, OP_JE8); /* flag clear: take the branch */
+            emit_chained_exit(jit, next);
+            land_jump(jit, site);
+            emit_chained_exit(jit, insn->dst.value);
+            break;
+        default:
+            break;
+    }
+}
+
+/* Returns TRUE if native code can execute the instruction. */
+static bool_t translatable(const emu_insn_t *insn) {
+    switch (insn->opcode) {
+        case MOV_OP: case CMP_OP: case ADD_OP: case SUB_OP: case LEA_OP:
+        case CLR_OP: case NOT_OP: case INC_OP: case DEC_OP:
+            return insn->src.kind != EMU_OPERAND_MATRIX && insn->src.kind != EMU_OPERAND_EXTERNAL &&
+                   insn->dst.kind != EMU_OPERAND_MATRIX && insn->dst.kind != EMU_OPERAND_EXTERNAL ? TRUE : FALSE;
+        case JMP_OP:
+        case BNE_OP:
+            return insn->dst.kind == EMU_OPERAND_MEMORY ? TRUE : FALSE;
+        default:
+            return FALSE;
+    }
+}
+
+/* Makes the mapping writable (to emit code) or executable. Returns 0 on success. */
+static int protect(emu_jit_t *jit, const int writable) {
+    return mprotect(jit->code, (size_t) EMU_JIT_CODE_SIZE, writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC);
+}
+
+/* Emits the entry and exit stubs at the start of the mapping. */
+static void emit_stubs(emu_jit_t *jit) {
+    int i;
+
+    jit->code_used = 0;
+    emit8(jit, 0x53); /* push rbx */
+    emit8(jit, 0x55); /* push rbp */
+    for (i = 12; i <= 15; i++) { /* push r12..r15 */
+        emit8(jit, 0x41);
+        emit8(jit, 0x50 + (unsigned) (i - 8));
+    }
+    emit_rr(jit, 64, OP_STORE, RDI, RBX);
+    emit_rr(jit, 64, OP_STORE, RSI, RBP);
+    for (i = 0; i < EMU_REGISTERS; i++) {
+        emit_rm(jit, 32, OP_MOVZX_WORD, R8 + i, RBX, EMU_OFFSET(regs) + (long) sizeof(WORD) * i);
+    }
+    emit_rr(jit, 32, OP_GROUP5, 4, RDX); /* jmp rdx */
+
+    jit->exit_offset = jit->code_used;
+    for (i = 0; i < EMU_REGISTERS; i++) {
+        emit_rm(jit, 16, OP_STORE, R8 + i, RBX, EMU_OFFSET(regs) + (long) sizeof(WORD) * i);
+    }
+    for (i = 15; i >= 12; i--) { /* pop r15..r12 */
+        emit8(jit, 0x41);
+        emit8(jit, 0x58 + (unsigned) (i - 8));
+    }
+    emit8(jit, 0x5D); /* pop rbp */
+    emit8(jit, 0x5B); /* pop rbx */
+    emit8(jit, 0xC3); /* ret */
+    jit->stubs_end = jit->code_used;
+}
+
+/* Drops every translation, keeping the stubs. */
+static void flush(emu_jit_t *jit) {
+    int a;
+
+    for (a = 0; a < EMU_MEMORY_SIZE; a++) jit->block[a] = JIT_NOT_TRANSLATED;
+    memset(jit->hits, 0, sizeof(jit->hits));
+    memset(jit->code_map, 0, sizeof(jit->code_map));
+    jit->n_links = 0;
+    jit->code_used = jit->stubs_end;
+}
+
+/* Drops the mapping after it could not be protected; the interpreter takes over. */
+static void lose_native_code(emu_jit_t *jit) {
+    munmap(jit->code, (size_t) EMU_JIT_CODE_SIZE);
+    jit->code = NULL;
+}
+
+/* Translates the block starting at start, or marks start for the interpreter. */
+static void translate(emu_jit_t *jit, const emulator_t *emu, const int start) {
+    emu_insn_t insns[EMU_JIT_MAX_BLOCK];
+    int n = 0, i, pc = start, cycles = 0, skipped_cycles, a;
+    long offset, site;
+
+    while (n < EMU_JIT_MAX_BLOCK && pc < EMU_MEMORY_SIZE) {
+        emu_decode(emu->memory + pc, EMU_MEMORY_SIZE - pc, &insns[n]);
+        if (!translatable(&insns[n])) break;
+        cycles += insns[n].cycles;
+        pc += insns[n++].length;
+        if (insns[n - 1].opcode == JMP_OP || insns[n - 1].opcode == BNE_OP) break;
+    }
+    if (n == 0) {
+        jit->block[start] = JIT_UNTRANSLATABLE;
+        return;
+    }
+    if (jit->code_used + JIT_BLOCK_ROOM > EMU_JIT_CODE_SIZE) {
+        flush(jit);
+        jit->flushes++;
+    }
+    if (protect(jit, 1) != 0) {
+        lose_native_code(jit);
+        return;
+    }
+
+    offset = jit->code_used;
+    /* charge the whole block, unless that crosses the step limit */
+    emit_rm(jit, 64, OP_LOAD, RAX, RBX, EMU_OFFSET(steps));
+    emit_rr(jit, 64, OP_GROUP1, DIGIT_ADD, RAX);
+    emit32(jit, n);
+    emit_rm(jit, 64, OP_CMP_LOAD, RAX, RBP, JIT_OFFSET(limit));
+    site = emit_jump8(jit, OP_JLE8);
+    emit_exit(jit, start, JIT_EXIT_LIMIT);
+    land_jump(jit, site);
+    emit_rm(jit, 64, OP_STORE, RAX, RBX, EMU_OFFSET(steps));
+    emit_rm(jit, 64, OP_GROUP1, DIGIT_ADD, RBX, EMU_OFFSET(cycles));
+    emit32(jit, cycles);
+
+    skipped_cycles = cycles;
+    for (i = 0, pc = start; i < n; i++) {
+        skipped_cycles -= insns[i].cycles;
+        emit_insn(jit, &insns[i], pc, n - 1 - i, skipped_cycles);
+        for (a = pc; a < pc + insns[i].length; a++) jit->code_map[a] = 1;
+        pc += insns[i].length;
+    }
+    if (insns[n - 1].opcode != JMP_OP && insns[n - 1].opcode != BNE_OP) emit_chained_exit(jit, pc);
+    jit->block[start] = offset;
+    jit->blocks++;
+
+    /* jumps emitted earlier now go straight to the block */
+    for (i = 0; i < jit->n_links; i++) {
+        if (jit->links[i].target != start) continue;
+        put32(jit, jit->links[i].site, offset - (jit->links[i].site + 4));
+        jit->chained++;
+        jit->links[i--] = jit->links[--jit->n_links];
+    }
+    if (protect(jit, 0) != 0) lose_native_code(jit);
+}
+
+/* Runs native code from the block at pc. Returns the JIT_EXIT_ reason. */
+static int enter(emu_jit_t *jit, emulator_t *emu, const int pc) {
+    jit_enter_t entry;
+    unsigned char *stub = jit->code;
+
+    memcpy(&entry, &stub, sizeof(entry)); /* ISO C has no object to function pointer cast */
+    return entry(emu, jit, jit->code + jit->block[pc]);
+}
+
+/* Runs native code from pc, translating the block at pc once it is hot.
+ * Returns FALSE if the interpreter has to execute the instruction at pc.
+ */
+static bool_t run_native(emu_jit_t *jit, emulator_t *emu) {
+    int reason;
+
+    if (emu->pc < 0 || emu->pc >= EMU_MEMORY_SIZE) return FALSE;
+    if (jit->block[emu->pc] == JIT_NOT_TRANSLATED && ++jit->hits[emu->pc] >= EMU_JIT_HOT_THRESHOLD) {
+        translate(jit, emu, emu->pc);
+    }
+    if (!jit->code || jit->block[emu->pc] < 0) return FALSE;
+    reason = enter(jit, emu, emu->pc);
+    if (reason == JIT_EXIT_MODIFIED) {
+        flush(jit);
+        jit->flushes++;
+    }
+    return reason != JIT_EXIT_LIMIT ? TRUE : FALSE;
+}
+
+#endif
+
+/* Executes one instruction with the interpreter, dropping the translations when it
+ * stored into a translated word.
+ */
+static void interpret(emu_jit_t *jit, emulator_t *emu) {
+    emu_insn_t insn;
+    int address = -1;
+
+    if (emu->pc >= 0 && emu->pc < EMU_MEMORY_SIZE) {
+        emu_decode(emu->memory + emu->pc, EMU_MEMORY_SIZE - emu->pc, &insn);
+        address = stored_address(emu, &insn);
+    }
+    emu_step(emu);
+    jit->interpreted++;
+    if (address >= 0 && jit->code_map[address]) {
+        emu_jit_reset(jit);
+        jit->flushes++;
+    }
+}
+
+/* --- Public API Functions Implementation --- */
+
+int emu_jit_open(emu_jit_t *jit) {
+    memset(jit, 0, sizeof(*jit));
+    jit->code = NULL;
+    jit->owner = NULL;
+    emu_jit_reset(jit);
+#ifdef EMU_JIT_NATIVE
+    jit->code = mmap(NULL, (size_t) EMU_JIT_CODE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (jit->code == MAP_FAILED) {
+        jit->code = NULL;
+        return -1;
+    }
+    emit_stubs(jit);
+    if (protect(jit, 0) != 0) {
+        lose_native_code(jit);
+        return -1;
+    }
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+void emu_jit_close(emu_jit_t *jit) {
+#ifdef EMU_JIT_NATIVE
+    if (jit->code) lose_native_code(jit);
+#endif
+    jit->code = NULL;
+}
+
+void emu_jit_reset(emu_jit_t *jit) {
+#ifdef EMU_JIT_NATIVE
+    flush(jit);
+#else
+    memset(jit->code_map, 0, sizeof(jit->code_map));
+#endif
+}
+
+emu_status_t emu_jit_run(emu_jit_t *jit, emulator_t *emu) {
+    if (jit->owner != emu) {
+        emu_jit_reset(jit);
+        jit->owner = emu;
+    }
+    jit->limit = emu->max_steps == EMU_NO_STEP_LIMIT ? LONG_MAX : emu->max_steps;
+    while (emu->status == EMU_RUNNING && jit->code) {
+        if (emu->max_steps != EMU_NO_STEP_LIMIT && emu->steps >= emu->max_steps) break;
+#ifdef EMU_JIT_NATIVE
+        if (run_native(jit, emu)) continue;
+        /* chained blocks may have run up to the limit before one would cross it */
+        if (emu->max_steps != EMU_NO_STEP_LIMIT && emu->steps >= emu->max_steps) break;
+#endif
+        interpret(jit, emu);
+    }
+    return emu_run(emu); /* the interpreter finishes, or reports the step limit */
+}
+
+const char *emu_jit_diff(const emulator_t *a, const emulator_t *b) {
+    if (FIELD_DIFFERS(memory, EMU_MEMORY_SIZE)) return "memory";
+    if (FIELD_DIFFERS(regs, EMU_REGISTERS)) return "registers";
+    if (a->pc != b->pc) return "pc";
+    if (a->zero_flag != b->zero_flag) return "zero flag";
+    if (a->sp != b->sp || FIELD_DIFFERS(stack, a->sp)) return "return stack";
+    if (a->status != b->status) return "status";
+    if (a->status == EMU_FAULT && (a->fault != b->fault || a->fault_pc != b->fault_pc)) return "fault";
+    if (a->steps != b->steps) return "steps";
+    if (a->cycles != b->cycles) return "cycles";
+    if (FIELD_DIFFERS(exec_count, EMU_MEMORY_SIZE)) return "execution counters";
+    if (FIELD_DIFFERS(cycle_count, EMU_MEMORY_SIZE)) return "cycle counters";
+    if (a->dirty_pages != b->dirty_pages) return "dirty pages";
+    return NULL;
+}
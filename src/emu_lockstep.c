@@ -0,0 +1,354 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/emu_lockstep.h"
+
+/*
+ * =====================================================================================
+ * Filename:  emu_lockstep.c
+ * Description: Implementation of the lockstep emulator. A round picks the lowest pc
+ * of the running lanes, masks in the lanes at it and applies the instruction to
+ * all lanes: operands are loaded into lane vectors and results are blended back
+ * under the mask, so registers and directly addressed words are processed as
+ * whole rows. Matrix operands and the return stack go lane by lane. The dispatch
+ * records are shared and only cached for words that are the same in every running
+ * lane; a lane whose code was changed differently is decoded in a round of its own.
+ * =====================================================================================
+ */
+
+#define SIGN_BIT 0x200 /* sign of a 10 bit word */
+#define NUMBER_TEXT_LENGTH 8 /* "-512\n" and the terminator */
+#define FIRST_OUTPUT_CAPACITY 64
+
+typedef unsigned char lane_mask_t[EMU_LANES];
+
+/* --- Private Helper Functions --- */
+
+static int to_signed(const WORD w) {
+    return (w & SIGN_BIT) ? (int) w - (WORD_MASK + 1) : (int) w;
+}
+
+/* Stops lane l with a fault and masks it off. */
+static void fault(emu_lockstep_t *m, unsigned char *active, const int l, const error_code_t code) {
+    m->runs[l]->status = EMU_FAULT;
+    m->runs[l]->fault = code;
+    m->runs[l]->fault_pc = m->pc[l];
+    m->pc[l] = EMU_LANE_STOPPED;
+    active[l] = 0;
+}
+
+static void fault_active(emu_lockstep_t *m, unsigned char *active, const error_code_t code) {
+    int l;
+    for (l = 0; l < EMU_LANES; l++) {
+        if (active[l]) fault(m, active, l, code);
+    }
+}
+
+/* Drops the records of the instructions that cover the word at address. */
+static void invalidate(emu_lockstep_t *m, const int address) {
+    int a;
+    for (a = address; a >= 0 && a > address - EMU_MAX_INSN_LENGTH; a--) m->insns[a].decoded = 0;
+}
+
+/* Returns the record of the instruction at pc for the active lanes. Lanes whose
+ * words differ from those of the first active lane are masked off; they come back
+ * in a later round at the same pc.
+ */
+static const emu_insn_t *decode(emu_lockstep_t *m, const int pc, unsigned char *active, emu_insn_t *scratch) {
+    WORD words[EMU_MAX_INSN_LENGTH];
+    emu_insn_t *insn = &m->insns[pc];
+    int l, k, first = 0, n = EMU_MEMORY_SIZE - pc, uniform = 1;
+
+    if (insn->decoded) return insn;
+    while (!active[first]) first++;
+    if (n > EMU_MAX_INSN_LENGTH) n = EMU_MAX_INSN_LENGTH;
+    for (k = 0; k < n; k++) words[k] = m->memory[pc + k][first];
+    emu_decode(words, n, scratch);
+
+    for (l = 0; l < EMU_LANES; l++) {
+        if (m->pc[l] == EMU_LANE_STOPPED) continue;
+        for (k = 0; k < scratch->length && m->memory[pc + k][l] == words[k]; k++) continue;
+        if (k < scratch->length) {
+            uniform = 0;
+            active[l] = 0;
+        }
+    }
+    if (!uniform) return scratch;
+    *insn = *scratch;
+    return insn;
+}
+
+/* Computes the address an operand refers to in every active lane. Lanes where it
+ * cannot be computed fault.
+ */
+static void operand_address(emu_lockstep_t *m, const emu_operand_t *op, unsigned char *active, int *address) {
+    int l;
+
+    switch (op->kind) {
+        case EMU_OPERAND_MEMORY:
+            for (l = 0; l < EMU_LANES; l++) address[l] = op->value;
+            break;
+        case EMU_OPERAND_MATRIX:
+            for (l = 0; l < EMU_LANES; l++) {
+                address[l] = op->value + to_signed(m->regs[op->row][l]) * m->mat_cols +
+                             to_signed(m->regs[op->col][l]);
+            }
+            for (l = 0; l < EMU_LANES; l++) {
+                if (active[l] && (address[l] < 0 || address[l] >= EMU_MEMORY_SIZE)) {
+                    fault(m, active, l, ERROR_ADDRESS_OUT_OF_RANGE);
+                }
+            }
+            break;
+        case EMU_OPERAND_EXTERNAL:
+            fault_active(m, active, ERROR_UNLINKED_EXTERNAL);
+            break;
+        default:
+            fault_active(m, active, ERROR_INVALID_INSTRUCTION);
+            break;
+    }
+}
+
+/* Reads the value of an operand in every active lane. */
+static void load(emu_lockstep_t *m, const emu_operand_t *op, unsigned char *active, WORD *value) {
+    int address[EMU_LANES];
+    int l;
+
+    switch (op->kind) {
+        case EMU_OPERAND_IMMEDIATE:
+            for (l = 0; l < EMU_LANES; l++) value[l] = (WORD) (op->value & WORD_MASK);
+            break;
+        case EMU_OPERAND_REGISTER:
+            memcpy(value, m->regs[op->value], sizeof(emu_lane_words_t));
+            break;
+        case EMU_OPERAND_MEMORY:
+            memcpy(value, m->memory[op->value], sizeof(emu_lane_words_t));
+            break;
+        default:
+            operand_address(m, op, active, address);
+            for (l = 0; l < EMU_LANES; l++) {
+                if (active[l]) value[l] = m->memory[address[l]][l];
+            }
+            break;
+    }
+}
+
+/* Writes the value of an operand in every active lane. */
+static void store(emu_lockstep_t *m, const emu_operand_t *op, unsigned char *active, const WORD *value) {
+    emu_lane_words_t merged;
+    WORD keep;
+    int address[EMU_LANES];
+    WORD *row;
+    int l;
+
+    if (op->kind == EMU_OPERAND_REGISTER || op->kind == EMU_OPERAND_MEMORY) {
+        row = op->kind == EMU_OPERAND_REGISTER ? m->regs[op->value] : m->memory[op->value];
+        for (l = 0; l < EMU_LANES; l++) {
+            keep = (WORD) (active[l] - 1); /* all ones in an inactive lane, a bitwise blend vectorizes */
+            merged[l] = (WORD) ((row[l] & keep) | (value[l] & WORD_MASK & ~keep));
+        }
+        memcpy(row, merged, sizeof(merged));
+        if (op->kind == EMU_OPERAND_MEMORY) invalidate(m, op->value);
+        return;
+    }
+    operand_address(m, op, active, address);
+    for (l = 0; l < EMU_LANES; l++) {
+        if (!active[l]) continue;
+        m->memory[address[l]][l] = (WORD) (value[l] & WORD_MASK);
+        invalidate(m, address[l]);
+    }
+}
+
+/* Computes the address a jump goes to in every active lane. */
+static void jump_target(emu_lockstep_t *m, const emu_operand_t *op, unsigned char *active, int *target) {
+    int l;
+
+    if (op->kind != EMU_OPERAND_REGISTER) {
+        operand_address(m, op, active, target);
+        return;
+    }
+    for (l = 0; l < EMU_LANES; l++) target[l] = to_signed(m->regs[op->value][l]);
+    for (l = 0; l < EMU_LANES; l++) {
+        if (active[l] && (target[l] < 0 || target[l] >= EMU_MEMORY_SIZE)) {
+            fault(m, active, l, ERROR_ADDRESS_OUT_OF_RANGE);
+        }
+    }
+}
+
+/* Appends the text of prn to the output of lane l. */
+static void print_number(emu_lockstep_t *m, unsigned char *active, const int l, const int value) {
+    char text[NUMBER_TEXT_LENGTH];
+    emu_run_t *run = m->runs[l];
+    char *grown;
+    size_t n = (size_t) sprintf(text, "%d\n", value), cap = m->out_cap[l];
+
+    if (run->output_len + n + 1 > cap) {
+        if (cap == 0) cap = FIRST_OUTPUT_CAPACITY;
+        while (run->output_len + n + 1 > cap) cap *= 2;
+        grown = realloc(run->output, cap);
+        if (!grown) {
+            fault(m, active, l, ERROR_MEMORY_ALLOCATION_FAILED);
+            return;
+        }
+        run->output = grown;
+        m->out_cap[l] = cap;
+    }
+    memcpy(run->output + run->output_len, text, n + 1);
+    run->output_len += n;
+}
+
+/* Applies the instruction at pc to the active lanes. */
+static void execute(emu_lockstep_t *m, const emu_insn_t *insn, const int pc, unsigned char *active) {
+    emu_lane_words_t a, b;
+    int target[EMU_LANES];
+    int l, c, next = pc + insn->length;
+    emu_run_t *run;
+
+    switch (insn->opcode) {
+        case MOV_OP:
+            load(m, &insn->src, active, a);
+            store(m, &insn->dst, active, a);
+            break;
+        case CMP_OP:
+            load(m, &insn->src, active, a);
+            load(m, &insn->dst, active, b);
+            for (l = 0; l < EMU_LANES; l++) m->zero_flag[l] = active[l] ? a[l] == b[l] : m->zero_flag[l];
+            break;
+        case ADD_OP:
+        case SUB_OP:
+            load(m, &insn->src, active, a);
+            load(m, &insn->dst, active, b);
+            if (insn->opcode == ADD_OP) {
+                for (l = 0; l < EMU_LANES; l++) b[l] = (WORD) (b[l] + a[l]);
+            } else {
+                for (l = 0; l < EMU_LANES; l++) b[l] = (WORD) (b[l] - a[l]);
+            }
+            store(m, &insn->dst, active, b);
+            break;
+        case LEA_OP:
+            operand_address(m, &insn->src, active, target);
+            for (l = 0; l < EMU_LANES; l++) a[l] = (WORD) target[l];
+            store(m, &insn->dst, active, a);
+            break;
+        case CLR_OP:
+            memset(a, 0, sizeof(a));
+            store(m, &insn->dst, active, a);
+            break;
+        case NOT_OP:
+        case INC_OP:
+        case DEC_OP:
+            load(m, &insn->dst, active, a);
+            c = insn->opcode == INC_OP ? 1 : -1;
+            for (l = 0; l < EMU_LANES; l++) a[l] = (WORD) (insn->opcode == NOT_OP ? ~a[l] : a[l] + c);
+            store(m, &insn->dst, active, a);
+            break;
+        case JMP_OP:
+            jump_target(m, &insn->dst, active, target);
+            for (l = 0; l < EMU_LANES; l++) m->pc[l] = active[l] ? target[l] : m->pc[l];
+            return;
+        case BNE_OP:
+            jump_target(m, &insn->dst, active, target);
+            for (l = 0; l < EMU_LANES; l++) {
+                m->pc[l] = active[l] ? (m->zero_flag[l] ? next : target[l]) : m->pc[l];
+            }
+            return;
+        case JSR_OP:
+            jump_target(m, &insn->dst, active, target);
+            for (l = 0; l < EMU_LANES; l++) {
+                if (!active[l]) continue;
+                if (m->sp[l] == EMU_STACK_DEPTH) {
+                    fault(m, active, l, ERROR_RETURN_STACK);
+                    continue;
+                }
+                m->stack[m->sp[l]++][l] = next;
+                m->pc[l] = target[l];
+            }
+            return;
+        case RED_OP:
+            for (l = 0; l < EMU_LANES; l++) {
+                if (!active[l]) continue;
+                run = m->runs[l];
+                a[l] = (WORD) (m->in_pos[l] < run->input_len ? (unsigned char) run->input[m->in_pos[l]++] : WORD_MASK);
+            }
+            store(m, &insn->dst, active, a);
+            break;
+        case PRN_OP:
+            load(m, &insn->dst, active, a);
+            for (l = 0; l < EMU_LANES; l++) {
+                if (active[l]) print_number(m, active, l, to_signed(a[l]));
+            }
+            break;
+        case RTS_OP:
+            for (l = 0; l < EMU_LANES; l++) {
+                if (!active[l]) continue;
+                if (m->sp[l] == 0) {
+                    fault(m, active, l, ERROR_RETURN_STACK);
+                    continue;
+                }
+                m->pc[l] = m->stack[--m->sp[l]][l];
+            }
+            return;
+        case STOP_OP:
+            for (l = 0; l < EMU_LANES; l++) {
+                if (!active[l]) continue;
+                m->runs[l]->status = EMU_HALTED;
+                m->pc[l] = EMU_LANE_STOPPED;
+            }
+            return;
+        default:
+            fault_active(m, active, ERROR_INVALID_INSTRUCTION);
+            return;
+    }
+    for (l = 0; l < EMU_LANES; l++) m->pc[l] = active[l] ? next : m->pc[l];
+}
+
+/* --- Public API Functions Implementation --- */
+
+int emu_lockstep_run(emu_lockstep_t *m, const object_t *program, const int mat_cols, const long max_steps,
+                     emu_run_t *runs, const int n_runs) {
+    lane_mask_t active;
+    emu_insn_t scratch;
+    const emu_insn_t *insn;
+    int total = program->code_len + program->data_len;
+    int l, a, pc;
+
+    if (total > EMU_MEMORY_SIZE - ADDRESS_BASE || n_runs < 1 || n_runs > EMU_LANES) return -1;
+    memset(m, 0, sizeof(*m));
+    for (a = 0; a < total; a++) {
+        for (l = 0; l < EMU_LANES; l++) m->memory[ADDRESS_BASE + a][l] = program->words[a];
+    }
+    m->mat_cols = mat_cols;
+    m->max_steps = max_steps;
+    for (l = 0; l < EMU_LANES; l++) m->pc[l] = EMU_LANE_STOPPED;
+    for (l = 0; l < n_runs; l++) {
+        m->runs[l] = &runs[l];
+        m->pc[l] = ADDRESS_BASE;
+        runs[l].status = EMU_RUNNING;
+        runs[l].fault = ERROR_OK;
+        runs[l].fault_pc = 0;
+        runs[l].output_len = 0;
+    }
+
+    for (;;) {
+        pc = EMU_LANE_STOPPED;
+        for (l = 0; l < EMU_LANES; l++) pc = m->pc[l] < pc ? m->pc[l] : pc;
+        if (pc == EMU_LANE_STOPPED) break;
+
+        for (l = 0; l < EMU_LANES; l++) active[l] = (unsigned char) (m->pc[l] == pc);
+        for (l = 0; l < EMU_LANES && m->max_steps != EMU_NO_STEP_LIMIT; l++) {
+            if (active[l] && m->steps[l] >= m->max_steps) fault(m, active, l, ERROR_STEP_LIMIT);
+        }
+        if (pc >= EMU_MEMORY_SIZE) fault_active(m, active, ERROR_ADDRESS_OUT_OF_RANGE); /* ran past the last word */
+        if (memchr(active, 1, sizeof(active)) == NULL) continue;
+
+        insn = decode(m, pc, active, &scratch);
+        for (l = 0; l < EMU_LANES; l++) m->steps[l] += active[l];
+        m->rounds++;
+        execute(m, insn, pc, active);
+    }
+
+    for (l = 0; l < n_runs; l++) {
+        runs[l].steps = m->steps[l];
+        if (!runs[l].output) runs[l].output = calloc(1, 1); /* an empty text, as from open_memstream */
+    }
+    return 0;
+}
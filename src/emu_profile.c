@@ -0,0 +1,105 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../include/emu_profile.h"
+#include "../include/isa.h"
+
+/*
+ * =====================================================================================
+ * Filename:  emu_profile.c
+ * Description: Report of the execution counters of the emulator. The symbols are
+ * sorted by address so that each one owns the addresses up to the next symbol;
+ * the counters of those addresses are summed into its line of the hot-label table.
+ * The totals come from the counters too, which keep adding up across snapshot
+ * restores while the step count of the emulator is restored.
+ * =====================================================================================
+ */
+
+/* struct label_stat_t is the counters of the addresses owned by one label. */
+typedef struct {
+    const char *name;
+    int address; /* first address owned */
+    unsigned long instructions;
+    unsigned long cycles;
+} label_stat_t;
+
+/* --- Private Helper Functions --- */
+
+static int by_address(const void *a, const void *b) {
+    const label_stat_t *x = a, *y = b;
+    if (x->address != y->address) return x->address < y->address ? -1 : 1;
+    return strcmp(x->name, y->name);
+}
+
+static int by_cycles(const void *a, const void *b) {
+    const label_stat_t *x = a, *y = b;
+    if (x->cycles != y->cycles) return x->cycles > y->cycles ? -1 : 1;
+    return x->address < y->address ? -1 : x->address > y->address;
+}
+
+/* Writes one listing line for address a; returns the words the instruction takes. */
+static int listing_line(const emulator_t *emu, const int a, FILE *out) {
+    instruction_t ins;
+
+    fprintf(out, "  %10lu %9lu  %7d  ", emu->cycle_count[a], emu->exec_count[a], a);
+    if (isa_decode(emu->memory[a], &ins) != 0) {
+        fprintf(out, "(not an instruction)\n");
+        return 1;
+    }
+    fprintf(out, "%s\n", isa_mnemonic(ins.opcode));
+    return ins.length;
+}
+
+/* --- Public API Functions Implementation --- */
+
+int emu_profile_report(const emulator_t *emu, const int code_len, const obj_symbol_t *symbols, const int n_symbols,
+                       FILE *out) {
+    label_stat_t *labels;
+    unsigned long instructions = 0, cycles = 0;
+    int i, a, end, in_code, next_insn = ADDRESS_BASE, next_label = 0, n = n_symbols + 1;
+
+    labels = malloc(sizeof(label_stat_t) * (size_t) n);
+    if (!labels) return -1;
+    labels[0].name = EMU_PROFILE_NO_LABEL;
+    labels[0].address = -1; /* sorts first, owns the addresses below every symbol */
+    for (i = 0; i < n_symbols; i++) {
+        labels[i + 1].name = symbols[i].name;
+        labels[i + 1].address = symbols[i].address;
+    }
+    qsort(labels, (size_t) n, sizeof(label_stat_t), by_address);
+    for (i = 0; i < n; i++) {
+        labels[i].instructions = labels[i].cycles = 0;
+        end = i + 1 < n ? labels[i + 1].address : EMU_MEMORY_SIZE;
+        for (a = labels[i].address < 0 ? 0 : labels[i].address; a < end && a < EMU_MEMORY_SIZE; a++) {
+            labels[i].instructions += emu->exec_count[a];
+            labels[i].cycles += emu->cycle_count[a];
+        }
+        instructions += labels[i].instructions;
+        cycles += labels[i].cycles;
+    }
+
+    qsort(labels, (size_t) n, sizeof(label_stat_t), by_cycles);
+    fprintf(out, "Profile: %lu instructions, %lu cycles\n\nHot labels:\n", instructions, cycles);
+    fprintf(out, "  %%cycles      cycles    instrs  label\n");
+    for (i = 0; i < n && labels[i].instructions > 0; i++) {
+        fprintf(out, "  %6.2f %11lu %9lu  %s\n",
+                cycles ? 100.0 * (double) labels[i].cycles / (double) cycles : 0.0,
+                labels[i].cycles, labels[i].instructions, labels[i].name);
+    }
+
+    /* the listing walks the instructions of the code image, plus whatever else ran */
+    qsort(labels, (size_t) n, sizeof(label_stat_t), by_address);
+    fprintf(out, "\nAnnotated listing:\n      cycles    instrs  address  instruction\n");
+    for (a = 0; a < EMU_MEMORY_SIZE; a++) {
+        in_code = a >= next_insn && a < ADDRESS_BASE + code_len;
+        if (!in_code && emu->exec_count[a] == 0) continue;
+        while (next_label < n && labels[next_label].address <= a) {
+            if (labels[next_label].address >= 0) fprintf(out, "%s:\n", labels[next_label].name);
+            next_label++;
+        }
+        end = listing_line(emu, a, out);
+        if (in_code) next_insn = a + end;
+    }
+
+    free(labels);
+    return ferror(out) ? -1 : 0;
+}
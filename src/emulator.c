@@ -0,0 +1,366 @@
+#include <string.h>
+#include "../include/emulator.h"
+#include "../include/isa.h"
+
+/*
+ * =====================================================================================
+ * Filename:  emulator.c
+ * Description: Implementation of the emulator. decode turns the words of an
+ * instruction into a dispatch record (opcode, length and the kind, value and
+ * registers of each operand) and execute switches on the record. Values are
+ * 10 bit two's complement numbers, immediates are 8 bit two's complement as
+ * the assembler encodes them. Every store marks its page dirty, so a restore
+ * only copies back the pages written since the snapshot.
+ * =====================================================================================
+ */
+
+#define SIGN_BIT 0x200 /* sign of a 10 bit word */
+#define IMMEDIATE_BITS 0xFF /* an immediate is 8 bits, above the ARE field */
+#define IMMEDIATE_SIGN 0x80
+#define REGISTER_FIELD 0xF /* register numbers are 4 bit fields */
+#define SRC_REGISTER_SHIFT 6 /* source (and single operand) register, bits 6..9 */
+#define DST_REGISTER_SHIFT 2 /* destination register, bits 2..5 */
+#define ALL_PAGES ((1UL << EMU_PAGES) - 1)
+
+/* --- Private Helper Functions --- */
+
+static int to_signed(const WORD w) {
+    return (w & SIGN_BIT) ? (int) w - (WORD_MASK + 1) : (int) w;
+}
+
+static void fault(emulator_t *emu, const error_code_t code) {
+    emu->status = EMU_FAULT;
+    emu->fault = code;
+    emu->fault_pc = emu->pc;
+}
+
+/* Decodes the operand words at words[at]. Returns the number of words used,
+ * or -1 if they do not encode an operand of the given mode.
+ */
+static int decode_operand(const WORD *words, const addressing_mode_t mode, const int at, const int reg_shift,
+                          emu_operand_t *op) {
+    WORD w = words[at];
+    int v;
+
+    switch (mode) {
+        case IMMEDIATE:
+            v = (w >> 2) & IMMEDIATE_BITS;
+            op->kind = EMU_OPERAND_IMMEDIATE;
+            op->value = (short) ((v & IMMEDIATE_SIGN) ? v - (IMMEDIATE_BITS + 1) : v);
+            return 1;
+        case DIRECT:
+        case MATRIX_ACCESS:
+            op->kind = (w & 3) == ARE_E ? EMU_OPERAND_EXTERNAL : EMU_OPERAND_MEMORY;
+            op->value = (short) (w >> 2);
+            if (mode == DIRECT) return 1;
+            w = words[at + 1];
+            op->row = (unsigned char) ((w >> SRC_REGISTER_SHIFT) & REGISTER_FIELD);
+            op->col = (unsigned char) ((w >> DST_REGISTER_SHIFT) & REGISTER_FIELD);
+            if (op->row >= EMU_REGISTERS || op->col >= EMU_REGISTERS) return -1;
+            if (op->kind == EMU_OPERAND_MEMORY) op->kind = EMU_OPERAND_MATRIX;
+            return 2;
+        case REGISTER_DIRECT:
+            op->kind = EMU_OPERAND_REGISTER;
+            op->value = (short) ((w >> reg_shift) & REGISTER_FIELD);
+            return op->value < EMU_REGISTERS ? 1 : -1;
+        default:
+            return -1;
+    }
+}
+
+/* Returns TRUE if the operands suit the opcode, as the line parser checks them. */
+static bool_t valid_operands(const op_code_t opcode, const emu_insn_t *insn) {
+    int src_address = insn->src.kind != EMU_OPERAND_IMMEDIATE && insn->src.kind != EMU_OPERAND_REGISTER;
+
+    switch (opcode) {
+        case LEA_OP:
+            if (!src_address) return FALSE;
+            return insn->dst.kind != EMU_OPERAND_IMMEDIATE ? TRUE : FALSE;
+        case CMP_OP:
+        case PRN_OP:
+        case RTS_OP:
+        case STOP_OP:
+            return TRUE;
+        default:
+            return insn->dst.kind != EMU_OPERAND_IMMEDIATE ? TRUE : FALSE;
+    }
+}
+
+/* Builds the dispatch record of the instruction at pc. */
+static void decode(const emulator_t *emu, const int pc, emu_insn_t *insn) {
+    emu_decode(emu->memory + pc, EMU_MEMORY_SIZE - pc, insn);
+}
+
+/* Returns the address an operand refers to, or -1 after a fault. */
+static int operand_address(emulator_t *emu, const emu_operand_t *op) {
+    int address;
+
+    switch (op->kind) {
+        case EMU_OPERAND_MEMORY:
+            return op->value;
+        case EMU_OPERAND_MATRIX:
+            address = op->value + to_signed(emu->regs[op->row]) * emu->mat_cols + to_signed(emu->regs[op->col]);
+            if (address >= 0 && address < EMU_MEMORY_SIZE) return address;
+            fault(emu, ERROR_ADDRESS_OUT_OF_RANGE);
+            return -1;
+        case EMU_OPERAND_EXTERNAL:
+            fault(emu, ERROR_UNLINKED_EXTERNAL);
+            return -1;
+        default:
+            fault(emu, ERROR_INVALID_INSTRUCTION);
+            return -1;
+    }
+}
+
+/* Reads the value of an operand. Returns 0, or -1 after a fault. */
+static int load(emulator_t *emu, const emu_operand_t *op, WORD *value) {
+    int address;
+
+    if (op->kind == EMU_OPERAND_IMMEDIATE) {
+        *value = (WORD) (op->value & WORD_MASK);
+        return 0;
+    }
+    if (op->kind == EMU_OPERAND_REGISTER) {
+        *value = emu->regs[op->value];
+        return 0;
+    }
+    address = operand_address(emu, op);
+    if (address < 0) return -1;
+    *value = emu->memory[address];
+    return 0;
+}
+
+/* Writes the value of an operand, dropping the records of the instructions that
+ * cover a written memory word. Returns 0, or -1 after a fault.
+ */
+static int store(emulator_t *emu, const emu_operand_t *op, const WORD value) {
+    int address, a;
+
+    if (op->kind == EMU_OPERAND_REGISTER) {
+        emu->regs[op->value] = (WORD) (value & WORD_MASK);
+        return 0;
+    }
+    address = operand_address(emu, op);
+    if (address < 0) return -1;
+    emu->memory[address] = (WORD) (value & WORD_MASK);
+    emu->dirty_pages |= 1UL << (address / EMU_PAGE_WORDS);
+    for (a = address; a >= 0 && a > address - EMU_MAX_INSN_LENGTH; a--) emu->insns[a].decoded = 0;
+    return 0;
+}
+
+/* Returns the address a jump goes to, or -1 after a fault. */
+static int jump_target(emulator_t *emu, const emu_operand_t *op) {
+    int target;
+
+    if (op->kind != EMU_OPERAND_REGISTER) return operand_address(emu, op);
+    target = to_signed(emu->regs[op->value]);
+    if (target >= 0 && target < EMU_MEMORY_SIZE) return target;
+    fault(emu, ERROR_ADDRESS_OUT_OF_RANGE);
+    return -1;
+}
+
+/* Executes the instruction at pc. */
+static void execute(emulator_t *emu) {
+    emu_insn_t *insn;
+    WORD a, b;
+    int next, target, c;
+
+    if (emu->pc < 0 || emu->pc >= EMU_MEMORY_SIZE) {
+        fault(emu, ERROR_ADDRESS_OUT_OF_RANGE);
+        return;
+    }
+    insn = &emu->insns[emu->pc];
+    if (!insn->decoded) decode(emu, emu->pc, insn);
+    next = emu->pc + insn->length;
+    emu->steps++;
+    emu->cycles += insn->cycles;
+    emu->exec_count[emu->pc]++;
+    emu->cycle_count[emu->pc] += insn->cycles;
+
+    switch (insn->opcode) {
+        case MOV_OP:
+            if (load(emu, &insn->src, &a) == 0 && store(emu, &insn->dst, a) == 0) emu->pc = next;
+            break;
+        case CMP_OP:
+            if (load(emu, &insn->src, &a) == 0 && load(emu, &insn->dst, &b) == 0) {
+                emu->zero_flag = a == b;
+                emu->pc = next;
+            }
+            break;
+        case ADD_OP:
+        case SUB_OP:
+            if (load(emu, &insn->src, &a) == 0 && load(emu, &insn->dst, &b) == 0 &&
+                store(emu, &insn->dst, (WORD) (insn->opcode == ADD_OP ? b + a : b - a)) == 0) {
+                emu->pc = next;
+            }
+            break;
+        case LEA_OP:
+            target = operand_address(emu, &insn->src);
+            if (target >= 0 && store(emu, &insn->dst, (WORD) target) == 0) emu->pc = next;
+            break;
+        case CLR_OP:
+            if (store(emu, &insn->dst, 0) == 0) emu->pc = next;
+            break;
+        case NOT_OP:
+        case INC_OP:
+        case DEC_OP:
+            if (load(emu, &insn->dst, &a) == 0) {
+                b = (WORD) (insn->opcode == NOT_OP ? ~a : insn->opcode == INC_OP ? a + 1 : a - 1);
+                if (store(emu, &insn->dst, b) == 0) emu->pc = next;
+            }
+            break;
+        case JMP_OP:
+            target = jump_target(emu, &insn->dst);
+            if (target >= 0) emu->pc = target;
+            break;
+        case BNE_OP:
+            target = jump_target(emu, &insn->dst);
+            if (target >= 0) emu->pc = emu->zero_flag ? next : target;
+            break;
+        case JSR_OP:
+            target = jump_target(emu, &insn->dst);
+            if (target < 0) break;
+            if (emu->sp == EMU_STACK_DEPTH) {
+                fault(emu, ERROR_RETURN_STACK);
+                break;
+            }
+            emu->stack[emu->sp++] = next;
+            emu->pc = target;
+            break;
+        case RED_OP:
+            c = fgetc(emu->in);
+            if (store(emu, &insn->dst, (WORD) (c == EOF ? WORD_MASK : c)) == 0) emu->pc = next;
+            break;
+        case PRN_OP:
+            if (load(emu, &insn->dst, &a) == 0) {
+                fprintf(emu->out, "%d\n", to_signed(a));
+                emu->pc = next;
+            }
+            break;
+        case RTS_OP:
+            if (emu->sp == 0) {
+                fault(emu, ERROR_RETURN_STACK);
+                break;
+            }
+            emu->pc = emu->stack[--emu->sp];
+            break;
+        case STOP_OP:
+            emu->status = EMU_HALTED;
+            break;
+        default:
+            fault(emu, ERROR_INVALID_INSTRUCTION);
+            break;
+    }
+}
+
+/* --- Public API Functions Implementation --- */
+
+void emu_decode(const WORD *words, const int available, emu_insn_t *insn) {
+    instruction_t ins;
+    WORD w;
+    int used = 0;
+
+    memset(insn, 0, sizeof(*insn));
+    insn->decoded = 1;
+    insn->opcode = EMU_INVALID_OPCODE;
+    insn->length = 1;
+    insn->cycles = 1;
+    if (isa_decode(words[0], &ins) != 0 || ins.length > available) return;
+
+    if (ins.n_operands == 2 && ins.src_mode == REGISTER_DIRECT && ins.dst_mode == REGISTER_DIRECT) {
+        w = words[1];
+        insn->src.kind = insn->dst.kind = EMU_OPERAND_REGISTER;
+        insn->src.value = (short) ((w >> SRC_REGISTER_SHIFT) & REGISTER_FIELD);
+        insn->dst.value = (short) ((w >> DST_REGISTER_SHIFT) & REGISTER_FIELD);
+        if (insn->src.value >= EMU_REGISTERS || insn->dst.value >= EMU_REGISTERS) return;
+    } else if (ins.n_operands == 2) {
+        used = decode_operand(words, ins.src_mode, 1, SRC_REGISTER_SHIFT, &insn->src);
+        if (used < 0 || decode_operand(words, ins.dst_mode, 1 + used, DST_REGISTER_SHIFT, &insn->dst) < 0) return;
+    } else if (ins.n_operands == 1) {
+        /* the single operand is encoded like a source */
+        if (decode_operand(words, ins.dst_mode, 1, SRC_REGISTER_SHIFT, &insn->dst) < 0) return;
+    }
+    if (!valid_operands(ins.opcode, insn)) return;
+
+    insn->opcode = (unsigned char) ins.opcode;
+    insn->length = (unsigned char) ins.length;
+    insn->cycles = (unsigned char) isa_cycles(&ins);
+}
+
+
+void emu_init(emulator_t *emu, FILE *in, FILE *out) {
+    memset(emu, 0, sizeof(*emu));
+    emu->in = in;
+    emu->out = out;
+    emu->pc = ADDRESS_BASE;
+    emu->mat_cols = EMU_DEFAULT_MAT_COLS;
+    emu->max_steps = EMU_NO_STEP_LIMIT;
+    emu->status = EMU_RUNNING;
+    emu->fault = ERROR_OK;
+}
+
+int emu_load(emulator_t *emu, const object_t *program) {
+    int total = program->code_len + program->data_len;
+
+    if (total > EMU_MEMORY_SIZE - ADDRESS_BASE) return -1;
+    if (total > 0) memcpy(emu->memory + ADDRESS_BASE, program->words, sizeof(WORD) * (size_t) total);
+    memset(emu->insns, 0, sizeof(emu->insns));
+    emu->dirty_pages = ALL_PAGES;
+    return 0;
+}
+
+void emu_snapshot(emulator_t *emu, emu_snapshot_t *snap) {
+    memcpy(snap->memory, emu->memory, sizeof(snap->memory));
+    memcpy(snap->insns, emu->insns, sizeof(snap->insns));
+    memcpy(snap->regs, emu->regs, sizeof(snap->regs));
+    memcpy(snap->stack, emu->stack, sizeof(int) * (size_t) emu->sp);
+    snap->pc = emu->pc;
+    snap->zero_flag = emu->zero_flag;
+    snap->sp = emu->sp;
+    snap->steps = emu->steps;
+    snap->cycles = emu->cycles;
+    snap->status = emu->status;
+    snap->fault = emu->fault;
+    snap->fault_pc = emu->fault_pc;
+    emu->dirty_pages = 0;
+}
+
+void emu_restore(emulator_t *emu, const emu_snapshot_t *snap) {
+    int page, first, from;
+
+    for (page = 0; page < EMU_PAGES && emu->dirty_pages != 0; page++) {
+        if (!(emu->dirty_pages & (1UL << page))) continue;
+        first = page * EMU_PAGE_WORDS;
+        memcpy(emu->memory + first, snap->memory + first, sizeof(WORD) * EMU_PAGE_WORDS);
+        /* records just before the page may have been decoded from its modified words */
+        from = first - (EMU_MAX_INSN_LENGTH - 1) < 0 ? 0 : first - (EMU_MAX_INSN_LENGTH - 1);
+        memcpy(emu->insns + from, snap->insns + from, sizeof(emu_insn_t) * (size_t) (first + EMU_PAGE_WORDS - from));
+        emu->dirty_pages &= ~(1UL << page);
+    }
+    memcpy(emu->regs, snap->regs, sizeof(emu->regs));
+    memcpy(emu->stack, snap->stack, sizeof(int) * (size_t) snap->sp);
+    emu->pc = snap->pc;
+    emu->zero_flag = snap->zero_flag;
+    emu->sp = snap->sp;
+    emu->steps = snap->steps;
+    emu->cycles = snap->cycles;
+    emu->status = snap->status;
+    emu->fault = snap->fault;
+    emu->fault_pc = snap->fault_pc;
+}
+
+emu_status_t emu_step(emulator_t *emu) {
+    if (emu->status == EMU_RUNNING) execute(emu);
+    return emu->status;
+}
+
+emu_status_t emu_run(emulator_t *emu) {
+    while (emu->status == EMU_RUNNING) {
+        if (emu->max_steps != EMU_NO_STEP_LIMIT && emu->steps >= emu->max_steps) {
+            fault(emu, ERROR_STEP_LIMIT);
+            break;
+        }
+        execute(emu);
+    }
+    return emu->status;
+}
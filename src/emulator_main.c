@@ -0,0 +1,267 @@
+#define _POSIX_C_SOURCE 200809L /* fmemopen, open_memstream */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/emulator.h"
+#include "../include/emu_profile.h"
+#include "../include/emu_batch.h"
+#include "../include/emu_lockstep.h"
+#include "../include/emu_jit.h"
+
+/*
+ * =====================================================================================
+ * Filename:  emulator_main.c
+ * Description: Command line driver of the emulator. Loads <program>.ob (an object
+ * file or a linked image) and runs it: red reads characters from stdin and prn
+ * writes numbers to stdout. A fault is reported at the .ob line of the
+ * instruction that caused it. With --profile the execution counters are reported
+ * per label of <program>.ent (or of the --symbols file) at exit. With --batch the
+ * program runs once per line of a vector file on -j threads and the output and
+ * final state of every run are printed in vector order; --lockstep runs the vectors
+ * EMU_LANES at a time on the lockstep emulator. --jit runs hot blocks as native
+ * code, and --jit-verify runs the program on both tiers and checks that they agree.
+ * =====================================================================================
+ */
+
+#define OB_FIRST_WORD_LINE 2 /* the .ob header is line 1 */
+
+/* Parses a positive number option value. Returns the number, or -1 if invalid. */
+static long parse_count(const char *val) {
+    char *end;
+    long n = strtol(val, &end, 10);
+    if (*end != '\0' || end == val || n < 1) return -1;
+    return n;
+}
+
+/* Writes the profile of a run on stderr, or into path. Returns 0 on success. */
+static int report_profile(const emulator_t *emu, const object_t *program, const obj_symbol_t *symbols,
+                          const int n_symbols, const char *path) {
+    FILE *out = path ? fopen(path, "w") : stderr;
+    int result;
+
+    if (!out) {
+        print_error_file(path, ERROR_CANNOT_OPEN_FILE, 0);
+        return -1;
+    }
+    result = emu_profile_report(emu, program->code_len, symbols, n_symbols, out);
+    if (path && fclose(out) != 0) result = -1;
+    if (result != 0) print_error_file(path ? path : "stderr", ERROR_WRITE_FAILED, 0);
+    return result;
+}
+
+/* Runs the program on the interpreter in emu and again on the translating tier, with
+ * the same input, and compares the final states and outputs. The output of the
+ * interpreter is written to stdout. Returns 0 if both runs agree.
+ */
+static int run_verified(emulator_t *emu, emu_jit_t *jit) {
+    emulator_t *native = malloc(sizeof(emulator_t));
+    char *input = NULL, *output[2] = {NULL, NULL};
+    size_t input_len = 0, output_len[2] = {0, 0};
+    FILE *stream = open_memstream(&input, &input_len), *in[2] = {NULL, NULL}, *out[2] = {NULL, NULL};
+    const char *differs = NULL;
+    int c, i, result = 0;
+
+    while (stream && (c = getchar()) != EOF) fputc(c, stream);
+    if (!native || !stream || fclose(stream) != 0) {
+        print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+        free(native);
+        free(input);
+        return -1;
+    }
+    *native = *emu;
+    for (i = 0; i < 2; i++) {
+        in[i] = fmemopen(input, input_len, "r");
+        out[i] = open_memstream(&output[i], &output_len[i]);
+        if (!in[i] || !out[i]) result = -1;
+    }
+    if (result == 0) {
+        emu->in = in[0];
+        emu->out = out[0];
+        native->in = in[1];
+        native->out = out[1];
+        emu_run(emu);
+        emu_jit_run(jit, native);
+    }
+    for (i = 0; i < 2; i++) {
+        if (in[i]) fclose(in[i]);
+        if (out[i]) fclose(out[i]);
+    }
+    emu->in = stdin;
+    emu->out = stdout;
+    if (result != 0) {
+        print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+    } else {
+        fwrite(output[0], 1, output_len[0], stdout);
+        differs = emu_jit_diff(emu, native);
+        if (!differs && (output_len[0] != output_len[1] || memcmp(output[0], output[1], output_len[0]) != 0)) {
+            differs = "output";
+        }
+        if (differs) {
+            print_error(ERROR_JIT_MISMATCH);
+            printf("The translated run differs from the interpreter in its %s\n", differs);
+            result = -1;
+        }
+    }
+    free(output[0]);
+    free(output[1]);
+    free(input);
+    free(native);
+    return result;
+}
+
+/* Runs the program once per vector of vectors_path and prints the results in vector
+ * order. Returns 0 if every run halted.
+ */
+static int run_batch(const object_t *program, const char *vectors_path, const int mat_cols, const long max_steps,
+                     const int jobs, const int lockstep) {
+    emu_run_t *runs;
+    long rounds = 0, steps = 0;
+    int i, n_runs, faulted = 0, status;
+
+    if (emu_batch_read(vectors_path, &runs, &n_runs) != 0) return -1;
+    if (lockstep) {
+        status = emu_batch_run_lockstep(program, mat_cols, max_steps, runs, n_runs, jobs, &rounds);
+    } else {
+        status = emu_batch_run(program, mat_cols, max_steps, runs, n_runs, jobs);
+    }
+    if (status != 0) {
+        print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+        emu_batch_free(runs, n_runs);
+        return -1;
+    }
+    for (i = 0; i < n_runs; i++) {
+        if (runs[i].status == EMU_HALTED) {
+            printf("Vector %d: halted after %ld instructions\n", i + 1, runs[i].steps);
+        } else {
+            printf("Vector %d: %s at address %d after %ld instructions\n", i + 1, error_message(runs[i].fault),
+                   runs[i].fault_pc, runs[i].steps);
+            faulted++;
+        }
+        if (runs[i].output_len > 0) fwrite(runs[i].output, 1, runs[i].output_len, stdout);
+        steps += runs[i].steps;
+    }
+    printf("Ran %d vectors: %d halted, %d faulted\n", n_runs, n_runs - faulted, faulted);
+    if (lockstep && rounds > 0) {
+        printf("Lockstep: %ld instructions issued, %.1f lanes of %d active on average\n", rounds,
+               (double) steps / (double) rounds, EMU_LANES);
+    }
+    emu_batch_free(runs, n_runs);
+    return faulted == 0 ? 0 : -1;
+}
+
+int main(int argc, char *argv[]) {
+    emulator_t *emu;
+    emu_jit_t *jit = NULL;
+    object_t program;
+    obj_symbol_t *symbols = NULL;
+    char *ob_path;
+    const char *name = NULL, *profile_path = NULL, *symbols_path = NULL, *batch_path = NULL;
+    long mat_cols = EMU_DEFAULT_MAT_COLS, max_steps = EMU_NO_STEP_LIMIT, jobs = 1;
+    int i, n_symbols = 0, profile = 0, lockstep = 0, use_jit = 0, verify = 0, result = 0;
+
+    for (i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--mat-cols=", 11) == 0) {
+            mat_cols = parse_count(argv[i] + 11);
+            if (mat_cols < 0) result = -1;
+        } else if (strncmp(argv[i], "--max-steps=", 12) == 0) {
+            max_steps = parse_count(argv[i] + 12);
+            if (max_steps < 0) result = -1;
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            profile = 1;
+        } else if (strncmp(argv[i], "--profile=", 10) == 0 && argv[i][10] != '\0') {
+            profile = 1;
+            profile_path = argv[i] + 10;
+        } else if (strncmp(argv[i], "--symbols=", 10) == 0 && argv[i][10] != '\0') {
+            symbols_path = argv[i] + 10;
+        } else if (strncmp(argv[i], "--batch=", 8) == 0 && argv[i][8] != '\0') {
+            batch_path = argv[i] + 8;
+        } else if (strcmp(argv[i], "--lockstep") == 0) {
+            lockstep = 1;
+        } else if (strcmp(argv[i], "--jit") == 0) {
+            use_jit = 1;
+        } else if (strcmp(argv[i], "--jit-verify") == 0) {
+            use_jit = verify = 1;
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            jobs = parse_count(argv[++i]);
+        } else if (strncmp(argv[i], "-j", 2) == 0 || strncmp(argv[i], "--jobs=", 7) == 0) {
+            jobs = parse_count(argv[i] + (argv[i][1] == 'j' ? 2 : 7));
+        } else if (argv[i][0] == '-' || name) {
+            result = -1;
+        } else {
+            name = argv[i];
+        }
+        if (jobs < 0 || jobs > MAX_JOBS) result = -1;
+        if (result != 0) {
+            print_error(ERROR_INVALID_ARGUMENT);
+            printf("Invalid option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (!name) {
+        print_error(ERROR_CANNOT_OPEN_FILE);
+        printf("Usage: %s [--mat-cols=<columns>] [--max-steps=<steps>] [--profile[=<file>]]"
+               " [--symbols=<file>] [--jit | --jit-verify] [--batch=<vectors> [-j <jobs>] [--lockstep]]"
+               " <program>\n", argv[0]);
+        return 1;
+    }
+    if (batch_path && profile) {
+        print_error(ERROR_INVALID_ARGUMENT);
+        printf("--profile cannot be combined with --batch\n");
+        return 1;
+    }
+    if (batch_path && use_jit) {
+        print_error(ERROR_INVALID_ARGUMENT);
+        printf("--jit cannot be combined with --batch\n");
+        return 1;
+    }
+    if (lockstep && !batch_path) {
+        print_error(ERROR_INVALID_ARGUMENT);
+        printf("--lockstep needs --batch\n");
+        return 1;
+    }
+
+    ob_path = create_file_path(name, ".ob");
+    emu = malloc(sizeof(emulator_t));
+    if (use_jit) jit = malloc(sizeof(emu_jit_t));
+    if (!ob_path || !emu || (use_jit && !jit)) {
+        print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+        free(ob_path);
+        free(emu);
+        free(jit);
+        return 1;
+    }
+    if (jit) emu_jit_open(jit); /* without native code the interpreter runs */
+
+    emu_init(emu, stdin, stdout);
+    emu->mat_cols = (int) mat_cols;
+    emu->max_steps = max_steps;
+    if (object_read(name, &program) != 0 ||
+        (symbols_path && object_read_symbols(symbols_path, &symbols, &n_symbols) != 0)) {
+        result = -1;
+    } else if (emu_load(emu, &program) != 0) {
+        print_error_file(ob_path, ERROR_PROGRAM_TOO_LARGE, 1);
+        result = -1;
+    } else if (batch_path) {
+        result = run_batch(&program, batch_path, (int) mat_cols, max_steps, (int) jobs, lockstep);
+    } else if (verify && run_verified(emu, jit) != 0) {
+        result = -1;
+    } else if ((verify ? emu->status : jit ? emu_jit_run(jit, emu) : emu_run(emu)) == EMU_FAULT) {
+        i = emu->fault_pc - ADDRESS_BASE; /* word index, 0 when outside the program */
+        print_error_file(ob_path, emu->fault,
+                         (i >= 0 && i < program.code_len + program.data_len) ? i + OB_FIRST_WORD_LINE : 0);
+        printf("Stopped at address %d after %ld instructions\n", emu->fault_pc, emu->steps);
+        result = -1;
+    }
+    if (profile && emu->steps > 0 && report_profile(emu, &program, symbols_path ? symbols : program.entries,
+                                                    symbols_path ? n_symbols : program.n_entries, profile_path) != 0) {
+        result = -1;
+    }
+
+    if (jit) emu_jit_close(jit);
+    object_free(&program);
+    free(symbols);
+    free(ob_path);
+    free(emu);
+    free(jit);
+    return result == 0 ? 0 : 1;
+}
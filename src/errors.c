@@ -1,5 +1,8 @@
+#define _POSIX_C_SOURCE 200809L /* pthread thread-specific data */
 #include "../include/errors.h"
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 /*
  * =====================================================================================
@@ -8,13 +11,34 @@
  * It provides functions to print error messages based on error codes.
  * Each error code corresponds to a specific error condition, and the messages
  * are designed to help the user understand what went wrong.
+ * Diagnostics can be redirected per thread to a sink (used by the library API).
  * =====================================================================================
  */
 
+/* struct sink_slot_t holds the sink of one thread */
+typedef struct {
+    error_sink_t sink;
+    void *user;
+} sink_slot_t;
+
+static pthread_key_t sink_key;
+static pthread_once_t sink_once = PTHREAD_ONCE_INIT;
+static int sink_key_ok = 0;
+
+static void create_sink_key(void) {
+    sink_key_ok = pthread_key_create(&sink_key, free) == 0;
+}
+
+/* Returns the sink slot of the calling thread, or NULL if none was set. */
+static sink_slot_t *current_sink(void) {
+    pthread_once(&sink_once, create_sink_key);
+    return sink_key_ok ? (sink_slot_t *) pthread_getspecific(sink_key) : NULL;
+}
+
 /* * Returns a string describing the error corresponding to the given error code.
  * If the code is not recognized, it returns "unknown error code".
  */
-static const char *error_message(const int code) {
+const char *error_message(const int code) {
     switch (code) {
         /* success */
         case ERROR_OK: return "no error";
@@ -48,6 +72,8 @@ static const char *error_message(const int code) {
         case ERROR_INVALID_ARGUMENT: return "invalid argument";
         case ERROR_INVALID_ADDRESSING_MODE: return "invalid addressing mode";
         case ERROR_EXPECTED_OPERAND: return "operand expected but not found";
+        case ERROR_TOO_MANY_OPERANDS: return "too many operands for command";
+        case ERROR_INVALID_OPERAND_COUNT_FOR_COMMAND: return "wrong number of operands for command";
         case ERROR_TRAILING_CHARACTERS: return "trailing characters after statement";
         case ERROR_DUPLICATE_LABEL_DEFINITION: return "duplicate label definition";
         case ERROR_FIRST_PASSED: return "first pass failed";
@@ -56,14 +82,69 @@ static const char *error_message(const int code) {
         case ERROR_ENTRY_SYMBOL_NOT_DEFINED: return "entry symbol not defined";
         case ERROR_DUPLICATE_ENTRY_DECLARATION: return "duplicate entry declaration";
 
+        /* linker */
+        case ERROR_INVALID_OBJECT_FILE: return "malformed object file";
+        case ERROR_DUPLICATE_EXPORTED_SYMBOL: return "symbol is an entry of more than one module";
+        case ERROR_UNRESOLVED_EXTERNAL_SYMBOL: return "external symbol is not an entry of any module";
+        case ERROR_INVALID_ARCHIVE: return "malformed archive file";
+        case ERROR_UNKNOWN_ROOT_SYMBOL: return "root symbol is not an entry of any module";
+
+        /* Emulator Errors */
+        case ERROR_PROGRAM_TOO_LARGE: return "program does not fit the 256 word memory";
+        case ERROR_INVALID_INSTRUCTION: return "word is not a valid instruction";
+        case ERROR_UNLINKED_EXTERNAL: return "instruction uses an external symbol that was not linked";
+        case ERROR_ADDRESS_OUT_OF_RANGE: return "address outside the memory";
+        case ERROR_RETURN_STACK: return "return stack overflow or underflow";
+        case ERROR_STEP_LIMIT: return "step limit reached";
+        case ERROR_INVALID_TEST_VECTOR: return "invalid escape sequence in a test vector";
+        case ERROR_JIT_MISMATCH: return "translated code and interpreter disagree";
+        case ERROR_CODE_MODIFIED: return "store into the code of a translated program";
+        case ERROR_UNTRANSLATED_ADDRESS: return "jump to an address outside the translated code";
+
+        /* Cost Estimate Errors */
+        case ERROR_INVALID_COST_TABLE: return "invalid line in the cost table";
+
         default: return "unknown error code";
     }
 }
 
+void set_error_sink(error_sink_t sink, void *user) {
+    sink_slot_t *slot = current_sink();
+
+    if (!slot) {
+        if (!sink || !sink_key_ok) return;
+        slot = malloc(sizeof(*slot));
+        if (!slot) return;
+        if (pthread_setspecific(sink_key, slot) != 0) {
+            free(slot);
+            return;
+        }
+    }
+    slot->sink = sink;
+    slot->user = user;
+}
+
+error_sink_t get_error_sink(void **user) {
+    sink_slot_t *slot = current_sink();
+
+    *user = slot ? slot->user : NULL;
+    return slot ? slot->sink : NULL;
+}
+
 void print_error(int error_code) {
+    sink_slot_t *slot = current_sink();
+    if (slot && slot->sink) {
+        slot->sink(slot->user, NULL, error_code, 0);
+        return;
+    }
     printf("error: %s\n", error_message(error_code));
 }
 
 void print_error_file(const char *file_name, int error_code, int line_number) {
+    sink_slot_t *slot = current_sink();
+    if (slot && slot->sink) {
+        slot->sink(slot->user, file_name, error_code, line_number);
+        return;
+    }
     printf("There is error in %s at line:%d ERROR: %s\n", file_name, line_number, error_message(error_code));
 }
@@ -1,6 +1,8 @@
 #include "../include/symbol_table.h"
 #include "../include/line_parser.h"
 #include "../include/globals.h"
+#include "../include/spill.h"
+#include "../include/profile.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -72,10 +74,12 @@ static void rebase_data_symbols(symbol_table_t *st, int ic_final) {
     symtab_bump_data_addresses(st, ic_final);
 }
 
-/* Public API Functions Implementation */
-
-int first_pass(const char *input_path, symbol_table_t *symtab) {
-    FILE *fp;
+/* Runs the first pass over an opened stream.
+ * input_path only names the source in diagnostics.
+ * When spill is not NULL, statements are also written to the spill files.
+ * Returns the number of errors found.
+ */
+static int run_first_pass(FILE *fp, const char *input_path, symbol_table_t *symtab, spill_t *spill) {
     char line_buf[MAX_LINE_LENGTH];
     parsed_line pl; /* parsed line to used every iteration */
     int line_no = 0;
@@ -86,17 +90,10 @@ int first_pass(const char *input_path, symbol_table_t *symtab) {
     symbol_t *symbol = NULL;
     error_code_t st;
     int ok;
+    int words;
     char *name;
 
-    if (!input_path || !symtab) return -1;
-
-    fp = fopen(input_path, "r");
-    if (!fp) {
-        print_error_file(input_path, ERROR_CANNOT_OPEN_FILE, 0);
-        return -1;
-    }
-
-    while (fgets(line_buf, sizeof(line_buf), fp)) {
+    while (prof_fgets(line_buf, sizeof(line_buf), fp)) {
         line_no++;
 
         memset(&pl, 0, sizeof(pl));
@@ -141,7 +138,12 @@ int first_pass(const char *input_path, symbol_table_t *symtab) {
 
         /* handle the statement body to update ic */
         if (pl.kind == LINE_OPERATION) {
-            ic += calc_instruction_words(&pl);
+            words = calc_instruction_words(&pl);
+            if (spill && spill_put_instruction(spill, &pl, line_no, words) != 0) {
+                print_error_file(input_path, ERROR_WRITE_FAILED, line_no);
+                errors++;
+            }
+            ic += words;
             continue;
         }
 
@@ -151,6 +153,10 @@ int first_pass(const char *input_path, symbol_table_t *symtab) {
             case STRING_DIRECTIVE:
             case MATRIX_DIRECTIVE:
                 dc += calc_directive_words(&pl);
+                if (spill && spill_put_data(spill, &pl) != 0) {
+                    print_error_file(input_path, ERROR_WRITE_FAILED, line_no);
+                    errors++;
+                }
                 break;
 
             case EXTERN_DIRECTIVE:
@@ -184,8 +190,6 @@ int first_pass(const char *input_path, symbol_table_t *symtab) {
         }
     }
 
-    fclose(fp);
-
     /* rebase data symbols so they start right after the code image. */
     rebase_data_symbols(symtab, ic);
 
@@ -209,3 +213,31 @@ int first_pass(const char *input_path, symbol_table_t *symtab) {
 
     return errors;
 }
+
+/* Public API Functions Implementation */
+
+int first_pass(const char *input_path, symbol_table_t *symtab) {
+    return first_pass_spill(input_path, symtab, NULL);
+}
+
+int first_pass_spill(const char *input_path, symbol_table_t *symtab, spill_t *spill) {
+    FILE *fp;
+    int errors;
+
+    if (!input_path || !symtab) return -1;
+
+    fp = fopen(input_path, "r");
+    if (!fp) {
+        print_error_file(input_path, ERROR_CANNOT_OPEN_FILE, 0);
+        return -1;
+    }
+
+    errors = run_first_pass(fp, input_path, symtab, spill);
+    fclose(fp);
+    return errors;
+}
+
+int first_pass_stream(FILE *fp, const char *source_name, symbol_table_t *symtab) {
+    if (!fp || !source_name || !symtab) return -1;
+    return run_first_pass(fp, source_name, symtab, NULL);
+}
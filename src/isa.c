@@ -0,0 +1,106 @@
+#include "../include/isa.h"
+
+/*
+ * =====================================================================================
+ * Filename:  isa.c
+ * Description: Decodes first words of instructions. The operand counts mirror the
+ * opcode table of the line parser and the lengths mirror encode_instruction:
+ * immediate, direct and register operands take one word, a matrix access two,
+ * and two register operands share a single word.
+ * =====================================================================================
+ */
+
+#define OPCODE_COUNT 16
+
+static const char *const MNEMONICS[OPCODE_COUNT] = {
+    "mov", "cmp", "add", "sub", "lea", "clr", "not", "inc",
+    "dec", "jmp", "bne", "jsr", "red", "prn", "rts", "stop"
+};
+
+/* --- Private Helper Functions --- */
+
+/* Words taken by one operand that does not share its word. */
+static int operand_words(const addressing_mode_t mode) {
+    return mode == MATRIX_ACCESS ? 2 : 1;
+}
+
+/* Memory words accessed through an operand of the given mode, accesses is the
+ * number of reads and writes the opcode makes through it.
+ */
+static int memory_accesses(const addressing_mode_t mode, const int accesses) {
+    return (mode == DIRECT || mode == MATRIX_ACCESS) ? accesses : 0;
+}
+
+/* --- Public API Functions Implementation --- */
+
+int isa_operand_count(const op_code_t opcode) {
+    if (opcode <= LEA_OP) return 2;
+    if (opcode <= PRN_OP) return 1;
+    return 0;
+}
+
+int isa_decode(const WORD w, instruction_t *out) {
+    out->opcode = (op_code_t) WORD_OPCODE(w);
+    out->n_operands = isa_operand_count(out->opcode);
+    out->src_mode = (addressing_mode_t) WORD_SRC_MODE(w);
+    out->dst_mode = (addressing_mode_t) WORD_DST_MODE(w);
+
+    if (WORD_ARE(w) != ARE_A || (w & ~WORD_MASK) != 0) return -1;
+    /* unused mode fields are encoded as 0 */
+    if (out->n_operands < 2 && out->src_mode != IMMEDIATE) return -1;
+    if (out->n_operands < 1 && out->dst_mode != IMMEDIATE) return -1;
+
+    switch (out->n_operands) {
+        case 2:
+            if (out->src_mode == REGISTER_DIRECT && out->dst_mode == REGISTER_DIRECT) {
+                out->length = 2;
+            } else {
+                out->length = 1 + operand_words(out->src_mode) + operand_words(out->dst_mode);
+            }
+            break;
+        case 1:
+            out->length = 1 + operand_words(out->dst_mode);
+            break;
+        default:
+            out->length = 1;
+            break;
+    }
+    return 0;
+}
+
+int isa_cycles(const instruction_t *ins) {
+    int cycles = ins->length;
+
+    switch (ins->opcode) {
+        case MOV_OP:
+        case CMP_OP:
+            cycles += memory_accesses(ins->src_mode, 1) + memory_accesses(ins->dst_mode, 1);
+            break;
+        case ADD_OP:
+        case SUB_OP:
+            cycles += memory_accesses(ins->src_mode, 1) + memory_accesses(ins->dst_mode, 2);
+            break;
+        case LEA_OP:
+        case CLR_OP:
+        case RED_OP:
+        case PRN_OP:
+            cycles += memory_accesses(ins->dst_mode, 1); /* lea only computes its source address */
+            break;
+        case NOT_OP:
+        case INC_OP:
+        case DEC_OP:
+            cycles += memory_accesses(ins->dst_mode, 2);
+            break;
+        case JSR_OP:
+        case RTS_OP:
+            cycles += 1;
+            break;
+        default:
+            break; /* jmp and bne only compute their target */
+    }
+    return cycles;
+}
+
+const char *isa_mnemonic(const int opcode) {
+    return (opcode >= 0 && opcode < OPCODE_COUNT) ? MNEMONICS[opcode] : "?";
+}
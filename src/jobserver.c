@@ -0,0 +1,160 @@
+#define _POSIX_C_SOURCE 200809L /* poll, fcntl, read/write */
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../include/jobserver.h"
+
+/*
+ * =====================================================================================
+ * Filename:  jobserver.c
+ * Description: GNU make jobserver client.
+ * Reads must never block a worker forever: a worker waiting for a token has to
+ * notice that the remaining files were taken by the others. The inherited pipe is
+ * shared with make and its other children, so instead of changing its flags the
+ * read end is reopened through /proc with O_NONBLOCK and polled. A pipe that can
+ * only be read blocking is not used.
+ * =====================================================================================
+ */
+
+#define AUTH_OPTION "--jobserver-auth="
+#define FDS_OPTION "--jobserver-fds=" /* make before 4.2 */
+#define FIFO_PREFIX "fifo:"
+
+/* --- Private Helper Functions --- */
+
+/* Returns a pointer to the value of the last occurrence of option in flags,
+ * or NULL. make may repeat the option, the last one wins.
+ */
+static const char *find_last_option(const char *flags, const char *option) {
+    const char *found = NULL;
+    const char *p = flags;
+
+    while ((p = strstr(p, option)) != NULL) {
+        p += strlen(option);
+        found = p;
+    }
+    return found;
+}
+
+/* Returns nonzero if fd is an open descriptor. */
+static int fd_is_open(int fd) {
+    return fd >= 0 && fcntl(fd, F_GETFD) != -1;
+}
+
+/* Opens a private non blocking descriptor on the same pipe as fd.
+ * Returns the new descriptor, or -1 if the platform does not allow it.
+ */
+static int reopen_nonblocking(int fd) {
+    char path[32];
+    sprintf(path, "/proc/self/fd/%d", fd);
+    return open(path, O_RDONLY | O_NONBLOCK);
+}
+
+/* Connects to a fifo style jobserver. */
+static jobserver_status_t connect_fifo(jobserver_t *js, const char *value) {
+    char *path;
+    size_t len;
+    int fd;
+
+    len = strcspn(value, " ");
+    path = malloc(len + 1);
+    if (!path) return JOBSERVER_UNUSABLE;
+    memcpy(path, value, len);
+    path[len] = '\0';
+
+    /* O_RDWR never blocks on a fifo, one descriptor serves both directions */
+    fd = open(path, O_RDWR | O_NONBLOCK);
+    free(path);
+    if (fd < 0) return JOBSERVER_UNUSABLE;
+
+    js->read_fd = fd;
+    js->write_fd = fd;
+    js->owns_read_fd = 1;
+    js->owns_write_fd = 0;
+    return JOBSERVER_CONNECTED;
+}
+
+/* Connects to a pipe style jobserver given as "R,W". */
+static jobserver_status_t connect_pipe(jobserver_t *js, const char *value) {
+    int r, w, fd;
+
+    if (sscanf(value, "%d,%d", &r, &w) != 2) return JOBSERVER_UNUSABLE;
+    if (!fd_is_open(r) || !fd_is_open(w)) return JOBSERVER_UNUSABLE; /* recipe lacks '+' */
+
+    /* a blocking read would keep a worker waiting after the files ran out,
+     * so without a non blocking descriptor only the implicit token is used
+     */
+    fd = reopen_nonblocking(r);
+    if (fd < 0 && !(fcntl(r, F_GETFL) & O_NONBLOCK)) return JOBSERVER_UNUSABLE;
+    js->read_fd = fd >= 0 ? fd : r; /* make already shares it non blocking */
+    js->owns_read_fd = fd >= 0;
+    js->write_fd = w;
+    js->owns_write_fd = 0;
+    return JOBSERVER_CONNECTED;
+}
+
+/* --- Public API Functions Implementation --- */
+
+jobserver_status_t jobserver_connect(jobserver_t *js) {
+    const char *flags;
+    const char *value;
+
+    if (!js) return JOBSERVER_NONE;
+    memset(js, 0, sizeof(*js));
+    js->read_fd = -1;
+    js->write_fd = -1;
+
+    flags = getenv("MAKEFLAGS");
+    if (!flags) return JOBSERVER_NONE;
+
+    value = find_last_option(flags, AUTH_OPTION);
+    if (!value) value = find_last_option(flags, FDS_OPTION);
+    if (!value) return JOBSERVER_NONE;
+
+    if (strncmp(value, FIFO_PREFIX, strlen(FIFO_PREFIX)) == 0) {
+        return connect_fifo(js, value + strlen(FIFO_PREFIX));
+    }
+    return connect_pipe(js, value);
+}
+
+void jobserver_disconnect(jobserver_t *js) {
+    if (!js) return;
+    if (js->owns_read_fd && js->read_fd >= 0) close(js->read_fd);
+    if (js->owns_write_fd && js->write_fd >= 0) close(js->write_fd);
+    js->read_fd = -1;
+    js->write_fd = -1;
+}
+
+int jobserver_acquire(jobserver_t *js, unsigned char *token, int (*keep_waiting)(void *), void *arg) {
+    struct pollfd pfd;
+    ssize_t n;
+
+    if (!js || !token || js->read_fd < 0) return -1;
+
+    for (;;) {
+        if (keep_waiting && !keep_waiting(arg)) return -1;
+
+        n = read(js->read_fd, token, 1);
+        if (n == 1) return 0;
+        if (n == 0) return -1; /* make closed the jobserver */
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) return -1;
+
+        pfd.fd = js->read_fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        poll(&pfd, 1, JOBSERVER_POLL_MS);
+    }
+}
+
+void jobserver_release(jobserver_t *js, unsigned char token) {
+    ssize_t n;
+
+    if (!js || js->write_fd < 0) return;
+    do {
+        n = write(js->write_fd, &token, 1);
+    } while (n < 0 && errno == EINTR);
+}
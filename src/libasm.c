@@ -0,0 +1,186 @@
+#define _POSIX_C_SOURCE 200809L /* fmemopen, open_memstream */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/libasm.h"
+#include "../include/macro.h"
+#include "../include/symbol_table.h"
+#include "../include/util_vec.h"
+
+/*
+ * =====================================================================================
+ * Filename:  libasm.c
+ * Description: In-memory front end of the assembler.
+ * The source buffer is read through fmemopen and the preprocessed text is kept in
+ * an open_memstream buffer, so the same preprocessor and passes used for files run
+ * without touching the filesystem. Diagnostics are captured with a per thread
+ * error sink instead of being printed.
+ * =====================================================================================
+ */
+
+/* --- Private Helper Functions --- */
+
+/* Error sink collecting the diagnostics into a vector of asm_diagnostic_t. */
+static void collect_diagnostic(void *user, const char *file_name, int error_code, int line_number) {
+    vec_t *diags = user;
+    asm_diagnostic_t d;
+    (void) file_name;
+
+    d.code = (error_code_t) error_code;
+    d.line = line_number;
+    d.message = error_message(error_code);
+    vec_push(diags, &d); /* a diagnostic lost for lack of memory still fails the assembly */
+}
+
+/* Clears the bits above the 10 bit machine word, as the .ob file does. */
+static void mask_words(WORD *words, int len) {
+    int i;
+    for (i = 0; i < len; i++) {
+        words[i] &= WORD_MASK;
+    }
+}
+
+/* Copies the entry symbols in the order of the .ent file.
+ * Returns 0 on success, -1 on allocation failure.
+ */
+static int collect_entries(symbol_table_t *symtab, asm_result_t *result) {
+    hash_entry_t *it;
+    symbol_t *sym;
+    vec_t entries;
+    asm_symbol_t e;
+
+    vec_create(&entries, sizeof(asm_symbol_t));
+    for (it = hash_get_next(symtab, NULL); it; it = hash_get_next(symtab, it)) {
+        sym = (symbol_t *) it->value;
+        if (!sym || !(sym->flags & SYM_ENTRY)) continue;
+        strncpy(e.name, sym->name, MAX_LABEL_LENGTH - 1);
+        e.name[MAX_LABEL_LENGTH - 1] = '\0';
+        e.address = sym->address;
+        if (vec_push(&entries, &e) != 0) {
+            vec_destroy(&entries);
+            return -1;
+        }
+    }
+    result->entries = vec_take(&entries, &result->n_entries);
+    return 0;
+}
+
+/* Runs the preprocessor and both passes on the source.
+ * Returns 0 on success, -1 on failure.
+ */
+static int assemble(const char *source_name, const char *src, size_t len, asm_result_t *result) {
+    FILE *in;
+    FILE *am;
+    char *am_buf = NULL;
+    size_t am_len = 0;
+    symbol_table_t *symtab;
+    second_pass_ctx_t ctx;
+    int status;
+
+    /* fmemopen rejects empty buffers, an empty source is an empty program */
+    if (len == 0) return 0;
+
+    in = fmemopen((void *) src, len, "r");
+    am = open_memstream(&am_buf, &am_len);
+    if (!in || !am) {
+        if (in) fclose(in);
+        if (am) fclose(am);
+        free(am_buf);
+        print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+        return -1;
+    }
+    status = preprocess_stream(in, am);
+    fclose(in);
+    if (fclose(am) != 0 || status != 0) {
+        free(am_buf);
+        print_error(ERROR_FAILED_PREPROCESSING);
+        return -1;
+    }
+    if (am_len == 0) {
+        free(am_buf);
+        return 0;
+    }
+
+    in = fmemopen(am_buf, am_len, "r");
+    symtab = symtab_create();
+    if (!in || !symtab) {
+        if (in) fclose(in);
+        if (symtab) symtab_destroy(symtab);
+        free(am_buf);
+        print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+        return -1;
+    }
+
+    status = first_pass_stream(in, source_name, symtab) != 0 ? -1 : 0;
+    if (status == 0) {
+        rewind(in);
+        status = second_pass_stream(in, source_name, symtab, &ctx);
+        if (status == 0 && collect_entries(symtab, result) != 0) {
+            print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+            status = -1;
+        }
+        if (status == 0) {
+            result->code = vec_take(&ctx.code_image, &result->code_len);
+            result->data = vec_take(&ctx.data_image, &result->data_len);
+            mask_words(result->code, result->code_len);
+            mask_words(result->data, result->data_len);
+            result->externals = vec_take(&ctx.ext_list, &result->n_externals);
+        }
+        second_pass_ctx_destroy(&ctx);
+    } else {
+        print_error(ERROR_FIRST_PASSED);
+    }
+
+    fclose(in);
+    symtab_destroy(symtab);
+    free(am_buf);
+    return status;
+}
+
+/* --- Public API Functions Implementation --- */
+
+asm_ctx_t *asm_ctx_create(void) {
+    asm_ctx_t *ctx = malloc(sizeof(asm_ctx_t));
+    if (!ctx) return NULL;
+    ctx->source_name = ASM_DEFAULT_SOURCE_NAME;
+    return ctx;
+}
+
+void asm_ctx_destroy(asm_ctx_t *ctx) {
+    free(ctx);
+}
+
+int asm_assemble_buffer(asm_ctx_t *ctx, const char *src, size_t len, asm_result_t *result) {
+    vec_t diags;
+    error_sink_t caller_sink;
+    void *caller_user;
+    size_t n_reported;
+    int status;
+
+    if (!result) return -1;
+    memset(result, 0, sizeof(*result));
+    if (!ctx || (!src && len > 0)) return -1;
+
+    vec_create(&diags, sizeof(asm_diagnostic_t));
+    caller_sink = get_error_sink(&caller_user);
+    set_error_sink(collect_diagnostic, &diags);
+    status = assemble(ctx->source_name, src, len, result);
+    set_error_sink(caller_sink, caller_user);
+
+    n_reported = diags.len;
+    result->diagnostics = vec_take(&diags, &result->n_diagnostics);
+    if (status != 0 || n_reported > 0) {
+        status = -1;
+    }
+    return status;
+}
+
+void asm_result_free(asm_result_t *result) {
+    if (!result) return;
+    free(result->code);
+    free(result->data);
+    free(result->entries);
+    free(result->externals);
+    free(result->diagnostics);
+    memset(result, 0, sizeof(*result));
+}
@@ -1,4 +1,5 @@
 #include "../include/line_parser.h"
+#include "../include/profile.h"
 #include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
@@ -211,13 +212,17 @@ static const opcode_desc_t OPCODES[] = {
  */
 static op_code_t lookup_opcode_by_mnemonic(const char *tok, int *out_required) {
     int i;
+    sig_atomic_t saved;
+    PROF_ENTER(saved, PROF_ACT_OPCODE_LOOKUP);
     for (i = 0; OPCODES[i].mnemonic; ++i) {
         if (strcmp(OPCODES[i].mnemonic, tok) == 0) {
             *out_required = OPCODES[i].required_operands;
+            PROF_LEAVE(saved);
             return OPCODES[i].opcode;
         }
     }
     *out_required = 0;
+    PROF_LEAVE(saved);
     return UNKNOWN_OP;
 }
 
@@ -226,12 +231,16 @@ static op_code_t lookup_opcode_by_mnemonic(const char *tok, int *out_required) {
  * The returned value can be used to determine the type of directive.
  */
 static directive_t lookup_directive_by_token(const char *tok) {
-    if (strcmp(tok, ".data") == 0) return DATA_DIRECTIVE;
-    if (strcmp(tok, ".string") == 0) return STRING_DIRECTIVE;
-    if (strcmp(tok, ".mat") == 0) return MATRIX_DIRECTIVE;
-    if (strcmp(tok, ".entry") == 0) return ENTRY_DIRECTIVE;
-    if (strcmp(tok, ".extern") == 0) return EXTERN_DIRECTIVE;
-    return (directive_t) -1;
+    directive_t d = (directive_t) -1;
+    sig_atomic_t saved;
+    PROF_ENTER(saved, PROF_ACT_OPCODE_LOOKUP);
+    if (strcmp(tok, ".data") == 0) d = DATA_DIRECTIVE;
+    else if (strcmp(tok, ".string") == 0) d = STRING_DIRECTIVE;
+    else if (strcmp(tok, ".mat") == 0) d = MATRIX_DIRECTIVE;
+    else if (strcmp(tok, ".entry") == 0) d = ENTRY_DIRECTIVE;
+    else if (strcmp(tok, ".extern") == 0) d = EXTERN_DIRECTIVE;
+    PROF_LEAVE(saved);
+    return d;
 }
 
 /* -- directive parsers -- */
@@ -449,6 +458,20 @@ static error_code_t parse_directive_operand(char *cursor, parsed_line *out) {
 static error_code_t parse_instruction_operands(char *cursor, parsed_line *out, int required_operands) {
     char *token;
     error_code_t error;
+    const char *p;
+    int given = 0;
+
+    /* count the operands first: operands are comma separated and never contain commas */
+    if (*skip_leading_whitespace(cursor)) {
+        given = 1;
+        for (p = cursor; *p; ++p) {
+            if (*p == ',') given++;
+        }
+    }
+    if (given > required_operands) {
+        return required_operands == 0 ? ERROR_INVALID_OPERAND_COUNT_FOR_COMMAND : ERROR_TOO_MANY_OPERANDS;
+    }
+    if (given < required_operands) return ERROR_INVALID_OPERAND_COUNT_FOR_COMMAND;
 
     out->body.operation.n_operands = required_operands;
 
@@ -469,7 +492,8 @@ static error_code_t parse_instruction_operands(char *cursor, parsed_line *out, i
     return next_token(&cursor, " \t\n\r") ? ERROR_TRAILING_CHARACTERS : ERROR_OK;
 }
 
-error_code_t parse_line(char *line, parsed_line *out) {
+/* Body of parse_line, see line_parser.h. */
+static error_code_t parse_line_body(char *line, parsed_line *out) {
     char working_copy[MAX_LINE_LENGTH];
     char *cursor, *token;
     int token_len, required_operands;
@@ -500,6 +524,8 @@ error_code_t parse_line(char *line, parsed_line *out) {
     /* Handle label if present */
     if (token_len > 0 && token[token_len - 1] == ':') {
         token[token_len - 1] = '\0';
+        /* empty or too long is a syntax error, bad characters or a keyword make it illegal */
+        if (token_len == 1 || token_len - 1 >= MAX_LABEL_LENGTH) return ERROR_INVALID_LABEL;
         if (!is_valid_label(token)) return ERROR_ILLEGAL_LABEL;
         strcpy(out->label, token);
         token = next_token(&cursor, " \t\n\r");
@@ -524,3 +550,13 @@ error_code_t parse_line(char *line, parsed_line *out) {
 
     return validate_addressing_modes(out);
 }
+
+error_code_t parse_line(char *line, parsed_line *out) {
+    error_code_t error;
+    sig_atomic_t saved;
+
+    PROF_ENTER(saved, PROF_ACT_LEXING);
+    error = parse_line_body(line, out);
+    PROF_LEAVE(saved);
+    return error;
+}
@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/link_state.h"
+#include "../include/errors.h"
+
+/*
+ * =====================================================================================
+ * Filename:  link_state.c
+ * Description: Reads and writes link-state files. The file is text, one record per
+ * line: a header with the image lengths and the record counts, then the archives
+ * ("A"), the modules ("M"), the symbols ("S") and the patch sites ("X"). Names and
+ * paths come last on their line so they may hold spaces.
+ * =====================================================================================
+ */
+
+#define LINK_STATE_MAGIC "ASMLINK1"
+#define LINK_STATE_LINE_LENGTH 4096 /* longest name or path in a record */
+
+/* --- Private Helper Functions --- */
+
+/* Reads the rest of a record, after its separating space, as a name.
+ * Returns a new string, or NULL if the line is empty or too long.
+ */
+static char *read_name(FILE *fp) {
+    char line[LINK_STATE_LINE_LENGTH];
+    size_t len;
+
+    if (fgetc(fp) != ' ' || !fgets(line, sizeof(line), fp)) return NULL;
+    len = strlen(line);
+    if (len == 0 || line[len - 1] != '\n') return NULL;
+    line[--len] = '\0';
+    return len > 0 ? dupstr(line) : NULL;
+}
+
+/* Skips white space and checks the tag that starts a record. */
+static int read_tag(FILE *fp, const char tag) {
+    char c;
+
+    return (fscanf(fp, " %c", &c) == 1 && c == tag) ? 0 : -1;
+}
+
+static int read_key(FILE *fp, content_key_t *key) {
+    return fscanf(fp, "%lu %lu %lu", &key->len, &key->fnv, &key->djb) == 3 ? 0 : -1;
+}
+
+static void write_key(FILE *fp, const content_key_t *key) {
+    fprintf(fp, " %lu %lu %lu", key->len, key->fnv, key->djb);
+}
+
+/* Reads the archive and module records. */
+static int read_inputs(FILE *fp, link_state_t *state) {
+    link_module_t *m;
+    int i, k, image_end = ADDRESS_BASE + state->code_len + state->data_len;
+
+    for (i = 0; i < state->n_archives; i++) {
+        if (read_tag(fp, 'A') != 0 || read_key(fp, &state->archives[i].key) != 0) return -1;
+        state->archives[i].path = read_name(fp);
+        if (!state->archives[i].path) return -1;
+    }
+    for (i = 0; i < state->n_modules; i++) {
+        m = &state->modules[i];
+        if (read_tag(fp, 'M') != 0 ||
+            fscanf(fp, "%d %d %d %d %d %d", &m->from_archive, &m->code_base, &m->code_slot, &m->data_base,
+                   &m->data_slot, &m->n_entries) != 6) {
+            return -1;
+        }
+        for (k = 0; k < LINK_STATE_FILES; k++) {
+            if (read_key(fp, &m->keys[k]) != 0) return -1;
+        }
+        m->name = read_name(fp);
+        if (!m->name || m->code_slot < 0 || m->data_slot < 0 || m->n_entries < 0 ||
+            m->code_base < ADDRESS_BASE || m->code_base + m->code_slot > ADDRESS_BASE + state->code_len ||
+            m->data_base < ADDRESS_BASE + state->code_len || m->data_base + m->data_slot > image_end) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Reads the symbol and site records. */
+static int read_symbols(FILE *fp, link_state_t *state) {
+    link_symbol_t *s;
+    link_site_t *x;
+    char *name;
+    int i;
+
+    for (i = 0; i < state->n_symbols; i++) {
+        s = &state->symbols[i];
+        if (read_tag(fp, 'S') != 0 || fscanf(fp, "%d %d", &s->module, &s->address) != 2 ||
+            s->address < ADDRESS_BASE || s->address >= ADDRESS_BASE + state->code_len + state->data_len) {
+            return -1;
+        }
+        name = read_name(fp);
+        if (!name || strlen(name) >= MAX_LABEL_LENGTH || s->module < 0 || s->module >= state->n_modules) {
+            free(name);
+            return -1;
+        }
+        strcpy(s->name, name);
+        free(name);
+    }
+    for (i = 0; i < state->n_sites; i++) {
+        x = &state->sites[i];
+        if (read_tag(fp, 'X') != 0 || fscanf(fp, "%d %d %d", &x->module, &x->symbol, &x->address) != 3 ||
+            x->module < 0 || x->module >= state->n_modules || x->symbol < 0 || x->symbol >= state->n_symbols ||
+            x->address < ADDRESS_BASE || x->address >= ADDRESS_BASE + state->code_len) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* --- Public API Functions Implementation --- */
+
+int link_module_keys(const char *base_name, content_key_t keys[LINK_STATE_FILES]) {
+    static const char *const endings[LINK_STATE_FILES] = {".ob", ".ent", ".ext"};
+    char *path;
+    int k;
+
+    for (k = 0; k < LINK_STATE_FILES; k++) {
+        path = create_file_path(base_name, endings[k]);
+        if (!path) return -1;
+        if (content_key_file(path, &keys[k]) != 0) memset(&keys[k], 0, sizeof(keys[k]));
+        free(path);
+    }
+    return 0;
+}
+
+int link_state_read(const char *path, link_state_t *state) {
+    FILE *fp;
+    char magic[sizeof(LINK_STATE_MAGIC)];
+    int result = -1;
+
+    memset(state, 0, sizeof(*state));
+    fp = fopen(path, "r");
+    if (!fp) return -1;
+
+    if (fscanf(fp, "%8s %d %d %d %d %d %d", magic, &state->code_len, &state->data_len, &state->n_archives,
+               &state->n_modules, &state->n_symbols, &state->n_sites) == 7 &&
+        strcmp(magic, LINK_STATE_MAGIC) == 0 && state->code_len >= 0 && state->data_len >= 0 &&
+        state->n_archives >= 0 && state->n_modules >= 0 && state->n_symbols >= 0 && state->n_sites >= 0) {
+        state->archives = calloc((size_t) state->n_archives + 1, sizeof(link_input_t));
+        state->modules = calloc((size_t) state->n_modules + 1, sizeof(link_module_t));
+        state->symbols = calloc((size_t) state->n_symbols + 1, sizeof(link_symbol_t));
+        state->sites = calloc((size_t) state->n_sites + 1, sizeof(link_site_t));
+        if (state->archives && state->modules && state->symbols && state->sites &&
+            read_inputs(fp, state) == 0 && read_symbols(fp, state) == 0) {
+            result = 0;
+        }
+    }
+
+    fclose(fp);
+    if (result != 0) link_state_free(state);
+    return result;
+}
+
+int link_state_write(const char *path, const link_state_t *state) {
+    FILE *fp;
+    const link_module_t *m;
+    int i, k, n_sites = 0;
+
+    fp = fopen(path, "w");
+    if (!fp) return -1;
+
+    for (i = 0; i < state->n_sites; i++) {
+        if (state->sites[i].symbol >= 0) n_sites++;
+    }
+    fprintf(fp, "%s %d %d %d %d %d %d\n", LINK_STATE_MAGIC, state->code_len, state->data_len, state->n_archives,
+            state->n_modules, state->n_symbols, n_sites);
+    for (i = 0; i < state->n_archives; i++) {
+        fprintf(fp, "A");
+        write_key(fp, &state->archives[i].key);
+        fprintf(fp, " %s\n", state->archives[i].path);
+    }
+    for (i = 0; i < state->n_modules; i++) {
+        m = &state->modules[i];
+        fprintf(fp, "M %d %d %d %d %d %d", m->from_archive, m->code_base, m->code_slot, m->data_base, m->data_slot,
+                m->n_entries);
+        for (k = 0; k < LINK_STATE_FILES; k++) write_key(fp, &m->keys[k]);
+        fprintf(fp, " %s\n", m->name);
+    }
+    for (i = 0; i < state->n_symbols; i++) {
+        fprintf(fp, "S %d %d %s\n", state->symbols[i].module, state->symbols[i].address, state->symbols[i].name);
+    }
+    for (i = 0; i < state->n_sites; i++) {
+        if (state->sites[i].symbol < 0) continue;
+        fprintf(fp, "X %d %d %d\n", state->sites[i].module, state->sites[i].symbol, state->sites[i].address);
+    }
+
+    k = ferror(fp);
+    return (fclose(fp) == 0 && !k) ? 0 : -1;
+}
+
+void link_state_free(link_state_t *state) {
+    int i;
+
+    if (!state) return;
+    for (i = 0; state->archives && i < state->n_archives; i++) free(state->archives[i].path);
+    for (i = 0; state->modules && i < state->n_modules; i++) free(state->modules[i].name);
+    free(state->archives);
+    free(state->modules);
+    free(state->symbols);
+    free(state->sites);
+    memset(state, 0, sizeof(*state));
+}
@@ -0,0 +1,618 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../include/linker.h"
+#include "../include/errors.h"
+#include "../include/util_hash.h"
+#include "../include/util_pool.h"
+
+/*
+ * =====================================================================================
+ * Filename:  linker.c
+ * Description: Core of the linker. Every module gets a code base and a data base in
+ * the image, its words are copied there and its relocatable words are moved by the
+ * offset of their section. External usages are resolved with a hash join: the
+ * entries of all modules are inserted into one hash table (build side) and every
+ * .ext usage probes it, so linking is linear in the size of the modules.
+ * The patch phase (copying, relocating and resolving) can run on a worker pool:
+ * every module only writes its own slots, and the diagnostics of every module are
+ * recorded and reported afterwards in module order, as a serial link would.
+ * =====================================================================================
+ */
+
+#define LINK_BATCHES_PER_WORKER 8 /* batches of modules handed out per worker, for balance */
+
+/* struct module_layout_t is where a module lands in the image. */
+typedef struct {
+    int code_base; /* image address of the first code word */
+    int data_base; /* image address of the first data word */
+} module_layout_t;
+
+/* struct link_diag_t is a diagnostic on a line of the .ext file of a module. */
+typedef struct {
+    error_code_t code;
+    int line;
+} link_diag_t;
+
+/* struct patch_job_t is the shared state of the patch phase. */
+typedef struct {
+    const object_t *modules;
+    const module_layout_t *layout;
+    const hash_table_t *globals; /* only read by the workers */
+    WORD *words; /* image words, every module writes its own slots only */
+    const int *batch_first; /* first module of every batch, one past the last batch included */
+    link_diag_t *diags; /* room for one diagnostic per external of every module */
+    const long *diag_first; /* first diagnostic slot of every module */
+    int *n_diags; /* diagnostics recorded per module */
+} patch_job_t;
+
+/* --- Private Helper Functions --- */
+
+/* Maps an address of a module to the image: code addresses move with the code,
+ * the others with the data that follows it.
+ */
+static int relocate(const object_t *m, const module_layout_t *lay, const int address) {
+    if (address < ADDRESS_BASE + m->code_len) {
+        return address - ADDRESS_BASE + lay->code_base;
+    }
+    return address - ADDRESS_BASE - m->code_len + lay->data_base;
+}
+
+/* Returns 1 if an image of these lengths fits the addresses of the machine. */
+static int fits_image(const long code_len, const long data_len) {
+    return code_len >= 0 && data_len >= 0 && ADDRESS_BASE + code_len + data_len <= IMAGE_LENGTH;
+}
+
+/* Returns 1 if every slot and usage site of a link state lies inside its image. */
+static int state_fits(const link_state_t *state) {
+    const int end = ADDRESS_BASE + state->code_len + state->data_len;
+    const link_module_t *lm;
+    int i;
+
+    if (!fits_image(state->code_len, state->data_len)) return 0;
+    for (i = 0; i < state->n_modules; i++) {
+        lm = &state->modules[i];
+        if (lm->code_base < ADDRESS_BASE || lm->code_slot < 0 || lm->code_base + lm->code_slot > end ||
+            lm->data_base < ADDRESS_BASE || lm->data_slot < 0 || lm->data_base + lm->data_slot > end) {
+            return 0;
+        }
+    }
+    for (i = 0; i < state->n_sites; i++) {
+        if (state->sites[i].address < ADDRESS_BASE || state->sites[i].address >= end) return 0;
+    }
+    return 1;
+}
+
+/* Gives every module its code slot and its data slot, in module order. */
+static void lay_out(const object_t *modules, const int n_modules, const int code_len, module_layout_t *layout) {
+    int m, code_at = ADDRESS_BASE, data_at = ADDRESS_BASE + code_len;
+
+    for (m = 0; m < n_modules; m++) {
+        layout[m].code_base = code_at;
+        layout[m].data_base = data_at;
+        code_at += modules[m].code_len;
+        data_at += modules[m].data_len;
+    }
+}
+
+/* Reports an error on a line of the .ent or .ext file of a module. */
+static void report(const object_t *m, const char *ending, const error_code_t code, const int line) {
+    char *path = create_file_path(m->name ? m->name : "", ending);
+
+    print_error_file(path ? path : ending, code, line);
+    free(path);
+}
+
+/* Copies the words of a module into the image and relocates its ARE_R code words.
+ * Data words are plain values and are never relocated.
+ */
+static void place_module(const object_t *m, const module_layout_t *lay, WORD *image_words) {
+    WORD *code = image_words + (lay->code_base - ADDRESS_BASE);
+    WORD w;
+    int i;
+
+    for (i = 0; i < m->code_len; i++) {
+        w = m->words[i];
+        if ((w & 3) == ARE_R) {
+            w = (WORD) (((relocate(m, lay, w >> 2) << 2) | ARE_R) & WORD_MASK);
+        }
+        code[i] = w;
+    }
+    if (m->data_len > 0) {
+        memcpy(image_words + (lay->data_base - ADDRESS_BASE), m->words + m->code_len,
+               (size_t) m->data_len * sizeof(WORD));
+    }
+}
+
+/* Inserts the relocated entries of every module into the global table.
+ * The table points into image->entries, which is allocated up front.
+ */
+static int build_entries(const object_t *modules, int n_modules, const module_layout_t *layout,
+                         hash_table_t *globals, object_t *image) {
+    obj_symbol_t *sym;
+    int m, i, errors = 0;
+
+    for (m = 0; m < n_modules; m++) {
+        for (i = 0; i < modules[m].n_entries; i++) {
+            if (hash_get(globals, modules[m].entries[i].name)) {
+                report(&modules[m], ".ent", ERROR_DUPLICATE_EXPORTED_SYMBOL, i + 1);
+                errors++;
+                continue;
+            }
+            sym = &image->entries[image->n_entries];
+            *sym = modules[m].entries[i];
+            sym->address = relocate(&modules[m], &layout[m], sym->address);
+            if (hash_put(globals, sym->name, sym) != 0) {
+                print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+                return -1;
+            }
+            image->n_entries++;
+        }
+    }
+    return errors ? -1 : 0;
+}
+
+/* Patches every external usage site of a module with the address of its entry.
+ * Problems are recorded in diags, reported later in module order.
+ * Returns the number of diagnostics recorded.
+ */
+static int resolve_externals(const object_t *m, const module_layout_t *lay, const hash_table_t *globals,
+                             WORD *image_words, link_diag_t *diags) {
+    const obj_symbol_t *u, *def;
+    int i, n_diags = 0;
+
+    for (i = 0; i < m->n_externals; i++) {
+        u = &m->externals[i];
+        if (u->address < ADDRESS_BASE || u->address >= ADDRESS_BASE + m->code_len) {
+            diags[n_diags].code = ERROR_INVALID_OBJECT_FILE; /* not a code word */
+            diags[n_diags++].line = i + 1;
+            continue;
+        }
+        def = hash_get(globals, u->name);
+        if (!def) {
+            diags[n_diags].code = ERROR_UNRESOLVED_EXTERNAL_SYMBOL;
+            diags[n_diags++].line = i + 1;
+            continue;
+        }
+        image_words[relocate(m, lay, u->address) - ADDRESS_BASE] =
+                (WORD) (((def->address << 2) | ARE_R) & WORD_MASK);
+    }
+    return n_diags;
+}
+
+/* Pool task: places and resolves the modules of one batch. */
+static void patch_task(void *arg, const size_t item, const int worker) {
+    patch_job_t *job = arg;
+    int m;
+    (void) worker;
+
+    for (m = job->batch_first[item]; m < job->batch_first[item + 1]; m++) {
+        place_module(&job->modules[m], &job->layout[m], job->words);
+        job->n_diags[m] = resolve_externals(&job->modules[m], &job->layout[m], job->globals, job->words,
+                                            job->diags + job->diag_first[m]);
+    }
+}
+
+/* Cuts the modules into consecutive batches of about the same amount of work.
+ * Returns the number of batches, batch_first has room for n_modules + 1 entries.
+ */
+static int make_batches(const object_t *modules, const int n_modules, const int n_workers, int *batch_first) {
+    long total = 0, target, acc = 0;
+    int m, n_batches = 0;
+
+    for (m = 0; m < n_modules; m++) total += modules[m].code_len + modules[m].data_len + modules[m].n_externals;
+    target = total / ((long) n_workers * LINK_BATCHES_PER_WORKER) + 1;
+
+    for (m = 0; m < n_modules; m++) {
+        if (acc == 0) batch_first[n_batches++] = m;
+        acc += modules[m].code_len + modules[m].data_len + modules[m].n_externals;
+        if (acc >= target) acc = 0;
+    }
+    batch_first[n_batches] = n_modules;
+    return n_batches;
+}
+
+/* Adds the entries of a module to the set of defined symbols. */
+static int define_entries(hash_table_t *defined, const object_t *m) {
+    int i;
+
+    for (i = 0; i < m->n_entries; i++) {
+        if (hash_put(defined, m->entries[i].name, (void *) m) != 0) return -1; /* value only marks presence */
+    }
+    return 0;
+}
+
+/* Finds the archive member exporting a symbol. Returns its archive index and sets *member,
+ * or returns -1 if no archive exports it.
+ */
+static int find_in_archives(const archive_t *archives, const int n_archives, const char *name, int *member) {
+    int a;
+
+    for (a = 0; a < n_archives; a++) {
+        *member = archive_find(&archives[a], name);
+        if (*member >= 0) return a;
+    }
+    return -1;
+}
+
+/* Checks that an image is linked from the same modules and archives as a state:
+ * the same names in the same order and archives with unchanged content.
+ */
+static int same_inputs(const link_state_t *state, char *const *names, const int n_names,
+                       char *const *archive_paths, const int n_archives) {
+    content_key_t key;
+    int i;
+
+    if (state->n_archives != n_archives || state->n_modules < n_names) return 0;
+    for (i = 0; i < n_archives; i++) {
+        if (strcmp(state->archives[i].path, archive_paths[i]) != 0 ||
+            content_key_file(archive_paths[i], &key) != 0 ||
+            !content_key_equal(&key, &state->archives[i].key)) {
+            return 0;
+        }
+    }
+    for (i = 0; i < state->n_modules; i++) {
+        if (state->modules[i].from_archive != (i >= n_names)) return 0;
+        if (i < n_names && strcmp(state->modules[i].name, names[i]) != 0) return 0;
+    }
+    return 1;
+}
+
+/* Puts a changed module into its slot of the image and updates the state: the
+ * addresses of its symbols (marking the moved ones in dirty) and its usage sites.
+ * The sites are patched later, once every changed module has moved its symbols.
+ * Returns 1 on success, 0 if the module no longer fits its slot or its symbols
+ * changed (a full link is needed), -1 if it cannot be read or memory ran out.
+ */
+static int relink_module(link_state_t *state, const int index, const char *name, const hash_table_t *globals,
+                         object_t *image, unsigned char *dirty) {
+    link_module_t *lm = &state->modules[index];
+    link_symbol_t *sym;
+    link_site_t *sites;
+    module_layout_t lay;
+    object_t m;
+    int i, address, result = 1;
+
+    if (object_read(name, &m) != 0) {
+        object_free(&m);
+        return -1;
+    }
+    if (m.code_len > lm->code_slot || m.data_len > lm->data_slot || m.n_entries != lm->n_entries) result = 0;
+    for (i = 0; i < m.n_entries && result == 1; i++) {
+        sym = hash_get(globals, m.entries[i].name);
+        if (!sym || sym->module != index) result = 0;
+    }
+    for (i = 0; i < m.n_externals && result == 1; i++) {
+        if (!hash_get(globals, m.externals[i].name) || m.externals[i].address < ADDRESS_BASE ||
+            m.externals[i].address >= ADDRESS_BASE + m.code_len) {
+            result = 0; /* a new external may need a module the image does not have */
+        }
+    }
+    sites = result == 1 ? realloc(state->sites, sizeof(link_site_t) * (size_t) (state->n_sites + m.n_externals + 1))
+                        : NULL;
+    if (result == 1 && !sites) {
+        print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+        result = -1;
+    }
+    if (result != 1) {
+        object_free(&m);
+        return result;
+    }
+    state->sites = sites;
+
+    /* the rest of a shrunk slot is left zero */
+    memset(image->words + (lm->code_base - ADDRESS_BASE), 0, sizeof(WORD) * (size_t) lm->code_slot);
+    memset(image->words + (lm->data_base - ADDRESS_BASE), 0, sizeof(WORD) * (size_t) lm->data_slot);
+    lay.code_base = lm->code_base;
+    lay.data_base = lm->data_base;
+    place_module(&m, &lay, image->words);
+
+    for (i = 0; i < m.n_entries; i++) {
+        sym = hash_get(globals, m.entries[i].name);
+        address = relocate(&m, &lay, m.entries[i].address);
+        if (sym->address != address) {
+            sym->address = address;
+            dirty[sym - state->symbols] = 1;
+        }
+    }
+    for (i = 0; i < state->n_sites; i++) {
+        if (state->sites[i].module == index) state->sites[i].symbol = -1;
+    }
+    for (i = 0; i < m.n_externals; i++) {
+        sym = hash_get(globals, m.externals[i].name);
+        state->sites[state->n_sites].module = index;
+        state->sites[state->n_sites].symbol = (int) (sym - state->symbols);
+        state->sites[state->n_sites].address = relocate(&m, &lay, m.externals[i].address);
+        state->n_sites++;
+    }
+    object_free(&m);
+    return 1;
+}
+
+/* Reads a linked image back, if it is there and matches the state. */
+static int read_image(const char *output, const link_state_t *state, object_t *image) {
+    char *path = create_file_path(output, ".ob");
+    FILE *fp = path ? fopen(path, "r") : NULL;
+
+    free(path);
+    memset(image, 0, sizeof(*image));
+    if (!fp) return 0;
+    fclose(fp);
+    if (object_read(output, image) != 0 || image->code_len != state->code_len ||
+        image->data_len != state->data_len) {
+        object_free(image);
+        return 0;
+    }
+    return 1;
+}
+
+/* --- Public API Functions Implementation --- */
+
+int link_objects(const object_t *modules, const int n_modules, object_t *image) {
+    return link_objects_parallel(modules, n_modules, 1, image);
+}
+
+int link_objects_parallel(const object_t *modules, const int n_modules, const int n_workers, object_t *image) {
+    module_layout_t *layout;
+    hash_table_t *globals;
+    patch_job_t job;
+    long *diag_first, total_code = 0, total_data = 0, total_entries = 0, total_externals = 0;
+    int *batch_first, *n_diags;
+    int m, i, n_batches, result = 0;
+
+    memset(image, 0, sizeof(*image));
+    for (m = 0; m < n_modules; m++) {
+        total_code += modules[m].code_len;
+        total_data += modules[m].data_len;
+        total_entries += modules[m].n_entries;
+        total_externals += modules[m].n_externals;
+    }
+    /* relocated words and the .ob addresses only hold 8 bits */
+    if (!fits_image(total_code, total_data)) {
+        print_error(ERROR_PROGRAM_TOO_LARGE);
+        return -1;
+    }
+    image->code_len = (int) total_code;
+    image->data_len = (int) total_data;
+
+    layout = malloc((size_t) (n_modules > 0 ? n_modules : 1) * sizeof(module_layout_t));
+    diag_first = malloc(((size_t) n_modules + 1) * sizeof(long));
+    n_diags = calloc((size_t) n_modules + 1, sizeof(int));
+    batch_first = malloc(((size_t) n_modules + 1) * sizeof(int));
+    job.diags = malloc((size_t) (total_externals + 1) * sizeof(link_diag_t));
+    image->words = malloc((size_t) (image->code_len + image->data_len + 1) * sizeof(WORD));
+    image->entries = malloc((size_t) (total_entries + 1) * sizeof(obj_symbol_t));
+    globals = hash_create(0);
+    if (!layout || !diag_first || !n_diags || !batch_first || !job.diags || !image->words || !image->entries ||
+        !globals) {
+        print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+        result = -1;
+    }
+
+    if (result == 0) {
+        lay_out(modules, n_modules, image->code_len, layout);
+        if (build_entries(modules, n_modules, layout, globals, image) != 0) result = -1;
+
+        /* the table is complete, the workers only read it */
+        diag_first[0] = 0;
+        for (m = 0; m < n_modules; m++) diag_first[m + 1] = diag_first[m] + modules[m].n_externals;
+        n_batches = make_batches(modules, n_modules, n_workers > 0 ? n_workers : 1, batch_first);
+        job.modules = modules;
+        job.layout = layout;
+        job.globals = globals;
+        job.words = image->words;
+        job.batch_first = batch_first;
+        job.diag_first = diag_first;
+        job.n_diags = n_diags;
+        pool_run((size_t) n_batches, n_workers < n_batches ? n_workers : n_batches, patch_task, &job, NULL);
+
+        for (m = 0; m < n_modules; m++) {
+            for (i = 0; i < n_diags[m]; i++) {
+                report(&modules[m], ".ext", job.diags[diag_first[m] + i].code, job.diags[diag_first[m] + i].line);
+                result = -1;
+            }
+        }
+    }
+
+    hash_destroy(globals, NULL);
+    free(layout);
+    free(diag_first);
+    free(n_diags);
+    free(batch_first);
+    free(job.diags);
+    if (result != 0) object_free(image);
+    return result;
+}
+
+int link_pull_members(vec_t *modules, const archive_t *archives, const int n_archives) {
+    hash_table_t *defined;
+    unsigned char **pulled;
+    object_t *m, member_obj;
+    char name[MAX_LABEL_LENGTH];
+    size_t i;
+    int a, e, member, result = 0;
+
+    defined = hash_create(0);
+    pulled = calloc((size_t) (n_archives > 0 ? n_archives : 1), sizeof(unsigned char *));
+    for (a = 0; a < n_archives && pulled; a++) {
+        pulled[a] = calloc(archives[a].n_members + 1, 1);
+        if (!pulled[a]) result = -1;
+    }
+    if (!defined || !pulled || result != 0) result = -1;
+    for (i = 0; i < modules->len && result == 0; i++) {
+        if (define_entries(defined, vec_get(modules, i)) != 0) result = -1;
+    }
+
+    /* the vector grows while it is scanned, pulled members are scanned in turn */
+    for (i = 0; i < modules->len && result == 0; i++) {
+        for (e = 0; result == 0 && e < ((object_t *) vec_get(modules, i))->n_externals; e++) {
+            m = vec_get(modules, i); /* pulling a member may move the vector */
+            strcpy(name, m->externals[e].name);
+            if (hash_get(defined, name)) continue;
+            a = find_in_archives(archives, n_archives, name, &member);
+            if (a < 0 || pulled[a][member]) continue; /* unresolved, reported by link_objects */
+            pulled[a][member] = 1;
+            if (archive_load_member(&archives[a], member, &member_obj) != 0) {
+                object_free(&member_obj);
+                result = -1;
+            } else if (vec_push(modules, &member_obj) != 0 || define_entries(defined, &member_obj) != 0) {
+                print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+                result = -1;
+            }
+        }
+    }
+
+    for (a = 0; a < n_archives && pulled; a++) free(pulled[a]);
+    free(pulled);
+    hash_destroy(defined, NULL);
+    return result;
+}
+
+int link_record_state(const object_t *modules, const int n_modules, const int n_named,
+                      char *const *archive_paths, const int n_archives, link_state_t *state) {
+    module_layout_t *layout;
+    hash_table_t *globals;
+    link_symbol_t *sym;
+    const obj_symbol_t *u;
+    int m, i, total_entries = 0, total_externals = 0, result = 0;
+
+    memset(state, 0, sizeof(*state));
+    for (m = 0; m < n_modules; m++) {
+        state->code_len += modules[m].code_len;
+        state->data_len += modules[m].data_len;
+        total_entries += modules[m].n_entries;
+        total_externals += modules[m].n_externals;
+    }
+
+    layout = malloc(sizeof(module_layout_t) * ((size_t) n_modules + 1));
+    globals = hash_create(0);
+    state->archives = calloc((size_t) n_archives + 1, sizeof(link_input_t));
+    state->modules = calloc((size_t) n_modules + 1, sizeof(link_module_t));
+    state->symbols = calloc((size_t) total_entries + 1, sizeof(link_symbol_t));
+    state->sites = calloc((size_t) total_externals + 1, sizeof(link_site_t));
+    if (!layout || !globals || !state->archives || !state->modules || !state->symbols || !state->sites) result = -1;
+
+    for (i = 0; i < n_archives && result == 0; i++) {
+        state->archives[i].path = dupstr(archive_paths[i]);
+        if (!state->archives[i].path) result = -1;
+        state->n_archives++;
+        if (content_key_file(archive_paths[i], &state->archives[i].key) != 0) {
+            memset(&state->archives[i].key, 0, sizeof(state->archives[i].key));
+        }
+    }
+
+    if (result == 0) lay_out(modules, n_modules, state->code_len, layout);
+    for (m = 0; m < n_modules && result == 0; m++) {
+        state->modules[m].name = dupstr(modules[m].name ? modules[m].name : "");
+        state->n_modules++;
+        state->modules[m].from_archive = m >= n_named;
+        state->modules[m].code_base = layout[m].code_base;
+        state->modules[m].code_slot = modules[m].code_len;
+        state->modules[m].data_base = layout[m].data_base;
+        state->modules[m].data_slot = modules[m].data_len;
+        state->modules[m].n_entries = modules[m].n_entries;
+        if (!state->modules[m].name || (m < n_named && link_module_keys(modules[m].name, state->modules[m].keys) != 0)) {
+            result = -1;
+        }
+        for (i = 0; i < modules[m].n_entries && result == 0; i++) {
+            sym = &state->symbols[state->n_symbols++];
+            strcpy(sym->name, modules[m].entries[i].name);
+            sym->module = m;
+            sym->address = relocate(&modules[m], &layout[m], modules[m].entries[i].address);
+            result = hash_put(globals, sym->name, sym);
+        }
+    }
+    for (m = 0; m < n_modules && result == 0; m++) {
+        for (i = 0; i < modules[m].n_externals; i++) {
+            u = &modules[m].externals[i];
+            sym = hash_get(globals, u->name);
+            if (!sym) continue; /* only linked images are recorded */
+            state->sites[state->n_sites].module = m;
+            state->sites[state->n_sites].symbol = (int) (sym - state->symbols);
+            state->sites[state->n_sites].address = relocate(&modules[m], &layout[m], u->address);
+            state->n_sites++;
+        }
+    }
+
+    if (result != 0) {
+        print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+        link_state_free(state);
+    }
+    hash_destroy(globals, NULL);
+    free(layout);
+    return result;
+}
+
+int link_incremental(link_state_t *state, const char *output, char *const *names, const int n_names,
+                     char *const *archive_paths, const int n_archives, object_t *image, int *relinked) {
+    content_key_t *keys;
+    hash_table_t *globals;
+    unsigned char *changed, *dirty;
+    link_site_t *x;
+    int i, n_changed = 0, result = 1;
+
+    memset(image, 0, sizeof(*image));
+    *relinked = 0;
+    /* a state whose image does not fit is left to the full link to report */
+    if (!state_fits(state) || !same_inputs(state, names, n_names, archive_paths, n_archives)) return 0;
+
+    keys = malloc(sizeof(content_key_t) * LINK_STATE_FILES * ((size_t) n_names + 1));
+    changed = calloc((size_t) state->n_modules + 1, 1);
+    dirty = calloc((size_t) state->n_symbols + 1, 1);
+    globals = hash_create(0);
+    if (!keys || !changed || !dirty || !globals) {
+        print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+        result = -1;
+    }
+    for (i = 0; i < n_names && result == 1; i++) {
+        if (link_module_keys(names[i], &keys[i * LINK_STATE_FILES]) != 0) {
+            print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+            result = -1;
+        } else if (memcmp(&keys[i * LINK_STATE_FILES], state->modules[i].keys, sizeof(state->modules[i].keys)) != 0) {
+            changed[i] = 1;
+            n_changed++;
+        }
+    }
+    if (result == 1) result = read_image(output, state, image);
+    for (i = 0; i < state->n_symbols && result == 1; i++) {
+        if (hash_put(globals, state->symbols[i].name, &state->symbols[i]) != 0) {
+            print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+            result = -1;
+        }
+    }
+
+    for (i = 0; i < n_names && result == 1; i++) {
+        if (!changed[i]) continue;
+        result = relink_module(state, i, names[i], globals, image, dirty);
+        if (result == 1) memcpy(state->modules[i].keys, &keys[i * LINK_STATE_FILES], sizeof(state->modules[i].keys));
+    }
+    /* the usages of moved symbols and every usage of a changed module */
+    for (i = 0; i < state->n_sites && result == 1 && n_changed > 0; i++) {
+        x = &state->sites[i];
+        if (x->symbol < 0 || (!dirty[x->symbol] && !changed[x->module])) continue;
+        image->words[x->address - ADDRESS_BASE] =
+                (WORD) (((state->symbols[x->symbol].address << 2) | ARE_R) & WORD_MASK);
+    }
+
+    /* the image entries are the symbol table */
+    if (result == 1) {
+        free(image->entries);
+        image->entries = malloc(sizeof(obj_symbol_t) * ((size_t) state->n_symbols + 1));
+        if (!image->entries) {
+            print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+            result = -1;
+        }
+        for (i = 0; i < state->n_symbols && result == 1; i++) {
+            strcpy(image->entries[i].name, state->symbols[i].name);
+            image->entries[i].address = state->symbols[i].address;
+        }
+        image->n_entries = result == 1 ? state->n_symbols : 0;
+    }
+    if (result == 1) *relinked = n_changed;
+    if (result != 1) object_free(image);
+
+    hash_destroy(globals, NULL);
+    free(keys);
+    free(changed);
+    free(dirty);
+    return result;
+}
@@ -0,0 +1,305 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/linker.h"
+#include "../include/dead_strip.h"
+#include "../include/errors.h"
+#include "../include/util_pool.h"
+
+/*
+ * =====================================================================================
+ * Filename:  linker_main.c
+ * Description: Command line driver of the linker. Reads the .ob/.ent/.ext files of
+ * every module named on the command line, pulls in the archive members (-l) that
+ * resolve their externals, optionally strips what the roots cannot reach, links
+ * them and writes the image as <output>.ob plus <output>.ent with the addresses of
+ * all entry symbols. With --incremental the link state is kept in <output>.lks and
+ * later runs only relink the modules that changed. With -j the modules are read
+ * and patched by a worker pool; diagnostics are still printed in module order.
+ * =====================================================================================
+ */
+
+#define DEFAULT_OUTPUT "linked" /* output base name without -o */
+#define NO_STRIP (-1) /* keep every module */
+
+/* struct captured_t is a diagnostic held back until it can be printed in order. */
+typedef struct {
+    char *file_name; /* NULL for a diagnostic without a file */
+    int error_code;
+    int line_number;
+} captured_t;
+
+/* struct read_job_t is the shared state of the parallel reading of the modules. */
+typedef struct {
+    char *const *names;
+    object_t *objs; /* one per name */
+    int *results; /* object_read result per name */
+    vec_t *diags; /* captured_t diagnostics per name */
+} read_job_t;
+
+/* Releases the modules and the archives. */
+static void release(vec_t *modules, archive_t *archives, const int n_archives) {
+    size_t i;
+    int a;
+
+    for (i = 0; i < modules->len; i++) object_free(vec_get(modules, i));
+    vec_destroy(modules);
+    for (a = 0; a < n_archives; a++) archive_close(&archives[a]);
+    free(archives);
+}
+
+/* Error sink of a worker: keeps the diagnostic of the module being read. */
+static void capture(void *user, const char *file_name, int error_code, int line_number) {
+    captured_t c;
+
+    c.file_name = file_name ? dupstr(file_name) : NULL;
+    c.error_code = error_code;
+    c.line_number = line_number;
+    if (vec_push(user, &c) != 0) free(c.file_name);
+}
+
+/* Pool task: reads one module, holding its diagnostics back. */
+static void read_task(void *arg, size_t item, int worker) {
+    read_job_t *job = arg;
+    (void) worker;
+
+    set_error_sink(capture, &job->diags[item]);
+    job->results[item] = object_read(job->names[item], &job->objs[item]);
+    set_error_sink(NULL, NULL);
+}
+
+/* Reads the named modules with n_workers threads and appends them to modules in
+ * command line order. Every failing module is reported, in the same order.
+ */
+static int read_modules(char *const *names, const int n_names, const int n_workers, vec_t *modules) {
+    read_job_t job;
+    captured_t *c;
+    size_t k;
+    int i, result = 0;
+
+    job.names = names;
+    job.objs = calloc((size_t) n_names + 1, sizeof(object_t));
+    job.results = calloc((size_t) n_names + 1, sizeof(int));
+    job.diags = malloc(sizeof(vec_t) * ((size_t) n_names + 1));
+    if (!job.objs || !job.results || !job.diags) {
+        print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+        free(job.objs);
+        free(job.results);
+        free(job.diags);
+        return -1;
+    }
+    for (i = 0; i < n_names; i++) vec_create(&job.diags[i], sizeof(captured_t));
+
+    pool_run((size_t) n_names, n_workers < n_names ? n_workers : n_names, read_task, &job, NULL);
+
+    for (i = 0; i < n_names; i++) {
+        for (k = 0; k < job.diags[i].len; k++) {
+            c = vec_get(&job.diags[i], k);
+            if (c->file_name) {
+                print_error_file(c->file_name, (error_code_t) c->error_code, c->line_number);
+            } else {
+                print_error((error_code_t) c->error_code);
+            }
+            free(c->file_name);
+        }
+        vec_destroy(&job.diags[i]);
+        if (job.results[i] != 0 || result != 0) {
+            object_free(&job.objs[i]);
+            result = -1;
+        } else if (vec_push(modules, &job.objs[i]) != 0) {
+            print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+            object_free(&job.objs[i]);
+            result = -1;
+        }
+    }
+
+    free(job.objs);
+    free(job.results);
+    free(job.diags);
+    return result;
+}
+
+/* Reports an image written without its link state. The state file is removed, as it
+ * would not describe the image, so the next link is a full one.
+ */
+static void state_not_saved(const char *output, const char *state_path) {
+    print_error_file(state_path, ERROR_WRITE_FAILED, 0);
+    remove(state_path);
+    printf("%s.ob written, but its link state was not saved; the next link is a full one\n", output);
+}
+
+/* Tries to relink the image from its link state. Returns 1 when done, 0 when a full
+ * link is needed, -1 on errors, -2 if the image was written but its state was not.
+ */
+static int relink(const char *output, const char *state_path, char *const *names, const int n_names,
+                  char *const *archive_paths, const int n_archives) {
+    link_state_t state;
+    object_t image;
+    int relinked, result;
+
+    if (link_state_read(state_path, &state) != 0) return 0;
+    result = link_incremental(&state, output, names, n_names, archive_paths, n_archives, &image, &relinked);
+    if (result == 1 && relinked > 0) {
+        if (object_write(output, &image) != 0) {
+            print_error_file(output, ERROR_WRITE_FAILED, 0);
+            result = -1;
+        } else if (link_state_write(state_path, &state) != 0) {
+            state_not_saved(output, state_path);
+            result = -2;
+        } else {
+            printf("Relinked %d of %d modules incrementally into %s.ob\n", relinked, state.n_modules, output);
+        }
+    } else if (result == 1) {
+        printf("%s.ob is up to date\n", output);
+    }
+    object_free(&image);
+    link_state_free(&state);
+    return result;
+}
+
+/* Writes the link state of a fully linked image. Returns 0 on success, -1 on failure. */
+static int record(const char *state_path, const vec_t *modules, const int n_named,
+                  char *const *archive_paths, const int n_archives) {
+    link_state_t state;
+    int result;
+
+    result = link_record_state(modules->data, (int) modules->len, n_named, archive_paths, n_archives, &state);
+    if (result == 0 && link_state_write(state_path, &state) != 0) result = -1;
+    link_state_free(&state);
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    vec_t modules;
+    archive_t *archives;
+    char **roots, **names, **archive_paths, *state_path = NULL;
+    object_t image;
+    const char *output = DEFAULT_OUTPUT;
+    int i, n_named = 0, n_archives = 0, n_roots = 0, n_linked, removed = 0, result = 0;
+    int strip = NO_STRIP, incremental = 0, jobs = 1, state_failed = 0;
+
+    vec_create(&modules, sizeof(object_t));
+    archives = malloc(sizeof(archive_t) * (size_t) argc);
+    roots = malloc(sizeof(char *) * (size_t) argc);
+    names = malloc(sizeof(char *) * (size_t) argc);
+    archive_paths = malloc(sizeof(char *) * (size_t) argc);
+    if (!archives || !roots || !names || !archive_paths) {
+        print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+        result = -1;
+    }
+
+    /* check the options first, nothing is read before the command line is valid */
+    for (i = 1; i < argc && result == 0; i++) {
+        if ((strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "-l") == 0) && i + 1 < argc) {
+            if (argv[i][1] == 'o') output = argv[i + 1];
+            if (argv[i][1] == 'l') archive_paths[n_archives++] = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            jobs = parse_jobs(argv[++i]);
+        } else if (strncmp(argv[i], "-j", 2) == 0 || strncmp(argv[i], "--jobs=", 7) == 0) {
+            jobs = parse_jobs(argv[i] + (argv[i][1] == 'j' ? 2 : 7));
+        } else if (strcmp(argv[i], "--strip") == 0 || strcmp(argv[i], "--strip=modules") == 0) {
+            strip = STRIP_MODULES;
+        } else if (strcmp(argv[i], "--strip=labels") == 0) {
+            strip = STRIP_LABELS;
+        } else if (strncmp(argv[i], "--root=", 7) == 0 && argv[i][7] != '\0') {
+            roots[n_roots++] = argv[i] + 7;
+        } else if (strcmp(argv[i], "--incremental") == 0) {
+            incremental = 1;
+        } else if (argv[i][0] == '-') {
+            print_error(ERROR_INVALID_ARGUMENT);
+            printf("Invalid option: %s\n", argv[i]);
+            result = -1;
+        } else {
+            names[n_named++] = argv[i];
+        }
+    }
+    if (result == 0 && jobs < 0) {
+        print_error(ERROR_INVALID_ARGUMENT);
+        printf("Invalid job count\n");
+        result = -1;
+    }
+    if (result == 0 && incremental && strip != NO_STRIP) {
+        print_error(ERROR_INVALID_ARGUMENT);
+        printf("--incremental cannot be combined with --strip\n");
+        result = -1;
+    }
+    if (result == 0 && n_named == 0) {
+        print_error(ERROR_CANNOT_OPEN_FILE);
+        printf("Usage: %s [-o <output>] [-l <archive>]... [-j <jobs>] [--strip[=modules|labels]]"
+               " [--root=<symbol>]... [--incremental] <module1> <module2> ... <moduleN>\n", argv[0]);
+        result = -1;
+    }
+    if (result != 0) {
+        free(archives);
+        free(roots);
+        free(names);
+        free(archive_paths);
+        return 1;
+    }
+
+    state_path = create_file_path(output, LINK_STATE_ENDING);
+    if (!state_path) {
+        print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+        result = -1;
+    } else if (incremental) {
+        result = relink(output, state_path, names, n_named, archive_paths, n_archives);
+    }
+    if (result != 0) {
+        free(state_path);
+        free(archives);
+        free(roots);
+        free(names);
+        free(archive_paths);
+        if (result == -1) printf("Linking failed, %s.ob not written\n", output);
+        return result < 0 ? 1 : 0;
+    }
+    remove(state_path); /* a state left from an earlier link no longer describes the image */
+
+    for (i = 0; i < n_archives; i++) {
+        if (archive_open(archive_paths[i], &archives[i]) != 0) result = -1;
+        if (result != 0) {
+            n_archives = i; /* only the opened ones are closed */
+            break;
+        }
+    }
+    if (result == 0) result = read_modules(names, n_named, jobs, &modules);
+
+    if (result == 0 && link_pull_members(&modules, archives, n_archives) != 0) result = -1;
+    n_linked = (int) modules.len;
+    if (result == 0 && strip != NO_STRIP &&
+        link_strip(modules.data, &n_linked, roots, n_roots, (strip_granularity_t) strip, &removed) != 0) {
+        result = -1;
+    }
+    if (result == 0 && link_objects_parallel(modules.data, n_linked, jobs, &image) == 0) {
+        if (object_write(output, &image) != 0) {
+            print_error_file(output, ERROR_WRITE_FAILED, 0);
+            result = -1;
+        } else {
+            printf("Linked %d modules (%d from archives) into %s.ob (%d code words, %d data words)\n",
+                   n_linked, (int) modules.len - n_named, output, image.code_len, image.data_len);
+            if (strip != NO_STRIP) {
+                printf("Stripped %d unreachable words, %d modules removed\n", removed, (int) modules.len - n_linked);
+            }
+        }
+        object_free(&image);
+    } else {
+        result = -1;
+    }
+    if (result == 0 && incremental && record(state_path, &modules, n_named, archive_paths, n_archives) != 0) {
+        state_not_saved(output, state_path);
+        state_failed = 1;
+    }
+
+    modules.len = (size_t) n_linked; /* the stripped modules are freed already */
+    release(&modules, archives, n_archives);
+    free(roots);
+    free(names);
+    free(archive_paths);
+    free(state_path);
+    if (result != 0) {
+        printf("Linking failed, %s.ob not written\n", output);
+        return 1;
+    }
+    return state_failed ? 1 : 0;
+}
@@ -0,0 +1,364 @@
+#define _POSIX_C_SOURCE 200809L /* open_memstream */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/ob2c.h"
+#include "../include/emulator.h"
+#include "../include/isa.h"
+
+/*
+ * =====================================================================================
+ * Filename:  ob2c.c
+ * Description: Implementation of the C translation. The code image is decoded
+ * from ADDRESS_BASE one instruction after the other with emu_decode, so the
+ * simulator executes exactly what the emulator would decode. A first pass finds
+ * the addresses that need a label: the targets of jumps to known addresses and,
+ * when the program returns or jumps through a register, every address the switch
+ * of computed jumps may reach. The body of run() is written into a buffer first,
+ * so that only the state and helpers it uses are declared and the simulator
+ * compiles without warnings.
+ * =====================================================================================
+ */
+
+/* Parts of the simulator that are declared only when the body uses them. */
+#define USES_MEMORY 0x01
+#define USES_REGISTERS 0x02
+#define USES_FLAG 0x04
+#define USES_STACK 0x08
+#define USES_FAULT 0x10
+#define USES_DISPATCH 0x20 /* pc and the switch of computed jumps */
+#define USES_FIRST_ADDRESS 0x40 /* t */
+#define USES_SECOND_ADDRESS 0x80 /* u */
+#define USES_CHAR 0x100 /* c */
+
+#define STATIC_FAULT (-2) /* the operand faults whenever the instruction runs */
+#define COMPUTED (-1) /* the jump target is computed into t */
+#define MAX_EXPRESSION 32
+#define WORDS_PER_LINE 12
+
+/* struct translation_t is the state of one translation. */
+typedef struct {
+    FILE *body; /* statements of run() */
+    WORD memory[EMU_MEMORY_SIZE]; /* the loaded program */
+    emu_insn_t insns[EMU_MEMORY_SIZE];
+    unsigned char is_insn[EMU_MEMORY_SIZE]; /* an instruction starts at the address */
+    unsigned char label[EMU_MEMORY_SIZE]; /* a goto may reach the address */
+    unsigned char dispatch[EMU_MEMORY_SIZE]; /* the switch of computed jumps may reach the address */
+    int code_end; /* first address after the code */
+    int words; /* code and data words */
+    int mat_cols;
+    unsigned uses;
+} translation_t;
+
+/* --- Private Helper Functions --- */
+
+/* Writes the statement that stops the simulator with a fault at pc. */
+static void emit_fault(translation_t *tr, const int pc, const error_code_t code) {
+    fprintf(tr->body, "    return fault(%d, \"%s\");\n", pc, error_message(code));
+    tr->uses |= USES_FAULT;
+}
+
+/* Writes the computation of the address of a matrix operand into var.
+ * Returns 0, or STATIC_FAULT after writing the fault of an external operand.
+ */
+static int emit_address(translation_t *tr, const emu_operand_t *op, const char *var, const int pc) {
+    if (op->kind == EMU_OPERAND_EXTERNAL) {
+        emit_fault(tr, pc, ERROR_UNLINKED_EXTERNAL);
+        return STATIC_FAULT;
+    }
+    if (op->kind != EMU_OPERAND_MATRIX) return 0;
+    fprintf(tr->body, "    %s = %d + SIGNED(r[%d]) * %d + SIGNED(r[%d]);\n", var, op->value, op->row, tr->mat_cols,
+            op->col);
+    fprintf(tr->body, "    if (%s < 0 || %s >= %d) return fault(%d, \"%s\");\n", var, var, EMU_MEMORY_SIZE, pc,
+            error_message(ERROR_ADDRESS_OUT_OF_RANGE));
+    tr->uses |= USES_REGISTERS | USES_FAULT | (var[0] == 't' ? USES_FIRST_ADDRESS : USES_SECOND_ADDRESS);
+    return 0;
+}
+
+/* Formats the value of an operand whose address, if computed, is in var. */
+static void operand_value(translation_t *tr, const emu_operand_t *op, const char *var, char *expr) {
+    switch (op->kind) {
+        case EMU_OPERAND_IMMEDIATE:
+            sprintf(expr, "%d", op->value & WORD_MASK);
+            break;
+        case EMU_OPERAND_REGISTER:
+            sprintf(expr, "r[%d]", op->value);
+            tr->uses |= USES_REGISTERS;
+            break;
+        case EMU_OPERAND_MATRIX:
+            sprintf(expr, "m[%s]", var);
+            tr->uses |= USES_MEMORY;
+            break;
+        default:
+            sprintf(expr, "m[%d]", op->value);
+            tr->uses |= USES_MEMORY;
+            break;
+    }
+}
+
+/* Writes the store of value into an operand whose address, if computed, is in var. */
+static void emit_store(translation_t *tr, const emu_operand_t *op, const char *var, const char *value, const int pc) {
+    if (op->kind == EMU_OPERAND_REGISTER) {
+        fprintf(tr->body, "    r[%d] = (%s) & %d;\n", op->value, value, WORD_MASK);
+        tr->uses |= USES_REGISTERS;
+        return;
+    }
+    if (op->kind == EMU_OPERAND_MEMORY && op->value >= ADDRESS_BASE && op->value < tr->code_end) {
+        emit_fault(tr, pc, ERROR_CODE_MODIFIED);
+        return;
+    }
+    if (op->kind == EMU_OPERAND_MATRIX) {
+        fprintf(tr->body, "    if (%s >= %d && %s < %d) return fault(%d, \"%s\");\n", var, ADDRESS_BASE, var,
+                tr->code_end, pc, error_message(ERROR_CODE_MODIFIED));
+        fprintf(tr->body, "    m[%s] = (%s) & %d;\n", var, value, WORD_MASK);
+        tr->uses |= USES_FAULT;
+    } else {
+        fprintf(tr->body, "    m[%d] = (%s) & %d;\n", op->value, value, WORD_MASK);
+    }
+    tr->uses |= USES_MEMORY;
+}
+
+/* Writes the computation of a jump target into t. Returns the target when it is
+ * known, COMPUTED, or STATIC_FAULT after writing the fault of an external operand.
+ */
+static int emit_target(translation_t *tr, const emu_operand_t *op, const int pc) {
+    if (op->kind == EMU_OPERAND_MEMORY) return op->value;
+    if (op->kind == EMU_OPERAND_REGISTER) {
+        fprintf(tr->body, "    t = SIGNED(r[%d]);\n", op->value);
+        fprintf(tr->body, "    if (t < 0 || t >= %d) return fault(%d, \"%s\");\n", EMU_MEMORY_SIZE, pc,
+                error_message(ERROR_ADDRESS_OUT_OF_RANGE));
+        tr->uses |= USES_REGISTERS | USES_FAULT | USES_FIRST_ADDRESS;
+        return COMPUTED;
+    }
+    return emit_address(tr, op, "t", pc) == 0 ? COMPUTED : STATIC_FAULT;
+}
+
+/* Writes a jump to target, a known address or COMPUTED. */
+static void emit_jump(translation_t *tr, const int target, const char *indent) {
+    if (target == COMPUTED) {
+        fprintf(tr->body, "%spc = t;\n%sgoto dispatch;\n", indent, indent);
+        tr->uses |= USES_DISPATCH;
+    } else if (tr->is_insn[target]) {
+        fprintf(tr->body, "%sgoto L%d;\n", indent, target);
+    } else {
+        fprintf(tr->body, "%sreturn fault(%d, \"%s\");\n", indent, target, error_message(ERROR_UNTRANSLATED_ADDRESS));
+        tr->uses |= USES_FAULT;
+    }
+}
+
+/* Writes the statements of the instruction at pc. */
+static void emit_insn(translation_t *tr, const int pc) {
+    const emu_insn_t *insn = &tr->insns[pc];
+    char a[MAX_EXPRESSION], b[MAX_EXPRESSION], value[3 * MAX_EXPRESSION];
+    int next = pc + insn->length, target;
+
+    if (tr->label[pc]) fprintf(tr->body, "L%d:\n", pc);
+    fprintf(tr->body, "    steps++; /* %d %s */\n", pc,
+            insn->opcode == EMU_INVALID_OPCODE ? "invalid" : isa_mnemonic(insn->opcode));
+    switch (insn->opcode) {
+        case MOV_OP: case CMP_OP: case ADD_OP: case SUB_OP:
+            if (emit_address(tr, &insn->src, "t", pc) != 0 || emit_address(tr, &insn->dst, "u", pc) != 0) break;
+            operand_value(tr, &insn->src, "t", a);
+            operand_value(tr, &insn->dst, "u", b);
+            if (insn->opcode == CMP_OP) {
+                fprintf(tr->body, "    z = %s == %s;\n", a, b);
+                tr->uses |= USES_FLAG;
+                break;
+            }
+            if (insn->opcode == MOV_OP) strcpy(value, a);
+            else sprintf(value, "%s %c %s", b, insn->opcode == ADD_OP ? '+' : '-', a);
+            emit_store(tr, &insn->dst, "u", value, pc);
+            break;
+        case LEA_OP:
+            if (emit_address(tr, &insn->src, "t", pc) != 0 || emit_address(tr, &insn->dst, "u", pc) != 0) break;
+            if (insn->src.kind == EMU_OPERAND_MATRIX) strcpy(value, "t");
+            else sprintf(value, "%d", insn->src.value);
+            emit_store(tr, &insn->dst, "u", value, pc);
+            break;
+        case CLR_OP:
+        case NOT_OP:
+        case INC_OP:
+        case DEC_OP:
+            if (emit_address(tr, &insn->dst, "u", pc) != 0) break;
+            operand_value(tr, &insn->dst, "u", b);
+            if (insn->opcode == CLR_OP) strcpy(value, "0");
+            else if (insn->opcode == NOT_OP) sprintf(value, "~%s", b);
+            else sprintf(value, "%s %c 1", b, insn->opcode == INC_OP ? '+' : '-');
+            emit_store(tr, &insn->dst, "u", value, pc);
+            break;
+        case RED_OP:
+            fprintf(tr->body, "    c = getchar();\n");
+            tr->uses |= USES_CHAR;
+            if (emit_address(tr, &insn->dst, "u", pc) != 0) break;
+            sprintf(value, "c == EOF ? %d : c", WORD_MASK);
+            emit_store(tr, &insn->dst, "u", value, pc);
+            break;
+        case PRN_OP:
+            if (emit_address(tr, &insn->dst, "u", pc) != 0) break;
+            operand_value(tr, &insn->dst, "u", b);
+            fprintf(tr->body, "    printf(\"%%d\\n\", SIGNED(%s));\n", b);
+            break;
+        case JMP_OP:
+            target = emit_target(tr, &insn->dst, pc);
+            if (target != STATIC_FAULT) emit_jump(tr, target, "    ");
+            break;
+        case BNE_OP:
+            target = emit_target(tr, &insn->dst, pc);
+            if (target == STATIC_FAULT) break;
+            fprintf(tr->body, "    if (!z) {\n");
+            emit_jump(tr, target, "        ");
+            fprintf(tr->body, "    }\n");
+            tr->uses |= USES_FLAG;
+            break;
+        case JSR_OP:
+            target = emit_target(tr, &insn->dst, pc);
+            if (target == STATIC_FAULT) break;
+            fprintf(tr->body, "    if (sp == %d) return fault(%d, \"%s\");\n", EMU_STACK_DEPTH, pc,
+                    error_message(ERROR_RETURN_STACK));
+            fprintf(tr->body, "    stack[sp++] = %d;\n", next);
+            emit_jump(tr, target, "    ");
+            tr->uses |= USES_STACK | USES_FAULT;
+            break;
+        case RTS_OP:
+            fprintf(tr->body, "    if (sp == 0) return fault(%d, \"%s\");\n", pc, error_message(ERROR_RETURN_STACK));
+            fprintf(tr->body, "    pc = stack[--sp];\n    goto dispatch;\n");
+            tr->uses |= USES_STACK | USES_FAULT | USES_DISPATCH;
+            break;
+        case STOP_OP:
+            fprintf(tr->body, "    return 0;\n");
+            break;
+        default:
+            emit_fault(tr, pc, ERROR_INVALID_INSTRUCTION);
+            break;
+    }
+}
+
+/* Decodes the code image and marks the addresses that need a label. */
+static void find_labels(translation_t *tr) {
+    const emu_insn_t *insn;
+    int pc, computed = 0, returns = 0;
+
+    for (pc = ADDRESS_BASE; pc < tr->code_end; pc += tr->insns[pc].length) {
+        emu_decode(tr->memory + pc, EMU_MEMORY_SIZE - pc, &tr->insns[pc]);
+        tr->is_insn[pc] = 1;
+    }
+    for (pc = ADDRESS_BASE; pc < tr->code_end; pc += insn->length) {
+        insn = &tr->insns[pc];
+        if (insn->opcode == RTS_OP) returns = 1;
+        if (insn->opcode != JMP_OP && insn->opcode != BNE_OP && insn->opcode != JSR_OP) continue;
+        if (insn->dst.kind == EMU_OPERAND_MEMORY && tr->is_insn[insn->dst.value]) tr->label[insn->dst.value] = 1;
+        if (insn->dst.kind == EMU_OPERAND_REGISTER || insn->dst.kind == EMU_OPERAND_MATRIX) computed = 1;
+        if (insn->opcode == JSR_OP && pc + insn->length < EMU_MEMORY_SIZE) tr->dispatch[pc + insn->length] = 1;
+    }
+    /* rts reaches the return addresses, a computed jump any instruction */
+    for (pc = ADDRESS_BASE; pc < tr->code_end; pc++) {
+        if (computed) tr->dispatch[pc] = tr->is_insn[pc];
+        else tr->dispatch[pc] = (unsigned char) (returns && tr->dispatch[pc] && tr->is_insn[pc]);
+        if (tr->dispatch[pc]) tr->label[pc] = 1;
+    }
+}
+
+/* Writes a C string literal. */
+static void write_string(FILE *out, const char *s) {
+    fputc('"', out);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') fputc('\\', out);
+        fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+/* Writes the simulator around the body of run(). */
+static void write_simulator(const translation_t *tr, const char *ob_name, const char *body, const size_t body_len,
+                            FILE *out) {
+    int i;
+
+    fprintf(out, "/* Simulator of ");
+    write_string(out, ob_name);
+    fprintf(out, ", written by ob2c with %d matrix columns. */\n", tr->mat_cols);
+    fprintf(out, "#include <stdio.h>\n\n");
+    fprintf(out, "#define SIGNED(w) ((w) & 0x200 ? (int) (w) - 0x400 : (int) (w))\n\n");
+    if (tr->uses & USES_MEMORY) {
+        fprintf(out, "static const unsigned short image[%d] = {", tr->words > 0 ? tr->words : 1);
+        for (i = 0; i < tr->words; i++) {
+            fprintf(out, "%s%s%d", i > 0 ? "," : "", i % WORDS_PER_LINE == 0 ? "\n    " : " ",
+                    tr->memory[ADDRESS_BASE + i]);
+        }
+        fprintf(out, "%s\n};\n", tr->words > 0 ? "" : "0");
+        fprintf(out, "static unsigned short m[%d];\n", EMU_MEMORY_SIZE);
+    }
+    if (tr->uses & USES_REGISTERS) fprintf(out, "static unsigned short r[%d];\n", EMU_REGISTERS);
+    if (tr->uses & USES_FLAG) fprintf(out, "static int z;\n");
+    if (tr->uses & USES_STACK) fprintf(out, "static int stack[%d], sp;\n", EMU_STACK_DEPTH);
+    fprintf(out, "static long steps;\n\n");
+
+    if (tr->uses & USES_FAULT) {
+        fprintf(out, "static int fault(int pc, const char *message) {\n");
+        fprintf(out, "    int word = pc - %d;\n\n", ADDRESS_BASE);
+        fprintf(out, "    printf(\"There is error in %%s at line:%%d ERROR: %%s\\n\", ");
+        write_string(out, ob_name);
+        fprintf(out, ",\n           word >= 0 && word < %d ? word + 2 : 0, message);\n", tr->words);
+        fprintf(out, "    printf(\"Stopped at address %%d after %%ld instructions\\n\", pc, steps);\n");
+        fprintf(out, "    return 1;\n}\n\n");
+    }
+
+    fprintf(out, "static int run(void) {\n");
+    if (tr->uses & USES_DISPATCH) fprintf(out, "    int pc;\n");
+    if (tr->uses & USES_FIRST_ADDRESS) fprintf(out, "    int t;\n");
+    if (tr->uses & USES_SECOND_ADDRESS) fprintf(out, "    int u;\n");
+    if (tr->uses & USES_CHAR) fprintf(out, "    int c;\n");
+    fprintf(out, "\n");
+    fwrite(body, 1, body_len, out);
+    if (tr->uses & USES_DISPATCH) {
+        fprintf(out, "dispatch:\n    switch (pc) {\n");
+        for (i = ADDRESS_BASE; i < tr->code_end; i++) {
+            if (tr->dispatch[i]) fprintf(out, "        case %d: goto L%d;\n", i, i);
+        }
+        fprintf(out, "        default: return fault(pc, \"%s\");\n    }\n",
+                error_message(ERROR_UNTRANSLATED_ADDRESS));
+    }
+    fprintf(out, "}\n\n");
+
+    fprintf(out, "int main(void) {\n");
+    if (tr->uses & USES_MEMORY) {
+        fprintf(out, "    int i;\n\n");
+        fprintf(out, "    for (i = 0; i < %d; i++) m[%d + i] = image[i];\n", tr->words, ADDRESS_BASE);
+    }
+    fprintf(out, "    return run();\n}\n");
+}
+
+/* --- Public API Functions Implementation --- */
+
+int ob2c_translate(const object_t *program, const char *ob_name, const int mat_cols, FILE *out) {
+    translation_t *tr;
+    char *body = NULL;
+    size_t body_len = 0;
+    int pc, result = 0;
+
+    if (program->code_len + program->data_len > EMU_MEMORY_SIZE - ADDRESS_BASE) return -1;
+    tr = calloc(1, sizeof(translation_t));
+    if (!tr) return -1;
+    tr->words = program->code_len + program->data_len;
+    tr->code_end = ADDRESS_BASE + program->code_len;
+    tr->mat_cols = mat_cols;
+    if (tr->words > 0) memcpy(tr->memory + ADDRESS_BASE, program->words, sizeof(WORD) * (size_t) tr->words);
+    find_labels(tr);
+
+    tr->body = open_memstream(&body, &body_len);
+    if (!tr->body) {
+        free(tr);
+        return -1;
+    }
+    for (pc = ADDRESS_BASE; pc < tr->code_end; pc += tr->insns[pc].length) emit_insn(tr, pc);
+    /* the program runs past its code */
+    emit_fault(tr, pc, ERROR_UNTRANSLATED_ADDRESS);
+    if (fclose(tr->body) != 0) {
+        result = -1;
+    } else {
+        write_simulator(tr, ob_name, body, body_len, out);
+        if (ferror(out)) result = -1;
+    }
+    free(body);
+    free(tr);
+    return result;
+}
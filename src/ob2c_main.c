@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/ob2c.h"
+#include "../include/emulator.h"
+
+/*
+ * =====================================================================================
+ * Filename:  ob2c_main.c
+ * Description: Command line driver of the C translation. Reads <program>.ob (an
+ * object file or a linked image) and writes the C source of its simulator into
+ * <program>.sim.c, or into the file given with -o. Compiled with the host compiler,
+ * the simulator runs the program as the emulator would, for programs that do not
+ * store into their own code.
+ * =====================================================================================
+ */
+
+#define OUTPUT_ENDING ".sim.c"
+
+int main(int argc, char *argv[]) {
+    object_t program;
+    FILE *out;
+    char *ob_path, *default_path = NULL, *end;
+    const char *name = NULL, *out_path = NULL;
+    long mat_cols = EMU_DEFAULT_MAT_COLS;
+    int i, result = 0;
+
+    for (i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--mat-cols=", 11) == 0) {
+            mat_cols = strtol(argv[i] + 11, &end, 10);
+            if (*end != '\0' || end == argv[i] + 11 || mat_cols < 1) result = -1;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (argv[i][0] == '-' || name) {
+            result = -1;
+        } else {
+            name = argv[i];
+        }
+        if (result != 0) {
+            print_error(ERROR_INVALID_ARGUMENT);
+            printf("Invalid option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (!name) {
+        print_error(ERROR_CANNOT_OPEN_FILE);
+        printf("Usage: %s [--mat-cols=<columns>] [-o <file>] <program>\n", argv[0]);
+        return 1;
+    }
+
+    ob_path = create_file_path(name, ".ob");
+    if (!out_path) out_path = default_path = create_file_path(name, OUTPUT_ENDING);
+    if (!ob_path || !out_path) {
+        print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+        free(ob_path);
+        return 1;
+    }
+    if (object_read(name, &program) != 0) {
+        result = -1;
+    } else if (program.code_len + program.data_len > EMU_MEMORY_SIZE - ADDRESS_BASE) {
+        print_error_file(ob_path, ERROR_PROGRAM_TOO_LARGE, 1);
+        result = -1;
+    } else {
+        out = fopen(out_path, "w");
+        if (!out) {
+            print_error_file(out_path, ERROR_CANNOT_OPEN_FILE, 0);
+            result = -1;
+        } else {
+            result = ob2c_translate(&program, ob_path, (int) mat_cols, out);
+            if (fclose(out) != 0) result = -1;
+            if (result != 0) print_error_file(out_path, ERROR_WRITE_FAILED, 0);
+        }
+    }
+
+    object_free(&program);
+    free(ob_path);
+    free(default_path);
+    return result == 0 ? 0 : 1;
+}
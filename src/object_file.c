@@ -0,0 +1,312 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/object_file.h"
+#include "../include/errors.h"
+#include "../include/util_vec.h"
+
+/*
+ * =====================================================================================
+ * Filename:  object_file.c
+ * Description: Reads and writes the .ob, .ent and .ext files of a module.
+ * The .ob file is a header line "<code length> <data length>" followed by one
+ * "address<TAB>word" line per word, the .ent and .ext files hold one
+ * "name<TAB>address" line per symbol, all numbers in base-4 digits 'a'..'d'.
+ * =====================================================================================
+ */
+
+#define OBJ_LINE_LENGTH 128 /* longest header or symbol line, with room to spare */
+#define OBJ_ADDRESS_DIGITS 4
+#define OBJ_WORD_DIGITS 5
+
+/* --- Private Helper Functions --- */
+
+/* Reads base-4 digits at *p into *value and advances *p past them.
+ * Returns the number of digits read.
+ */
+static int read_base4(const char **p, long *value) {
+    int n = 0;
+
+    *value = 0;
+    while (**p >= 'a' && **p <= 'd' && n < LENGTH_BASE4_MAX - 1) {
+        *value = (*value << 2) | (**p - 'a');
+        (*p)++;
+        n++;
+    }
+    return n;
+}
+
+/* Returns TRUE if nothing but the line terminator is left at p. */
+static bool_t at_line_end(const char *p) {
+    if (*p == '\r') p++;
+    return (*p == '\n' || *p == '\0') ? TRUE : FALSE;
+}
+
+/* Reads the words of an .ob file into obj.
+ * The header lengths must match the number of word lines.
+ */
+static int read_ob_stream(FILE *fp, const char *path, object_t *obj) {
+    char line[OBJ_LINE_LENGTH];
+    const char *p;
+    long code_len = 0, data_len = 0, value;
+    vec_t words;
+    WORD w;
+    int line_no = 1, n_words;
+    error_code_t status = ERROR_OK;
+
+    vec_create(&words, sizeof(WORD));
+
+    p = line;
+    if (!fgets(line, sizeof(line), fp) || !read_base4(&p, &code_len) || *p++ != ' ' ||
+        !read_base4(&p, &data_len) || !at_line_end(p)) {
+        status = ERROR_INVALID_OBJECT_FILE;
+    }
+    while (status == ERROR_OK && fgets(line, sizeof(line), fp)) {
+        line_no++;
+        p = line;
+        if (read_base4(&p, &value) != OBJ_ADDRESS_DIGITS || *p++ != '\t' ||
+            read_base4(&p, &value) != OBJ_WORD_DIGITS || !at_line_end(p)) {
+            status = ERROR_INVALID_OBJECT_FILE;
+            break;
+        }
+        w = (WORD) value;
+        if (vec_push(&words, &w) != 0) status = ERROR_MEMORY_ALLOCATION_FAILED;
+    }
+
+    if (status == ERROR_OK && (long) words.len != code_len + data_len) {
+        status = ERROR_INVALID_OBJECT_FILE; /* the header does not describe the words */
+        line_no = 1;
+    }
+    if (status != ERROR_OK) {
+        print_error_file(path, status, status == ERROR_INVALID_OBJECT_FILE ? line_no : 0);
+        vec_destroy(&words);
+        return -1;
+    }
+
+    obj->code_len = (int) code_len;
+    obj->data_len = (int) data_len;
+    obj->words = vec_take(&words, &n_words);
+    return 0;
+}
+
+/* Reads the "name<TAB>address" lines of a .ent or .ext file. */
+static int read_symbol_stream(FILE *fp, const char *path, obj_symbol_t **symbols, int *count) {
+    char line[OBJ_LINE_LENGTH];
+    const char *p, *tab;
+    long address;
+    vec_t list;
+    obj_symbol_t sym;
+    int line_no = 0;
+    error_code_t status = ERROR_OK;
+
+    vec_create(&list, sizeof(obj_symbol_t));
+
+    while (status == ERROR_OK && fgets(line, sizeof(line), fp)) {
+        line_no++;
+        tab = strchr(line, '\t');
+        if (!tab || tab == line || tab - line >= MAX_LABEL_LENGTH) {
+            status = ERROR_INVALID_OBJECT_FILE;
+            break;
+        }
+        p = tab + 1;
+        if (read_base4(&p, &address) != OBJ_ADDRESS_DIGITS || !at_line_end(p)) {
+            status = ERROR_INVALID_OBJECT_FILE;
+            break;
+        }
+        memcpy(sym.name, line, (size_t) (tab - line));
+        sym.name[tab - line] = '\0';
+        sym.address = (int) address;
+        if (vec_push(&list, &sym) != 0) status = ERROR_MEMORY_ALLOCATION_FAILED;
+    }
+
+    if (status != ERROR_OK) {
+        print_error_file(path, status, status == ERROR_INVALID_OBJECT_FILE ? line_no : 0);
+        vec_destroy(&list);
+        return -1;
+    }
+    *symbols = vec_take(&list, count);
+    return 0;
+}
+
+/* Writes "name<TAB>address" lines to base_name + ending, if there are any. */
+static int write_symbol_file(const char *base_name, const char *ending, const obj_symbol_t *symbols, int count) {
+    char *path;
+    FILE *fp;
+    char b4_address[OBJ_ADDRESS_DIGITS + 1];
+    int i, result = 0;
+
+    if (count == 0) return 0;
+    path = create_file_path(base_name, ending);
+    if (!path) return -1;
+    fp = fopen(path, "w");
+    free(path);
+    if (!fp) return -1;
+
+    for (i = 0; i < count; i++) {
+        word_to_base4((WORD) symbols[i].address, b4_address, sizeof(b4_address));
+        fprintf(fp, "%s\t%s\n", symbols[i].name, b4_address);
+    }
+    if (ferror(fp)) result = -1;
+    if (fclose(fp) != 0) result = -1;
+    return result;
+}
+
+/* Returns 1 if every address of a module fits the 8 bits of the file addresses. */
+static int addresses_fit(const object_t *obj) {
+    int i;
+
+    if (obj->code_len < 0 || obj->data_len < 0 || ADDRESS_BASE + (long) obj->code_len + obj->data_len > IMAGE_LENGTH) {
+        return 0;
+    }
+    for (i = 0; i < obj->n_entries; i++) {
+        if (obj->entries[i].address < 0 || obj->entries[i].address >= IMAGE_LENGTH) return 0;
+    }
+    for (i = 0; i < obj->n_externals; i++) {
+        if (obj->externals[i].address < 0 || obj->externals[i].address >= IMAGE_LENGTH) return 0;
+    }
+    return 1;
+}
+
+/* --- Public API Functions Implementation --- */
+
+int object_read_streams(const char *name, FILE *ob, FILE *ent, FILE *ext, object_t *obj) {
+    char *ob_path, *ent_path, *ext_path;
+    int result = -1;
+
+    memset(obj, 0, sizeof(*obj));
+    obj->name = dupstr(name);
+    ob_path = create_file_path(name, ".ob");
+    ent_path = create_file_path(name, ".ent");
+    ext_path = create_file_path(name, ".ext");
+
+    if (!obj->name || !ob_path || !ent_path || !ext_path) {
+        print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+    } else if (read_ob_stream(ob, ob_path, obj) == 0 &&
+               (!ent || read_symbol_stream(ent, ent_path, &obj->entries, &obj->n_entries) == 0) &&
+               (!ext || read_symbol_stream(ext, ext_path, &obj->externals, &obj->n_externals) == 0)) {
+        result = 0;
+    }
+
+    free(ob_path);
+    free(ent_path);
+    free(ext_path);
+    return result;
+}
+
+int object_read(const char *base_name, object_t *obj) {
+    char *paths[3];
+    FILE *fp[3];
+    const char *endings[3] = {".ob", ".ent", ".ext"};
+    int i, result = -1;
+
+    for (i = 0; i < 3; i++) {
+        paths[i] = create_file_path(base_name, endings[i]);
+        fp[i] = paths[i] ? fopen(paths[i], "r") : NULL; /* .ent and .ext exist only when needed */
+    }
+
+    if (!paths[0] || !paths[1] || !paths[2]) {
+        memset(obj, 0, sizeof(*obj));
+        print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+    } else if (!fp[0]) {
+        memset(obj, 0, sizeof(*obj));
+        print_error_file(paths[0], ERROR_CANNOT_OPEN_FILE, 0);
+    } else {
+        result = object_read_streams(base_name, fp[0], fp[1], fp[2], obj);
+    }
+
+    for (i = 0; i < 3; i++) {
+        if (fp[i]) fclose(fp[i]);
+        free(paths[i]);
+    }
+    return result;
+}
+
+int object_read_symbols(const char *path, obj_symbol_t **symbols, int *count) {
+    FILE *fp = fopen(path, "r");
+    int result;
+
+    *symbols = NULL;
+    *count = 0;
+    if (!fp) {
+        print_error_file(path, ERROR_CANNOT_OPEN_FILE, 0);
+        return -1;
+    }
+    result = read_symbol_stream(fp, path, symbols, count);
+    fclose(fp);
+    return result;
+}
+
+int object_from_result(const char *name, const asm_result_t *result, object_t *obj) {
+    int i;
+
+    memset(obj, 0, sizeof(*obj));
+    obj->name = name ? dupstr(name) : NULL;
+    obj->words = malloc(sizeof(WORD) * (size_t) (result->code_len + result->data_len + 1));
+    obj->entries = malloc(sizeof(obj_symbol_t) * (size_t) (result->n_entries + 1));
+    obj->externals = malloc(sizeof(obj_symbol_t) * (size_t) (result->n_externals + 1));
+    if ((name && !obj->name) || !obj->words || !obj->entries || !obj->externals) {
+        object_free(obj);
+        return -1;
+    }
+    if (result->code_len > 0) memcpy(obj->words, result->code, sizeof(WORD) * (size_t) result->code_len);
+    if (result->data_len > 0) {
+        memcpy(obj->words + result->code_len, result->data, sizeof(WORD) * (size_t) result->data_len);
+    }
+    for (i = 0; i < result->n_entries; i++) {
+        strcpy(obj->entries[i].name, result->entries[i].name);
+        obj->entries[i].address = result->entries[i].address;
+    }
+    for (i = 0; i < result->n_externals; i++) {
+        strcpy(obj->externals[i].name, result->externals[i].name);
+        obj->externals[i].address = result->externals[i].address;
+    }
+    obj->code_len = result->code_len;
+    obj->data_len = result->data_len;
+    obj->n_entries = result->n_entries;
+    obj->n_externals = result->n_externals;
+    return 0;
+}
+
+int object_write(const char *base_name, const object_t *obj) {
+    char *path;
+    FILE *fp;
+    char b4_code[LENGTH_BASE4_MAX], b4_data[LENGTH_BASE4_MAX];
+    char b4_address[OBJ_ADDRESS_DIGITS + 1], b4_word[OBJ_WORD_DIGITS + 1];
+    int i, result = 0;
+
+    path = create_file_path(base_name, ".ob");
+    if (!path) return -1;
+    if (!addresses_fit(obj)) {
+        /* the addresses would be written cut to 8 bits */
+        print_error_file(path, ERROR_PROGRAM_TOO_LARGE, 0);
+        free(path);
+        return -1;
+    }
+    fp = fopen(path, "w");
+    free(path);
+    if (!fp) return -1;
+
+    length_to_base4(obj->code_len, OB_CODE_DIGITS, b4_code);
+    length_to_base4(obj->data_len, OB_DATA_DIGITS, b4_data);
+    fprintf(fp, "%s %s\n", b4_code, b4_data);
+    for (i = 0; i < obj->code_len + obj->data_len; i++) {
+        word_to_base4((WORD) (ADDRESS_BASE + i), b4_address, sizeof(b4_address));
+        word_to_base4(obj->words[i], b4_word, sizeof(b4_word));
+        fprintf(fp, "%s\t%s\n", b4_address, b4_word);
+    }
+    if (ferror(fp)) result = -1;
+    if (fclose(fp) != 0) result = -1;
+
+    if (write_symbol_file(base_name, ".ent", obj->entries, obj->n_entries) != 0) result = -1;
+    if (write_symbol_file(base_name, ".ext", obj->externals, obj->n_externals) != 0) result = -1;
+    return result;
+}
+
+void object_free(object_t *obj) {
+    if (!obj) return;
+    free(obj->name);
+    free(obj->words);
+    free(obj->entries);
+    free(obj->externals);
+    memset(obj, 0, sizeof(*obj));
+}
@@ -5,6 +5,7 @@
 #include "../include/globals.h"
 #include "../include/util_hash.h"
 #include "../include/errors.h"
+#include "../include/profile.h"
 
 /*
  * =====================================================================================
@@ -19,6 +20,26 @@
 
 /* --- Private Helper Functions --- */
 
+#define WORD_DELIMITERS " \t\n\r"
+
+/* Returns the next whitespace delimited word of *cursor and advances the cursor.
+ * Works like strtok but keeps its state in the caller, so several files can be
+ * preprocessed concurrently. Returns NULL when no word is left.
+ */
+static char *next_word(char **cursor) {
+    char *start, *end;
+
+    start = *cursor + strspn(*cursor, WORD_DELIMITERS);
+    if (!*start) {
+        *cursor = start;
+        return NULL;
+    }
+    end = start + strcspn(start, WORD_DELIMITERS);
+    if (*end) *end++ = '\0';
+    *cursor = end;
+    return start;
+}
+
 /* Creates a new, empty macro object.
  * Returns a pointer to the newly created macro_t object, or NULL on failure.
  */
@@ -72,8 +93,7 @@ static int add_line_to_macro(macro_t* m, const char* line) {
 
 /* --- Public API preprocessor function --- */
 
-int preprocess_file(const char *input_path, const char *output_path) {
-    FILE *as_file, *am_file;
+int preprocess_stream(FILE *as_file, FILE *am_file) {
     char line[MAX_LINE_LENGTH];
     char line_copy[MAX_LINE_LENGTH];
     bool_t success = TRUE;
@@ -82,10 +102,14 @@ int preprocess_file(const char *input_path, const char *output_path) {
     bool_t in_macro_definition = FALSE;
     macro_t *current_macro = NULL;
 
+    char *cursor;
     char *token;
     char *macro_name;
     macro_t *macro_to_expand;
     size_t i;
+    sig_atomic_t saved;
+
+    if (!as_file || !am_file) return -1;
 
     macro_table = hash_create(0); /* use default capacity */
     if (!macro_table) {
@@ -93,31 +117,19 @@ int preprocess_file(const char *input_path, const char *output_path) {
         return -1;
     }
 
-    as_file = fopen(input_path, "r");
-    if (!as_file) {
-        print_error(ERROR_CANNOT_OPEN_FILE);
-        hash_destroy(macro_table, destroy_macro);
-        return -1;
-    }
-
-    am_file = fopen(output_path, "w");
-    if (!am_file) {
-        print_error(ERROR_CANNOT_OPEN_FILE);
-        fclose(as_file);
-        hash_destroy(macro_table, destroy_macro);
-        return -1;
-    }
-
     /* read the input file line by line and process it.*/
-    while (fgets(line, sizeof(line), as_file)) {
-        strcpy(line_copy, line); /* strtok modifies the string, so we use a copy */
+    while (prof_fgets(line, sizeof(line), as_file)) {
+        strcpy(line_copy, line); /* next_word modifies the string, so we use a copy */
 
-        token = strtok(line_copy, " \t\n\r");
+        cursor = line_copy;
+        token = next_word(&cursor);
         if (!token) {
             if (in_macro_definition) {
                 add_line_to_macro(current_macro, line);
             } else {
+                PROF_ENTER(saved, PROF_ACT_IO);
                 fputs(line, am_file);
+                PROF_LEAVE(saved);
             }
             continue;
         }
@@ -126,7 +138,7 @@ int preprocess_file(const char *input_path, const char *output_path) {
         if (strcmp(token, mcro) == 0) {
             in_macro_definition = TRUE;
 
-            macro_name = strtok(NULL, " \t\n\r");
+            macro_name = next_word(&cursor);
             if (!macro_name) {
                 print_error(ERROR_INVALID_MACRO_NAME);
                 success = FALSE;
@@ -137,7 +149,7 @@ int preprocess_file(const char *input_path, const char *output_path) {
                 success = FALSE;
                 continue;
             }
-            if (strtok(NULL, " \t\n\r") != NULL) {
+            if (next_word(&cursor) != NULL) {
                 print_error(ERROR_TOKEN_AFTER_MACRO);
                 success = FALSE;
                 continue;
@@ -147,7 +159,7 @@ int preprocess_file(const char *input_path, const char *output_path) {
             hash_put(macro_table, macro_name, current_macro);
 
         } else if (strcmp(token, mcrend) == 0) {
-            if (strtok(NULL, " \t\n\r") != NULL) {
+            if (next_word(&cursor) != NULL) {
                 print_error(ERROR_TOKEN_AFTER_MACRO);
                 success = FALSE;
             }
@@ -159,7 +171,11 @@ int preprocess_file(const char *input_path, const char *output_path) {
 
         } else {
             /* not in a macro definition, check for macro call */
+            PROF_ENTER(saved, PROF_ACT_SYMBOL_LOOKUP);
             macro_to_expand = hash_get(macro_table, token);
+            PROF_LEAVE(saved);
+
+            PROF_ENTER(saved, PROF_ACT_IO);
             if (macro_to_expand) {
                 for (i = 0; i < macro_to_expand->body.len; i++) {
                     char *macro_line = *(char **) vec_get(&macro_to_expand->body, i); /* get the line from the macro body */
@@ -169,14 +185,37 @@ int preprocess_file(const char *input_path, const char *output_path) {
                 /* regular line, write to output */
                 fputs(line, am_file);
             }
+            PROF_LEAVE(saved);
         }
     }
 
+    hash_destroy(macro_table, destroy_macro);
+
+    return success ? 0 : -1;
+}
+
+int preprocess_file(const char *input_path, const char *output_path) {
+    FILE *as_file, *am_file;
+    int result;
+
+    as_file = fopen(input_path, "r");
+    if (!as_file) {
+        print_error(ERROR_CANNOT_OPEN_FILE);
+        return -1;
+    }
+
+    am_file = fopen(output_path, "w");
+    if (!am_file) {
+        print_error(ERROR_CANNOT_OPEN_FILE);
+        fclose(as_file);
+        return -1;
+    }
+
+    result = preprocess_stream(as_file, am_file);
     fclose(as_file);
     fclose(am_file);
-    hash_destroy(macro_table, destroy_macro);
 
-    if (!success) {
+    if (result != 0) {
         remove(output_path); /* delete the .am file if errors occurred */
         return -1;
     }
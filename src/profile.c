@@ -0,0 +1,169 @@
+#define _POSIX_C_SOURCE 200809L /* sigaction, setitimer */
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include "../include/profile.h"
+
+/*
+ * =====================================================================================
+ * Filename:  profile.c
+ * Description: Sampling profiler driven by ITIMER_PROF.
+ * The SIGPROF handler only increments the counter of the current phase/activity
+ * pair; all formatting happens in profile_report after the timer is stopped.
+ * The handler is installed with SA_RESTART so interrupted reads and writes of the
+ * assembler resume transparently.
+ * =====================================================================================
+ */
+
+volatile sig_atomic_t prof_phase = PROF_PHASE_DRIVER;
+volatile sig_atomic_t prof_activity = PROF_ACT_OTHER;
+int prof_enabled = 0;
+
+static volatile unsigned long samples[PROF_PHASE_COUNT][PROF_ACT_COUNT];
+static long sample_interval_us = PROFILE_INTERVAL_US;
+static struct sigaction previous_action;
+static int running = 0;
+
+static const char *const PHASE_NAMES[PROF_PHASE_COUNT] = {
+    "driver", "preprocessing", "first pass", "second pass"
+};
+
+static const char *const ACTIVITY_NAMES[PROF_ACT_COUNT] = {
+    "other", "lexing", "opcode lookup", "symbol lookup", "formatting", "I/O"
+};
+
+/* --- Private Helper Functions --- */
+
+static void on_sigprof(int sig) {
+    int phase = (int) prof_phase;
+    int activity = (int) prof_activity;
+    (void) sig;
+
+    if (phase < 0 || phase >= PROF_PHASE_COUNT) phase = PROF_PHASE_DRIVER;
+    if (activity < 0 || activity >= PROF_ACT_COUNT) activity = PROF_ACT_OTHER;
+    samples[phase][activity]++;
+}
+
+/* Arms (or disarms with 0) the profiling timer. Returns 0 on success. */
+static int set_timer(long interval_us) {
+    struct itimerval tv;
+
+    tv.it_interval.tv_sec = interval_us / 1000000L;
+    tv.it_interval.tv_usec = interval_us % 1000000L;
+    tv.it_value = tv.it_interval;
+    return setitimer(ITIMER_PROF, &tv, NULL);
+}
+
+/* Writes one report line, detail may be NULL. */
+static void report_line(FILE *out, unsigned long n, unsigned long total, const char *what, const char *detail) {
+    fprintf(out, "  %6.2f %9lu %9.3f  ",
+            total ? 100.0 * (double) n / (double) total : 0.0,
+            n, (double) n * (double) sample_interval_us / 1e6);
+    if (detail) {
+        fprintf(out, "%-14s %s\n", what, detail);
+    } else {
+        fprintf(out, "%s\n", what);
+    }
+}
+
+/* --- Public API Functions Implementation --- */
+
+int profile_start(long interval_us) {
+    struct sigaction sa;
+
+    if (running) return 0;
+    if (interval_us <= 0) interval_us = PROFILE_INTERVAL_US;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_sigprof;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    if (sigaction(SIGPROF, &sa, &previous_action) != 0) return -1;
+
+    sample_interval_us = interval_us;
+    prof_enabled = 1;
+    if (set_timer(interval_us) != 0) {
+        prof_enabled = 0;
+        sigaction(SIGPROF, &previous_action, NULL);
+        return -1;
+    }
+    running = 1;
+    return 0;
+}
+
+void profile_stop(void) {
+    if (!running) return;
+    set_timer(0);
+    sigaction(SIGPROF, &previous_action, NULL);
+    prof_enabled = 0;
+    prof_phase = PROF_PHASE_DRIVER;
+    prof_activity = PROF_ACT_OTHER;
+    running = 0;
+}
+
+void profile_report(FILE *out) {
+    unsigned long snapshot[PROF_PHASE_COUNT][PROF_ACT_COUNT];
+    unsigned long by_phase[PROF_PHASE_COUNT];
+    unsigned long by_activity[PROF_ACT_COUNT];
+    unsigned long total = 0, best;
+    int p, a, best_p, best_a;
+
+    if (!out) return;
+    memset(by_phase, 0, sizeof(by_phase));
+    memset(by_activity, 0, sizeof(by_activity));
+    for (p = 0; p < PROF_PHASE_COUNT; p++) {
+        for (a = 0; a < PROF_ACT_COUNT; a++) {
+            snapshot[p][a] = samples[p][a];
+            by_phase[p] += snapshot[p][a];
+            by_activity[a] += snapshot[p][a];
+            total += snapshot[p][a];
+        }
+    }
+
+    fprintf(out, "Flat profile: %lu samples of %.3f ms CPU time (%.3f s)\n",
+            total, (double) sample_interval_us / 1000.0,
+            (double) total * (double) sample_interval_us / 1e6);
+    if (total == 0) {
+        fprintf(out, "  no samples, the run was shorter than the sampling period\n");
+        return;
+    }
+
+    fprintf(out, "  %%time   samples   seconds  phase          activity\n");
+    for (;;) {
+        /* at most PROF_PHASE_COUNT * PROF_ACT_COUNT lines, selection order is enough */
+        best = 0;
+        best_p = best_a = -1;
+        for (p = 0; p < PROF_PHASE_COUNT; p++) {
+            for (a = 0; a < PROF_ACT_COUNT; a++) {
+                if (snapshot[p][a] > best) {
+                    best = snapshot[p][a];
+                    best_p = p;
+                    best_a = a;
+                }
+            }
+        }
+        if (best_p < 0) break;
+        report_line(out, best, total, PHASE_NAMES[best_p], ACTIVITY_NAMES[best_a]);
+        snapshot[best_p][best_a] = 0;
+    }
+
+    fprintf(out, "By activity:\n");
+    for (a = 0; a < PROF_ACT_COUNT; a++) {
+        if (by_activity[a]) report_line(out, by_activity[a], total, ACTIVITY_NAMES[a], NULL);
+    }
+    fprintf(out, "By phase:\n");
+    for (p = 0; p < PROF_PHASE_COUNT; p++) {
+        if (by_phase[p]) report_line(out, by_phase[p], total, PHASE_NAMES[p], NULL);
+    }
+}
+
+char *prof_fgets(char *buf, int size, FILE *fp) {
+    sig_atomic_t saved;
+    char *line;
+
+    PROF_ENTER(saved, PROF_ACT_IO);
+    line = fgets(buf, size, fp);
+    PROF_LEAVE(saved);
+    return line;
+}
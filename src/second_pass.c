@@ -4,6 +4,9 @@
 #include "../include/second_pass.h"
 #include "../include/errors.h"
 #include "../include/util_vec.h"
+#include "../include/spill.h"
+#include "../include/profile.h"
+#include "../include/cost.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -19,17 +22,33 @@
  * =====================================================================================
  */
 
-/* The base address for the code image.
- * It is used to calculate the absolute addresses of instructions and data.
+/* Converts a word to length - 1 base-4 digits ('a'..'d') plus a terminator.
+ * Only the low 2 * (length - 1) bits of the word are written.
  */
-static void word_to_base4(WORD w, char *out, const int length) {
+void word_to_base4(WORD w, char *out, const int length) {
     int i, d;
+    sig_atomic_t saved;
+    PROF_ENTER(saved, PROF_ACT_FORMATTING);
     for (i = length - 2; i >= 0; --i) {
         d = w & 3; /* 2 bits mask */
         out[i] = (char) ('a' + d); /* 0-a, 1-b, 2-c, 3-d */
         w >>= 2; /* shift right by 2 bits to mask next 2 bits */
     }
     out[length - 1] = '\0';
+    PROF_LEAVE(saved);
+}
+
+void length_to_base4(long length, const int min_digits, char *out) {
+    char digits[LENGTH_BASE4_MAX];
+    int n = 0, i;
+
+    do {
+        digits[n++] = (char) ('a' + (length & 3));
+        length >>= 2;
+    } while (length > 0 && n < LENGTH_BASE4_MAX - 1);
+    while (n < min_digits) digits[n++] = 'a';
+    for (i = 0; i < n; i++) out[i] = digits[n - 1 - i];
+    out[n] = '\0';
 }
 
 /* Adds an external symbol usage to the context.
@@ -38,6 +57,22 @@ static void word_to_base4(WORD w, char *out, const int length) {
 static void add_extern(second_pass_ctx_t *ctx, const char *name, const int addr) {
     ext_usage_t u;
     size_t n;
+    char b4_address[5];
+    sig_atomic_t saved;
+
+    if (ctx->ob_fp) {
+        /* streaming: write the usage right away, the file exists only if used */
+        PROF_ENTER(saved, PROF_ACT_IO);
+        if (!ctx->ext_fp && !(ctx->ext_fp = fopen(ctx->ext_path, "w"))) {
+            ctx->out_failed = 1;
+            PROF_LEAVE(saved);
+            return;
+        }
+        word_to_base4((WORD) addr, b4_address, sizeof(b4_address));
+        fprintf(ctx->ext_fp, "%s\t%s\n", name, b4_address);
+        PROF_LEAVE(saved);
+        return;
+    }
 
     n = strlen(name);
     memcpy(u.name, name, n);
@@ -46,6 +81,50 @@ static void add_extern(second_pass_ctx_t *ctx, const char *name, const int addr)
     vec_push(&ctx->ext_list, &u);
 }
 
+/* Writes one "address<TAB>word" line of the object file in base-4. */
+static void write_word_line(FILE *fp, const int address, const WORD w) {
+    char b4_line[6];
+    char b4_address[5];
+    sig_atomic_t saved;
+
+    word_to_base4((WORD) address, b4_address, sizeof(b4_address));
+    word_to_base4(w, b4_line, sizeof(b4_line));
+    PROF_ENTER(saved, PROF_ACT_IO);
+    fprintf(fp, "%s\t%s\n", b4_address, b4_line);
+    PROF_LEAVE(saved);
+}
+
+/* Writes the object file header: code length and data length in base-4.
+ * The lengths take 3 and 2 digits, or more when they do not fit.
+ */
+static void write_ob_header(FILE *fp, const int code_len, const int data_len) {
+    char b4_code_length[LENGTH_BASE4_MAX];
+    char b4_data_length[LENGTH_BASE4_MAX];
+
+    length_to_base4(code_len, OB_CODE_DIGITS, b4_code_length);
+    fprintf(fp, "%s ", b4_code_length);
+    length_to_base4(data_len, OB_DATA_DIGITS, b4_data_length);
+    fprintf(fp, "%s\n", b4_data_length);
+}
+
+/* Appends an encoded word to the code image.
+ * In streaming mode the word goes straight to the object file instead.
+ */
+static void emit_code_word(second_pass_ctx_t *ctx, const WORD w) {
+    if (ctx->ob_fp) {
+        write_word_line(ctx->ob_fp, ADDRESS_BASE + ctx->code_pos, w);
+    } else if (vec_push(&ctx->code_image, &w) != 0) {
+        ctx->out_failed = 1;
+    }
+    ctx->code_pos++;
+}
+
+/* Appends an encoded word to the data image. */
+static void emit_data_word(second_pass_ctx_t *ctx, const WORD w) {
+    if (vec_push(&ctx->data_image, &w) != 0) ctx->out_failed = 1;
+    ctx->data_pos++;
+}
+
 /* encodes an operand into the code image.
  * It handles different addressing modes and returns the number of words used.
  * It returns -1 on error (e.g., symbol not found).
@@ -59,7 +138,7 @@ static int encode_operand(second_pass_ctx_t *ctx, const operand_t *op, symbol_ta
         case IMMEDIATE:
             w = (WORD) ((op->value.immediate_value) << 2);
             WORD_SET_ARE(w, ARE_A);
-            ctx->code_image[ctx->code_pos++] = w;
+            emit_code_word(ctx, w);
             return 1;
 
         case DIRECT:
@@ -73,7 +152,7 @@ static int encode_operand(second_pass_ctx_t *ctx, const operand_t *op, symbol_ta
                 w = (WORD) ((sym->address) << 2);
                 WORD_SET_ARE(w, ARE_R);
             }
-            ctx->code_image[ctx->code_pos++] = w;
+            emit_code_word(ctx, w);
             return 1;
 
         case MATRIX_ACCESS:
@@ -87,12 +166,12 @@ static int encode_operand(second_pass_ctx_t *ctx, const operand_t *op, symbol_ta
                 w = (WORD) ((sym->address) << 2);
                 WORD_SET_ARE(w, ARE_R);
             }
-            ctx->code_image[ctx->code_pos++] = w;
+            emit_code_word(ctx, w);
 
             /* row bits 6..9, col bits 2..5, are=a */
             w = (WORD) ((op->row_reg << 6) | (op->col_reg << 2));
             WORD_SET_ARE(w, ARE_A);
-            ctx->code_image[ctx->code_pos++] = w;
+            emit_code_word(ctx, w);
             return 2;
 
         case REGISTER_DIRECT:
@@ -102,7 +181,7 @@ static int encode_operand(second_pass_ctx_t *ctx, const operand_t *op, symbol_ta
             } else {
                 w = (WORD) ((op->value.reg_num << 2) | ARE_A);
             }
-            ctx->code_image[ctx->code_pos++] = w;
+            emit_code_word(ctx, w);
             return 1;
 
         default:
@@ -114,7 +193,7 @@ static int encode_operand(second_pass_ctx_t *ctx, const operand_t *op, symbol_ta
  * It handles the opcode, addressing modes, and operands.
  * It returns 0 on success, or -1 on error.
  */
-static int encode_instruction(second_pass_ctx_t *ctx, parsed_line *pl, symbol_table_t *st) {
+int encode_instruction(second_pass_ctx_t *ctx, parsed_line *pl, symbol_table_t *st) {
     WORD first_word;
     WORD reg_word;
     operand_t *src;
@@ -125,21 +204,22 @@ static int encode_instruction(second_pass_ctx_t *ctx, parsed_line *pl, symbol_ta
     src = &pl->body.operation.source_op;
     dst = &pl->body.operation.dest_op;
     n_ops = pl->body.operation.n_operands;
+    if (ctx->cost) cost_add(ctx->cost, pl, st, ADDRESS_BASE + ctx->code_pos);
 
     if (n_ops == 0) {
         first_word = FIRST_WORD((pl->body.operation.opcode), 0, 0, ARE_A);
-        ctx->code_image[ctx->code_pos++] = first_word;
+        emit_code_word(ctx, first_word);
         return 0; /* no operands, just the opcode */
     }
 
     /* first word opcode + addressing modes (are=00 for first line) */
     first_word = FIRST_WORD((pl->body.operation.opcode), (n_ops == 2) ? src->mode : 0, (n_ops > 1) ? dst->mode : src->mode, ARE_A);
-    ctx->code_image[ctx->code_pos++] = first_word;
+    emit_code_word(ctx, first_word);
 
     /* if both operands are registers, one shared reg word (src 6..9, dst 2..5) */
     if (n_ops == 2 && src->mode == REGISTER_DIRECT && dst->mode == REGISTER_DIRECT) {
         reg_word = (WORD) ((src->value.reg_num << 6) | ((dst->value.reg_num) << 2) | ARE_A);
-        ctx->code_image[ctx->code_pos++] = reg_word;
+        emit_code_word(ctx, reg_word);
         return 0;
     }
 
@@ -161,7 +241,7 @@ static int encode_instruction(second_pass_ctx_t *ctx, parsed_line *pl, symbol_ta
  * It handles operations and directives, encoding them into machine code.
  * It also manages external symbols and their usage.
  */
-static void encode_data(second_pass_ctx_t *ctx, parsed_line *pl) {
+void encode_data(second_pass_ctx_t *ctx, parsed_line *pl) {
     int i;
     WORD w;
     matrix_def_t *m;
@@ -171,7 +251,7 @@ static void encode_data(second_pass_ctx_t *ctx, parsed_line *pl) {
         case DATA_DIRECTIVE:
             for (i = 0; i < pl->body.directive.operands.data.count; ++i) {
                 w = (WORD) (pl->body.directive.operands.data.values[i]);
-                ctx->data_image[ctx->data_pos++] = w;
+                emit_data_word(ctx, w);
             }
             break;
 
@@ -179,18 +259,18 @@ static void encode_data(second_pass_ctx_t *ctx, parsed_line *pl) {
             s = pl->body.directive.operands.string_val;
             while (*s) {
                 w = (WORD) (*s);
-                ctx->data_image[ctx->data_pos++] = w;
+                emit_data_word(ctx, w);
                 ++s;
             }
             w = 0; /* null termnaitor */
-            ctx->data_image[ctx->data_pos++] = w;
+            emit_data_word(ctx, w);
             break;
 
         case MATRIX_DIRECTIVE:
             m = &pl->body.directive.operands.mat;
             for (i = 0; i < m->rows * m->cols; ++i) {
                 w = (WORD) (m->cells[i]);
-                ctx->data_image[ctx->data_pos++] = w;
+                emit_data_word(ctx, w);
             }
             break;
         default:
@@ -198,6 +278,58 @@ static void encode_data(second_pass_ctx_t *ctx, parsed_line *pl) {
     }
 }
 
+/* Writes the header and every code and data word of the object file to fp. */
+int write_ob_stream(FILE *fp, const second_pass_ctx_t *ctx) {
+    int i;
+
+    /* write code length and data length */
+    write_ob_header(fp, ctx->code_pos, ctx->data_pos);
+
+    for (i = 0; i < ctx->code_pos; ++i) {
+        write_word_line(fp, ADDRESS_BASE + i, *(WORD *) vec_get(&ctx->code_image, (size_t) i));
+    }
+    for (i = 0; i < ctx->data_pos; ++i) {
+        write_word_line(fp, ADDRESS_BASE + i + ctx->code_pos, *(WORD *) vec_get(&ctx->data_image, (size_t) i));
+    }
+    return ferror(fp) ? -1 : 0;
+}
+
+/* Writes one "name<TAB>address" line per entry symbol to fp. */
+int write_ent_stream(FILE *fp, symbol_table_t *st) {
+    hash_entry_t *it;
+    symbol_t *sym;
+    char b4_address[5]; /* 4 digits + null terminator */
+    sig_atomic_t saved;
+
+    PROF_ENTER(saved, PROF_ACT_IO);
+    for (it = hash_get_next(st, NULL); it; it = hash_get_next(st, it)) {
+        sym = (symbol_t *) (it->value);
+        if (sym && (sym->flags & SYM_ENTRY)) {
+            word_to_base4(sym->address, b4_address, sizeof(b4_address));
+            fprintf(fp, "%s\t%s\n", sym->name, b4_address );
+        }
+    }
+    PROF_LEAVE(saved);
+    return ferror(fp) ? -1 : 0;
+}
+
+/* Writes one "name<TAB>address" line per external symbol usage to fp. */
+int write_ext_stream(FILE *fp, const second_pass_ctx_t *ctx) {
+    const ext_usage_t *u;
+    size_t i;
+    char b4_address[5];
+    sig_atomic_t saved;
+
+    PROF_ENTER(saved, PROF_ACT_IO);
+    for (i = 0; i < ctx->ext_list.len; i++) {
+        u = (ext_usage_t *) vec_get(&ctx->ext_list, i);
+        word_to_base4(u->address, b4_address, sizeof(b4_address));
+        fprintf(fp, "%s\t%s\n", u->name, b4_address);
+    }
+    PROF_LEAVE(saved);
+    return ferror(fp) ? -1 : 0;
+}
+
 /* Write the object file (.ob)
  * It contains the code image and data image in base-4 format.
  * The first line contains the code length and data length in base-4.
@@ -206,11 +338,7 @@ static void encode_data(second_pass_ctx_t *ctx, parsed_line *pl) {
 static int write_ob_file(const char *base_name, const second_pass_ctx_t *ctx) {
     char *path;
     FILE *fp;
-    char b4_line[6];
-    char b4_address[5];
-    char b4_code_length[4];
-    char b4_data_length[3];
-    int i;
+    int result;
 
     path = create_file_path(base_name, ".ob");
     if (!path) return -1;
@@ -221,26 +349,10 @@ static int write_ob_file(const char *base_name, const second_pass_ctx_t *ctx) {
         return -1;
     }
 
-    /* write code length and data length */
-    word_to_base4(ctx->code_pos, b4_code_length, sizeof(b4_code_length));
-    fprintf(fp, "%s ", b4_code_length);
-    word_to_base4(ctx->data_pos, b4_data_length, sizeof(b4_data_length));
-    fprintf(fp, "%s\n", b4_data_length);
-
-    for (i = 0; i < ctx->code_pos; ++i) {
-        word_to_base4(ADDRESS_BASE + i, b4_address, sizeof(b4_address));
-        word_to_base4(ctx->code_image[i], b4_line, sizeof(b4_line));
-        fprintf(fp, "%s\t%s\n", b4_address, b4_line);
-    }
-    for (i = 0; i < ctx->data_pos; ++i) {
-        word_to_base4(ctx->data_image[i], b4_line, sizeof(b4_line));
-        word_to_base4(ADDRESS_BASE + i + ctx->code_pos , b4_address, sizeof(b4_address));
-        fprintf(fp, "%s\t%s\n", b4_address, b4_line);
-    }
-
-    fclose(fp);
+    result = write_ob_stream(fp, ctx);
+    if (fclose(fp) != 0) result = -1;
     free(path);
-    return 0;
+    return result;
 }
 
 /* write the entry symbols file (.ent)
@@ -253,14 +365,10 @@ static int write_ent_file(const char *base_name, symbol_table_t *st) {
     hash_entry_t *it;
     symbol_t *sym;
     int has_any;
-    char b4_address[5]; /* 4 digits + null terminator */
-
-    path = create_file_path(base_name, ".ent");
-    if (!path) return -1;
+    int result;
 
-    /* first pass: see if there are any entries */
+    /* see if there are any entries, the file exists only if there are */
     has_any = 0;
-    it = NULL;
     for (it = hash_get_next(st, NULL); it; it = hash_get_next(st, it)) {
         sym = (symbol_t *) (it->value);
         if (sym && (sym->flags & SYM_ENTRY)) {
@@ -268,10 +376,10 @@ static int write_ent_file(const char *base_name, symbol_table_t *st) {
             break;
         }
     }
-    if (!has_any) {
-        free(path);
-        return 0;
-    }
+    if (!has_any) return 0;
+
+    path = create_file_path(base_name, ".ent");
+    if (!path) return -1;
 
     fp = fopen(path, "w");
     if (!fp) {
@@ -279,18 +387,10 @@ static int write_ent_file(const char *base_name, symbol_table_t *st) {
         return -1;
     }
 
-    /* second pass: print them */
-    for (it = hash_get_next(st, NULL); it; it = hash_get_next(st, it)) {
-        sym = (symbol_t *) (it->value);
-        if (sym && (sym->flags & SYM_ENTRY)) {
-            word_to_base4(sym->address, b4_address, sizeof(b4_address));
-            fprintf(fp, "%s\t%s\n", sym->name, b4_address );
-        }
-    }
-
-    fclose(fp);
+    result = write_ent_stream(fp, st);
+    if (fclose(fp) != 0) result = -1;
     free(path);
-    return 0;
+    return result;
 }
 
 /* write the external symbols file (.ext)
@@ -300,9 +400,7 @@ static int write_ent_file(const char *base_name, symbol_table_t *st) {
 static int write_ext_file(const char *base_name, const second_pass_ctx_t *ctx) {
     char *path;
     FILE *fp;
-    const ext_usage_t *u;
-    size_t i;
-    char b4_address[5];
+    int result;
 
     if (ctx->ext_list.len == 0) return 0;
 
@@ -315,68 +413,169 @@ static int write_ext_file(const char *base_name, const second_pass_ctx_t *ctx) {
         return -1;
     }
 
-    for (i = 0; i < ctx->ext_list.len; i++) {
-        u = (ext_usage_t *) vec_get(&ctx->ext_list, i);
-        word_to_base4(u->address, b4_address, sizeof(b4_address));
-        fprintf(fp, "%s\t%s\n", u->name, b4_address);
-    }
-
-    fclose(fp);
+    result = write_ext_stream(fp, ctx);
+    if (fclose(fp) != 0) result = -1;
     free(path);
-    return 0;
+    return result;
 }
 
-int second_pass(const char *input_path, const char *file_name, symbol_table_t *symtab) {
-    second_pass_ctx_t ctx;
-    FILE *fp;
+void second_pass_ctx_destroy(second_pass_ctx_t *ctx) {
+    if (!ctx) return;
+    vec_destroy(&ctx->code_image);
+    vec_destroy(&ctx->data_image);
+    vec_destroy(&ctx->ext_list);
+}
+
+/* Encodes the source of fp into ctx, see second_pass_stream. */
+static int encode_stream(FILE *fp, const char *file_name, symbol_table_t *symtab, second_pass_ctx_t *ctx,
+                         cost_t *cost) {
     char line_buf[MAX_LINE_LENGTH];
     parsed_line pl;
     error_code_t st;
-    int error_flag = 0;
     int line_no = 0;
 
-    memset(&ctx, 0, sizeof(ctx)); /* zero init */
-    vec_create(&ctx.ext_list, sizeof(ext_usage_t)); /* initialize vector for external usage tracking */
+    if (!ctx) return -1;
+    memset(ctx, 0, sizeof(*ctx)); /* zero init */
+    vec_create(&ctx->code_image, sizeof(WORD));
+    vec_create(&ctx->data_image, sizeof(WORD));
+    vec_create(&ctx->ext_list, sizeof(ext_usage_t)); /* initialize vector for external usage tracking */
+    ctx->cost = cost;
 
-    if (!input_path || !symtab) return -1;
-
-    fp = fopen(input_path, "r");
-    if (!fp) {
-        print_error_file(file_name, ERROR_CANNOT_OPEN_FILE, 0);
-        return -1;
-    }
+    if (!fp || !symtab) return -1;
 
-    while (fgets(line_buf, sizeof(line_buf), fp)) {
+    while (prof_fgets(line_buf, sizeof(line_buf), fp)) {
         line_no++;
         st = parse_line(line_buf, &pl);
         if (st != ERROR_OK) continue;
 
         if (pl.kind == LINE_OPERATION) {
-            error_flag = encode_instruction(&ctx, &pl, symtab);
-            if (error_flag < 0) {
-                fclose(fp);
-                vec_destroy(&ctx.ext_list);
+            if (encode_instruction(ctx, &pl, symtab) < 0) {
                 print_error_file(file_name, ERROR_UNDEFINED_SYMBOL_USED, line_no);
                 return -1;
             }
         } else if (pl.kind == LINE_DIRECTIVE) {
             if (pl.body.directive.type == DATA_DIRECTIVE || pl.body.directive.type == STRING_DIRECTIVE || pl.body.directive.type == MATRIX_DIRECTIVE) {
-                encode_data(&ctx, &pl);
+                encode_data(ctx, &pl);
             }
         }
     }
 
+    if (ctx->out_failed) {
+        print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+        return -1;
+    }
+    return 0;
+}
+
+int second_pass_stream(FILE *fp, const char *file_name, symbol_table_t *symtab, second_pass_ctx_t *ctx) {
+    return encode_stream(fp, file_name, symtab, ctx, NULL);
+}
+
+int second_pass(const char *input_path, const char *file_name, symbol_table_t *symtab, cost_t *cost) {
+    second_pass_ctx_t ctx;
+    FILE *fp;
+    int result;
+
+    if (!input_path || !symtab) return -1;
+
+    fp = fopen(input_path, "r");
+    if (!fp) {
+        print_error_file(file_name, ERROR_CANNOT_OPEN_FILE, 0);
+        return -1;
+    }
+
+    result = encode_stream(fp, file_name, symtab, &ctx, cost);
     fclose(fp);
+    if (result != 0) {
+        second_pass_ctx_destroy(&ctx);
+        return -1;
+    }
 
     /* write outputs */
     if (write_ob_file(file_name, &ctx) != 0 ||
         write_ent_file(file_name, symtab) != 0 ||
         write_ext_file(file_name, &ctx) != 0) {
-        vec_destroy(&ctx.ext_list);
+        second_pass_ctx_destroy(&ctx);
         print_error(ERROR_WRITE_FAILED);
         return -1;
     }
 
-    vec_destroy(&ctx.ext_list);
+    second_pass_ctx_destroy(&ctx);
     return 0;
-}
\ No newline at end of file
+}
+
+int second_pass_spill(spill_t *spill, const char *file_name, symbol_table_t *symtab, cost_t *cost) {
+    second_pass_ctx_t ctx;
+    parsed_line pl;
+    char *ob_path;
+    char *ext_path;
+    WORD w;
+    int line_no = 0;
+    int rc;
+    int result = 0;
+
+    if (!spill || !file_name || !symtab) return -1;
+
+    memset(&ctx, 0, sizeof(ctx)); /* zero init, images stay empty while streaming */
+    ob_path = create_file_path(file_name, ".ob");
+    ext_path = create_file_path(file_name, ".ext");
+    if (!ob_path || !ext_path || spill_rewind(spill) != 0) {
+        free(ob_path);
+        free(ext_path);
+        print_error(ERROR_WRITE_FAILED);
+        return -1;
+    }
+
+    ctx.ext_path = ext_path;
+    ctx.cost = cost;
+    ctx.ob_fp = fopen(ob_path, "w");
+    if (!ctx.ob_fp) {
+        free(ob_path);
+        free(ext_path);
+        print_error_file(file_name, ERROR_CANNOT_OPEN_FILE, 0);
+        return -1;
+    }
+
+    /* the first pass already counted both images, so the header goes first */
+    write_ob_header(ctx.ob_fp, (int) spill->code_words, (int) spill->data_words);
+
+    while ((rc = spill_get_instruction(spill, &pl, &line_no)) > 0) {
+        if (encode_instruction(&ctx, &pl, symtab) < 0) {
+            print_error_file(file_name, ERROR_UNDEFINED_SYMBOL_USED, line_no);
+            result = -1;
+            break;
+        }
+    }
+    if (rc < 0) {
+        print_error(ERROR_WRITE_FAILED); /* spill record could not be read back */
+        result = -1;
+    }
+
+    /* data image follows the code image */
+    while (result == 0 && spill_get_data_word(spill, &w)) {
+        write_word_line(ctx.ob_fp, ADDRESS_BASE + ctx.code_pos + ctx.data_pos, w);
+        ctx.data_pos++;
+    }
+
+    if (ferror(ctx.ob_fp) || (ctx.ext_fp && ferror(ctx.ext_fp))) ctx.out_failed = 1;
+    if (fclose(ctx.ob_fp) != 0) ctx.out_failed = 1;
+    if (ctx.ext_fp && fclose(ctx.ext_fp) != 0) ctx.out_failed = 1;
+
+    if (result == 0 && ctx.out_failed) {
+        print_error(ERROR_WRITE_FAILED);
+        result = -1;
+    }
+    if (result == 0 && write_ent_file(file_name, symtab) != 0) {
+        print_error(ERROR_WRITE_FAILED);
+        result = -1;
+    }
+
+    if (result != 0) {
+        /* no partial outputs, same as the in-memory second pass */
+        remove(ob_path);
+        if (ctx.ext_fp) remove(ext_path);
+    }
+    free(ob_path);
+    free(ext_path);
+    return result;
+}
@@ -0,0 +1,316 @@
+#define _POSIX_C_SOURCE 200809L /* shm_open, mmap, robust process-shared mutexes */
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "../include/shm_cache.h"
+
+/*
+ * =====================================================================================
+ * Filename:  shm_cache.c
+ * Description: Implementation of the shared-memory build cache.
+ * The segment layout is [header][slots][arena]. The arena is a bump allocator,
+ * when it (or the index) is full the cache is recycled as a whole, which keeps
+ * the shared structure trivial and crash tolerant.
+ * A process that dies while holding the lock leaves a robust mutex behind, the
+ * next owner recycles the cache since its state may be half written. A segment
+ * whose creator died before publishing it, or which belongs to a build with
+ * another layout, is unlinked and created again.
+ * =====================================================================================
+ */
+
+#define SHM_CACHE_MAGIC 0x41534d43UL /* "ASMC" */
+#define SHM_CACHE_VERSION 1UL
+#define SHM_CACHE_ATTACH_TRIES 200 /* wait at most ~2s for the creator */
+#define SHM_CACHE_STALE (-2) /* open_segment: the existing segment will never be usable */
+
+/* struct shm_cache_header lives at the start of the segment. */
+struct shm_cache_header {
+    unsigned long magic; /* published last by the creator, see publish_magic */
+    unsigned long version;
+    pthread_mutex_t lock; /* process-shared, robust */
+    unsigned long n_slots;
+    unsigned long n_used; /* occupied slots */
+    unsigned long arena_size;
+    unsigned long arena_used; /* bump pointer */
+};
+
+/* struct shm_cache_slot is one index entry. */
+struct shm_cache_slot {
+    content_key_t key;
+    unsigned long offset; /* content offset in the arena */
+    unsigned long length; /* content length */
+    int used;
+};
+
+/* --- Private Helper Functions --- */
+
+/* Total size of the segment. */
+static size_t segment_size(void) {
+    return sizeof(struct shm_cache_header) + SHM_CACHE_SLOTS * sizeof(struct shm_cache_slot) +
+           SHM_CACHE_ARENA_SIZE;
+}
+
+/* Sleep for about 10ms while waiting for the creator. */
+static void short_sleep(void) {
+    struct timespec ts;
+    ts.tv_sec = 0;
+    ts.tv_nsec = 10000000L;
+    nanosleep(&ts, NULL);
+}
+
+/* Publish the initialized header: the release store orders every write of the
+ * creator before magic, so an attacher that observes magic sees the whole header.
+ */
+static void publish_magic(struct shm_cache_header *hdr) {
+    __atomic_store_n(&hdr->magic, SHM_CACHE_MAGIC, __ATOMIC_RELEASE);
+}
+
+/* Returns nonzero once the header is published, pairing with publish_magic. */
+static int magic_published(struct shm_cache_header *hdr) {
+    return __atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) == SHM_CACHE_MAGIC;
+}
+
+/* Forget every entry. Called with the lock held. */
+static void recycle(shm_cache_t *cache) {
+    memset(cache->slots, 0, SHM_CACHE_SLOTS * sizeof(struct shm_cache_slot));
+    cache->hdr->n_used = 0;
+    cache->hdr->arena_used = 0;
+}
+
+/* Take the segment lock, recovering from a dead owner.
+ * Returns 0 on success, -1 on failure.
+ */
+static int lock_cache(shm_cache_t *cache) {
+    int rc = pthread_mutex_lock(&cache->hdr->lock);
+    if (rc == EOWNERDEAD) {
+        /* previous owner died mid update, its entry may be torn */
+        recycle(cache);
+        pthread_mutex_consistent(&cache->hdr->lock);
+        return 0;
+    }
+    return rc == 0 ? 0 : -1;
+}
+
+static void unlock_cache(shm_cache_t *cache) {
+    pthread_mutex_unlock(&cache->hdr->lock);
+}
+
+/* Initialize a freshly created segment. Returns 0 on success. */
+static int init_segment(shm_cache_t *cache) {
+    pthread_mutexattr_t attr;
+    struct shm_cache_header *hdr = cache->hdr;
+
+    if (pthread_mutexattr_init(&attr) != 0) return -1;
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    if (pthread_mutex_init(&hdr->lock, &attr) != 0) {
+        pthread_mutexattr_destroy(&attr);
+        return -1;
+    }
+    pthread_mutexattr_destroy(&attr);
+
+    hdr->version = SHM_CACHE_VERSION;
+    hdr->n_slots = SHM_CACHE_SLOTS;
+    hdr->arena_size = SHM_CACHE_ARENA_SIZE;
+    recycle(cache);
+    publish_magic(hdr);
+    return 0;
+}
+
+/* Fill the process local pointers from the mapping base. */
+static void set_pointers(shm_cache_t *cache) {
+    char *p = (char *) cache->base;
+    cache->hdr = (struct shm_cache_header *) p;
+    cache->slots = (struct shm_cache_slot *) (p + sizeof(struct shm_cache_header));
+    cache->arena = p + sizeof(struct shm_cache_header) + SHM_CACHE_SLOTS * sizeof(struct shm_cache_slot);
+}
+
+/* Find the slot of a key, or the empty slot where it belongs. Lock must be held. */
+static struct shm_cache_slot *probe(shm_cache_t *cache, const content_key_t *key) {
+    unsigned long i, mask = SHM_CACHE_SLOTS - 1;
+    struct shm_cache_slot *s;
+
+    for (i = key->fnv & mask;; i = (i + 1) & mask) {
+        s = &cache->slots[i];
+        if (!s->used || content_key_equal(&s->key, key)) return s;
+    }
+}
+
+/* Create the segment, or attach to the existing one once its creator published it.
+ * Returns 0 on success, SHM_CACHE_STALE if the existing segment is never published
+ * or has another layout, -1 on failure.
+ */
+static int open_segment(shm_cache_t *cache, const char *name) {
+    int fd;
+    int created = 1;
+    int tries;
+    struct stat st;
+    size_t size = segment_size();
+
+    memset(cache, 0, sizeof(*cache));
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0 && errno == EEXIST) {
+        created = 0;
+        fd = shm_open(name, O_RDWR, 0600);
+    }
+    if (fd < 0) return -1;
+
+    if (created) {
+        if (ftruncate(fd, (off_t) size) != 0) {
+            close(fd);
+            shm_unlink(name);
+            return -1;
+        }
+    } else {
+        /* the creator may not have sized the segment yet, any other size is another build */
+        for (tries = 0; fstat(fd, &st) == 0 && (size_t) st.st_size != size; tries++) {
+            if (st.st_size != 0 || tries == SHM_CACHE_ATTACH_TRIES) {
+                close(fd);
+                return SHM_CACHE_STALE;
+            }
+            short_sleep();
+        }
+    }
+
+    cache->base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (cache->base == MAP_FAILED) {
+        cache->base = NULL;
+        return -1;
+    }
+    cache->map_size = size;
+    set_pointers(cache);
+
+    if (created) {
+        if (init_segment(cache) != 0) {
+            shm_cache_close(cache);
+            shm_unlink(name);
+            return -1;
+        }
+        return 0;
+    }
+
+    for (tries = 0; !magic_published(cache->hdr); tries++) {
+        if (tries == SHM_CACHE_ATTACH_TRIES) {
+            shm_cache_close(cache); /* the creator died before publishing */
+            return SHM_CACHE_STALE;
+        }
+        short_sleep();
+    }
+    if (cache->hdr->version != SHM_CACHE_VERSION || cache->hdr->n_slots != SHM_CACHE_SLOTS ||
+        cache->hdr->arena_size != SHM_CACHE_ARENA_SIZE) {
+        shm_cache_close(cache); /* segment of an incompatible build */
+        return SHM_CACHE_STALE;
+    }
+    return 0;
+}
+
+/* --- Public API Functions Implementation --- */
+
+int shm_cache_open(shm_cache_t *cache, const char *name) {
+    int rc;
+
+    if (!cache || !name) return -1;
+    rc = open_segment(cache, name);
+    if (rc == SHM_CACHE_STALE) {
+        /* processes already attached keep their mapping, new ones get a fresh segment */
+        shm_unlink(name);
+        rc = open_segment(cache, name);
+    }
+    return rc == 0 ? 0 : -1;
+}
+
+void shm_cache_close(shm_cache_t *cache) {
+    if (!cache || !cache->base) return;
+    munmap(cache->base, cache->map_size);
+    memset(cache, 0, sizeof(*cache));
+}
+
+int shm_cache_fetch(shm_cache_t *cache, const content_key_t *key, FILE *out) {
+    struct shm_cache_slot *s;
+    char *copy = NULL;
+    unsigned long length = 0;
+    int hit = 0;
+
+    if (!cache || !cache->base || !key || !out) return -1;
+
+    if (lock_cache(cache) != 0) return -1;
+    s = probe(cache, key);
+    if (s->used) {
+        /* copy out under the lock, write to the file without it */
+        length = s->length;
+        copy = malloc(length ? length : 1);
+        if (copy) {
+            memcpy(copy, cache->arena + s->offset, length);
+            hit = 1;
+        } else {
+            hit = -1;
+        }
+    }
+    unlock_cache(cache);
+
+    if (hit != 1) return hit;
+    if (fwrite(copy, 1, length, out) != length) hit = -1;
+    free(copy);
+    return hit;
+}
+
+int shm_cache_store(shm_cache_t *cache, const content_key_t *key, const char *path) {
+    FILE *fp;
+    char *buf;
+    long size;
+    struct shm_cache_slot *s;
+    struct shm_cache_header *hdr;
+
+    if (!cache || !cache->base || !key || !path) return -1;
+
+    fp = fopen(path, "rb");
+    if (!fp) return -1;
+    if (fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) < 0) {
+        fclose(fp);
+        return -1;
+    }
+    if ((unsigned long) size > SHM_CACHE_MAX_ENTRY) {
+        fclose(fp);
+        return 0; /* too large to be worth caching */
+    }
+    rewind(fp);
+    buf = malloc(size ? (size_t) size : 1);
+    if (!buf || fread(buf, 1, (size_t) size, fp) != (size_t) size) {
+        free(buf);
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+
+    if (lock_cache(cache) != 0) {
+        free(buf);
+        return -1;
+    }
+    hdr = cache->hdr;
+    s = probe(cache, key);
+    if (!s->used) {
+        if (hdr->arena_used + (unsigned long) size > hdr->arena_size ||
+            (hdr->n_used + 1) * 4 > hdr->n_slots * 3) {
+            recycle(cache);
+            s = probe(cache, key);
+        }
+        memcpy(cache->arena + hdr->arena_used, buf, (size_t) size);
+        s->key = *key;
+        s->offset = hdr->arena_used;
+        s->length = (unsigned long) size;
+        s->used = 1;
+        hdr->arena_used += (unsigned long) size;
+        hdr->n_used++;
+    }
+    unlock_cache(cache);
+    free(buf);
+    return 0;
+}
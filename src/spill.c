@@ -0,0 +1,211 @@
+#include <stdio.h>
+#include <string.h>
+#include "../include/spill.h"
+
+/*
+ * =====================================================================================
+ * Filename:  spill.c
+ * Description: Temporary spill files for the memory-bounded mode of the assembler.
+ * Instruction records are stored in a compact variable length format (a few bytes
+ * per operand instead of a full parsed_line) and data words are stored encoded,
+ * so the second pass never has to re-read or re-parse the source.
+ * Spill files are temporary and read back by the same process only, so values are
+ * stored in native byte order.
+ * =====================================================================================
+ */
+
+/* --- Private Helper Functions --- */
+
+/* Write a single byte, returns 0 on success. */
+static int put_byte(FILE *fp, int b) {
+    return fputc((unsigned char) b, fp) == EOF ? -1 : 0;
+}
+
+/* Write a native int, returns 0 on success. */
+static int put_int(FILE *fp, int v) {
+    return fwrite(&v, sizeof(v), 1, fp) == 1 ? 0 : -1;
+}
+
+/* Write a label as a length byte followed by its characters. */
+static int put_label(FILE *fp, const char *label) {
+    size_t n = strlen(label);
+    if (put_byte(fp, (int) n) != 0) return -1;
+    return fwrite(label, 1, n, fp) == n ? 0 : -1;
+}
+
+/* Read a single byte, returns -1 at end of file. */
+static int get_byte(FILE *fp) {
+    int c = fgetc(fp);
+    return c == EOF ? -1 : c;
+}
+
+/* Read a native int, returns 0 on success. */
+static int get_int(FILE *fp, int *v) {
+    return fread(v, sizeof(*v), 1, fp) == 1 ? 0 : -1;
+}
+
+/* Read a length prefixed label into out (MAX_LABEL_LENGTH bytes). */
+static int get_label(FILE *fp, char *out) {
+    int n = get_byte(fp);
+    if (n < 0 || n >= MAX_LABEL_LENGTH) return -1;
+    if (fread(out, 1, (size_t) n, fp) != (size_t) n) return -1;
+    out[n] = '\0';
+    return 0;
+}
+
+/* Write one operand: mode byte followed by the mode specific payload. */
+static int put_operand(FILE *fp, const operand_t *op) {
+    if (put_byte(fp, op->mode) != 0) return -1;
+    switch (op->mode) {
+        case IMMEDIATE:
+            return put_int(fp, op->value.immediate_value);
+        case REGISTER_DIRECT:
+            return put_byte(fp, op->value.reg_num);
+        case DIRECT:
+            return put_label(fp, op->value.label);
+        case MATRIX_ACCESS:
+            if (put_label(fp, op->value.label) != 0) return -1;
+            if (put_byte(fp, op->row_reg) != 0) return -1;
+            return put_byte(fp, op->col_reg);
+        default:
+            return -1;
+    }
+}
+
+/* Read one operand written by put_operand. */
+static int get_operand(FILE *fp, operand_t *op) {
+    int b;
+
+    b = get_byte(fp);
+    if (b < 0) return -1;
+    op->mode = (addressing_mode_t) b;
+    switch (op->mode) {
+        case IMMEDIATE:
+            return get_int(fp, &op->value.immediate_value);
+        case REGISTER_DIRECT:
+            if ((b = get_byte(fp)) < 0) return -1;
+            op->value.reg_num = b;
+            return 0;
+        case DIRECT:
+            return get_label(fp, op->value.label);
+        case MATRIX_ACCESS:
+            if (get_label(fp, op->value.label) != 0) return -1;
+            if ((b = get_byte(fp)) < 0) return -1;
+            op->row_reg = b;
+            if ((b = get_byte(fp)) < 0) return -1;
+            op->col_reg = b;
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+/* Append a single data word to the data spill. */
+static int put_data_word(spill_t *sp, WORD w) {
+    if (fwrite(&w, sizeof(w), 1, sp->data_fp) != 1) return -1;
+    sp->data_words++;
+    return 0;
+}
+
+/* Give a spill file a buffer of the requested size (stdio allocates it). */
+static void set_spill_buffer(FILE *fp, long size) {
+    if (size < SPILL_MIN_BUFFER) size = SPILL_MIN_BUFFER;
+    setvbuf(fp, NULL, _IOFBF, (size_t) size);
+}
+
+/* --- Public API Functions Implementation --- */
+
+int spill_open(spill_t *sp, const long mem_budget) {
+    if (!sp) return -1;
+    memset(sp, 0, sizeof(*sp));
+
+    sp->stmt_fp = tmpfile();
+    sp->data_fp = tmpfile();
+    if (!sp->stmt_fp || !sp->data_fp) {
+        spill_close(sp);
+        return -1;
+    }
+    /* half of the budget for each file, the rest of the assembler is constant size */
+    set_spill_buffer(sp->stmt_fp, mem_budget / 2);
+    set_spill_buffer(sp->data_fp, mem_budget / 2);
+    return 0;
+}
+
+void spill_close(spill_t *sp) {
+    if (!sp) return;
+    if (sp->stmt_fp) fclose(sp->stmt_fp);
+    if (sp->data_fp) fclose(sp->data_fp);
+    sp->stmt_fp = NULL;
+    sp->data_fp = NULL;
+}
+
+int spill_put_instruction(spill_t *sp, const parsed_line *pl, const int line_no, const int n_words) {
+    const int n_ops = pl->body.operation.n_operands;
+
+    if (put_int(sp->stmt_fp, line_no) != 0) return -1;
+    if (put_byte(sp->stmt_fp, pl->body.operation.opcode) != 0) return -1;
+    if (put_byte(sp->stmt_fp, n_ops) != 0) return -1;
+    if (n_ops >= 1 && put_operand(sp->stmt_fp, &pl->body.operation.source_op) != 0) return -1;
+    if (n_ops >= 2 && put_operand(sp->stmt_fp, &pl->body.operation.dest_op) != 0) return -1;
+
+    sp->code_words += n_words;
+    return 0;
+}
+
+int spill_put_data(spill_t *sp, const parsed_line *pl) {
+    int i;
+    const char *s;
+    const matrix_def_t *m;
+
+    switch (pl->body.directive.type) {
+        case DATA_DIRECTIVE:
+            for (i = 0; i < pl->body.directive.operands.data.count; ++i) {
+                if (put_data_word(sp, (WORD) pl->body.directive.operands.data.values[i]) != 0) return -1;
+            }
+            return 0;
+
+        case STRING_DIRECTIVE:
+            for (s = pl->body.directive.operands.string_val; *s; ++s) {
+                if (put_data_word(sp, (WORD) *s) != 0) return -1;
+            }
+            return put_data_word(sp, 0); /* null terminator */
+
+        case MATRIX_DIRECTIVE:
+            m = &pl->body.directive.operands.mat;
+            for (i = 0; i < m->rows * m->cols; ++i) {
+                if (put_data_word(sp, (WORD) m->cells[i]) != 0) return -1;
+            }
+            return 0;
+
+        default:
+            return 0; /* .entry/.extern take no space */
+    }
+}
+
+int spill_rewind(spill_t *sp) {
+    if (fflush(sp->stmt_fp) != 0 || fflush(sp->data_fp) != 0) return -1;
+    rewind(sp->stmt_fp);
+    rewind(sp->data_fp);
+    return 0;
+}
+
+int spill_get_instruction(spill_t *sp, parsed_line *pl, int *line_no) {
+    int b;
+
+    if (get_int(sp->stmt_fp, line_no) != 0) return 0; /* clean end of spill */
+
+    memset(pl, 0, sizeof(*pl));
+    pl->kind = LINE_OPERATION;
+    if ((b = get_byte(sp->stmt_fp)) < 0) return -1;
+    pl->body.operation.opcode = (op_code_t) b;
+    if ((b = get_byte(sp->stmt_fp)) < 0 || b > 2) return -1;
+    pl->body.operation.n_operands = b;
+
+    if (b >= 1 && get_operand(sp->stmt_fp, &pl->body.operation.source_op) != 0) return -1;
+    if (b >= 2 && get_operand(sp->stmt_fp, &pl->body.operation.dest_op) != 0) return -1;
+    return 1;
+}
+
+int spill_get_data_word(spill_t *sp, WORD *w) {
+    return fread(w, sizeof(*w), 1, sp->data_fp) == 1 ? 1 : 0;
+}
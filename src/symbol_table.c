@@ -2,6 +2,7 @@
 #include <string.h>
 #include "../include/symbol_table.h"
 #include "../include/globals.h"
+#include "../include/profile.h"
 
 
 /*
@@ -26,9 +27,12 @@ static int check_symbol_conflicts(int existing_flags, int new_flags) {
 
 int symtab_insert(symbol_table_t *st, const char *name, const int address, const int add_flags) {
     symbol_t *s;
+    sig_atomic_t saved;
     if (!st || !name) return 0;
 
+    PROF_ENTER(saved, PROF_ACT_SYMBOL_LOOKUP);
     s = (symbol_t *) hash_get(st, name);
+    PROF_LEAVE(saved);
     if (s) {
         if (check_symbol_conflicts(s->flags, add_flags)) return 0;
 
@@ -47,10 +51,13 @@ int symtab_insert(symbol_table_t *st, const char *name, const int address, const
     s->address = address;
     s->flags = add_flags;
 
+    PROF_ENTER(saved, PROF_ACT_SYMBOL_LOOKUP);
     if (hash_put(st, s->name, s) != 0) {
+        PROF_LEAVE(saved);
         free(s);
         return 0;
     }
+    PROF_LEAVE(saved);
     return 1;
 }
 
@@ -63,7 +70,14 @@ void symtab_destroy(symbol_table_t *st) {
 }
 
 symbol_t *symtab_lookup(symbol_table_t *st, const char *name) {
-    return st ? (symbol_t *) hash_get(st, name) : NULL;
+    symbol_t *s;
+    sig_atomic_t saved;
+
+    if (!st) return NULL;
+    PROF_ENTER(saved, PROF_ACT_SYMBOL_LOOKUP);
+    s = (symbol_t *) hash_get(st, name);
+    PROF_LEAVE(saved);
+    return s;
 }
 
 void symtab_bump_data_addresses(symbol_table_t *st, const int ic_final) {
@@ -7,10 +7,15 @@
  * =====================================================================================
  * Filename: util_hash.c
  * Description: Implementation of a generic hash table using the djb2 hash
- * function and collision resolution with the Chaining method.
+ * function and collision resolution with the Chaining method, and of the
+ * content keys of files.
  * =====================================================================================
  */
 
+#define FNV_OFFSET 2166136261UL
+#define FNV_PRIME 16777619UL
+#define CONTENT_CHUNK 8192 /* bytes hashed per read */
+
 /* --- Private Helper Functions --- */
 
 /* The djb2 hash function.
@@ -52,6 +57,32 @@ static char *dupstr(const char *str) {
     return dup;
 }
 
+/* Doubles the capacity of the table and relinks every entry into its new bucket.
+ * The stored hashes make this a pass over the entries without rehashing the keys.
+ * Returns 0 on success, -1 if memory allocation fails (the table is unchanged).
+ */
+static int grow(hash_table_t *ht) {
+    size_t i, new_capacity, index;
+    hash_entry_t **new_tbl, *entry, *next;
+
+    new_capacity = ht->capacity * 2;
+    new_tbl = calloc(new_capacity, sizeof(hash_entry_t *));
+    if (!new_tbl) return -1;
+
+    for (i = 0; i < ht->capacity; i++) {
+        for (entry = ht->tbl[i]; entry; entry = next) {
+            next = entry->next;
+            index = entry->hash & (new_capacity - 1);
+            entry->next = new_tbl[index];
+            new_tbl[index] = entry;
+        }
+    }
+    free(ht->tbl);
+    ht->tbl = new_tbl;
+    ht->capacity = new_capacity;
+    return 0;
+}
+
 /* Public API Functions Implementation */
 
 hash_table_t *hash_create(size_t pow2_cap) {
@@ -110,7 +141,7 @@ int hash_put(hash_table_t *ht, const char *key, void *value) {
     entry = ht->tbl[index]; /* get head of the chain */
     /* check if the key already exists in the chain */
     while (entry) {
-        if (strcmp(entry->key, key) == 0) {
+        if (entry->hash == hash && strcmp(entry->key, key) == 0) {
             /* key already exists, update value */
             entry->value = value;
             return 0;
@@ -128,10 +159,13 @@ int hash_put(hash_table_t *ht, const char *key, void *value) {
         return -1;
     }
     new_entry->value = value;
+    new_entry->hash = hash;
     new_entry->next = ht->tbl[index]; /* point to the current head of the chain */
     ht->tbl[index] = new_entry; /* insert at the head of the chain */
     ht->size++;
 
+    /* keep the chains short, a failed growth only costs longer chains */
+    if (ht->size > ht->capacity * HASH_MAX_LOAD) grow(ht);
     return 0;
 }
 
@@ -149,7 +183,7 @@ void *hash_get(const hash_table_t *ht, const char *key) {
     if (!ht->tbl || !ht->tbl[index]) return NULL; /* hash table is empty or key not found */
 
     for (entry = ht->tbl[index]; entry; entry = entry->next) {
-        if (strcmp(entry->key, key) == 0) {
+        if (entry->hash == hash && strcmp(entry->key, key) == 0) {
             return entry->value; /* key found return value */
         }
     }
@@ -170,7 +204,7 @@ int hash_remove(hash_table_t *ht, const char *key, void (*destroy_val)(void *))
 
     entry = ht->tbl[index]; /* get head of the chain */
     while (entry) {
-        if (strcmp(entry->key, key) == 0) {
+        if (entry->hash == hash && strcmp(entry->key, key) == 0) {
             /* key found remove it */
             if (prev) {
                 prev->next = entry->next; /* bypass the entry to remove it */
@@ -205,7 +239,7 @@ hash_entry_t *hash_get_next(hash_table_t *ht, const hash_entry_t *current) {
             return current->next;
         }
         /* otherwise find the next bucket to start searching from */
-        index = (djb2(current->key) & (ht->capacity - 1)) + 1;
+        index = (current->hash & (ht->capacity - 1)) + 1;
     }
     /* find the next nonempty bucket and return its first entry */
     for (; index < ht->capacity; index++) {
@@ -216,3 +250,31 @@ hash_entry_t *hash_get_next(hash_table_t *ht, const hash_entry_t *current) {
     /* no more entries found */
     return NULL;
 }
+
+int content_key_file(const char *path, content_key_t *key) {
+    FILE *fp;
+    unsigned char buf[CONTENT_CHUNK];
+    size_t n, i;
+
+    if (!path || !key) return -1;
+    fp = fopen(path, "rb");
+    if (!fp) return -1;
+
+    key->fnv = FNV_OFFSET;
+    key->djb = HASH_STARTING_VAL;
+    key->len = 0;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        for (i = 0; i < n; i++) {
+            key->fnv = (key->fnv ^ buf[i]) * FNV_PRIME;
+            key->djb = ((key->djb << DJ_SHIFT) + key->djb) + buf[i];
+        }
+        key->len += n;
+    }
+    n = (size_t) ferror(fp);
+    fclose(fp);
+    return n ? -1 : 0;
+}
+
+int content_key_equal(const content_key_t *a, const content_key_t *b) {
+    return a->fnv == b->fnv && a->djb == b->djb && a->len == b->len;
+}
@@ -0,0 +1,119 @@
+#define _POSIX_C_SOURCE 200809L /* pthreads */
+#include <pthread.h>
+#include <stdlib.h>
+#include "../include/util_pool.h"
+
+/*
+ * =====================================================================================
+ * Filename:  util_pool.c
+ * Description: Implementation of the worker pool. Items are handed out one at a
+ * time under a mutex, which balances uneven items (files of very different size)
+ * and keeps the order in which items start deterministic.
+ * =====================================================================================
+ */
+
+/* shared state of one pool_run call */
+typedef struct {
+    pthread_mutex_t lock;
+    size_t next; /* next item to hand out */
+    size_t n_items;
+    pool_task_fn task;
+    void *arg;
+    jobserver_t *js;
+} pool_t;
+
+/* per thread start argument */
+typedef struct {
+    pool_t *pool;
+    int id;
+} pool_worker_t;
+
+/* --- Private Helper Functions --- */
+
+/* Takes the next item. Returns 1 and sets *item, or 0 if none is left. */
+static int take_item(pool_t *p, size_t *item) {
+    int ok = 0;
+    pthread_mutex_lock(&p->lock);
+    if (p->next < p->n_items) {
+        *item = p->next++;
+        ok = 1;
+    }
+    pthread_mutex_unlock(&p->lock);
+    return ok;
+}
+
+/* keep_waiting callback of the jobserver: wait for a token only while work is left */
+static int work_left(void *arg) {
+    pool_t *p = arg;
+    int left;
+    pthread_mutex_lock(&p->lock);
+    left = p->next < p->n_items;
+    pthread_mutex_unlock(&p->lock);
+    return left;
+}
+
+/* Main loop of a worker. Worker 0 runs on make's implicit token. */
+static void worker_loop(pool_t *p, int id) {
+    unsigned char token = 0;
+    int has_token;
+    size_t item;
+
+    for (;;) {
+        has_token = 0;
+        if (id > 0 && p->js) {
+            if (jobserver_acquire(p->js, &token, work_left, p) != 0) return;
+            has_token = 1;
+        }
+        if (!take_item(p, &item)) {
+            if (has_token) jobserver_release(p->js, token);
+            return;
+        }
+        p->task(p->arg, item, id);
+        if (has_token) jobserver_release(p->js, token);
+    }
+}
+
+static void *thread_main(void *arg) {
+    pool_worker_t *w = arg;
+    worker_loop(w->pool, w->id);
+    return NULL;
+}
+
+/* --- Public API Functions Implementation --- */
+
+int pool_run(size_t n_items, int n_workers, pool_task_fn task, void *arg, jobserver_t *js) {
+    pool_t pool;
+    pool_worker_t *workers;
+    pthread_t *threads;
+    int i, started = 0;
+
+    if (!task) return -1;
+    if (n_workers < 1) n_workers = 1;
+    if ((size_t) n_workers > n_items) n_workers = n_items > 0 ? (int) n_items : 1;
+
+    pool.next = 0;
+    pool.n_items = n_items;
+    pool.task = task;
+    pool.arg = arg;
+    pool.js = js;
+    if (pthread_mutex_init(&pool.lock, NULL) != 0) return -1;
+
+    workers = malloc(sizeof(*workers) * (size_t) n_workers);
+    threads = malloc(sizeof(*threads) * (size_t) n_workers);
+    if (workers && threads) {
+        for (i = 1; i < n_workers; i++) {
+            workers[i].pool = &pool;
+            workers[i].id = i;
+            if (pthread_create(&threads[i], NULL, thread_main, &workers[i]) != 0) break;
+            started++;
+        }
+    }
+
+    worker_loop(&pool, 0);
+
+    for (i = 1; i <= started; i++) pthread_join(threads[i], NULL);
+    free(workers);
+    free(threads);
+    pthread_mutex_destroy(&pool.lock);
+    return started == n_workers - 1 ? 0 : -1;
+}
@@ -78,3 +78,17 @@ void vec_destroy(vec_t *v) {
     v->cap = 0;
     v->elem_sz = 0;
 }
+
+void *vec_take(vec_t *v, int *len) {
+    void *data = v->data;
+
+    *len = (int) v->len;
+    if (v->len == 0) {
+        free(data);
+        data = NULL;
+    }
+    v->data = NULL;
+    v->len = 0;
+    v->cap = 0;
+    return data;
+}
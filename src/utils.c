@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "../include/globals.h"
+#include "../include/profile.h"
 /*
  * =====================================================================================
  * Filename: utils.c
@@ -20,6 +21,8 @@ char *dupstr(const char *str) {
 
 bool_t is_reserved_keyword(const char* name) {
     int i;
+    bool_t found = FALSE;
+    sig_atomic_t saved;
     const char* reserved_keywords[] = {
         "mov", "cmp", "add", "sub", "not", "clr", "lea", "inc", "dec",
         "jmp", "bne", "red", "prn", "jsr", "rts", "stop",
@@ -28,26 +31,38 @@ bool_t is_reserved_keyword(const char* name) {
         "mcro", "mcrend",
         NULL /* sentinel to mark the end of the array */
     };
+    PROF_ENTER(saved, PROF_ACT_OPCODE_LOOKUP);
     for (i = 0; reserved_keywords[i] != NULL; i++) {
         if (strcmp(reserved_keywords[i], name) == 0) {
-            return TRUE;
+            found = TRUE;
+            break;
         }
     }
-    return FALSE;
+    PROF_LEAVE(saved);
+    return found;
 }
 
 char *create_file_path(const char *file_name, const char *ending) {
-    char *c, *new_file_name;
+    char *c, *base, *new_file_name;
     new_file_name = malloc(strlen(file_name) + strlen(ending) + 1);
     if (!new_file_name) {
         return NULL; /* memory allocation failed */
     }
     strcpy(new_file_name, file_name);
-    /* deleting the file name if a '.' exists and forth */
-    if ((c = strchr(new_file_name, '.')) != NULL) {
+    /* deleting the file name if a '.' exists and forth, directories may contain dots */
+    base = strrchr(new_file_name, '/');
+    base = base ? base + 1 : new_file_name;
+    if ((c = strchr(base, '.')) != NULL) {
         *c = '\0';
     }
     /* adds the ending of the new file name */
     strcat(new_file_name, ending);
     return new_file_name;
-}
\ No newline at end of file
+}
+
+int parse_jobs(const char *val) {
+    char *end;
+    long n = strtol(val, &end, 10);
+    if (*end != '\0' || end == val || n < 1 || n > MAX_JOBS) return -1;
+    return (int) n;
+}
@@ -0,0 +1,194 @@
+#define _POSIX_C_SOURCE 200809L /* clock_gettime */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Include the headers of the components we are testing */
+#include "../include/util_hash.h"
+#include "../include/symbol_table.h"
+#include "../include/libasm.h"
+
+/*
+ * Algorithmic complexity guards: every component runs at doubling input sizes and
+ * the growth of its time must stay within its complexity class. Linear and
+ * n log n components may grow by at most LINEAR_GROWTH per doubling, while a
+ * quadratic one grows by 4. The largest input is compared with the smallest one,
+ * so the noise of a single measurement is spread over all the doublings.
+ */
+
+#define LINEAR_GROWTH 2.8 /* allowed time ratio per doubling, about n^1.5 */
+#define REPEATS 3 /* every size is measured this many times, the best run counts */
+
+static int failures = 0;
+
+/* A workload of size n, returns its time in seconds. */
+typedef double (*workload_fn)(long n);
+
+/* --- Test Runner Helper Functions --- */
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/* Runs a workload at n0, 2 * n0, ... and checks the growth of the best times. */
+static void check_growth(const char *name, workload_fn run, long n0, int doublings) {
+    double first = 0, last = 0, t, best, limit = 1.0;
+    long n = n0;
+    int d, r;
+
+    printf("  %s:", name);
+    for (d = 0; d <= doublings; d++, n *= 2) {
+        best = -1;
+        for (r = 0; r < REPEATS; r++) {
+            t = run(n);
+            if (best < 0 || t < best) best = t;
+        }
+        printf(" %ld:%.2fms", n, best * 1e3);
+        if (d == 0) first = best;
+        last = best;
+        if (d > 0) limit *= LINEAR_GROWTH;
+    }
+    if (first <= 0) first = 1e-9;
+    printf(" -> x%.1f (limit x%.1f) ", last / first, limit);
+    if (last / first > limit) {
+        printf("FAIL (grows faster than linear)\n");
+        failures++;
+    } else {
+        printf("PASSED\n");
+    }
+}
+
+/* Writes the name of the i-th generated symbol. */
+static void symbol_name(char *buf, long i) {
+    sprintf(buf, "Sym%ld", i);
+}
+
+/* --- Workloads --- */
+
+/* Inserts n symbols into a symbol table and looks every one up. */
+static double symtab_insert_lookup(long n) {
+    symbol_table_t *st = symtab_create();
+    char name[MAX_LABEL_LENGTH];
+    double t0, t;
+    long i;
+
+    if (!st) return 0;
+    t0 = now_seconds();
+    for (i = 0; i < n; i++) {
+        symbol_name(name, i);
+        if (!symtab_insert(st, name, (int) (i & 0xFF), SYM_CODE)) failures++;
+    }
+    for (i = 0; i < n; i++) {
+        symbol_name(name, i);
+        if (!symtab_lookup(st, name)) failures++;
+    }
+    t = now_seconds() - t0;
+    symtab_destroy(st);
+    return t;
+}
+
+/* Iterates over a hash table of n entries with hash_get_next, 16 times. */
+static double hash_iteration(long n) {
+    hash_table_t *ht = hash_create(0);
+    hash_entry_t *it;
+    char name[MAX_LABEL_LENGTH];
+    double t0, t;
+    long i, seen = 0;
+    int r;
+
+    if (!ht) return 0;
+    for (i = 0; i < n; i++) {
+        symbol_name(name, i);
+        hash_put(ht, name, NULL);
+    }
+    t0 = now_seconds();
+    for (r = 0; r < 16; r++) {
+        for (it = hash_get_next(ht, NULL); it; it = hash_get_next(ht, it)) seen++;
+    }
+    t = now_seconds() - t0;
+    if (seen != 16 * n) failures++;
+    hash_destroy(ht, NULL);
+    return t;
+}
+
+/* Assembles a program of n .string lines with the longest payload a line allows.
+ * The payload of one line is bounded, so the number of lines is what grows.
+ */
+static double string_lines(long n) {
+    asm_ctx_t *ctx = asm_ctx_create();
+    asm_result_t result;
+    char payload[MAX_LINE_LENGTH];
+    char *src, *p;
+    double t0, t;
+    long i;
+
+    src = malloc((size_t) n * MAX_LINE_LENGTH + 1);
+    if (!ctx || !src) {
+        asm_ctx_destroy(ctx);
+        free(src);
+        return 0;
+    }
+    memset(payload, 'a', sizeof(payload));
+    payload[MAX_LINE_LENGTH - 12] = '\0'; /* .string, the quotes and the newline fill the line */
+    p = src;
+    for (i = 0; i < n; i++) {
+        p += sprintf(p, ".string \"%s\"\n", payload);
+    }
+
+    t0 = now_seconds();
+    if (asm_assemble_buffer(ctx, src, (size_t) (p - src), &result) != 0) failures++;
+    t = now_seconds() - t0;
+
+    asm_result_free(&result);
+    asm_ctx_destroy(ctx);
+    free(src);
+    return t;
+}
+
+/* Assembles a program of n labeled instructions, each referring to an earlier label. */
+static double assemble_program(long n) {
+    asm_ctx_t *ctx = asm_ctx_create();
+    asm_result_t result;
+    char *src, *p;
+    double t0, t;
+    long i;
+
+    src = malloc((size_t) n * 48 + 1);
+    if (!ctx || !src) {
+        asm_ctx_destroy(ctx);
+        free(src);
+        return 0;
+    }
+    p = src;
+    for (i = 0; i < n; i++) {
+        p += sprintf(p, "Sym%ld: mov Sym%ld, r%ld\n", i, (i * 7919) % (i + 1), i % 8);
+    }
+
+    t0 = now_seconds();
+    if (asm_assemble_buffer(ctx, src, (size_t) (p - src), &result) != 0) failures++;
+    t = now_seconds() - t0;
+
+    asm_result_free(&result);
+    asm_ctx_destroy(ctx);
+    free(src);
+    return t;
+}
+
+int main(void) {
+    printf("Running complexity guard tests...\n");
+
+    check_growth("symbol table insert + lookup", symtab_insert_lookup, 4096, 4);
+    check_growth("hash_get_next iteration", hash_iteration, 8192, 4);
+    check_growth("assembly of .string lines", string_lines, 1024, 3);
+    check_growth("assembly of labeled program", assemble_program, 2048, 3);
+
+    if (failures) {
+        printf("%d failure(s)\n", failures);
+        return 1;
+    }
+    printf("All tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Include the headers of the components we are testing */
+#include "../include/cost.h"
+#include "../include/second_pass.h"
+#include "../include/spill.h"
+#include "../include/errors.h"
+#include "test_support.h"
+
+#define BASE_NAME "cost_test"
+#define AM_PATH BASE_NAME ".am"
+#define TABLE_PATH BASE_NAME ".table"
+#define MAX_ROUTINES 8
+
+/* --- Test Runner Helper Functions --- */
+
+/* Writes text into a file. Returns 0 on success. */
+static int write_file(const char *path, const char *text) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) return -1;
+    fputs(text, fp);
+    return fclose(fp) == 0 ? 0 : -1;
+}
+
+/* Returns 1 if a cost table file holding text is rejected at line. */
+static int table_rejected(const char *text, const int line) {
+    cost_table_t table;
+
+    cost_table_default(&table);
+    last_error = ERROR_OK;
+    if (write_file(TABLE_PATH, text) != 0 || cost_table_read(&table, TABLE_PATH) == 0) return 0;
+    return last_error == ERROR_INVALID_COST_TABLE && last_line == line;
+}
+
+/* Assembles a source through the in-memory or the streaming passes with a cost estimate.
+ * Returns the number of routines copied into out, or -1 on failure.
+ */
+static int estimate(const char *src, const cost_table_t *table, const int streaming, cost_routine_t *out) {
+    symbol_table_t *st = symtab_create();
+    cost_routine_t *routines = NULL;
+    spill_t spill;
+    cost_t cost;
+    int n = -1, status;
+
+    if (!st || write_file(AM_PATH, src) != 0) {
+        symtab_destroy(st);
+        return -1;
+    }
+    cost_init(&cost, table);
+    if (streaming) {
+        status = spill_open(&spill, 0);
+        if (status == 0) {
+            status = first_pass_spill(AM_PATH, st, &spill) == 0 ? second_pass_spill(&spill, BASE_NAME, st, &cost) : -1;
+            spill_close(&spill);
+        }
+    } else {
+        status = first_pass(AM_PATH, st) == 0 ? second_pass(AM_PATH, BASE_NAME, st, &cost) : -1;
+    }
+    if (status == 0 && !cost.failed && cost_analyze(&cost, st, &routines, &n) == 0 && n <= MAX_ROUTINES) {
+        memcpy(out, routines, sizeof(cost_routine_t) * (size_t) n);
+    } else {
+        n = -1;
+    }
+    free(routines);
+    cost_destroy(&cost);
+    symtab_destroy(st);
+    remove(AM_PATH);
+    remove(BASE_NAME ".ob");
+    remove(BASE_NAME ".ent");
+    remove(BASE_NAME ".ext");
+    return n;
+}
+
+/* Returns 1 if a routine has the given name, size and estimates. */
+static int routine_is(const cost_routine_t *r, const char *name, const int words, const int loops, const long best,
+                      const long worst, const double weighted) {
+    return strcmp(r->name, name) == 0 && r->words == words && r->loops == loops && r->best == best &&
+           r->worst == worst && r->weighted == weighted;
+}
+
+/* --- Test Cases --- */
+
+static void test_routines(void) {
+    const char *src = ".entry MAIN\n"
+            "MAIN: mov #3, r1\n" /* 3 */
+            "L: dec r1\n" /* 2 */
+            "jsr F\n" /* 3, the words and the push */
+            "cmp r1, #0\n" /* 3 */
+            "bne L\n" /* 2 */
+            "stop\n" /* 1 */
+            "F: cmp X, #0\n" /* 4, a memory read */
+            "bne SKIP\n" /* 2 */
+            "add X, Y\n" /* 6, a read and a read-modify-write */
+            "SKIP: rts\n" /* 2 */
+            "X: .data 1\n"
+            "Y: .data 2\n";
+    cost_table_t table;
+    cost_routine_t r[MAX_ROUTINES];
+    int before = failures, n, k;
+
+    printf("Running test: routines, paths and loops... ");
+    cost_table_default(&table);
+    for (k = 0; k < 2; k++) {
+        n = estimate(src, &table, k, r);
+        check("two routines", n == 2);
+        if (n != 2) continue;
+        check("MAIN: the loop is taken once, weighted by 10", routine_is(&r[0], "MAIN", 13, 1, 14, 14, 104.0));
+        check("F: the skip is the best path", routine_is(&r[1], "F", 9, 0, 8, 14, 14.0));
+        check("routine addresses", r[0].address == 100 && r[1].address == 113);
+    }
+
+    n = estimate("mov #2, r1\n"
+                 "O: mov #2, r2\n"
+                 "I: dec r2\n"
+                 "bne I\n"
+                 "dec r1\n"
+                 "bne O\n"
+                 "jmp r3\n", &table, 0, r);
+    check("nested loops weigh 10 and 100",
+          n == 1 && routine_is(&r[0], COST_NO_LABEL, 16, 2, 16, 16, 3.0 + 30.0 + 400.0 + 40.0 + 2.0));
+    if (failures == before) printf("PASS\n");
+}
+
+static void test_table(void) {
+    cost_table_t table;
+    cost_routine_t r[MAX_ROUTINES];
+    int before = failures, n;
+
+    printf("Running test: cost tables... ");
+    cost_table_default(&table);
+    check("model of the emulator", table.cycles[ADD_OP][DIRECT][MATRIX_ACCESS] == 1 + 1 + 2 + 1 + 2 &&
+                                   table.cycles[MOV_OP][REGISTER_DIRECT][REGISTER_DIRECT] == 2 &&
+                                   table.cycles[STOP_OP][0][0] == 1);
+
+    check("table file", write_file(TABLE_PATH, "; slower stops\n"
+                                               "stop * * 5\n"
+                                               "\n"
+                                               "mov 0 3 7\n"
+                                               "loop 2\n") == 0 && cost_table_read(&table, TABLE_PATH) == 0);
+    check("entries replaced", table.cycles[STOP_OP][2][1] == 5 && table.loop_weight == 2 &&
+                              table.cycles[MOV_OP][IMMEDIATE][REGISTER_DIRECT] == 7);
+    check("other entries kept", table.cycles[MOV_OP][DIRECT][REGISTER_DIRECT] == 4);
+    n = estimate("L: mov #1, r1\nbne L\nstop\n", &table, 0, r);
+    check("estimate with the table", n == 1 && routine_is(&r[0], "L", 6, 1, 14, 14, 18.0 + 5.0));
+
+    set_error_sink(record_error, NULL);
+    check("unknown mnemonic", table_rejected("mov * * 2\nhalt * * 1\n", 2));
+    check("mode out of range", table_rejected("mov 4 * 1\n", 1));
+    check("trailing text", table_rejected("mov * * 1 2\n", 1));
+    check("negative cycles", table_rejected("mov * * -1\n", 1));
+    check("loop weight below 1", table_rejected("loop 0\n", 1));
+    set_error_sink(NULL, NULL);
+    remove(TABLE_PATH);
+    if (failures == before) printf("PASS\n");
+}
+
+int main(void) {
+    printf("Running cost estimate tests...\n");
+    test_routines();
+    test_table();
+
+    if (failures) {
+        printf("%d failure(s)\n", failures);
+        return 1;
+    }
+    printf("All tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Include the headers of the components we are testing */
+#include "../include/disasm.h"
+#include "../include/libasm.h"
+#include "../include/isa.h"
+#include "test_support.h"
+
+#define MAX_SOURCE 4096
+#define MAX_WORDS 256
+#define MAX_SYMBOLS 16
+
+/* struct assembled_t is a program assembled in memory, in the form the disassembler reads. */
+typedef struct {
+    object_t obj;
+    WORD words[MAX_WORDS];
+    obj_symbol_t entries[MAX_SYMBOLS];
+    obj_symbol_t externals[MAX_SYMBOLS];
+} assembled_t;
+
+/* --- Test Runner Helper Functions --- */
+
+/* Assembles a source into a. Returns 0 on success, -1 on failure. */
+static int assemble(asm_ctx_t *ctx, const char *src, assembled_t *a) {
+    asm_result_t r;
+    int i, result = -1;
+
+    memset(a, 0, sizeof(*a));
+    if (asm_assemble_buffer(ctx, src, strlen(src), &r) == 0 && r.code_len + r.data_len <= MAX_WORDS &&
+        r.n_entries <= MAX_SYMBOLS && r.n_externals <= MAX_SYMBOLS) {
+        for (i = 0; i < r.code_len; i++) a->words[i] = (WORD) (r.code[i] & WORD_MASK);
+        for (i = 0; i < r.data_len; i++) a->words[r.code_len + i] = (WORD) (r.data[i] & WORD_MASK);
+        for (i = 0; i < r.n_entries; i++) {
+            strcpy(a->entries[i].name, r.entries[i].name);
+            a->entries[i].address = r.entries[i].address;
+        }
+        for (i = 0; i < r.n_externals; i++) {
+            strcpy(a->externals[i].name, r.externals[i].name);
+            a->externals[i].address = r.externals[i].address;
+        }
+        a->obj.words = a->words;
+        a->obj.code_len = r.code_len;
+        a->obj.data_len = r.data_len;
+        a->obj.entries = a->entries;
+        a->obj.n_entries = r.n_entries;
+        a->obj.externals = a->externals;
+        a->obj.n_externals = r.n_externals;
+        result = 0;
+    }
+    asm_result_free(&r);
+    return result;
+}
+
+/* Disassembles a program into text. Returns 0 on success, -1 on failure. */
+static int disassemble(const object_t *obj, const obj_symbol_t *symbols, const int n_symbols, const int with_addresses,
+                       char *text) {
+    FILE *tmp = tmpfile();
+    disasm_t d;
+    size_t n = 0;
+    int result = -1;
+
+    text[0] = '\0';
+    if (!tmp) return -1;
+    if (disasm_open(&d, obj, symbols, n_symbols) == 0) {
+        result = disasm_write(&d, with_addresses, tmp);
+        disasm_close(&d);
+    }
+    rewind(tmp);
+    if (result == 0) n = fread(text, 1, MAX_SOURCE - 1, tmp);
+    text[n] = '\0';
+    fclose(tmp);
+    return result == 0 && n < MAX_SOURCE - 1 ? 0 : -1;
+}
+
+/* Returns 1 if the disassembly of a source assembles back into the same words and symbols. */
+static int round_trips(asm_ctx_t *ctx, const char *src, char *text) {
+    static assembled_t first, second;
+    int i;
+
+    if (assemble(ctx, src, &first) != 0 || disassemble(&first.obj, NULL, 0, 0, text) != 0 ||
+        assemble(ctx, text, &second) != 0) {
+        return 0;
+    }
+    if (first.obj.code_len != second.obj.code_len || first.obj.data_len != second.obj.data_len ||
+        first.obj.n_entries != second.obj.n_entries || first.obj.n_externals != second.obj.n_externals) {
+        return 0;
+    }
+    for (i = 0; i < first.obj.code_len + first.obj.data_len; i++) {
+        if (first.words[i] != second.words[i]) return 0;
+    }
+    for (i = 0; i < first.obj.n_externals; i++) {
+        if (first.externals[i].address != second.externals[i].address) return 0;
+    }
+    return 1;
+}
+
+/* --- Test Cases --- */
+
+static void test_table(void) {
+    disasm_entry_t table[DISASM_TABLE_SIZE];
+    instruction_t ins;
+    int w, agree = 1, n_valid = 0;
+
+    printf("Running test: decoding table... ");
+    disasm_build_table(table);
+    for (w = 0; w < DISASM_TABLE_SIZE; w++) {
+        if (!table[w].valid) continue;
+        n_valid++;
+        if (isa_decode((WORD) w, &ins) != 0 || ins.opcode != table[w].opcode || ins.length != table[w].length) {
+            agree = 0;
+        }
+    }
+    check("entries agree with isa_decode", agree);
+    check("mov #1, r1 is valid", table[FIRST_WORD(MOV_OP, IMMEDIATE, REGISTER_DIRECT, ARE_A)].valid);
+    check("an immediate destination is not", !table[FIRST_WORD(MOV_OP, DIRECT, IMMEDIATE, ARE_A)].valid);
+    check("lea needs a label source", !table[FIRST_WORD(LEA_OP, REGISTER_DIRECT, REGISTER_DIRECT, ARE_A)].valid);
+    check("a relocated first word is not", !table[FIRST_WORD(STOP_OP, 0, 0, ARE_R)].valid);
+    check("some entries are valid", n_valid > 0);
+    if (failures == 0) printf("PASS\n");
+}
+
+static void test_round_trip(asm_ctx_t *ctx) {
+    static char text[MAX_SOURCE], long_src[MAX_SOURCE];
+    const char *src = ".extern W\n"
+            ".entry MAIN\n"
+            "MAIN: mov #-1, r2\n"
+            "lea M[r1][r2], r3\n"
+            "L: cmp r1, #127\n"
+            "bne L\n"
+            "add M[r7][r0], X\n"
+            "jsr W\n"
+            "prn #-128\n"
+            "mov W, r4\n"
+            "rts\n"
+            "stop\n"
+            "X: .data 511, -512, 0, 1, 2, 3, 4, 5\n"
+            "M: .mat [2][2] 1, 2, 3, 4\n"
+            "S: .string \"ab\"\n";
+    int before = failures, i;
+
+    printf("Running test: round trip... ");
+    check("reassembles into the same words", round_trips(ctx, src, text));
+    check("entry kept", strstr(text, ".entry MAIN\n") != NULL);
+    check("external declared once", strstr(text, ".extern W\n") != NULL &&
+                                    strstr(strstr(text, ".extern W\n") + 1, ".extern") == NULL);
+    check("matrix operand", strstr(text, "lea L") != NULL && strstr(text, "[r1][r2], r3\n") != NULL);
+    check("negative immediates", strstr(text, "mov #-1, r2\n") != NULL && strstr(text, "prn #-128\n") != NULL);
+    check("branch label", strstr(text, "L107: cmp r1, #127\n") != NULL && strstr(text, "bne L107\n") != NULL);
+    check("data lines", strstr(text, ".data 511, -512, 0, 1, 2, 3\n") != NULL);
+
+    check("empty program", round_trips(ctx, "stop\n", text) && strcmp(text, "stop\n") == 0);
+
+    /* past address 255 label words and the symbol files only keep the low 8 bits */
+    strcpy(long_src, ".extern W\n.entry X\n");
+    for (i = 0; i < 80; i++) strcat(long_src, "prn #1\n");
+    strcat(long_src, "jsr W\njmp X\nstop\nX: .data 7\n");
+    check("long program round trip", round_trips(ctx, long_src, text));
+    check("wrapped label", strstr(text, "jmp X\n") != NULL && strstr(text, "X: .data 7\n") != NULL &&
+                           strstr(text, ".entry X\n") != NULL && strstr(text, "jsr W\n") != NULL);
+    if (failures == before) printf("PASS\n");
+}
+
+static void test_symbols_and_addresses(asm_ctx_t *ctx) {
+    static assembled_t a;
+    static char text[MAX_SOURCE];
+    obj_symbol_t symbols[2];
+    int before = failures;
+
+    printf("Running test: symbols and addresses... ");
+    check("assembled", assemble(ctx, "jmp X\nstop\nX: .data 7\n", &a) == 0);
+    strcpy(symbols[0].name, "VALUE");
+    symbols[0].address = ADDRESS_BASE + 3;
+    strcpy(symbols[1].name, "INSIDE");
+    symbols[1].address = ADDRESS_BASE + 1; /* the operand word of jmp, where no line starts */
+    check("disassembled", disassemble(&a.obj, symbols, 2, 0, text) == 0);
+    check("symbol names the data", strcmp(text, "jmp VALUE\nstop\nVALUE: .data 7\n") == 0);
+    check("with addresses", disassemble(&a.obj, NULL, 0, 1, text) == 0 &&
+                            strcmp(text, "  100  jmp L103\n  102  stop\n  103  L103: .data 7\n") == 0);
+    if (failures == before) printf("PASS\n");
+}
+
+static void test_invalid_words(asm_ctx_t *ctx) {
+    static assembled_t a;
+    static char text[MAX_SOURCE];
+    disasm_t d;
+    char insn[DISASM_TEXT_SIZE];
+    int before = failures;
+
+    printf("Running test: words that are not instructions... ");
+    check("assembled", assemble(ctx, "mov #1, r1\nstop\n", &a) == 0);
+    a.words[0] = FIRST_WORD(MOV_OP, IMMEDIATE, IMMEDIATE, ARE_A);
+    check("invalid first word as a comment", disassemble(&a.obj, NULL, 0, 0, text) == 0 &&
+                                             strcmp(text, "; not an instruction: 0\n"
+                                                          "; not an instruction: 4\n"
+                                                          "; not an instruction: 4\n"
+                                                          "stop\n") == 0);
+
+    check("assembled", assemble(ctx, "mov #1, r1\nstop\n", &a) == 0);
+    a.words[2] |= ARE_R; /* a register word the assembler never emits */
+    check("opened", disasm_open(&d, &a.obj, NULL, 0) == 0);
+    check("rejected operand", disasm_insn(&d, ADDRESS_BASE, insn, sizeof(insn)) == 0 && insn[0] == '\0');
+    check("next instruction", disasm_insn(&d, ADDRESS_BASE + 3, insn, sizeof(insn)) == 1 &&
+                              strcmp(insn, "stop") == 0);
+    check("outside the code", disasm_insn(&d, ADDRESS_BASE + 4, insn, sizeof(insn)) == 0);
+    check("text too small", disasm_insn(&d, ADDRESS_BASE + 3, insn, 4) == 0);
+    disasm_close(&d);
+    if (failures == before) printf("PASS\n");
+}
+
+int main(void) {
+    asm_ctx_t *ctx = asm_ctx_create();
+
+    if (!ctx) return 1;
+    printf("Running disassembler tests...\n");
+    test_table();
+    test_round_trip(ctx);
+    test_symbols_and_addresses(ctx);
+    test_invalid_words(ctx);
+    asm_ctx_destroy(ctx);
+
+    if (failures) {
+        printf("%d failure(s)\n", failures);
+        return 1;
+    }
+    printf("All tests passed!\n");
+    return 0;
+}
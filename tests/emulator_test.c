@@ -0,0 +1,599 @@
+#define _POSIX_C_SOURCE 200809L /* mkstemp, fdopen */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Include the headers of the components we are testing */
+#include "../include/emulator.h"
+#include "../include/emu_profile.h"
+#include "../include/emu_batch.h"
+#include "../include/emu_lockstep.h"
+#include "../include/emu_jit.h"
+#include "../include/libasm.h"
+#include "test_support.h"
+
+/* --- Test Runner Helper Functions --- */
+
+/* Assembles and runs a program with the given input.
+ * The output of prn is returned in out (at most out_size - 1 characters).
+ */
+static emu_status_t run_program(const char *src, const char *input, emulator_t *emu, char *out, size_t out_size) {
+    object_t program;
+    FILE *in = tmpfile(), *output = tmpfile();
+    size_t n = 0;
+
+    out[0] = '\0';
+    if (!in || !output || assemble_object(NULL, src, &program) != 0) {
+        check("assemble program", 0);
+        if (in) fclose(in);
+        if (output) fclose(output);
+        return EMU_FAULT;
+    }
+    fputs(input, in);
+    rewind(in);
+
+    emu_init(emu, in, output);
+    emu->max_steps = 10000;
+    check("load program", emu_load(emu, &program) == 0);
+    emu_run(emu);
+
+    rewind(output);
+    n = fread(out, 1, out_size - 1, output);
+    out[n] = '\0';
+    fclose(in);
+    fclose(output);
+    object_free(&program);
+    return emu->status;
+}
+
+/* --- Test Cases --- */
+
+static void test_arithmetic(void) {
+    emulator_t emu;
+    char out[256];
+    int before = failures;
+
+    printf("Running test: arithmetic and registers... ");
+    check("halts", run_program("mov #5, r1\n"
+                               "add #3, r1\n"
+                               "mov r1, r2\n"
+                               "sub #10, r2\n"
+                               "prn r1\n"
+                               "prn r2\n"
+                               "not r2\n"
+                               "prn r2\n"
+                               "clr r1\n"
+                               "dec r1\n"
+                               "prn r1\n"
+                               "stop\n", "", &emu, out, sizeof(out)) == EMU_HALTED);
+    check("output", strcmp(out, "8\n-2\n1\n-1\n") == 0);
+    check("steps", emu.steps == 12);
+    if (failures == before) printf("PASS\n");
+}
+
+static void test_control_flow(void) {
+    emulator_t emu;
+    char out[256];
+    int before = failures;
+
+    printf("Running test: branches and subroutines... ");
+    check("loop halts", run_program("mov #0, r1\n"
+                                    "LOOP: prn r1\n"
+                                    "inc r1\n"
+                                    "cmp r1, #3\n"
+                                    "bne LOOP\n"
+                                    "stop\n", "", &emu, out, sizeof(out)) == EMU_HALTED);
+    check("loop output", strcmp(out, "0\n1\n2\n") == 0);
+
+    check("call halts", run_program("MAIN: jsr SUB\n"
+                                    "prn V\n"
+                                    "stop\n"
+                                    "SUB: mov #7, V\n"
+                                    "rts\n"
+                                    "V: .data 1\n", "", &emu, out, sizeof(out)) == EMU_HALTED);
+    check("call output", strcmp(out, "7\n") == 0 && emu.sp == 0);
+
+    check("jump through a register", run_program("lea END, r3\n"
+                                                 "jmp r3\n"
+                                                 "prn #1\n"
+                                                 "END: stop\n", "", &emu, out, sizeof(out)) == EMU_HALTED);
+    check("jump skipped prn", out[0] == '\0');
+    if (failures == before) printf("PASS\n");
+}
+
+static void test_memory_and_io(void) {
+    emulator_t emu;
+    char out[256];
+    int before = failures;
+
+    printf("Running test: matrices, strings and I/O... ");
+    check("matrix halts", run_program("mov #1, r1\n"
+                                      "mov #0, r2\n"
+                                      "prn M[r1][r2]\n"
+                                      "mov #9, M[r2][r1]\n"
+                                      "prn M[r2][r1]\n"
+                                      "lea M[r1][r1], r3\n"
+                                      "lea M, r4\n"
+                                      "sub r4, r3\n"
+                                      "prn r3\n"
+                                      "stop\n"
+                                      "M: .mat [2][2] 1, 2, 3, 4\n", "", &emu, out, sizeof(out)) == EMU_HALTED);
+    check("matrix output", strcmp(out, "3\n9\n3\n") == 0);
+
+    check("string halts", run_program("prn S\n"
+                                      "stop\n"
+                                      "S: .string \"hi\"\n", "", &emu, out, sizeof(out)) == EMU_HALTED);
+    check("string output", strcmp(out, "104\n") == 0);
+
+    check("red halts", run_program("red r1\n"
+                                   "red X\n"
+                                   "red r2\n"
+                                   "prn r1\n"
+                                   "prn X\n"
+                                   "prn r2\n"
+                                   "stop\n"
+                                   "X: .data 0\n", "AB", &emu, out, sizeof(out)) == EMU_HALTED);
+    check("red output", strcmp(out, "65\n66\n-1\n") == 0);
+    if (failures == before) printf("PASS\n");
+}
+
+static void test_modified_code(void) {
+    emulator_t emu;
+    char out[256];
+    int before = failures;
+
+    printf("Running test: stores into decoded code... ");
+    /* -64 is the first word of stop, it replaces the decoded prn */
+    check("halts", run_program("MAIN: prn #1\n"
+                               "mov S, MAIN\n"
+                               "jmp MAIN\n"
+                               "S: .data -64\n", "", &emu, out, sizeof(out)) == EMU_HALTED);
+    check("decoded again", strcmp(out, "1\n") == 0 && emu.steps == 4);
+    if (failures == before) printf("PASS\n");
+}
+
+static void test_profile(void) {
+    emulator_t emu;
+    obj_symbol_t symbols[2];
+    char out[256], report[2048];
+    FILE *fp;
+    unsigned long instructions = 0, cycles = 0;
+    size_t n;
+    int a, before = failures;
+
+    printf("Running test: execution profile... ");
+    /* cycles: mov 3, then 5 times inc 2, cmp 3 and bne 2, add into memory 3 + 2, stop 1 */
+    check("halts", run_program("MAIN: mov #0, r1\n"
+                               "LOOP: inc r1\n"
+                               "cmp r1, #5\n"
+                               "bne LOOP\n"
+                               "add #1, X\n"
+                               "stop\n"
+                               "X: .data 0\n", "", &emu, out, sizeof(out)) == EMU_HALTED);
+    check("loop count", emu.exec_count[ADDRESS_BASE + 3] == 5 && emu.exec_count[ADDRESS_BASE + 10] == 1);
+    check("loop cycles", emu.cycle_count[ADDRESS_BASE + 3] == 10 && emu.cycle_count[ADDRESS_BASE + 5] == 15);
+    check("memory operand cycles", emu.cycle_count[ADDRESS_BASE + 10] == 5);
+    for (a = 0; a < EMU_MEMORY_SIZE; a++) {
+        instructions += emu.exec_count[a];
+        cycles += emu.cycle_count[a];
+    }
+    check("totals", instructions == (unsigned long) emu.steps && cycles == (unsigned long) emu.cycles &&
+                    emu.cycles == 3 + 5 * (2 + 3 + 2) + 5 + 1);
+
+    strcpy(symbols[0].name, "LOOP");
+    symbols[0].address = ADDRESS_BASE + 3;
+    strcpy(symbols[1].name, "MAIN");
+    symbols[1].address = ADDRESS_BASE;
+    fp = tmpfile();
+    check("report", fp && emu_profile_report(&emu, 14, symbols, 2, fp) == 0);
+    if (fp) {
+        rewind(fp);
+        n = fread(report, 1, sizeof(report) - 1, fp);
+        report[n] = '\0';
+        fclose(fp);
+        check("hottest label first", strstr(report, "LOOP") && strstr(report, "MAIN") &&
+                                     strstr(report, "LOOP") < strstr(report, "MAIN"));
+        check("listing", strstr(report, "LOOP:\n") && strstr(report, "      103  inc\n"));
+    }
+    if (failures == before) printf("PASS\n");
+}
+
+/* Runs a scenario from a snapshot with the given input, returns its output in out. */
+static void run_scenario(emulator_t *emu, const emu_snapshot_t *snap, const char *input, char *out, size_t out_size) {
+    FILE *in = tmpfile(), *output = tmpfile();
+    size_t n = 0;
+
+    out[0] = '\0';
+    if (!in || !output) {
+        check("scenario streams", 0);
+        if (in) fclose(in);
+        if (output) fclose(output);
+        return;
+    }
+    fputs(input, in);
+    rewind(in);
+    emu_restore(emu, snap);
+    emu->in = in;
+    emu->out = output;
+    emu_run(emu);
+    rewind(output);
+    n = fread(out, 1, out_size - 1, output);
+    out[n] = '\0';
+    fclose(in);
+    fclose(output);
+}
+
+static void test_snapshot(void) {
+    emulator_t *emu = malloc(sizeof(emulator_t));
+    emu_snapshot_t *snap = malloc(sizeof(emu_snapshot_t));
+    object_t program;
+    WORD initial[EMU_MEMORY_SIZE];
+    char out[256];
+    int before = failures;
+
+    printf("Running test: snapshot and restore... ");
+    if (!emu || !snap || assemble_object(NULL, "MAIN: mov #7, X\n"
+                                          "lea X, r1\n"
+                                          "red r2\n"
+                                          "add r2, X\n"
+                                          "prn X\n"
+                                          "mov S, P\n"
+                                          "jmp P\n"
+                                          "P: prn #1\n"
+                                          "stop\n"
+                                          "X: .data 0\n"
+                                          "S: .data -64\n", &program) != 0) {
+        check("setup", 0);
+        free(emu);
+        free(snap);
+        return;
+    }
+    emu_init(emu, stdin, stdout);
+    emu_load(emu, &program);
+    emu_step(emu);
+    emu_step(emu);
+    emu_snapshot(emu, snap);
+    memcpy(initial, emu->memory, sizeof(initial));
+    check("clean after snapshot", emu->dirty_pages == 0);
+
+    run_scenario(emu, snap, "\001", out, sizeof(out));
+    check("first scenario", strcmp(out, "8\n") == 0 && emu->status == EMU_HALTED && emu->dirty_pages != 0);
+    run_scenario(emu, snap, "\003", out, sizeof(out));
+    check("second scenario", strcmp(out, "10\n") == 0 && emu->steps == 8);
+
+    emu_restore(emu, snap);
+    check("restored", memcmp(initial, emu->memory, sizeof(initial)) == 0 && emu->pc == ADDRESS_BASE + 6 &&
+                      emu->regs[1] == ADDRESS_BASE + 21 && emu->regs[2] == 0 && emu->dirty_pages == 0);
+    check("profile keeps counting", emu->exec_count[ADDRESS_BASE + 6] == 2);
+
+    object_free(&program);
+    free(emu);
+    free(snap);
+    if (failures == before) printf("PASS\n");
+}
+
+#define BATCH_VECTORS 200
+
+static void test_batch(void) {
+    char path[] = "/tmp/emulator_test.XXXXXX";
+    object_t program;
+    emu_run_t *serial = NULL, *parallel = NULL;
+    FILE *fp;
+    int fd, i, k, n_serial = 0, n_parallel = 0, same = 1, before = failures;
+
+    printf("Running test: batch runs... ");
+    /* prints the sum of its input characters */
+    check("assemble", assemble_object(NULL, "clr r2\n"
+                                       "L: red r1\n"
+                                       "cmp r1, #-1\n"
+                                       "bne ADD\n"
+                                       "prn r2\n"
+                                       "stop\n"
+                                       "ADD: add r1, r2\n"
+                                       "jmp L\n", &program) == 0);
+    fd = mkstemp(path);
+    fp = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (!fp) {
+        check("vector file", 0);
+        if (fd >= 0) close(fd);
+        object_free(&program);
+        return;
+    }
+    fprintf(fp, "\\n\\t\\\\\n"); /* the escapes: 10 + 9 + 92 */
+    for (i = 1; i < BATCH_VECTORS; i++) {
+        for (k = 0; k < i % 9; k++) fputc('A', fp);
+        fputc('\n', fp);
+    }
+    fclose(fp);
+
+    check("read", emu_batch_read(path, &serial, &n_serial) == 0 && emu_batch_read(path, &parallel, &n_parallel) == 0);
+    check("vectors", n_serial == BATCH_VECTORS && n_parallel == BATCH_VECTORS && serial[0].input_len == 3);
+    check("serial", emu_batch_run(&program, EMU_DEFAULT_MAT_COLS, 1000, serial, n_serial, 1) == 0);
+    check("parallel", emu_batch_run(&program, EMU_DEFAULT_MAT_COLS, 1000, parallel, n_parallel, 4) == 0);
+    for (i = 0; i < n_serial && i < n_parallel; i++) {
+        if (serial[i].status != EMU_HALTED || parallel[i].status != EMU_HALTED ||
+            serial[i].steps != parallel[i].steps || serial[i].output_len != parallel[i].output_len ||
+            memcmp(serial[i].output, parallel[i].output, serial[i].output_len) != 0) {
+            same = 0;
+        }
+    }
+    check("same results in vector order", same);
+    check("outputs", n_parallel > 9 && strcmp(parallel[0].output, "111\n") == 0 &&
+                     strcmp(parallel[9].output, "0\n") == 0 && strcmp(parallel[8].output, "-504\n") == 0);
+    emu_batch_free(serial, n_serial);
+    emu_batch_free(parallel, n_parallel);
+
+    /* an unknown escape is rejected */
+    fp = fopen(path, "w");
+    if (fp) {
+        fprintf(fp, "ok\nbad\\q\n");
+        fclose(fp);
+    }
+    check("invalid escape", emu_batch_read(path, &serial, &n_serial) == -1 && serial == NULL);
+    remove(path);
+    object_free(&program);
+    if (failures == before) printf("PASS\n");
+}
+
+#define LOCKSTEP_VECTORS 40
+
+/* Returns 1 if the lockstep runs of a program over generated vectors end exactly
+ * like its runs on separate emulators.
+ */
+static int same_as_batch(const char *src, const long max_steps) {
+    object_t program;
+    emu_run_t *single, *lanes;
+    long rounds = 0;
+    size_t k;
+    int i, same = 1;
+
+    single = calloc(LOCKSTEP_VECTORS, sizeof(emu_run_t));
+    lanes = calloc(LOCKSTEP_VECTORS, sizeof(emu_run_t));
+    if (!single || !lanes || assemble_object(NULL, src, &program) != 0) {
+        free(single);
+        free(lanes);
+        return 0;
+    }
+    for (i = 0; i < LOCKSTEP_VECTORS; i++) {
+        single[i].input_len = lanes[i].input_len = (size_t) (i % 7);
+        single[i].input = malloc(single[i].input_len + 1);
+        lanes[i].input = malloc(lanes[i].input_len + 1);
+        for (k = 0; k < single[i].input_len && single[i].input && lanes[i].input; k++) {
+            single[i].input[k] = lanes[i].input[k] = (char) ('A' + (i * 13 + (int) k * 7) % 58);
+        }
+    }
+    if (emu_batch_run(&program, EMU_DEFAULT_MAT_COLS, max_steps, single, LOCKSTEP_VECTORS, 1) != 0 ||
+        emu_batch_run_lockstep(&program, EMU_DEFAULT_MAT_COLS, max_steps, lanes, LOCKSTEP_VECTORS, 2, &rounds) != 0) {
+        same = 0;
+    }
+    for (i = 0; i < LOCKSTEP_VECTORS && same; i++) {
+        if (single[i].status != lanes[i].status || single[i].fault != lanes[i].fault ||
+            single[i].fault_pc != lanes[i].fault_pc || single[i].steps != lanes[i].steps ||
+            single[i].output_len != lanes[i].output_len ||
+            memcmp(single[i].output, lanes[i].output, single[i].output_len) != 0) {
+            printf("(vector %d differs) ", i);
+            same = 0;
+        }
+    }
+    emu_batch_free(single, LOCKSTEP_VECTORS);
+    emu_batch_free(lanes, LOCKSTEP_VECTORS);
+    object_free(&program);
+    return same && rounds > 0;
+}
+
+/* Runs a program on the interpreter and on the translating tier with the same input.
+ * Returns 1 if the final states and outputs agree.
+ */
+static int same_as_jit(const char *src, const char *input, const long max_steps, emu_jit_t *jit) {
+    static emulator_t emus[2];
+    object_t program;
+    FILE *in[2], *out[2];
+    char text[2][512];
+    size_t n[2] = {0, 0};
+    const char *differs = NULL;
+    int i, same = 1;
+
+    if (assemble_object(NULL, src, &program) != 0) return 0;
+    for (i = 0; i < 2; i++) {
+        in[i] = tmpfile();
+        out[i] = tmpfile();
+        if (!in[i] || !out[i]) same = 0;
+        if (in[i]) {
+            fputs(input, in[i]);
+            rewind(in[i]);
+        }
+        emu_init(&emus[i], in[i], out[i]);
+        emus[i].max_steps = max_steps;
+        if (emu_load(&emus[i], &program) != 0) same = 0;
+    }
+    if (same) {
+        emu_run(&emus[0]);
+        emu_jit_reset(jit);
+        emu_jit_run(jit, &emus[1]);
+        differs = emu_jit_diff(&emus[0], &emus[1]);
+    }
+    for (i = 0; i < 2; i++) {
+        if (out[i]) {
+            rewind(out[i]);
+            n[i] = fread(text[i], 1, sizeof(text[i]), out[i]);
+            fclose(out[i]);
+        }
+        if (in[i]) fclose(in[i]);
+    }
+    if (same && !differs && (n[0] != n[1] || memcmp(text[0], text[1], n[0]) != 0)) differs = "output";
+    if (differs) printf("(%s differs) ", differs);
+    object_free(&program);
+    return same && !differs;
+}
+
+static void test_lockstep(void) {
+    int before = failures;
+
+    printf("Running test: lockstep lanes... ");
+    check("divergent loops", same_as_batch("clr r2\n"
+                                           "L: red r1\n"
+                                           "cmp r1, #-1\n"
+                                           "bne ADD\n"
+                                           "prn r2\n"
+                                           "stop\n"
+                                           "ADD: add r1, r2\n"
+                                           "jmp L\n", EMU_NO_STEP_LIMIT));
+    check("code changed in some lanes", same_as_batch("red r1\n"
+                                                      "cmp r1, #79\n"
+                                                      "bne SKIP\n"
+                                                      "mov S, P\n"
+                                                      "SKIP: prn r1\n"
+                                                      "P: prn #1\n"
+                                                      "prn #2\n"
+                                                      "stop\n"
+                                                      "S: .data -64\n", EMU_NO_STEP_LIMIT));
+    check("matrix faults in some lanes", same_as_batch("red r1\n"
+                                                       "sub #60, r1\n"
+                                                       "mov #3, M[r1][r1]\n"
+                                                       "prn M[r1][r1]\n"
+                                                       "stop\n"
+                                                       "M: .mat [1][1] 5\n", EMU_NO_STEP_LIMIT));
+    check("recursion and stack faults", same_as_batch("red r1\n"
+                                                      "jsr R\n"
+                                                      "prn r2\n"
+                                                      "stop\n"
+                                                      "R: inc r2\n"
+                                                      "dec r1\n"
+                                                      "cmp r1, #64\n"
+                                                      "bne DEEPER\n"
+                                                      "rts\n"
+                                                      "DEEPER: jsr R\n"
+                                                      "rts\n", EMU_NO_STEP_LIMIT));
+    check("step limit", same_as_batch("L: red r1\n"
+                                      "cmp r1, #-1\n"
+                                      "bne L\n"
+                                      "prn #0\n"
+                                      "stop\n", 12));
+    if (failures == before) printf("PASS\n");
+}
+
+static void test_jit(void) {
+    emu_jit_t jit;
+    long blocks;
+    int before = failures, native;
+
+    printf("Running test: translated code against the interpreter... ");
+    native = emu_jit_open(&jit) == 0;
+#ifdef EMU_JIT_NATIVE
+    check("native code available", native);
+#endif
+    check("hot loop", same_as_jit("mov #0, r1\n"
+                                  "L: inc r1\n"
+                                  "add #3, X\n"
+                                  "sub r1, r2\n"
+                                  "not r3\n"
+                                  "cmp r1, #100\n"
+                                  "bne L\n"
+                                  "lea X, r4\n"
+                                  "prn X\n"
+                                  "prn r2\n"
+                                  "stop\n"
+                                  "X: .data 7\n", "", EMU_NO_STEP_LIMIT, &jit));
+    check("blocks translated and chained", !native || (jit.blocks > 0 && jit.chained > 0));
+    blocks = jit.blocks;
+    check("step limit inside chained blocks", same_as_jit("L: inc r1\n"
+                                                          "add #2, r2\n"
+                                                          "cmp r1, r3\n"
+                                                          "jmp L\n", "", 1001, &jit) &&
+                                              same_as_jit("L: inc r1\n"
+                                                          "add #2, r2\n"
+                                                          "cmp r1, r3\n"
+                                                          "jmp L\n", "", 1003, &jit));
+    check("I/O and calls in a hot loop", same_as_jit("L: red r1\n"
+                                                     "jsr F\n"
+                                                     "cmp r1, #-1\n"
+                                                     "bne L\n"
+                                                     "stop\n"
+                                                     "F: add r1, r2\n"
+                                                     "prn r2\n"
+                                                     "rts\n", "a long enough line of input", 10000, &jit));
+    /* P turns into dec r2 and back on every pass */
+    check("translated store into its own block", same_as_jit("mov P, B\n"
+                                                             "mov D, A\n"
+                                                             "L: mov A, P\n"
+                                                             "P: inc r2\n"
+                                                             "mov A, r3\n"
+                                                             "mov B, A\n"
+                                                             "mov r3, B\n"
+                                                             "inc r1\n"
+                                                             "cmp r1, #31\n"
+                                                             "bne L\n"
+                                                             "prn r2\n"
+                                                             "stop\n"
+                                                             "D: dec r2\n"
+                                                             "A: .data 0\n"
+                                                             "B: .data 0\n", "", 10000, &jit));
+    check("flushed on modified code", !native || jit.flushes > 0);
+    /* the matrix store (interpreted) raises the immediate of the translated add */
+    check("interpreted store into a block", same_as_jit("mov #1, r3\n"
+                                                        "L: add #5, r1\n"
+                                                        "mov L[r0][r3], r2\n"
+                                                        "add #4, r2\n"
+                                                        "mov r2, L[r0][r3]\n"
+                                                        "cmp r2, #120\n"
+                                                        "bne L\n"
+                                                        "prn r1\n"
+                                                        "stop\n", "", 10000, &jit));
+    check("fault after a hot loop", same_as_jit("L: inc r1\n"
+                                                "cmp r1, #20\n"
+                                                "bne L\n"
+                                                "mov #-100, r2\n"
+                                                "prn M[r2][r2]\n"
+                                                "M: .mat [1][1] 0\n", "", 10000, &jit));
+    check("more blocks", !native || jit.blocks > blocks);
+    emu_jit_close(&jit);
+    if (failures == before) printf("PASS\n");
+}
+
+static void test_faults(void) {
+    emulator_t emu;
+    object_t big;
+    char out[256];
+    int before = failures;
+
+    printf("Running test: faults... ");
+    check("unlinked external", run_program(".extern F\njsr F\nstop\n", "", &emu, out, sizeof(out)) == EMU_FAULT &&
+                               emu.fault == ERROR_UNLINKED_EXTERNAL && emu.fault_pc == ADDRESS_BASE);
+    check("step limit", run_program("L: jmp L\n", "", &emu, out, sizeof(out)) == EMU_FAULT &&
+                        emu.fault == ERROR_STEP_LIMIT && emu.steps == 10000);
+    check("return without call", run_program("rts\n", "", &emu, out, sizeof(out)) == EMU_FAULT &&
+                                 emu.fault == ERROR_RETURN_STACK);
+    check("run into data", run_program("prn #1\nX: .data 1023\n", "", &emu, out, sizeof(out)) == EMU_FAULT &&
+                           emu.fault == ERROR_INVALID_INSTRUCTION && emu.fault_pc == ADDRESS_BASE + 2);
+    check("matrix outside memory", run_program("mov #-100, r1\nprn M[r1][r1]\nstop\nM: .mat [1][1] 0\n", "",
+                                               &emu, out, sizeof(out)) == EMU_FAULT &&
+                                   emu.fault == ERROR_ADDRESS_OUT_OF_RANGE);
+
+    memset(&big, 0, sizeof(big));
+    big.code_len = EMU_MEMORY_SIZE - ADDRESS_BASE + 1;
+    emu_init(&emu, stdin, stdout);
+    check("program too large", emu_load(&emu, &big) == -1);
+    if (failures == before) printf("PASS\n");
+}
+
+int main(void) {
+    printf("Running emulator tests...\n");
+    test_arithmetic();
+    test_control_flow();
+    test_memory_and_io();
+    test_modified_code();
+    test_profile();
+    test_snapshot();
+    test_batch();
+    test_lockstep();
+    test_jit();
+    test_faults();
+
+    if (failures) {
+        printf("%d failure(s)\n", failures);
+        return 1;
+    }
+    printf("All tests passed!\n");
+    return 0;
+}
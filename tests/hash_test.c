@@ -201,6 +201,29 @@ void handle_hash_collisions(void) {
     hash_destroy(ht, NULL);
 }
 
+void grow_keeps_every_entry(void) {
+    hash_table_t *ht = hash_create(4);
+    static int values[1000];
+    char key[16];
+    hash_entry_t *it;
+    int i, seen = 0;
+
+    for (i = 0; i < 1000; i++) {
+        values[i] = i;
+        sprintf(key, "k%d", i);
+        assert(hash_put(ht, key, &values[i]) == 0);
+    }
+    assert(hash_size(ht) == 1000);
+    assert(ht->capacity >= 1000 / HASH_MAX_LOAD);
+    for (i = 0; i < 1000; i++) {
+        sprintf(key, "k%d", i);
+        assert(*(int*)hash_get(ht, key) == i);
+    }
+    for (it = hash_get_next(ht, NULL); it; it = hash_get_next(ht, it)) seen++;
+    assert(seen == 1000);
+    hash_destroy(ht, NULL);
+}
+
 void destroy_with_callback_function(void) {
     hash_table_t *ht = hash_create(16);
     int value1 = 1, value2 = 2;
@@ -265,6 +288,7 @@ int main(void) {
     RUN_TEST(size_of_null_hash_table);
     RUN_TEST(size_of_empty_hash_table);
     RUN_TEST(handle_hash_collisions);
+    RUN_TEST(grow_keeps_every_entry);
     RUN_TEST(destroy_with_callback_function);
     RUN_TEST(remove_with_callback_function);
     RUN_TEST(store_and_retrieve_string_values);
@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <string.h>
+
+/* Include the header for the library we are testing */
+#include "../include/libasm.h"
+#include "test_support.h"
+
+/* --- Test Cases --- */
+
+static void test_valid_program(asm_ctx_t *ctx) {
+    const char *src =
+        ".extern W\n"
+        "mcro twice\n"
+        "inc r1\n"
+        "inc r1\n"
+        "mcrend\n"
+        "MAIN: mov #-1, r2\n"
+        "twice\n"
+        "jmp W\n"
+        "stop\n"
+        "K: .data 5, -2\n"
+        ".entry MAIN\n";
+    asm_result_t r;
+    int before = failures;
+
+    printf("Running test: valid program... ");
+    check("return value", asm_assemble_buffer(ctx, src, strlen(src), &r) == 0);
+    check("code length", r.code_len == 10);
+    check("data length", r.data_len == 2);
+    check("first word", r.code_len > 0 && r.code[0] == FIRST_WORD(0, 0, 3, ARE_A));
+    check("negative immediate", r.code_len > 1 && r.code[1] == (((WORD) -1 << 2) & WORD_MASK));
+    check("negative data", r.data_len > 1 && r.data[1] == ((WORD) -2 & WORD_MASK));
+    check("entry", r.n_entries == 1 && strcmp(r.entries[0].name, "MAIN") == 0 &&
+                   r.entries[0].address == ADDRESS_BASE);
+    check("external", r.n_externals == 1 && strcmp(r.externals[0].name, "W") == 0 &&
+                      r.externals[0].address == ADDRESS_BASE + 8);
+    check("no diagnostics", r.n_diagnostics == 0);
+    asm_result_free(&r);
+    if (failures == before) printf("PASS\n");
+}
+
+static void test_diagnostics(asm_ctx_t *ctx) {
+    const char *src =
+        "MAIN: mov r1, r2\n"
+        "jmp NOWHERE\n";
+    asm_result_t r;
+    int before = failures;
+
+    printf("Running test: diagnostics... ");
+    check("return value", asm_assemble_buffer(ctx, src, strlen(src), &r) == -1);
+    check("one diagnostic", r.n_diagnostics == 1);
+    check("code", r.n_diagnostics > 0 && r.diagnostics[0].code == ERROR_UNDEFINED_SYMBOL_USED);
+    check("line", r.n_diagnostics > 0 && r.diagnostics[0].line == 2);
+    check("no images", r.code == NULL && r.data == NULL);
+    asm_result_free(&r);
+    if (failures == before) printf("PASS\n");
+}
+
+static void test_empty_source(asm_ctx_t *ctx) {
+    asm_result_t r;
+    int before = failures;
+
+    printf("Running test: empty source... ");
+    check("return value", asm_assemble_buffer(ctx, "", 0, &r) == 0);
+    check("empty images", r.code_len == 0 && r.data_len == 0);
+    asm_result_free(&r);
+    if (failures == before) printf("PASS\n");
+}
+
+static int caller_errors = 0; /* diagnostics seen by the caller's own sink */
+
+static void caller_sink(void *user, const char *file_name, int error_code, int line_number) {
+    (void) user;
+    (void) file_name;
+    (void) error_code;
+    (void) line_number;
+    caller_errors++;
+}
+
+static void test_caller_sink(asm_ctx_t *ctx) {
+    const char *src = "jmp NOWHERE\n";
+    asm_result_t r;
+    error_sink_t sink;
+    void *user;
+    int before = failures;
+
+    printf("Running test: caller's sink kept... ");
+    set_error_sink(caller_sink, &caller_errors);
+    check("failing source", asm_assemble_buffer(ctx, src, strlen(src), &r) == -1 && r.n_diagnostics == 1);
+    asm_result_free(&r);
+    check("no diagnostic leaks to the caller", caller_errors == 0);
+    sink = get_error_sink(&user);
+    check("sink restored", sink == caller_sink && user == &caller_errors);
+    print_error(ERROR_MEMORY_ALLOCATION_FAILED);
+    check("later diagnostics reach the caller", caller_errors == 1);
+    set_error_sink(NULL, NULL);
+    check("no sink", get_error_sink(&user) == NULL && user == NULL);
+    if (failures == before) printf("PASS\n");
+}
+
+int main(void) {
+    asm_ctx_t *ctx = asm_ctx_create();
+
+    printf("--- Running libasm Tests ---\n");
+    if (!ctx) {
+        printf("FAIL (cannot create context)\n");
+        return 1;
+    }
+    test_valid_program(ctx);
+    test_diagnostics(ctx);
+    test_empty_source(ctx);
+    test_caller_sink(ctx);
+    asm_ctx_destroy(ctx);
+    printf("--- libasm Tests Finished ---\n");
+
+    return failures == 0 ? 0 : 1;
+}
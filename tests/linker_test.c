@@ -0,0 +1,570 @@
+#define _POSIX_C_SOURCE 200809L /* mkdtemp */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Include the headers of the components we are testing */
+#include "../include/linker.h"
+#include "../include/dead_strip.h"
+#include "../include/libasm.h"
+#include "test_support.h"
+
+/* --- Test Runner Helper Functions --- */
+
+/* A relocatable word pointing at address. */
+static WORD reloc_word(const int address) {
+    return (WORD) (((address << 2) | ARE_R) & WORD_MASK);
+}
+
+/* Module A: code 100..108, data V at 109, uses COUNT from module B. */
+static const char *src_a =
+    ".extern COUNT\n"
+    "MAIN: mov COUNT, r1\n"
+    "lea V, r2\n"
+    "LOOP: jmp LOOP\n"
+    "stop\n"
+    "V: .data 7\n"
+    ".entry MAIN\n";
+
+/* Module B: code 100..103, data 104..105. */
+static const char *src_b =
+    "COUNT: inc r3\n"
+    "jmp COUNT\n"
+    "C: .data 1, 2\n"
+    ".entry COUNT\n";
+
+/* --- Test Cases --- */
+
+static void test_link_two_modules(void) {
+    object_t mods[2], image;
+    int before = failures;
+
+    printf("Running test: link two modules... ");
+    check("assemble A", assemble_object("a", src_a, &mods[0]) == 0);
+    check("assemble B", assemble_object("b", src_b, &mods[1]) == 0);
+    check("module sizes", mods[0].code_len == 9 && mods[0].data_len == 1 &&
+                          mods[1].code_len == 4 && mods[1].data_len == 2);
+
+    check("link", link_objects(mods, 2, &image) == 0);
+    check("image sizes", image.code_len == 13 && image.data_len == 3);
+    if (image.words && image.code_len == 13 && image.data_len == 3) {
+        /* A code at 100, B code at 109, A data at 113, B data at 114 */
+        check("external patched", image.words[1] == reloc_word(109));
+        check("data reference moved past all code", image.words[4] == reloc_word(113));
+        check("first module code in place", image.words[7] == reloc_word(106));
+        check("second module code relocated", image.words[12] == reloc_word(109));
+        check("absolute words untouched", image.words[9] == mods[1].words[0]);
+        check("data copied", image.words[13] == 7 && image.words[14] == 1 && image.words[15] == 2);
+    }
+    check("entries", image.n_entries == 2 && image.n_externals == 0 &&
+                     strcmp(image.entries[0].name, "MAIN") == 0 && image.entries[0].address == 100 &&
+                     strcmp(image.entries[1].name, "COUNT") == 0 && image.entries[1].address == 109);
+
+    object_free(&image);
+    object_free(&mods[0]);
+    object_free(&mods[1]);
+    if (failures == before) printf("PASS\n");
+}
+
+static void test_link_errors(void) {
+    object_t mods[3], image;
+    int before = failures;
+
+    printf("Running test: link errors... ");
+    assemble_object("a", src_a, &mods[0]);
+    assemble_object("b", src_b, &mods[1]);
+    assemble_object("b2", src_b, &mods[2]);
+
+    set_error_sink(record_error, NULL);
+    last_error = ERROR_OK;
+    check("unresolved external fails", link_objects(mods, 1, &image) == -1);
+    check("unresolved external reported", last_error == ERROR_UNRESOLVED_EXTERNAL_SYMBOL);
+    check("failed image is empty", image.words == NULL && image.entries == NULL);
+    last_error = ERROR_OK;
+    check("duplicate entry fails", link_objects(mods, 3, &image) == -1);
+    check("duplicate entry reported", last_error == ERROR_DUPLICATE_EXPORTED_SYMBOL);
+    set_error_sink(NULL, NULL);
+
+    object_free(&mods[0]);
+    object_free(&mods[1]);
+    object_free(&mods[2]);
+    if (failures == before) printf("PASS\n");
+}
+
+/* Main module for dead stripping: DEAD and W are never reached from MAIN. */
+static const char *src_strip_main =
+    ".extern F1\n"
+    "MAIN: jsr F1\n"
+    "lea V, r1\n"
+    "stop\n"
+    "DEAD: inc r2\n"
+    "rts\n"
+    "V: .data 5\n"
+    "W: .data 6\n"
+    ".entry MAIN\n"
+    ".entry DEAD\n"
+    ".entry W\n";
+
+/* Library with a used routine F1 and an unused routine F2. */
+static const char *src_strip_lib1 =
+    "F1: prn #1\n"
+    "rts\n"
+    "F2: prn #2\n"
+    "rts\n"
+    ".entry F1\n"
+    ".entry F2\n";
+
+/* Library nobody uses; G falls through into H. */
+static const char *src_strip_lib2 =
+    "G: inc r1\n"
+    "H: stop\n"
+    ".entry G\n"
+    ".entry H\n";
+
+/* Assembles the three stripping modules into mods. */
+static void assemble_strip_modules(object_t *mods) {
+    assemble_object("main", src_strip_main, &mods[0]);
+    assemble_object("lib1", src_strip_lib1, &mods[1]);
+    assemble_object("lib2", src_strip_lib2, &mods[2]);
+}
+
+static void free_modules(object_t *mods, const int n) {
+    int i;
+
+    for (i = 0; i < n; i++) object_free(&mods[i]);
+}
+
+static void test_dead_strip(void) {
+    object_t mods[3], image;
+    char *roots[1];
+    int n, removed, i, before = failures;
+
+    printf("Running test: dead stripping... ");
+
+    /* whole modules from the first word of the first one */
+    assemble_strip_modules(mods);
+    n = 3;
+    check("module strip", link_strip(mods, &n, NULL, 0, STRIP_MODULES, &removed) == 0);
+    check("unused module removed", n == 2 && strcmp(mods[1].name, "lib1") == 0);
+    check("module strip word count", removed == 3);
+    free_modules(mods, n);
+
+    /* per label: DEAD, W and F2 go as well */
+    assemble_strip_modules(mods);
+    n = 3;
+    check("label strip", link_strip(mods, &n, NULL, 0, STRIP_LABELS, &removed) == 0);
+    check("label strip modules", n == 2);
+    check("label strip word count", removed == 3 + 3 + 1 + 3);
+    check("stripped modules link", link_objects(mods, n, &image) == 0);
+    check("stripped code length", image.code_len == 9);
+    check("stripped data length", image.data_len == 1);
+    check("call site points at F1", image.words[1] == reloc_word(106));
+    check("lea points at moved V", image.words[3] == reloc_word(109));
+    check("V kept", image.words[9] == 5);
+    check("live entries only", image.n_entries == 2);
+    for (i = 0; i < image.n_entries; i++) {
+        check("no dead entry", strcmp(image.entries[i].name, "DEAD") != 0 && strcmp(image.entries[i].name, "W") != 0 &&
+                               strcmp(image.entries[i].name, "F2") != 0);
+    }
+    object_free(&image);
+    free_modules(mods, n);
+
+    /* an explicit root replaces the default one */
+    assemble_strip_modules(mods);
+    n = 3;
+    roots[0] = "F2";
+    check("root strip", link_strip(mods, &n, roots, 1, STRIP_LABELS, &removed) == 0);
+    check("root keeps its routine only", n == 1 && mods[0].code_len == 3 && mods[0].n_entries == 1);
+    free_modules(mods, n);
+
+    /* fall through keeps the next label */
+    assemble_strip_modules(mods);
+    n = 3;
+    roots[0] = "G";
+    check("fall through strip", link_strip(mods, &n, roots, 1, STRIP_LABELS, &removed) == 0);
+    check("fall through kept", n == 1 && mods[0].code_len == 3 && mods[0].n_entries == 2);
+    free_modules(mods, n);
+
+    /* a root must be an entry symbol */
+    assemble_strip_modules(mods);
+    n = 3;
+    roots[0] = "NOPE";
+    set_error_sink(record_error, NULL);
+    last_error = ERROR_OK;
+    check("unknown root fails", link_strip(mods, &n, roots, 1, STRIP_MODULES, &removed) == -1);
+    check("unknown root reported", last_error == ERROR_UNKNOWN_ROOT_SYMBOL);
+    check("failed strip keeps modules", n == 3);
+    set_error_sink(NULL, NULL);
+    free_modules(mods, n);
+
+    if (failures == before) printf("PASS\n");
+}
+
+static void test_object_files(const char *dir) {
+    object_t mods[2], image, back;
+    char base[256], path[300];
+    char *src;
+    FILE *fp;
+    int i, before = failures;
+
+    printf("Running test: object file round trip... ");
+    assemble_object("a", src_a, &mods[0]);
+    assemble_object("b", src_b, &mods[1]);
+    link_objects(mods, 2, &image);
+
+    sprintf(base, "%s/image", dir);
+    check("write", object_write(base, &image) == 0);
+    check("read", object_read(base, &back) == 0);
+    check("same lengths", back.code_len == image.code_len && back.data_len == image.data_len);
+    check("same words", back.words && memcmp(back.words, image.words,
+                                             sizeof(WORD) * (size_t) (image.code_len + image.data_len)) == 0);
+    check("same entries", back.n_entries == 2 && back.entries[1].address == image.entries[1].address &&
+                          back.n_externals == 0);
+    object_free(&back);
+    object_free(&image);
+
+    /* more than 63 code words no longer fit the old 3 digit header */
+    src = malloc(100 * 6 + 1);
+    src[0] = '\0';
+    for (i = 0; i < 100; i++) strcat(src, "stop\n");
+    assemble_object("long", src, &image);
+    sprintf(base, "%s/long", dir);
+    check("write long", object_write(base, &image) == 0);
+    check("read long", object_read(base, &back) == 0 && back.code_len == 100 && back.data_len == 0);
+    object_free(&back);
+    object_free(&image);
+    free(src);
+
+    /* a header that does not describe the words is rejected */
+    sprintf(path, "%s/bad.ob", dir);
+    fp = fopen(path, "w");
+    if (fp) {
+        fprintf(fp, "aab aa\nbcba\taaaaa\nbcbb\taaaaa\n");
+        fclose(fp);
+    }
+    sprintf(base, "%s/bad", dir);
+    set_error_sink(record_error, NULL);
+    last_error = ERROR_OK;
+    check("bad header rejected", object_read(base, &back) == -1 && last_error == ERROR_INVALID_OBJECT_FILE);
+    object_free(&back);
+    last_error = ERROR_OK;
+    sprintf(base, "%s/missing", dir);
+    check("missing object", object_read(base, &back) == -1 && last_error == ERROR_CANNOT_OPEN_FILE);
+    object_free(&back);
+    set_error_sink(NULL, NULL);
+
+    sprintf(path, "%s/image.ob", dir); remove(path);
+    sprintf(path, "%s/image.ent", dir); remove(path);
+    sprintf(path, "%s/long.ob", dir); remove(path);
+    sprintf(path, "%s/bad.ob", dir); remove(path);
+
+    object_free(&mods[0]);
+    object_free(&mods[1]);
+    if (failures == before) printf("PASS\n");
+}
+
+/* Writes a module assembled from src as dir/name and returns its base name in base. */
+static void write_module(const char *dir, const char *name, const char *src, char *base) {
+    object_t obj;
+
+    sprintf(base, "%s/%s", dir, name);
+    if (assemble_object(base, src, &obj) != 0 || object_write(base, &obj) != 0) check(name, 0);
+    object_free(&obj);
+}
+
+/* Removes the files of a module written by write_module. */
+static void remove_module(const char *base) {
+    const char *endings[3] = {".ob", ".ent", ".ext"};
+    char path[300];
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        sprintf(path, "%s%s", base, endings[i]);
+        remove(path);
+    }
+}
+
+/* Assembles a module exporting FA that holds n times "inc r1", two words each. */
+static void assemble_incs(const int n, object_t *obj) {
+    char *src = malloc((size_t) n * 8 + 32);
+    int i;
+
+    strcpy(src, ".entry FA\nFA: ");
+    for (i = 0; i < n; i++) strcat(src, "inc r1\n");
+    strcat(src, "rts\n");
+    assemble_object("incs", src, obj);
+    free(src);
+}
+
+static void test_image_overflow(const char *dir) {
+    object_t mods[2], image, back;
+    char base[256];
+    int before = failures;
+
+    printf("Running test: images past the memory... ");
+    assemble_object("caller", ".extern FA\njsr FA\nstop\n", &mods[0]);
+    assemble_incs(160, &mods[1]);
+    set_error_sink(record_error, NULL);
+    last_error = ERROR_OK;
+    check("oversized link fails", link_objects(mods, 2, &image) == -1);
+    check("oversized link reported", last_error == ERROR_PROGRAM_TOO_LARGE);
+    check("nothing patched", image.words == NULL && image.code_len == 0);
+    last_error = ERROR_OK;
+    sprintf(base, "%s/oversized", dir);
+    check("oversized object not written", object_write(base, &mods[1]) == -1 &&
+                                          last_error == ERROR_PROGRAM_TOO_LARGE && object_read(base, &back) == -1);
+    object_free(&back);
+    set_error_sink(NULL, NULL);
+    object_free(&mods[1]);
+
+    /* 3 + 2 * 76 + 1 words end exactly at address 255 */
+    assemble_incs(76, &mods[1]);
+    check("full memory links", link_objects(mods, 2, &image) == 0 && image.code_len == IMAGE_LENGTH - ADDRESS_BASE);
+    sprintf(base, "%s/full", dir);
+    check("full memory written", object_write(base, &image) == 0 && object_read(base, &back) == 0 &&
+                                 back.code_len == image.code_len);
+    object_free(&back);
+    object_free(&image);
+    free_modules(mods, 2);
+    if (failures == before) printf("PASS\n");
+}
+
+static void test_archive(const char *dir) {
+    char c[256], h[256], u[256], lib[256], bad[256];
+    char *members[3];
+    archive_t ar;
+    vec_t modules;
+    object_t obj, image;
+    FILE *fp;
+    size_t i;
+    int before = failures;
+
+    printf("Running test: archive members pulled on demand... ");
+    write_module(dir, "c", ".extern HELP\nCOUNT: jmp HELP\nstop\n.entry COUNT\n", c);
+    write_module(dir, "u", "UNUSED: stop\n.entry UNUSED\n", u);
+    write_module(dir, "h", "HELP: stop\n.entry HELP\n", h);
+    members[0] = c;
+    members[1] = u;
+    members[2] = h;
+    sprintf(lib, "%s/lib.a", dir);
+    check("write archive", archive_write(lib, members, 3) == 0);
+
+    check("open archive", archive_open(lib, &ar) == 0);
+    check("index lookups", archive_find(&ar, "COUNT") == 0 && archive_find(&ar, "UNUSED") == 1 &&
+                           archive_find(&ar, "HELP") == 2 && archive_find(&ar, "MAIN") == -1);
+    check("member name", ar.n_members == 3 && strcmp(archive_member_name(&ar, 2), h) == 0);
+
+    vec_create(&modules, sizeof(object_t));
+    assemble_object("a", src_a, &obj);
+    vec_push(&modules, &obj);
+    check("pull members", link_pull_members(&modules, &ar, 1) == 0);
+    check("only needed members pulled", modules.len == 3 &&
+                                        strcmp(((object_t *) vec_get(&modules, 1))->name, c) == 0 &&
+                                        strcmp(((object_t *) vec_get(&modules, 2))->name, h) == 0);
+    check("link with members", link_objects(modules.data, (int) modules.len, &image) == 0 &&
+                               image.n_entries == 3);
+    object_free(&image);
+    for (i = 0; i < modules.len; i++) object_free(vec_get(&modules, i));
+    vec_destroy(&modules);
+    archive_close(&ar);
+
+    set_error_sink(record_error, NULL);
+    last_error = ERROR_OK;
+    members[1] = c;
+    check("duplicate symbol in archive", archive_write(lib, members, 2) == -1 &&
+                                         last_error == ERROR_DUPLICATE_EXPORTED_SYMBOL);
+    sprintf(bad, "%s/bad.a", dir);
+    fp = fopen(bad, "w");
+    if (fp) {
+        fprintf(fp, "ASMARCH1 but not an archive\n");
+        fclose(fp);
+    }
+    last_error = ERROR_OK;
+    check("corrupt archive rejected", archive_open(bad, &ar) == -1 && last_error == ERROR_INVALID_ARCHIVE);
+    set_error_sink(NULL, NULL);
+
+    remove(lib);
+    remove(bad);
+    remove_module(c);
+    remove_module(u);
+    remove_module(h);
+    if (failures == before) printf("PASS\n");
+}
+
+#define CHAIN_LENGTH 20 /* modules of the parallel link test, 7 words each to fit the memory */
+
+static char reported[4][64]; /* files of the first diagnostics, in report order */
+static int n_reported = 0;
+
+static void record_order(void *user, const char *file_name, int error_code, int line_number) {
+    (void) user;
+    (void) error_code;
+    (void) line_number;
+    if (n_reported < 4) strcpy(reported[n_reported], file_name ? file_name : "");
+    n_reported++;
+}
+
+/* Assembles a chain of modules, module k calls F<k+1> of the next one.
+ * The calls of the modules in broken go to symbols nobody exports.
+ */
+static void assemble_chain(object_t *mods, const int broken_a, const int broken_b) {
+    char src[256], name[32];
+    int k;
+
+    for (k = 0; k < CHAIN_LENGTH; k++) {
+        sprintf(name, "m%d", k);
+        if (k == broken_a || k == broken_b) {
+            sprintf(src, ".extern G%d\nF%d: jsr G%d\nlea D%d, r1\nstop\nD%d: .data %d\n.entry F%d\n", k, k, k, k, k, k, k);
+        } else {
+            sprintf(src, ".extern F%d\nF%d: jsr F%d\nlea D%d, r1\nstop\nD%d: .data %d\n.entry F%d\n",
+                    (k + 1) % CHAIN_LENGTH, k, (k + 1) % CHAIN_LENGTH, k, k, k, k);
+        }
+        assemble_object(name, src, &mods[k]);
+    }
+}
+
+static void test_parallel_link(void) {
+    object_t mods[CHAIN_LENGTH], serial, parallel;
+    int workers, before = failures;
+
+    printf("Running test: parallel patch phase... ");
+    assemble_chain(mods, -1, -1);
+    check("serial link", link_objects(mods, CHAIN_LENGTH, &serial) == 0);
+    for (workers = 2; workers <= 8; workers *= 2) {
+        check("parallel link", link_objects_parallel(mods, CHAIN_LENGTH, workers, &parallel) == 0);
+        check("same image", parallel.code_len == serial.code_len && parallel.data_len == serial.data_len &&
+                            memcmp(parallel.words, serial.words,
+                                   sizeof(WORD) * (size_t) (serial.code_len + serial.data_len)) == 0);
+        check("same entries", parallel.n_entries == serial.n_entries &&
+                              memcmp(parallel.entries, serial.entries,
+                                     sizeof(obj_symbol_t) * (size_t) serial.n_entries) == 0);
+        object_free(&parallel);
+    }
+    object_free(&serial);
+    free_modules(mods, CHAIN_LENGTH);
+
+    /* diagnostics arrive on the calling thread in module order */
+    assemble_chain(mods, 15, 5);
+    set_error_sink(record_order, NULL);
+    n_reported = 0;
+    check("unresolved fails in parallel", link_objects_parallel(mods, CHAIN_LENGTH, 8, &parallel) == -1);
+    check("diagnostics in module order", n_reported == 2 && strcmp(reported[0], "m5.ext") == 0 &&
+                                         strcmp(reported[1], "m15.ext") == 0);
+    set_error_sink(NULL, NULL);
+    free_modules(mods, CHAIN_LENGTH);
+
+    if (failures == before) printf("PASS\n");
+}
+
+/* Links the modules named in names from their files and records the link state. */
+static void full_link(char *const *names, const int n, const char *out, const char *state_path) {
+    object_t mods[3], image;
+    link_state_t state;
+    int i;
+
+    for (i = 0; i < n; i++) check("read module", object_read(names[i], &mods[i]) == 0);
+    check("full link", link_objects(mods, n, &image) == 0 && object_write(out, &image) == 0);
+    check("record state", link_record_state(mods, n, n, NULL, 0, &state) == 0);
+    check("write state", link_state_write(state_path, &state) == 0);
+    link_state_free(&state);
+    object_free(&image);
+    free_modules(mods, n);
+}
+
+/* Runs an incremental relink from the state file, returns what link_incremental returned. */
+static int relink_from(const char *state_path, const char *out, char *const *names, const int n,
+                       object_t *image, int *relinked) {
+    link_state_t state;
+    int result;
+
+    if (link_state_read(state_path, &state) != 0) return -2;
+    result = link_incremental(&state, out, names, n, NULL, 0, image, relinked);
+    link_state_free(&state);
+    return result;
+}
+
+static void test_incremental(const char *dir) {
+    char main_base[256], lib1[256], lib2[256], out[256], state_path[300];
+    char *names[3];
+    link_state_t state;
+    object_t image;
+    int i, relinked, before = failures;
+
+    printf("Running test: incremental relinking... ");
+    write_module(dir, "main", src_strip_main, main_base);
+    write_module(dir, "lib1", src_strip_lib1, lib1);
+    write_module(dir, "lib2", src_strip_lib2, lib2);
+    names[0] = main_base;
+    names[1] = lib1;
+    names[2] = lib2;
+    sprintf(out, "%s/out", dir);
+    sprintf(state_path, "%s%s", out, LINK_STATE_ENDING);
+    full_link(names, 3, out, state_path);
+
+    check("state round trip", link_state_read(state_path, &state) == 0 && state.n_modules == 3 &&
+                              state.n_symbols == 7 && state.n_sites == 1 && state.code_len == 18 &&
+                              state.modules[1].code_base == 109 && state.modules[1].code_slot == 6);
+    link_state_free(&state);
+
+    check("unchanged is up to date", relink_from(state_path, out, names, 3, &image, &relinked) == 1 && relinked == 0);
+    object_free(&image);
+    check("read state", link_state_read(state_path, &state) == 0);
+    state.modules[1].code_slot = IMAGE_LENGTH; /* a slot past the memory is never patched */
+    check("state past the memory", link_incremental(&state, out, names, 3, NULL, 0, &image, &relinked) == 0 &&
+                                   image.words == NULL);
+    link_state_free(&state);
+
+    /* F1 moves inside the slot of lib1, the call in main follows it */
+    write_module(dir, "lib1", "Y: rts\nF1: rts\nF2: prn #2\nrts\n.entry F1\n.entry F2\n", lib1);
+    check("changed module relinked", relink_from(state_path, out, names, 3, &image, &relinked) == 1 && relinked == 1);
+    check("image keeps its length", image.code_len == 18 && image.data_len == 2);
+    check("usage of a moved symbol patched", image.words[1] == reloc_word(110));
+    check("changed code placed", image.words[9] == FIRST_WORD(RTS_OP, 0, 0, ARE_A));
+    check("shrunk slot padded", image.words[14] == 0);
+    check("unchanged module kept", image.words[15] == FIRST_WORD(INC_OP, 0, REGISTER_DIRECT, ARE_A));
+    for (i = 0; i < image.n_entries; i++) {
+        if (strcmp(image.entries[i].name, "F1") == 0) check("moved entry", image.entries[i].address == 110);
+    }
+    object_free(&image);
+
+    /* a full link is needed when the exports change, the slot overflows or the inputs differ */
+    write_module(dir, "lib1", "F1: rts\nF2: rts\n.entry F1\n", lib1);
+    check("changed exports", relink_from(state_path, out, names, 3, &image, &relinked) == 0);
+    write_module(dir, "lib1", "F1: prn #1\nprn #1\nprn #1\nrts\nF2: rts\n.entry F1\n.entry F2\n", lib1);
+    check("slot overflow", relink_from(state_path, out, names, 3, &image, &relinked) == 0);
+    check("other modules", relink_from(state_path, out, names, 2, &image, &relinked) == 0);
+
+    remove_module(main_base);
+    remove_module(lib1);
+    remove_module(lib2);
+    remove_module(out);
+    remove(state_path);
+    if (failures == before) printf("PASS\n");
+}
+
+int main(void) {
+    char dir[] = "/tmp/linker_test.XXXXXX";
+
+    printf("Running linker tests...\n");
+    test_link_two_modules();
+    test_link_errors();
+    test_dead_strip();
+    test_parallel_link();
+    if (mkdtemp(dir)) {
+        test_object_files(dir);
+        test_image_overflow(dir);
+        test_archive(dir);
+        test_incremental(dir);
+        rmdir(dir);
+    } else {
+        check("temporary directory", 0);
+    }
+
+    if (failures) {
+        printf("%d failure(s)\n", failures);
+        return 1;
+    }
+    printf("All tests passed!\n");
+    return 0;
+}
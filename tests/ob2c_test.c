@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Include the headers of the components we are testing */
+#include "../include/ob2c.h"
+#include "../include/emulator.h"
+#include "../include/libasm.h"
+#include "test_support.h"
+
+#ifndef HOST_CC
+#define HOST_CC "cc"
+#endif
+
+#define OB_NAME "prog.ob" /* name the simulators report faults in */
+#define SIM_SOURCE "ob2c_test_sim.c"
+#define SIM_BINARY "./ob2c_test_sim"
+#define SIM_INPUT "ob2c_test_sim.in"
+#define SIM_OUTPUT "ob2c_test_sim.out"
+#define MAX_OUTPUT 4096
+
+/* --- Test Runner Helper Functions --- */
+
+/* Writes text into a file. Returns 0 on success. */
+static int write_file(const char *path, const char *text) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) return -1;
+    fputs(text, fp);
+    return fclose(fp) == 0 ? 0 : -1;
+}
+
+/* Reads at most size - 1 bytes of a file into text. */
+static void read_file(const char *path, char *text, const size_t size) {
+    FILE *fp = fopen(path, "r");
+    size_t n = 0;
+
+    if (fp) {
+        n = fread(text, 1, size - 1, fp);
+        fclose(fp);
+    }
+    text[n] = '\0';
+}
+
+/* Runs a program on the emulator and writes what the emulator command prints. */
+static void expected_output(const object_t *program, const char *input, char *text, const size_t size) {
+    emulator_t emu;
+    FILE *in = tmpfile(), *out = tmpfile();
+    size_t n = 0;
+    int word;
+
+    text[0] = '\0';
+    if (!in || !out) {
+        if (in) fclose(in);
+        if (out) fclose(out);
+        return;
+    }
+    fputs(input, in);
+    rewind(in);
+    emu_init(&emu, in, out);
+    emu_load(&emu, program);
+    if (emu_run(&emu) == EMU_FAULT) {
+        word = emu.fault_pc - ADDRESS_BASE;
+        fprintf(out, "There is error in %s at line:%d ERROR: %s\n", OB_NAME,
+                word >= 0 && word < program->code_len + program->data_len ? word + 2 : 0, error_message(emu.fault));
+        fprintf(out, "Stopped at address %d after %ld instructions\n", emu.fault_pc, emu.steps);
+    }
+    rewind(out);
+    n = fread(text, 1, size - 1, out);
+    text[n] = '\0';
+    fclose(in);
+    fclose(out);
+}
+
+/* Translates a program, compiles the simulator and runs it.
+ * Returns 1 if it prints what the emulator prints; with expected set, that instead.
+ */
+static int same_as_emulator(const char *src, const char *input, const char *expected) {
+    object_t program;
+    FILE *fp;
+    char want[MAX_OUTPUT], got[MAX_OUTPUT];
+    int status;
+
+    if (assemble_object(NULL, src, &program) != 0) return 0;
+    fp = fopen(SIM_SOURCE, "w");
+    status = fp ? ob2c_translate(&program, OB_NAME, EMU_DEFAULT_MAT_COLS, fp) : -1;
+    if (fp && fclose(fp) != 0) status = -1;
+    if (status == 0) status = write_file(SIM_INPUT, input);
+    /* the simulator must build cleanly as strict C89 */
+    if (status == 0 && system(HOST_CC " -std=c89 -pedantic -Wall -Wextra -Werror -O1 -o " SIM_BINARY
+                              " " SIM_SOURCE) != 0) {
+        printf("(compiling the simulator failed) ");
+        status = -1;
+    }
+    if (status == 0 && system(SIM_BINARY " < " SIM_INPUT " > " SIM_OUTPUT) == -1) status = -1;
+    if (status == 0) {
+        read_file(SIM_OUTPUT, got, sizeof(got));
+        if (expected) strcpy(want, expected);
+        else expected_output(&program, input, want, sizeof(want));
+        if (strcmp(got, want) != 0) {
+            printf("(simulator printed \"%s\", expected \"%s\") ", got, want);
+            status = -1;
+        }
+    }
+    object_free(&program);
+    remove(SIM_SOURCE);
+    remove(SIM_BINARY);
+    remove(SIM_INPUT);
+    remove(SIM_OUTPUT);
+    return status == 0;
+}
+
+/* --- Test Cases --- */
+
+static void test_programs(void) {
+    int before = failures;
+
+    printf("Running test: simulators against the emulator... ");
+    check("loops and calls", same_as_emulator("MAIN: mov #0, r1\n"
+                                              "LOOP: jsr WORK\n"
+                                              "inc r1\n"
+                                              "cmp r1, #5\n"
+                                              "bne LOOP\n"
+                                              "prn X\n"
+                                              "stop\n"
+                                              "WORK: add #1, X\n"
+                                              "sub r1, X\n"
+                                              "not r7\n"
+                                              "rts\n"
+                                              "X: .data 0\n", "", NULL));
+    check("matrices and lea", same_as_emulator("mov #1, r1\n"
+                                               "mov #0, r2\n"
+                                               "prn M[r1][r2]\n"
+                                               "mov #9, M[r2][r1]\n"
+                                               "add M[r2][r1], M[r1][r1]\n"
+                                               "prn M[r1][r1]\n"
+                                               "lea M[r1][r1], r3\n"
+                                               "lea M, r4\n"
+                                               "sub r4, r3\n"
+                                               "prn r3\n"
+                                               "clr M[r1][r2]\n"
+                                               "dec M[r1][r2]\n"
+                                               "prn M[r1][r2]\n"
+                                               "stop\n"
+                                               "M: .mat [2][2] 1, 2, 3, 4\n", "", NULL));
+    check("input until its end", same_as_emulator("L: red r1\n"
+                                                  "prn r1\n"
+                                                  "cmp r1, #-1\n"
+                                                  "bne L\n"
+                                                  "red X\n"
+                                                  "prn X\n"
+                                                  "stop\n"
+                                                  "X: .data 5\n", "ab\n", NULL));
+    check("jumps through registers", same_as_emulator("lea F, r3\n"
+                                                      "jsr r3\n"
+                                                      "lea END, r3\n"
+                                                      "cmp r3, #0\n"
+                                                      "bne r3\n"
+                                                      "prn #1\n"
+                                                      "END: stop\n"
+                                                      "F: prn #2\n"
+                                                      "jmp A[r0][r0]\n"
+                                                      "A: rts\n", "", NULL));
+    if (failures == before) printf("PASS\n");
+}
+
+static void test_faults(void) {
+    int before = failures;
+
+    printf("Running test: faults of simulators... ");
+    check("matrix outside memory", same_as_emulator("mov #-100, r1\n"
+                                                    "prn M[r1][r1]\n"
+                                                    "stop\n"
+                                                    "M: .mat [1][1] 0\n", "", NULL));
+    check("return without call", same_as_emulator("prn #3\nrts\n", "", NULL));
+    check("deep recursion", same_as_emulator("R: jsr R\n", "", NULL));
+    check("unlinked external", same_as_emulator(".extern F\n"
+                                                "prn #4\n"
+                                                "jsr F\n"
+                                                "stop\n", "", NULL));
+    check("store into code", same_as_emulator("MAIN: prn #1\n"
+                                              "mov S, MAIN\n"
+                                              "stop\n"
+                                              "S: .data -64\n", "",
+                                              "1\n"
+                                              "There is error in " OB_NAME " at line:4 ERROR: store into the code of a"
+                                              " translated program\n"
+                                              "Stopped at address 102 after 2 instructions\n"));
+    check("running past the code", same_as_emulator("prn #1\n", "",
+                                                    "1\n"
+                                                    "There is error in " OB_NAME " at line:0 ERROR: jump to an address"
+                                                    " outside the translated code\n"
+                                                    "Stopped at address 102 after 1 instructions\n"));
+    if (failures == before) printf("PASS\n");
+}
+
+int main(void) {
+    printf("Running ob2c tests...\n");
+    test_programs();
+    test_faults();
+
+    if (failures) {
+        printf("%d failure(s)\n", failures);
+        return 1;
+    }
+    printf("All tests passed!\n");
+    return 0;
+}
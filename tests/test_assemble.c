@@ -0,0 +1,24 @@
+#include <string.h>
+#include "../include/libasm.h"
+#include "test_support.h"
+
+/*
+ * =====================================================================================
+ * Filename:  test_assemble.c
+ * Description: In-memory assembly of test sources into modules.
+ * =====================================================================================
+ */
+
+int assemble_object(const char *name, const char *src, object_t *obj) {
+    asm_ctx_t *ctx = asm_ctx_create();
+    asm_result_t r;
+    int status;
+
+    memset(obj, 0, sizeof(*obj));
+    if (!ctx) return -1;
+    status = asm_assemble_buffer(ctx, src, strlen(src), &r);
+    asm_ctx_destroy(ctx);
+    if (status == 0) status = object_from_result(name, &r, obj);
+    asm_result_free(&r);
+    return status;
+}
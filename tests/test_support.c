@@ -0,0 +1,29 @@
+#include <stdio.h>
+#include "../include/errors.h"
+#include "test_support.h"
+
+/*
+ * =====================================================================================
+ * Filename:  test_support.c
+ * Description: Failure counting and the recording error sink of the test programs.
+ * Kept apart from test_assemble.c so tests of libasm alone do not need the core.
+ * =====================================================================================
+ */
+
+int failures = 0;
+int last_error = ERROR_OK;
+int last_line = 0;
+
+void check(const char *what, int condition) {
+    if (!condition) {
+        printf("FAIL (%s)\n", what);
+        failures++;
+    }
+}
+
+void record_error(void *user, const char *file_name, int error_code, int line_number) {
+    (void) user;
+    (void) file_name;
+    last_error = error_code;
+    last_line = line_number;
+}
@@ -0,0 +1,45 @@
+#ifndef TEST_SUPPORT_H
+#define TEST_SUPPORT_H
+#include "../include/object_file.h"
+
+/*
+ * =====================================================================================
+ * Filename:  test_support.h
+ * Description: Helpers shared by the test programs: failure counting, an error sink
+ * recording the last diagnostic and in-memory assembly into a module.
+ * =====================================================================================
+ */
+
+extern int failures; /* failed checks so far */
+extern int last_error; /* last diagnostic seen by record_error */
+extern int last_line; /* line of that diagnostic */
+
+/**
+ * @brief Count a failed check and print what failed
+ *
+ * @param what Description of the check
+ * @param condition Nonzero if the check passed
+ */
+void check(const char *what, int condition);
+
+/**
+ * @brief Error sink keeping the last diagnostic in last_error and last_line
+ *
+ * @param user Unused
+ * @param file_name Unused
+ * @param error_code Code of the diagnostic
+ * @param line_number Line of the diagnostic
+ */
+void record_error(void *user, const char *file_name, int error_code, int line_number);
+
+/**
+ * @brief Assemble a source in memory into a module
+ *
+ * @param name Base name of the module, or NULL
+ * @param src Source text
+ * @param obj Receives the module (zeroed on failure), released with object_free
+ * @return 0 on success, -1 if the source does not assemble
+ */
+int assemble_object(const char *name, const char *src, object_t *obj);
+
+#endif
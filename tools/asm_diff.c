@@ -0,0 +1,962 @@
+#define _POSIX_C_SOURCE 200809L /* mkdtemp, fork, shm_unlink */
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "../include/macro.h"
+#include "../include/symbol_table.h"
+#include "../include/second_pass.h"
+#include "../include/spill.h"
+#include "../include/libasm.h"
+#include "../include/errors.h"
+
+/*
+ * =====================================================================================
+ * Filename:  asm_diff.c
+ * Description: Differential testing harness for the assembly paths.
+ * Every input is assembled through the reference path (preprocess_file, first_pass,
+ * second_pass, i.e. the regular file mode of the assembler) and through each other
+ * path listed in PATHS. The .ob/.ent/.ext contents, the exit status and the
+ * diagnostics that carry a line number ("line N: message", as printed by the
+ * assembler without the file name) must be byte for byte identical. Summary
+ * messages without a line, such as "first pass failed", are reported by the
+ * drivers rather than by the paths and are not compared.
+ *
+ * With --assembler=PATH the assembler executable itself is run as two more paths:
+ * "cache" assembles the input twice on a private --shm-cache segment and compares
+ * the second run, whose preprocessing must come from the cache, and "jobs" assembles
+ * JOB_FILES files at once with -j, the input and shorter prefixes of it, and checks
+ * every file against its own reference run. What the executable printed for a file
+ * is turned back into the diagnostics format above.
+ *
+ * Besides the given corpora the harness assembles --mutations=N seeded variants of
+ * each one (lines deleted, duplicated, swapped, truncated or garbled) so the error
+ * paths are exercised too. A mismatching input is shrunk line by line to a minimal
+ * reproducer that still mismatches, written as <corpus>.<path>.min.as.
+ *
+ * A new fast path is added by writing a run_* function with the diff_path_fn
+ * signature and listing it in PATHS.
+ *
+ * Usage: asm_diff [--paths=a,b] [--mutations=N] [--seed=N] [--out-dir=DIR]
+ *                 [--no-shrink] [--assembler=PATH] <corpus.as> ...
+ * =====================================================================================
+ */
+
+#define MAX_PATH_LENGTH 1024
+#define MAX_EDITS 3 /* edits applied to one mutation */
+#define JOB_FILES 4 /* files assembled at once by the jobs path */
+
+/* Outputs compared between paths. */
+enum { OUT_OB, OUT_ENT, OUT_EXT, OUT_DIAG, N_OUTPUTS };
+
+static const char *const OUTPUT_NAMES[N_OUTPUTS] = {".ob", ".ent", ".ext", "diagnostics"};
+
+/* struct diff_output_t is everything a path produced for one input. */
+typedef struct {
+    int status; /* 0 on success, -1 on failure */
+    char *text[N_OUTPUTS]; /* NULL when the file was not written */
+} diff_output_t;
+
+/* A path assembles src (len bytes) in the scratch directory workdir. */
+typedef void (*diff_path_fn)(const char *src, size_t len, const char *workdir, diff_output_t *out);
+
+/* struct diff_path_t names one way of assembling a source. */
+typedef struct {
+    const char *name;
+    diff_path_fn run;
+    int enabled;
+    int external; /* runs the assembler executable, needs --assembler */
+} diff_path_t;
+
+/* struct text_buf_t is a growing null terminated string. */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} text_buf_t;
+
+/* struct lines_t is a source split into lines (without their newlines). */
+typedef struct {
+    char **line;
+    long n;
+} lines_t;
+
+/* struct diff_options_t holds the command line settings. */
+typedef struct {
+    long mutations;
+    unsigned long seed;
+    const char *out_dir;
+    int shrink;
+} diff_options_t;
+
+static void run_reference(const char *src, size_t len, const char *workdir, diff_output_t *out);
+static void run_streaming(const char *src, size_t len, const char *workdir, diff_output_t *out);
+static void run_library(const char *src, size_t len, const char *workdir, diff_output_t *out);
+static void run_cache(const char *src, size_t len, const char *workdir, diff_output_t *out);
+static void run_jobs(const char *src, size_t len, const char *workdir, diff_output_t *out);
+
+/* The reference path comes first. */
+static diff_path_t PATHS[] = {
+    {"reference", run_reference, 1, 0},
+    {"streaming", run_streaming, 1, 0}, /* memory-bounded mode through the spill files */
+    {"library", run_library, 1, 0}, /* asm_assemble_buffer, rendered in the file formats */
+    {"cache", run_cache, 1, 1}, /* preprocessing reused from the shared cache */
+    {"jobs", run_jobs, 1, 1} /* several files on the worker pool */
+};
+
+#define N_PATHS ((int) (sizeof(PATHS) / sizeof(PATHS[0])))
+
+static const char *assembler_path = NULL; /* executable run by the external paths */
+static char cache_name[64]; /* private shared cache segment of this run */
+
+/* --- Private Helper Functions --- */
+
+/* Appends len bytes to a buffer. Returns 0 on success, -1 if out of memory. */
+static int buf_append(text_buf_t *b, const char *s, size_t len) {
+    char *grown;
+    size_t cap;
+
+    if (b->len + len + 1 > b->cap) {
+        cap = b->cap ? b->cap : 256;
+        while (cap < b->len + len + 1) cap *= 2;
+        grown = realloc(b->data, cap);
+        if (!grown) return -1;
+        b->data = grown;
+        b->cap = cap;
+    }
+    memcpy(b->data + b->len, s, len);
+    b->len += len;
+    b->data[b->len] = '\0';
+    return 0;
+}
+
+/* Returns the buffer contents, an empty string if nothing was appended. */
+static char *buf_take(text_buf_t *b) {
+    char *s = b->data;
+
+    if (!s) s = calloc(1, 1);
+    b->data = NULL;
+    b->len = b->cap = 0;
+    return s;
+}
+
+/* Reads a whole file into a null terminated buffer. Returns NULL if it does not exist. */
+static char *read_text(const char *path, size_t *len) {
+    FILE *fp = fopen(path, "rb");
+    char *buf = NULL;
+    long size;
+
+    if (!fp) return NULL;
+    if (fseek(fp, 0, SEEK_END) == 0 && (size = ftell(fp)) >= 0 && fseek(fp, 0, SEEK_SET) == 0) {
+        buf = malloc((size_t) size + 1);
+        if (buf && fread(buf, 1, (size_t) size, fp) != (size_t) size) {
+            free(buf);
+            buf = NULL;
+        }
+        if (buf) {
+            buf[size] = '\0';
+            if (len) *len = (size_t) size;
+        }
+    }
+    fclose(fp);
+    return buf;
+}
+
+/* Writes len bytes to a file. Returns 0 on success, -1 on failure. */
+static int write_text(const char *path, const char *text, size_t len) {
+    FILE *fp = fopen(path, "wb");
+    int status = 0;
+
+    if (!fp) return -1;
+    if (len && fwrite(text, 1, len, fp) != len) status = -1;
+    if (fclose(fp) != 0) status = -1;
+    return status;
+}
+
+/* Error sink collecting the located diagnostics as the assembler prints them. */
+static void collect_diagnostic(void *user, const char *file_name, int error_code, int line_number) {
+    char line[128];
+
+    if (!file_name || line_number <= 0) return; /* driver level summary, not compared */
+    sprintf(line, "line %d: %s\n", line_number, error_message(error_code));
+    buf_append((text_buf_t *) user, line, strlen(line));
+}
+
+/* Joins workdir and a file name into path. */
+static void work_path(char *path, const char *workdir, const char *name) {
+    sprintf(path, "%s/%s", workdir, name);
+}
+
+/* Removes the files a path may leave in workdir. */
+static void clean_workdir(const char *workdir) {
+    static const char *const ENDINGS[] = {".as", ".am", ".ob", ".ent", ".ext"};
+    char path[MAX_PATH_LENGTH + 16], name[32];
+    size_t i;
+    int k;
+
+    for (i = 0; i < sizeof(ENDINGS) / sizeof(ENDINGS[0]); i++) {
+        sprintf(name, "input%s", ENDINGS[i]);
+        work_path(path, workdir, name);
+        remove(path);
+        for (k = 0; k < JOB_FILES; k++) {
+            sprintf(name, "job%d%s", k, ENDINGS[i]);
+            work_path(path, workdir, name);
+            remove(path);
+        }
+    }
+    work_path(path, workdir, "assembler.log");
+    remove(path);
+}
+
+/* Collects the .ob, .ent and .ext files of the module at base (path without extension). */
+static void read_outputs(const char *base, diff_output_t *out) {
+    char path[MAX_PATH_LENGTH + 32];
+
+    sprintf(path, "%s.ob", base);
+    out->text[OUT_OB] = read_text(path, NULL);
+    sprintf(path, "%s.ent", base);
+    out->text[OUT_ENT] = read_text(path, NULL);
+    sprintf(path, "%s.ext", base);
+    out->text[OUT_EXT] = read_text(path, NULL);
+}
+
+/* Runs a file based path: writes the source, preprocesses it and hands the .am
+ * file to passes(). Collects the diagnostics and the output files.
+ */
+static void run_file_path(const char *src, size_t len, const char *workdir, diff_output_t *out,
+                          int (*passes)(const char *am_path, const char *base, symbol_table_t *symtab)) {
+    char as_path[MAX_PATH_LENGTH + 16], am_path[MAX_PATH_LENGTH + 16], base[MAX_PATH_LENGTH + 16];
+    text_buf_t diags;
+    symbol_table_t *symtab;
+
+    memset(&diags, 0, sizeof(diags));
+    clean_workdir(workdir);
+    work_path(as_path, workdir, "input.as");
+    work_path(am_path, workdir, "input.am");
+    work_path(base, workdir, "input");
+
+    out->status = -1;
+    set_error_sink(collect_diagnostic, &diags);
+    if (write_text(as_path, src, len) == 0 && preprocess_file(as_path, am_path) == 0) {
+        symtab = symtab_create();
+        if (symtab) {
+            out->status = passes(am_path, base, symtab);
+            symtab_destroy(symtab);
+        }
+    }
+    set_error_sink(NULL, NULL);
+
+    read_outputs(base, out);
+    out->text[OUT_DIAG] = buf_take(&diags);
+}
+
+/* Both passes of the regular in-memory mode. */
+static int reference_passes(const char *am_path, const char *base, symbol_table_t *symtab) {
+    if (first_pass(am_path, symtab) != 0) return -1;
+    return second_pass(am_path, base, symtab, NULL) != 0 ? -1 : 0;
+}
+
+/* Both passes of the memory-bounded mode, with the smallest spill buffers. */
+static int streaming_passes(const char *am_path, const char *base, symbol_table_t *symtab) {
+    spill_t spill;
+    int status = -1;
+
+    if (spill_open(&spill, 0) != 0) return -1;
+    if (first_pass_spill(am_path, symtab, &spill) == 0 &&
+        second_pass_spill(&spill, base, symtab, NULL) == 0) {
+        status = 0;
+    }
+    spill_close(&spill);
+    return status;
+}
+
+static void run_reference(const char *src, size_t len, const char *workdir, diff_output_t *out) {
+    run_file_path(src, len, workdir, out, reference_passes);
+}
+
+static void run_streaming(const char *src, size_t len, const char *workdir, diff_output_t *out) {
+    run_file_path(src, len, workdir, out, streaming_passes);
+}
+
+/* Appends "name<TAB>address" in base-4, as the .ent and .ext files do. */
+static void append_symbol_line(text_buf_t *b, const char *name, int address) {
+    char b4_address[5];
+
+    word_to_base4((WORD) address, b4_address, sizeof(b4_address));
+    buf_append(b, name, strlen(name));
+    buf_append(b, "\t", 1);
+    buf_append(b, b4_address, strlen(b4_address));
+    buf_append(b, "\n", 1);
+}
+
+/* Appends one "address<TAB>word" line of the object file. */
+static void append_word_line(text_buf_t *b, int address, WORD w) {
+    char b4_address[5], b4_word[6];
+
+    word_to_base4((WORD) address, b4_address, sizeof(b4_address));
+    word_to_base4(w, b4_word, sizeof(b4_word));
+    buf_append(b, b4_address, strlen(b4_address));
+    buf_append(b, "\t", 1);
+    buf_append(b, b4_word, strlen(b4_word));
+    buf_append(b, "\n", 1);
+}
+
+static void run_library(const char *src, size_t len, const char *workdir, diff_output_t *out) {
+    asm_ctx_t *ctx;
+    asm_result_t r;
+    text_buf_t b;
+    char header[2 * LENGTH_BASE4_MAX + 2], b4_code[LENGTH_BASE4_MAX], b4_data[LENGTH_BASE4_MAX];
+    int i;
+    (void) workdir;
+
+    memset(&b, 0, sizeof(b));
+    out->status = -1;
+    ctx = asm_ctx_create();
+    if (!ctx) return;
+    out->status = asm_assemble_buffer(ctx, src, len, &r);
+
+    for (i = 0; i < r.n_diagnostics; i++) {
+        if (r.diagnostics[i].line <= 0) continue; /* driver level summary, not compared */
+        sprintf(header, "line %d: ", r.diagnostics[i].line);
+        buf_append(&b, header, strlen(header));
+        buf_append(&b, r.diagnostics[i].message, strlen(r.diagnostics[i].message));
+        buf_append(&b, "\n", 1);
+    }
+    out->text[OUT_DIAG] = buf_take(&b);
+
+    if (out->status == 0) {
+        length_to_base4(r.code_len, OB_CODE_DIGITS, b4_code);
+        length_to_base4(r.data_len, OB_DATA_DIGITS, b4_data);
+        sprintf(header, "%s %s\n", b4_code, b4_data);
+        buf_append(&b, header, strlen(header));
+        for (i = 0; i < r.code_len; i++) append_word_line(&b, ADDRESS_BASE + i, r.code[i]);
+        for (i = 0; i < r.data_len; i++) append_word_line(&b, ADDRESS_BASE + r.code_len + i, r.data[i]);
+        out->text[OUT_OB] = buf_take(&b);
+
+        if (r.n_entries > 0) {
+            for (i = 0; i < r.n_entries; i++) append_symbol_line(&b, r.entries[i].name, r.entries[i].address);
+            out->text[OUT_ENT] = buf_take(&b);
+        }
+        if (r.n_externals > 0) {
+            for (i = 0; i < r.n_externals; i++) {
+                append_symbol_line(&b, r.externals[i].name, r.externals[i].address);
+            }
+            out->text[OUT_EXT] = buf_take(&b);
+        }
+    }
+    asm_result_free(&r);
+    asm_ctx_destroy(ctx);
+}
+
+static void free_output(diff_output_t *out) {
+    int k;
+    for (k = 0; k < N_OUTPUTS; k++) {
+        free(out->text[k]);
+        out->text[k] = NULL;
+    }
+}
+
+/* Returns the first output differing between a and b, N_OUTPUTS for the status,
+ * or -1 if they are identical.
+ */
+static int first_difference(const diff_output_t *a, const diff_output_t *b) {
+    int k;
+
+    if (a->status != b->status) return N_OUTPUTS;
+    for (k = 0; k < N_OUTPUTS; k++) {
+        if (!a->text[k] != !b->text[k]) return k;
+        if (a->text[k] && strcmp(a->text[k], b->text[k]) != 0) return k;
+    }
+    return -1;
+}
+
+/* Runs the assembler executable with args (args[0] is the executable), its output
+ * going to log_path. Returns 0 if it ran to completion, -1 otherwise.
+ */
+static int run_assembler(char *const *args, const char *log_path) {
+    pid_t pid;
+    int fd, wstatus;
+
+    fflush(stdout);
+    pid = fork();
+    if (pid < 0) return -1;
+    if (pid == 0) {
+        fd = open(log_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        if (fd < 0 || dup2(fd, STDOUT_FILENO) < 0 || dup2(fd, STDERR_FILENO) < 0) _exit(127);
+        close(fd);
+        execv(args[0], args);
+        _exit(127);
+    }
+    if (waitpid(pid, &wstatus, 0) != pid) return -1;
+    return WIFEXITED(wstatus) && WEXITSTATUS(wstatus) != 127 ? 0 : -1;
+}
+
+/* Collects what the assembler printed about the module at base: its located
+ * diagnostics, in the format of collect_diagnostic, and whether it was processed.
+ */
+static void parse_log(const char *log, const char *base, diff_output_t *out) {
+    static const char ERROR_START[] = "There is error in ";
+    static const char FAILED[] = "Failed to process file: ";
+    static const char PROCESSED[] = "Processed file: ";
+    size_t base_len = strlen(base), n;
+    const char *line, *at, *message;
+    char header[32];
+    text_buf_t diags;
+    long line_no;
+
+    memset(&diags, 0, sizeof(diags));
+    out->status = -1;
+    for (line = log; line && *line; line = strchr(line, '\n') ? strchr(line, '\n') + 1 : NULL) {
+        n = strcspn(line, "\n");
+        if (strncmp(line, ERROR_START, sizeof(ERROR_START) - 1) == 0) {
+            at = line + sizeof(ERROR_START) - 1;
+            /* the passes name the file by its .am path or by the base name itself */
+            if (strncmp(at, base, base_len) != 0 || (at[base_len] != '.' && at[base_len] != ' ')) continue;
+            at = strstr(at, " at line:");
+            message = at ? strstr(at, " ERROR: ") : NULL;
+            if (!message || message >= line + n) continue;
+            line_no = strtol(at + 9, NULL, 10);
+            if (line_no <= 0) continue; /* driver level summary, not compared */
+            message += 8;
+            sprintf(header, "line %ld: ", line_no);
+            buf_append(&diags, header, strlen(header));
+            buf_append(&diags, message, n - (size_t) (message - line));
+            buf_append(&diags, "\n", 1);
+        } else if (n == sizeof(FAILED) - 1 + base_len && strncmp(line, FAILED, sizeof(FAILED) - 1) == 0 &&
+                   strncmp(line + sizeof(FAILED) - 1, base, base_len) == 0) {
+            out->status = -1;
+        } else if (n == sizeof(PROCESSED) - 1 + base_len && strncmp(line, PROCESSED, sizeof(PROCESSED) - 1) == 0 &&
+                   strncmp(line + sizeof(PROCESSED) - 1, base, base_len) == 0) {
+            out->status = 0;
+        }
+    }
+    out->text[OUT_DIAG] = buf_take(&diags);
+    read_outputs(base, out);
+}
+
+/* Reports an assembler that could not be run as a mismatch of every input. */
+static void assembler_failed(diff_output_t *out) {
+    static const char MESSAGE[] = "assembler did not run\n";
+    text_buf_t b;
+
+    memset(&b, 0, sizeof(b));
+    buf_append(&b, MESSAGE, sizeof(MESSAGE) - 1);
+    out->status = -1;
+    out->text[OUT_DIAG] = buf_take(&b);
+}
+
+static void run_cache(const char *src, size_t len, const char *workdir, diff_output_t *out) {
+    static const char MISSED[] = "preprocessing not reused from the shared cache\n";
+    char as_path[MAX_PATH_LENGTH + 16], base[MAX_PATH_LENGTH + 16], log_path[MAX_PATH_LENGTH + 16];
+    char cache_arg[sizeof(cache_name) + 16];
+    char *args[4];
+    char *first_log, *log;
+    text_buf_t b;
+
+    clean_workdir(workdir);
+    work_path(as_path, workdir, "input.as");
+    work_path(base, workdir, "input");
+    work_path(log_path, workdir, "assembler.log");
+    sprintf(cache_arg, "--shm-cache=%s", cache_name);
+    args[0] = (char *) assembler_path;
+    args[1] = cache_arg;
+    args[2] = base;
+    args[3] = NULL;
+
+    /* the first run fills the cache, the second one is compared */
+    if (write_text(as_path, src, len) != 0 || run_assembler(args, log_path) != 0) {
+        assembler_failed(out);
+        return;
+    }
+    first_log = read_text(log_path, NULL);
+    if (run_assembler(args, log_path) != 0 || !(log = read_text(log_path, NULL))) {
+        free(first_log);
+        assembler_failed(out);
+        return;
+    }
+    parse_log(log, base, out);
+
+    /* a preprocessed input must hit, or the plain path would be compared again */
+    if (first_log && strstr(first_log, "Pre-processing successful") &&
+        !strstr(log, "Pre-processing result reused from the shared cache")) {
+        memset(&b, 0, sizeof(b));
+        buf_append(&b, out->text[OUT_DIAG], strlen(out->text[OUT_DIAG]));
+        buf_append(&b, MISSED, sizeof(MISSED) - 1);
+        free(out->text[OUT_DIAG]);
+        out->text[OUT_DIAG] = buf_take(&b);
+    }
+    free(first_log);
+    free(log);
+}
+
+/* Returns the length of the first keep lines of src. */
+static size_t prefix_length(const char *src, size_t len, long keep) {
+    size_t i;
+
+    for (i = 0; i < len && keep > 0; i++) {
+        if (src[i] == '\n') keep--;
+    }
+    return i;
+}
+
+static void run_jobs(const char *src, size_t len, const char *workdir, diff_output_t *out) {
+    static const char *const PART_NAMES[N_OUTPUTS + 1] = {".ob", ".ent", ".ext", "diagnostics", "status"};
+    char bases[JOB_FILES][MAX_PATH_LENGTH + 16], log_path[MAX_PATH_LENGTH + 16];
+    char as_path[MAX_PATH_LENGTH + 32], name[16], jobs_arg[16], line[64];
+    char *args[JOB_FILES + 3];
+    size_t lengths[JOB_FILES], i;
+    diff_output_t ref, got[JOB_FILES];
+    text_buf_t b;
+    char *log;
+    long n_lines = 0;
+    int k, d;
+
+    clean_workdir(workdir);
+    for (i = 0; i < len; i++) {
+        if (src[i] == '\n') n_lines++;
+    }
+    if (len > 0 && src[len - 1] != '\n') n_lines++;
+
+    /* file k drops the last k quarters of the lines, so the files fail differently */
+    sprintf(jobs_arg, "-j%d", JOB_FILES);
+    args[0] = (char *) assembler_path;
+    args[1] = jobs_arg;
+    for (k = 0; k < JOB_FILES; k++) {
+        lengths[k] = prefix_length(src, len, n_lines - k * n_lines / JOB_FILES);
+        sprintf(name, "job%d", k);
+        work_path(bases[k], workdir, name);
+        sprintf(as_path, "%.*s.as", MAX_PATH_LENGTH + 15, bases[k]);
+        if (write_text(as_path, src, lengths[k]) != 0) {
+            assembler_failed(out);
+            return;
+        }
+        args[2 + k] = bases[k];
+    }
+    args[2 + JOB_FILES] = NULL;
+    work_path(log_path, workdir, "assembler.log");
+    if (run_assembler(args, log_path) != 0 || !(log = read_text(log_path, NULL))) {
+        assembler_failed(out);
+        return;
+    }
+
+    /* the whole input is compared as usual, the prefixes with their own reference runs,
+     * which clean the scratch directory, so every file is collected first
+     */
+    memset(got, 0, sizeof(got));
+    parse_log(log, bases[0], out);
+    for (k = 1; k < JOB_FILES; k++) parse_log(log, bases[k], &got[k]);
+    free(log);
+    memset(&b, 0, sizeof(b));
+    buf_append(&b, out->text[OUT_DIAG], strlen(out->text[OUT_DIAG]));
+    for (k = 1; k < JOB_FILES; k++) {
+        memset(&ref, 0, sizeof(ref));
+        run_reference(src, lengths[k], workdir, &ref);
+        d = first_difference(&ref, &got[k]);
+        if (d >= 0) {
+            sprintf(line, "job%d: %s differs from its reference\n", k, PART_NAMES[d]);
+            buf_append(&b, line, strlen(line));
+        }
+        free_output(&ref);
+        free_output(&got[k]);
+    }
+    free(out->text[OUT_DIAG]);
+    out->text[OUT_DIAG] = buf_take(&b);
+}
+
+/* Assembles src through the reference and one other path.
+ * Returns the first difference as first_difference does.
+ */
+static int compare_paths(const diff_path_t *path, const char *src, size_t len, const char *workdir,
+                         diff_output_t *ref, diff_output_t *got) {
+    memset(ref, 0, sizeof(*ref));
+    memset(got, 0, sizeof(*got));
+    PATHS[0].run(src, len, workdir, ref);
+    path->run(src, len, workdir, got);
+    return first_difference(ref, got);
+}
+
+/* Splits a text into lines; the text is modified and owned by the caller. */
+static int split_lines(char *text, lines_t *ls) {
+    long n = 0, cap = 64;
+    char *p = text, *nl;
+
+    ls->line = malloc(sizeof(char *) * (size_t) cap);
+    if (!ls->line) return -1;
+    while (*p) {
+        if (n == cap) {
+            char **grown = realloc(ls->line, sizeof(char *) * (size_t) (cap *= 2));
+            if (!grown) return -1;
+            ls->line = grown;
+        }
+        ls->line[n++] = p;
+        nl = strchr(p, '\n');
+        if (!nl) break;
+        *nl = '\0';
+        p = nl + 1;
+    }
+    ls->n = n;
+    return 0;
+}
+
+/* Joins the lines of ls, skipping [skip_from, skip_to), into a newline terminated text. */
+static char *join_lines(const lines_t *ls, long skip_from, long skip_to, size_t *len) {
+    text_buf_t b;
+    long i;
+
+    memset(&b, 0, sizeof(b));
+    for (i = 0; i < ls->n; i++) {
+        if (i >= skip_from && i < skip_to) continue;
+        if (buf_append(&b, ls->line[i], strlen(ls->line[i])) != 0 || buf_append(&b, "\n", 1) != 0) {
+            free(b.data);
+            return NULL;
+        }
+    }
+    *len = b.len;
+    return buf_take(&b);
+}
+
+/* Returns 1 if the lines without [from, to) still make the path differ. */
+static int still_differs(const diff_path_t *path, const lines_t *ls, long from, long to, const char *workdir) {
+    diff_output_t ref, got;
+    char *src;
+    size_t len;
+    int d;
+
+    src = join_lines(ls, from, to, &len);
+    if (!src) return 0;
+    d = compare_paths(path, src, len, workdir, &ref, &got);
+    free_output(&ref);
+    free_output(&got);
+    free(src);
+    return d >= 0;
+}
+
+/* Removes the lines [from, to) of ls. */
+static void drop_lines(lines_t *ls, long from, long to) {
+    memmove(ls->line + from, ls->line + to, sizeof(char *) * (size_t) (ls->n - to));
+    ls->n -= to - from;
+}
+
+/* Shrinks a mismatching source by deleting chunks of lines, halving the chunk
+ * size whenever no chunk can be removed, down to single lines. Every kept
+ * removal still makes the path differ from the reference.
+ */
+static void shrink_lines(const diff_path_t *path, lines_t *ls, const char *workdir) {
+    long chunk = ls->n / 2, start;
+    int progress;
+
+    if (chunk < 1) chunk = 1;
+    while (ls->n > 1) {
+        progress = 0;
+        for (start = 0; start < ls->n;) {
+            long end = start + chunk < ls->n ? start + chunk : ls->n;
+            if (end - start < ls->n && still_differs(path, ls, start, end, workdir)) {
+                drop_lines(ls, start, end);
+                progress = 1;
+            } else {
+                start = end;
+            }
+        }
+        if (!progress) {
+            if (chunk == 1) break;
+            chunk /= 2;
+        } else if (chunk > ls->n / 2 && ls->n > 1) {
+            chunk = ls->n / 2;
+        }
+    }
+}
+
+/* Prints the difference of one output, from the first differing line. */
+static void report_difference(int k, const diff_output_t *ref, const diff_output_t *got) {
+    const char *a, *b;
+    long line = 1;
+
+    if (k == N_OUTPUTS) {
+        printf("    status: reference %d, got %d\n", ref->status, got->status);
+        return;
+    }
+    if (!ref->text[k] || !got->text[k]) {
+        printf("    %s: written by the %s path only\n", OUTPUT_NAMES[k], ref->text[k] ? "reference" : "other");
+        return;
+    }
+    for (a = ref->text[k], b = got->text[k]; *a && *a == *b; a++, b++) {
+        if (*a == '\n') line++;
+    }
+    while (a > ref->text[k] && a[-1] != '\n') {
+        a--;
+        b--;
+    }
+    printf("    %s differs at line %ld:\n      reference: %.*s\n      got:       %.*s\n",
+           OUTPUT_NAMES[k], line, (int) strcspn(a, "\n"), a, (int) strcspn(b, "\n"), b);
+}
+
+/* Writes the shrunk reproducer of a mismatch. */
+static void write_reproducer(const diff_options_t *o, const char *label, const diff_path_t *path,
+                             const lines_t *ls) {
+    char out_path[MAX_PATH_LENGTH * 2 + 64];
+    const char *slash = strrchr(label, '/');
+    size_t len;
+    char *src = join_lines(ls, 0, 0, &len);
+
+    if (!src) return;
+    sprintf(out_path, "%.*s/%.*s.%s.min.as", MAX_PATH_LENGTH, o->out_dir ? o->out_dir : ".",
+            MAX_PATH_LENGTH, slash ? slash + 1 : label, path->name);
+    if (write_text(out_path, src, len) == 0) {
+        printf("    minimal reproducer (%ld lines): %s\n", ls->n, out_path);
+    } else {
+        printf("    cannot write %s\n", out_path);
+    }
+    free(src);
+}
+
+/* Checks one source against every enabled path. Returns the number of mismatching paths. */
+static int check_source(const diff_options_t *o, const char *label, const char *src, size_t len,
+                        const char *workdir) {
+    diff_output_t ref, got;
+    lines_t ls;
+    char *copy;
+    int p, d, mismatches = 0;
+
+    for (p = 1; p < N_PATHS; p++) {
+        if (!PATHS[p].enabled) continue;
+        d = compare_paths(&PATHS[p], src, len, workdir, &ref, &got);
+        if (d >= 0) {
+            mismatches++;
+            printf("MISMATCH %s: %s differs from %s\n", label, PATHS[p].name, PATHS[0].name);
+            report_difference(d, &ref, &got);
+            copy = malloc(len + 1);
+            if (copy) {
+                memcpy(copy, src, len);
+                copy[len] = '\0';
+            }
+            if (copy && split_lines(copy, &ls) == 0) {
+                if (o->shrink) shrink_lines(&PATHS[p], &ls, workdir);
+                write_reproducer(o, label, &PATHS[p], &ls);
+                free(ls.line);
+            }
+            free(copy);
+        }
+        free_output(&ref);
+        free_output(&got);
+    }
+    return mismatches;
+}
+
+/* xorshift32, the same generator as gen_workload. */
+static unsigned long next_random(unsigned long *state) {
+    unsigned long x = *state;
+    x ^= (x << 13) & 0xFFFFFFFFUL;
+    x ^= x >> 17;
+    x ^= (x << 5) & 0xFFFFFFFFUL;
+    *state = x & 0xFFFFFFFFUL;
+    return *state;
+}
+
+static long random_below(unsigned long *state, long n) {
+    return n > 0 ? (long) (next_random(state) % (unsigned long) n) : 0;
+}
+
+/* Builds a variant of the source with 1 to MAX_EDITS random edits.
+ * Returns the new text (owned by the caller) or NULL.
+ */
+static char *mutate(const lines_t *ls, unsigned long *rng, size_t *len) {
+    static const char GARBAGE[] = ",:#.\"r9 x";
+    char *owned[MAX_EDITS]; /* edited copies of lines */
+    lines_t m;
+    char *text, *tmp;
+    long i, a, b, edits;
+    int n_owned = 0;
+
+    if (ls->n == 0) return NULL;
+    m.line = malloc(sizeof(char *) * (size_t) (ls->n + MAX_EDITS));
+    if (!m.line) return NULL;
+    memcpy(m.line, ls->line, sizeof(char *) * (size_t) ls->n);
+    m.n = ls->n;
+
+    edits = 1 + random_below(rng, MAX_EDITS);
+    for (i = 0; i < edits && m.n > 0; i++) {
+        a = random_below(rng, m.n);
+        b = random_below(rng, m.n);
+        switch (random_below(rng, 5)) {
+            case 0: /* delete a line */
+                memmove(m.line + a, m.line + a + 1, sizeof(char *) * (size_t) (m.n - a - 1));
+                m.n--;
+                break;
+            case 1: /* duplicate a line */
+                memmove(m.line + a + 1, m.line + a, sizeof(char *) * (size_t) (m.n - a));
+                m.n++;
+                break;
+            case 2: /* swap two lines */
+                tmp = m.line[a];
+                m.line[a] = m.line[b];
+                m.line[b] = tmp;
+                break;
+            default: /* truncate or garble a copy of a line */
+                tmp = malloc(strlen(m.line[a]) + 1);
+                if (!tmp) break;
+                strcpy(tmp, m.line[a]);
+                if (tmp[0]) {
+                    b = random_below(rng, (long) strlen(tmp));
+                    if (random_below(rng, 2)) {
+                        tmp[b] = '\0';
+                    } else {
+                        tmp[b] = GARBAGE[random_below(rng, (long) sizeof(GARBAGE) - 1)];
+                    }
+                }
+                owned[n_owned++] = tmp;
+                m.line[a] = tmp;
+                break;
+        }
+    }
+
+    text = join_lines(&m, 0, 0, len);
+    while (n_owned > 0) free(owned[--n_owned]);
+    free(m.line);
+    return text;
+}
+
+/* Checks a corpus and its mutations. Returns the number of mismatches, -1 on error. */
+static int check_corpus(const diff_options_t *o, const char *path, const char *workdir) {
+    char label[MAX_PATH_LENGTH + 32];
+    char *src, *copy, *variant;
+    size_t len, vlen;
+    lines_t ls;
+    unsigned long rng = o->seed;
+    long i;
+    int mismatches;
+
+    src = read_text(path, &len);
+    if (!src) {
+        printf("%s: cannot read file\n", path);
+        return -1;
+    }
+    mismatches = check_source(o, path, src, len, workdir);
+
+    copy = malloc(len + 1);
+    if (copy && o->mutations > 0) {
+        memcpy(copy, src, len + 1);
+        if (split_lines(copy, &ls) == 0) {
+            for (i = 0; i < o->mutations; i++) {
+                variant = mutate(&ls, &rng, &vlen);
+                if (!variant) continue;
+                sprintf(label, "%.*s~%ld", MAX_PATH_LENGTH, path, i + 1);
+                mismatches += check_source(o, label, variant, vlen, workdir);
+                free(variant);
+            }
+            free(ls.line);
+        }
+    }
+    printf("%s: %ld variant(s), %d mismatch(es)\n", path, o->mutations + 1, mismatches);
+    free(copy);
+    free(src);
+    return mismatches;
+}
+
+/* Enables only the paths named in a comma separated list. Returns 0 on success. */
+static int select_paths(const char *list) {
+    const char *p = list;
+    size_t n;
+    int i, found;
+
+    for (i = 1; i < N_PATHS; i++) PATHS[i].enabled = 0;
+    while (*p) {
+        n = strcspn(p, ",");
+        found = 0;
+        for (i = 1; i < N_PATHS; i++) {
+            if (strlen(PATHS[i].name) == n && strncmp(PATHS[i].name, p, n) == 0) {
+                PATHS[i].enabled = 1;
+                found = 1;
+            }
+        }
+        if (!found) return -1;
+        p += n;
+        if (*p == ',') p++;
+    }
+    return 0;
+}
+
+static void usage(const char *prog) {
+    int i;
+
+    printf("Usage: %s [--paths=a,b] [--mutations=N] [--seed=N] [--out-dir=DIR] [--no-shrink]"
+           " [--assembler=PATH] <corpus.as> ...\n", prog);
+    printf("Paths compared with %s:", PATHS[0].name);
+    for (i = 1; i < N_PATHS; i++) printf(" %s", PATHS[i].name);
+    printf("\n");
+}
+
+int main(int argc, char *argv[]) {
+    diff_options_t o;
+    char workdir[MAX_PATH_LENGTH];
+    const char *tmp;
+    int i, r, corpora = 0, mismatches = 0, failed = 0, paths_selected = 0;
+
+    o.mutations = 0;
+    o.seed = 1;
+    o.out_dir = NULL;
+    o.shrink = 1;
+
+    for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+        if (strncmp(argv[i], "--paths=", 8) == 0) {
+            paths_selected = 1;
+            if (select_paths(argv[i] + 8) != 0) {
+                printf("Unknown path in %s\n", argv[i]);
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--mutations=", 12) == 0) {
+            o.mutations = strtol(argv[i] + 12, NULL, 10);
+        } else if (strncmp(argv[i], "--seed=", 7) == 0) {
+            o.seed = strtoul(argv[i] + 7, NULL, 10);
+            if (o.seed == 0) o.seed = 1; /* xorshift never leaves 0 */
+        } else if (strncmp(argv[i], "--out-dir=", 10) == 0) {
+            o.out_dir = argv[i] + 10;
+        } else if (strcmp(argv[i], "--no-shrink") == 0) {
+            o.shrink = 0;
+        } else if (strncmp(argv[i], "--assembler=", 12) == 0) {
+            assembler_path = argv[i] + 12;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (i == argc) {
+        usage(argv[0]);
+        return 1;
+    }
+    for (r = 1; r < N_PATHS && !assembler_path; r++) {
+        if (PATHS[r].external && paths_selected && PATHS[r].enabled) {
+            printf("The %s path needs --assembler\n", PATHS[r].name);
+            return 1;
+        }
+        if (PATHS[r].external) PATHS[r].enabled = 0;
+    }
+    sprintf(cache_name, "/asm_diff.%ld", (long) getpid());
+
+    tmp = getenv("TMPDIR");
+    if (!tmp || strlen(tmp) > MAX_PATH_LENGTH - 32) tmp = "/tmp";
+    sprintf(workdir, "%s/asm_diff.XXXXXX", tmp);
+    if (!mkdtemp(workdir)) {
+        printf("Cannot create a scratch directory in %s\n", tmp);
+        return 1;
+    }
+
+    for (; i < argc; i++) {
+        r = check_corpus(&o, argv[i], workdir);
+        if (r < 0) {
+            failed = 1;
+        } else {
+            mismatches += r;
+        }
+        corpora++;
+    }
+    clean_workdir(workdir);
+    rmdir(workdir);
+    if (assembler_path) shm_unlink(cache_name);
+
+    printf("%d corpus file(s), %d mismatch(es)\n", corpora, mismatches);
+    return (mismatches > 0 || failed) ? 1 : 0;
+}
@@ -0,0 +1,431 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/globals.h"
+
+/*
+ * =====================================================================================
+ * Filename:  gen_workload.c
+ * Description: Synthetic workload generator for scale testing.
+ * Writes a valid assembly source (.as) of a requested number of lines with a
+ * configurable mix of instructions, data directives, labels, macros, externals,
+ * entries and comments. The output depends only on the options and the seed (the
+ * generator uses its own PRNG), so the same corpus can be regenerated anywhere.
+ *
+ * Layout of a generated program:
+ *   comment header, .extern declarations, macro definitions (registers, immediates
+ *   and externals only), the body (instructions, data, macro calls, comments),
+ *   a final stop and the .entry declarations (entries must follow the definitions).
+ * Labels are only referenced after their definition, matrix operands only use
+ * labels defined by .mat, and every line stays within the 80 character limit.
+ * =====================================================================================
+ */
+
+#define LINE_LIMIT (MAX_LINE_LENGTH - 2) /* characters per line, without newline */
+#define MAX_DATA_PER_LINE 12 /* values written on one .data line */
+#define MAX_STRING_CHARS 24 /* characters of one generated .string */
+
+/* struct gen_options_t holds the knobs of the generator. */
+typedef struct {
+    long lines; /* target number of source lines */
+    int data_pct; /* statements that are data directives, percent */
+    int label_pct; /* statements carrying a label, percent */
+    int comment_pct; /* lines that are comments, percent */
+    int macros; /* macro definitions */
+    int macro_lines; /* instructions per macro body */
+    int expansions; /* calls of every macro in the body */
+    int mat_max; /* largest .mat dimension (rows and cols) */
+    int externs; /* .extern declarations */
+    int entries; /* .entry declarations */
+    unsigned long seed;
+    const char *output; /* NULL for stdout */
+} gen_options_t;
+
+/* struct gen_state_t is the state of the generation in progress. */
+typedef struct {
+    FILE *out;
+    unsigned long rng;
+    long lines; /* lines written so far */
+    long code_labels; /* labels L0..Ln-1 defined on instructions */
+    long data_labels; /* labels D0..Dn-1 defined on .data/.string */
+    long mat_labels; /* labels M0..Mn-1 defined on .mat */
+    long calls_left; /* macro calls still to place */
+} gen_state_t;
+
+/* Addressing mode sets used to pick operands. */
+#define OPND_IMM 1
+#define OPND_REG 2
+#define OPND_DIRECT 4
+#define OPND_MATRIX 8
+#define OPND_ANY (OPND_IMM | OPND_REG | OPND_DIRECT | OPND_MATRIX)
+#define OPND_NOT_IMM (OPND_REG | OPND_DIRECT | OPND_MATRIX)
+
+/* struct gen_opcode_t describes the legal operands of an instruction. */
+typedef struct {
+    const char *mnemonic;
+    int n_operands;
+    int src_modes; /* modes of the first operand */
+    int dst_modes; /* modes of the second operand */
+} gen_opcode_t;
+
+static const gen_opcode_t GEN_OPCODES[] = {
+    {"mov", 2, OPND_ANY, OPND_NOT_IMM}, {"cmp", 2, OPND_ANY, OPND_ANY},
+    {"add", 2, OPND_ANY, OPND_NOT_IMM}, {"sub", 2, OPND_ANY, OPND_NOT_IMM},
+    {"lea", 2, OPND_DIRECT | OPND_MATRIX, OPND_NOT_IMM},
+    {"clr", 1, OPND_NOT_IMM, 0}, {"not", 1, OPND_NOT_IMM, 0}, {"inc", 1, OPND_NOT_IMM, 0},
+    {"dec", 1, OPND_NOT_IMM, 0}, {"jmp", 1, OPND_NOT_IMM, 0}, {"bne", 1, OPND_NOT_IMM, 0},
+    {"jsr", 1, OPND_NOT_IMM, 0}, {"red", 1, OPND_NOT_IMM, 0}, {"prn", 1, OPND_ANY, 0},
+    {"rts", 0, 0, 0}, {"stop", 0, 0, 0}
+};
+#define N_GEN_OPCODES ((int) (sizeof(GEN_OPCODES) / sizeof(GEN_OPCODES[0])))
+
+/* --- Private Helper Functions --- */
+
+/* xorshift32, identical on every platform. */
+static unsigned long next_random(gen_state_t *g) {
+    unsigned long x = g->rng;
+    x ^= (x << 13) & 0xFFFFFFFFUL;
+    x ^= x >> 17;
+    x ^= (x << 5) & 0xFFFFFFFFUL;
+    g->rng = x & 0xFFFFFFFFUL;
+    return g->rng;
+}
+
+/* Returns a random integer in [0, n). */
+static long random_below(gen_state_t *g, long n) {
+    return n > 0 ? (long) (next_random(g) % (unsigned long) n) : 0;
+}
+
+/* Returns nonzero with the given probability in percent. */
+static int chance(gen_state_t *g, int pct) {
+    return random_below(g, 100) < pct;
+}
+
+/* Writes one complete line. */
+static void emit_line(gen_state_t *g, const char *line) {
+    fputs(line, g->out);
+    fputc('\n', g->out);
+    g->lines++;
+}
+
+/* Writes an operand of one of the allowed modes into buf.
+ * in_macro restricts labels to externals (macros are defined before any label).
+ * Returns 0, or -1 if none of the modes can be satisfied.
+ */
+static int make_operand(gen_state_t *g, const gen_options_t *o, int modes, int in_macro, char *buf) {
+    int choices[4];
+    int n = 0;
+    long labels = in_macro ? 0 : g->code_labels + g->data_labels;
+    long pick;
+
+    if (modes & OPND_IMM) choices[n++] = OPND_IMM;
+    if (modes & OPND_REG) choices[n++] = OPND_REG;
+    if ((modes & OPND_DIRECT) && (labels > 0 || o->externs > 0)) choices[n++] = OPND_DIRECT;
+    if ((modes & OPND_MATRIX) && !in_macro && g->mat_labels > 0) choices[n++] = OPND_MATRIX;
+    if (n == 0) return -1;
+
+    switch (choices[random_below(g, n)]) {
+        case OPND_IMM:
+            sprintf(buf, "#%ld", random_below(g, 201) - 100);
+            break;
+        case OPND_REG:
+            sprintf(buf, "r%ld", random_below(g, 8));
+            break;
+        case OPND_DIRECT:
+            pick = random_below(g, labels + o->externs);
+            if (pick < g->code_labels) {
+                sprintf(buf, "L%ld", pick);
+            } else if (pick < labels) {
+                sprintf(buf, "D%ld", pick - g->code_labels);
+            } else {
+                sprintf(buf, "X%ld", pick - labels);
+            }
+            break;
+        default:
+            sprintf(buf, "M%ld[r%ld][r%ld]", random_below(g, g->mat_labels), random_below(g, 8), random_below(g, 8));
+            break;
+    }
+    return 0;
+}
+
+/* Writes a random valid instruction (without label) into buf. */
+static void make_instruction(gen_state_t *g, const gen_options_t *o, int in_macro, char *buf) {
+    const gen_opcode_t *op;
+    char src[48], dst[48];
+
+    for (;;) {
+        /* stop and rts are rare in real code, keep them at a low rate */
+        op = &GEN_OPCODES[random_below(g, N_GEN_OPCODES - 2)];
+        if (chance(g, 2)) op = &GEN_OPCODES[N_GEN_OPCODES - 2 + random_below(g, 2)];
+
+        if (op->n_operands == 0) {
+            strcpy(buf, op->mnemonic);
+            return;
+        }
+        if (make_operand(g, o, op->src_modes, in_macro, src) != 0) continue; /* e.g. lea without labels */
+        if (op->n_operands == 1) {
+            sprintf(buf, "%s %s", op->mnemonic, src);
+            return;
+        }
+        make_operand(g, o, op->dst_modes, in_macro, dst);
+        sprintf(buf, "%s %s, %s", op->mnemonic, src, dst);
+        return;
+    }
+}
+
+/* Writes a .data directive body into buf. */
+static void make_data(gen_state_t *g, char *buf, size_t room) {
+    long count = 1 + random_below(g, MAX_DATA_PER_LINE);
+    char item[16];
+    long i;
+
+    strcpy(buf, ".data ");
+    for (i = 0; i < count; i++) {
+        sprintf(item, i ? ", %ld" : "%ld", random_below(g, 1001) - 500);
+        if (strlen(buf) + strlen(item) > room) break;
+        strcat(buf, item);
+    }
+}
+
+/* Writes a .string directive body into buf. */
+static void make_string(gen_state_t *g, char *buf) {
+    long len = 1 + random_below(g, MAX_STRING_CHARS);
+    long i;
+    char *p;
+
+    strcpy(buf, ".string \"");
+    p = buf + strlen(buf);
+    for (i = 0; i < len; i++) {
+        *p++ = (char) ('a' + random_below(g, 26));
+    }
+    strcpy(p, "\"");
+}
+
+/* Writes a .mat directive body into buf. Initializers are omitted (zero fill)
+ * when they would not fit on the line.
+ */
+static void make_matrix(gen_state_t *g, const gen_options_t *o, char *buf, size_t room) {
+    long rows = 1 + random_below(g, o->mat_max);
+    long cols = 1 + random_below(g, o->mat_max);
+    char item[16];
+    size_t header;
+    long i;
+
+    sprintf(buf, ".mat [%ld][%ld] ", rows, cols);
+    header = strlen(buf);
+    if (header + (size_t) (rows * cols) * 5 > room) { /* "-10, " per cell at most */
+        buf[header - 1] = '\0';
+        return;
+    }
+    for (i = 0; i < rows * cols; i++) {
+        sprintf(item, i ? ", %ld" : "%ld", random_below(g, 21) - 10);
+        strcat(buf, item);
+    }
+}
+
+/* Writes one body statement: a labeled or unlabeled instruction or data directive. */
+static void emit_statement(gen_state_t *g, const gen_options_t *o) {
+    char line[LINE_LIMIT + 64];
+    char label[MAX_LABEL_LENGTH + 2];
+    int labeled = chance(g, o->label_pct);
+    long kind;
+
+    label[0] = '\0';
+    if (!chance(g, o->data_pct)) {
+        if (labeled) sprintf(label, "L%ld: ", g->code_labels++);
+        strcpy(line, label);
+        make_instruction(g, o, 0, line + strlen(line));
+        emit_line(g, line);
+        return;
+    }
+
+    kind = random_below(g, 10); /* .data 50%, .string 30%, .mat 20% */
+    if (kind < 8) {
+        if (labeled) sprintf(label, "D%ld: ", g->data_labels++);
+        strcpy(line, label);
+        if (kind < 5) {
+            make_data(g, line + strlen(line), LINE_LIMIT - strlen(line));
+        } else {
+            make_string(g, line + strlen(line));
+        }
+    } else {
+        sprintf(label, "M%ld: ", g->mat_labels++); /* matrices are always labeled */
+        strcpy(line, label);
+        make_matrix(g, o, line + strlen(line), LINE_LIMIT - strlen(line));
+    }
+    emit_line(g, line);
+}
+
+/* Writes the macro definitions. */
+static void emit_macros(gen_state_t *g, const gen_options_t *o) {
+    char line[LINE_LIMIT + 64];
+    int m, i;
+
+    for (m = 0; m < o->macros; m++) {
+        sprintf(line, "mcro mac%d", m);
+        emit_line(g, line);
+        for (i = 0; i < o->macro_lines; i++) {
+            make_instruction(g, o, 1, line);
+            emit_line(g, line);
+        }
+        emit_line(g, "mcrend");
+    }
+}
+
+/* Writes the program. */
+static void generate(gen_state_t *g, const gen_options_t *o) {
+    char line[LINE_LIMIT + 64];
+    long body_end, slots;
+    int i;
+
+    sprintf(line, "; synthetic workload: %ld lines, seed %lu", o->lines, o->seed);
+    emit_line(g, line);
+    for (i = 0; i < o->externs; i++) {
+        sprintf(line, ".extern X%d", i);
+        emit_line(g, line);
+    }
+    emit_macros(g, o);
+
+    /* the body ends with stop and the entry declarations */
+    body_end = o->lines - 1 - o->entries;
+    g->calls_left = (long) o->macros * o->expansions;
+    while (g->lines < body_end) {
+        slots = body_end - g->lines;
+        if (chance(g, o->comment_pct)) {
+            sprintf(line, "; comment %ld", g->lines);
+            emit_line(g, line);
+        } else if (g->calls_left > 0 && random_below(g, slots) < g->calls_left) {
+            sprintf(line, "mac%ld", random_below(g, o->macros));
+            emit_line(g, line);
+            g->calls_left--;
+        } else {
+            emit_statement(g, o);
+        }
+    }
+
+    emit_line(g, "stop");
+    for (i = 0; i < o->entries; i++) {
+        if (i < g->code_labels) {
+            sprintf(line, ".entry L%d", i);
+        } else if (i - g->code_labels < g->data_labels) {
+            sprintf(line, ".entry D%ld", i - g->code_labels);
+        } else {
+            sprintf(line, "; no label left for entry %d", i); /* keeps the line count */
+        }
+        emit_line(g, line);
+    }
+}
+
+/* Parses "--name=value" into *value if arg starts with name. Returns 1 if matched,
+ * 0 if not, -1 if the value is not a valid number within [min, max].
+ */
+static int parse_long_option(const char *arg, const char *name, long min, long max, long *value) {
+    size_t n = strlen(name);
+    char *end;
+    long v;
+
+    if (strncmp(arg, name, n) != 0 || arg[n] != '=') return 0;
+    v = strtol(arg + n + 1, &end, 10);
+    if (*end != '\0' || end == arg + n + 1 || v < min || v > max) return -1;
+    *value = v;
+    return 1;
+}
+
+/* Parses one argument into the options. Returns 0 on success, -1 if invalid. */
+static int parse_argument(const char *arg, gen_options_t *o) {
+    long v = 0;
+    int r;
+
+    if (strncmp(arg, "--output=", 9) == 0) {
+        o->output = arg + 9;
+        return 0;
+    }
+#define LONG_OPTION(name, min, max, field) \
+    if ((r = parse_long_option(arg, name, min, max, &v)) != 0) { \
+        if (r > 0) o->field = v; \
+        return r > 0 ? 0 : -1; \
+    }
+    LONG_OPTION("--lines", 1, 2000000000L, lines)
+    LONG_OPTION("--data-pct", 0, 100, data_pct)
+    LONG_OPTION("--label-pct", 0, 100, label_pct)
+    LONG_OPTION("--comment-pct", 0, 99, comment_pct)
+    LONG_OPTION("--macros", 0, 100000, macros)
+    LONG_OPTION("--macro-lines", 1, 1000, macro_lines)
+    LONG_OPTION("--expansions", 0, 100000, expansions)
+    LONG_OPTION("--mat-max", 1, MAX_MATRIX_ROWS, mat_max)
+    LONG_OPTION("--externs", 0, 100000, externs)
+    LONG_OPTION("--entries", 0, 100000, entries)
+    LONG_OPTION("--seed", 1, 0x7FFFFFFFL, seed)
+#undef LONG_OPTION
+    return -1;
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [options]\n", prog);
+    printf("  --lines=N         source lines to write (default 1000)\n");
+    printf("  --data-pct=P      percent of statements that are data directives (20)\n");
+    printf("  --label-pct=P     percent of statements carrying a label (30)\n");
+    printf("  --comment-pct=P   percent of lines that are comments (10)\n");
+    printf("  --macros=N        macro definitions (4)\n");
+    printf("  --macro-lines=N   instructions per macro body (3)\n");
+    printf("  --expansions=N    calls of every macro (8)\n");
+    printf("  --mat-max=N       largest .mat dimension, 1..15 (4)\n");
+    printf("  --externs=N       .extern declarations (4)\n");
+    printf("  --entries=N       .entry declarations (4)\n");
+    printf("  --seed=N          random seed (1)\n");
+    printf("  --output=FILE     write to FILE instead of stdout\n");
+}
+
+int main(int argc, char *argv[]) {
+    gen_options_t o;
+    gen_state_t g;
+    long fixed;
+    int i;
+
+    o.lines = 1000;
+    o.data_pct = 20;
+    o.label_pct = 30;
+    o.comment_pct = 10;
+    o.macros = 4;
+    o.macro_lines = 3;
+    o.expansions = 8;
+    o.mat_max = 4;
+    o.externs = 4;
+    o.entries = 4;
+    o.seed = 1;
+    o.output = NULL;
+
+    for (i = 1; i < argc; i++) {
+        if (parse_argument(argv[i], &o) != 0) {
+            printf("Invalid option: %s\n", argv[i]);
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    /* header, externs, macro definitions, stop and entries come on top of the body */
+    fixed = 2 + o.externs + (long) o.macros * (o.macro_lines + 2) + o.entries;
+    if (o.lines < fixed) {
+        printf("--lines=%ld is too small for the requested externs, macros and entries (%ld)\n", o.lines, fixed);
+        return 1;
+    }
+    if (o.macros == 0) o.expansions = 0;
+
+    memset(&g, 0, sizeof(g));
+    g.rng = o.seed;
+    g.out = o.output ? fopen(o.output, "w") : stdout;
+    if (!g.out) {
+        printf("Cannot open %s\n", o.output);
+        return 1;
+    }
+
+    generate(&g, &o);
+
+    if (fflush(g.out) != 0 || ferror(g.out)) {
+        printf("Write failed\n");
+        if (o.output) fclose(g.out);
+        return 1;
+    }
+    if (o.output) fclose(g.out);
+    return 0;
+}